@@ -20,17 +20,35 @@
 #include "GenericAssetFactory.h"
 #include "AssetCache.h"
 #include "Platform.h"
+#include "AssetFileIndex.h"
+#include "JobSystem.h"
+#include <boost/bind.hpp>
 #include <QDir>
+#include <QTime>
 #include <QFileSystemWatcher>
 
+#include <algorithm>
+
 DEFINE_POCO_LOGGING_FUNCTIONS("Asset")
 
+/// Milliseconds after which AssetAPI::RecursiveFindFile rebuilds the index of a directory when a file is not found in it.
+static const int cRecursiveFindIndexLifetime = 5000;
+
+/// The default time the main thread may spend each frame on loading decoded assets, in milliseconds.
+static const float cDefaultLoadTimeBudget = 8.f;
+
 using namespace Foundation;
 
-AssetAPI::AssetAPI(bool isHeadless)
+AssetAPI::AssetAPI(Foundation::Framework *framework_, bool isHeadless)
 :assetCache(0),
 diskSourceChangeWatcher(0),
-isHeadless_(isHeadless)
+framework(framework_),
+isHeadless_(isHeadless),
+loadTimeBudget(cDefaultLoadTimeBudget),
+loadStartTime(0),
+firstAssetLoadTime(0),
+numAssetsLoaded(0),
+longestLoadFrame(0)
 {
     // The Asset API always understands at least this single built-in asset type "Binary".
     // You can use this type to request asset data as binary, without generating any kind of in-memory representation or loading for it.
@@ -256,23 +274,32 @@ QString AssetAPI::RecursiveFindFile(QString basePath, QString filename)
     if (boost::filesystem::exists(dir.absolutePath().toStdString()))
         return dir.absolutePath();
 
-    try
+    // Loading a scene looks up all its asset files under the same base path, so index the directory tree once instead of
+    // walking it for each file. These indices are not watched, so a file missing from an index older than
+    // cRecursiveFindIndexLifetime rebuilds the index.
+    static QHash<QString, boost::shared_ptr<AssetFileIndex> > indices;
+    static QHash<QString, QTime> indexTimes;
+    QString root = QDir(basePath).absolutePath();
+    boost::shared_ptr<AssetFileIndex> &index = indices[root];
+    QTime &indexTime = indexTimes[root];
+    if (!index)
     {
-        boost::filesystem::recursive_directory_iterator iter(basePath.toStdString());
-        boost::filesystem::recursive_directory_iterator end_iter;
-        // Check the subdir
-        for(; iter != end_iter; ++iter)
-        {
-            QDir dir(GuaranteeTrailingSlash(iter->path().string().c_str()) + filename);
-            if (!fs::is_regular_file(iter->status()) && boost::filesystem::exists(dir.absolutePath().toStdString()))
-                return dir.absolutePath();
-        }
+        index = boost::shared_ptr<AssetFileIndex>(new AssetFileIndex(root, false));
+        index->Rebuild();
+        indexTime.start();
     }
-    catch (...)
+
+    QString directory = index->FindDirectory(filename);
+    if (directory.isEmpty() && indexTime.elapsed() > cRecursiveFindIndexLifetime)
     {
+        index->Rebuild();
+        indexTime.start();
+        directory = index->FindDirectory(filename);
     }
 
-    return "";    
+    if (directory.isEmpty())
+        return "";
+    return QDir(GuaranteeTrailingSlash(directory) + filename).absolutePath();
 }
 
 AssetPtr AssetAPI::CreateAssetFromFile(QString assetType, QString assetFile)
@@ -476,6 +503,18 @@ void AssetAPI::ForgetAllAssets()
 
     assets.clear();
     currentTransfers.clear();
+    decodedTransfers.clear();
+    assetsByContentHash.clear();
+}
+
+void AssetAPI::ClearDecodedTransfers()
+{
+    decodedTransfers.clear();
+}
+
+bool AssetAPI::HasHigherPriority(const AssetTransferPtr &a, const AssetTransferPtr &b)
+{
+    return a->Priority() > b->Priority();
 }
 
 std::vector<AssetTransferPtr> AssetAPI::PendingTransfers()
@@ -589,19 +628,30 @@ AssetTransferPtr AssetAPI::RequestAsset(QString assetRef, QString assetType)
     {
         // The asset can be found from cache. Generate a 'virtual asset transfer' and return it to the client.
         transfer = AssetTransferPtr(new IAssetTransfer());
-        bool success = LoadFileToVector(assetFileInCache.toStdString().c_str(), transfer->rawAssetData);
-        if (!success)
-        {
-            LogError("AssetAPI::RequestAsset: Failed to load asset \"" + assetFileInCache + "\" from cache!");
-            return AssetTransferPtr();
-        }
         transfer->source.ref = assetRef;
         transfer->assetType = assetType;
         transfer->storage = AssetStorageWeakPtr(); // Note: Unfortunately when we load an asset from cache, we don't get the information about which storage it's supposed to come from.
         transfer->provider = provider;
         transfer->SetCachingBehavior(false, assetFileInCache);
-        LogDebug("AssetAPI::RequestAsset: Loaded asset \"" + assetRef + "\" from disk cache instead of having to use asset provider."); 
-        readyTransfers.push_back(transfer); // There is no assetprovider that will "push" the AssetTransferCompleted call. We have to remember to do it ourselves.
+        LogDebug("AssetAPI::RequestAsset: Loading asset \"" + assetRef + "\" from disk cache instead of having to use asset provider."); 
+
+        // Read the file in a worker thread. The continuation keeps the transfer alive until the read has finished.
+        Foundation::JobSystemPtr jobs = framework->GetJobSystem();
+        if (jobs)
+        {
+            Foundation::JobPtr job = jobs->Spawn(boost::bind(&IAssetTransfer::ReadRawAssetData, transfer.get(), assetFileInCache));
+            jobs->ContinueOnMainThread(job, boost::bind(&AssetAPI::CachedAssetRead, this, transfer, assetFileInCache));
+        }
+        else
+        {
+            bool success = LoadFileToVector(assetFileInCache.toStdString().c_str(), transfer->rawAssetData);
+            if (!success)
+            {
+                LogError("AssetAPI::RequestAsset: Failed to load asset \"" + assetFileInCache + "\" from cache!");
+                return AssetTransferPtr();
+            }
+            readyTransfers.push_back(transfer); // There is no assetprovider that will "push" the AssetTransferCompleted call. We have to remember to do it ourselves.
+        }
     }
     else // Can't find the asset in cache. Do a real request from the asset provider.
     {
@@ -799,8 +849,42 @@ AssetPtr AssetAPI::GetAsset(QString assetRef)
 
 AssetPtr AssetAPI::GetAssetByHash(QString assetHash)
 {
-    ///\todo Implement.
-    return AssetPtr();
+    assetHash = assetHash.trimmed().toLower();
+    QHash<QString, QList<AssetWeakPtr> >::iterator iter = assetsByContentHash.find(assetHash);
+    if (iter == assetsByContentHash.end())
+        return AssetPtr();
+
+    // The assets may have been reloaded with other content, or forgotten, after they were indexed. Drop those, newest first.
+    QList<AssetWeakPtr> &indexed = iter.value();
+    AssetPtr found;
+    for(int i = indexed.size() - 1; i >= 0 && !found; --i)
+    {
+        AssetPtr asset = indexed[i].lock();
+        if (asset && asset->ContentHash() == assetHash && GetAsset(asset->Name()) == asset)
+            found = asset;
+        else
+            indexed.removeAt(i);
+    }
+
+    if (indexed.isEmpty())
+        assetsByContentHash.erase(iter);
+    return found;
+}
+
+void AssetAPI::NotifyAssetContentHashChanged(AssetPtr asset)
+{
+    if (!asset || asset->ContentHash().isEmpty())
+        return;
+
+    // An asset reloaded back to content it had before may still be indexed under the hash
+    QList<AssetWeakPtr> &indexed = assetsByContentHash[asset->ContentHash()];
+    for(int i = 0; i < indexed.size(); ++i)
+        if (indexed[i].lock() == asset)
+        {
+            indexed.removeAt(i);
+            break;
+        }
+    indexed.append(asset);
 }
 
 void AssetAPI::Update(f64 frametime)
@@ -818,6 +902,103 @@ void AssetAPI::Update(f64 frametime)
     for(size_t i = 0; i < readyTransfers.size(); ++i)
         AssetTransferCompleted(readyTransfers[i].get());
     readyTransfers.clear();
+
+    LoadDecodedTransfers();
+    UpdateLoadStatistics(frametime);
+}
+
+void AssetAPI::CachedAssetRead(AssetTransferPtr transfer, QString assetFileInCache)
+{
+    if (transfer->rawAssetData.size() == 0)
+    {
+        AssetTransferFailed(transfer.get(), "Failed to load asset \"" + assetFileInCache + "\" from cache!");
+        return;
+    }
+
+    AssetTransferCompleted(transfer.get());
+}
+
+void AssetAPI::AssetTransferDecoded(AssetTransferPtr transfer)
+{
+    StoreTransferToCache(transfer);
+    decodedTransfers.push_back(transfer);
+}
+
+void AssetAPI::StoreTransferToCache(AssetTransferPtr transfer)
+{
+    // Save this asset to cache, and find out which file will represent a cached version of this asset.
+    QString assetDiskSource = transfer->DiskSource(); // The asset provider may have specified an explicit filename to use as a disk source.
+    if (transfer->CachingAllowed() && transfer->rawAssetData.size() > 0)
+        assetDiskSource = assetCache->StoreAsset(&transfer->rawAssetData[0], transfer->rawAssetData.size(), transfer->source.ref,
+            transfer->asset->PreparedContentHash()); // If the hash is empty, the cache computes it.
+    transfer->asset->SetDiskSource(assetDiskSource.trimmed());
+}
+
+void AssetAPI::LoadDecodedTransfers()
+{
+    if (decodedTransfers.empty())
+        return;
+
+    PROFILE(AssetAPI_LoadDecodedTransfers);
+
+    // Take the queue, so that the transfers queued while loading wait for the next frame.
+    std::vector<AssetTransferPtr> transfers;
+    transfers.swap(decodedTransfers);
+    std::stable_sort(transfers.begin(), transfers.end(), &AssetAPI::HasHigherPriority);
+
+    const tick_t budget = (tick_t)(loadTimeBudget * GetCurrentClockFreq() / 1000.f);
+    const tick_t start = GetCurrentClockTime();
+    size_t numLoaded = 0;
+    while(numLoaded < transfers.size())
+    {
+        LoadDecodedTransfer(transfers[numLoaded++]);
+        if (budget > 0 && GetCurrentClockTime() - start >= budget)
+            break;
+    }
+
+    decodedTransfers.insert(decodedTransfers.begin(), transfers.begin() + numLoaded, transfers.end());
+}
+
+void AssetAPI::LoadDecodedTransfer(AssetTransferPtr transfer)
+{
+    // The transfer may have been forgotten while its asset was being decoded.
+    AssetTransferMap::iterator iter = currentTransfers.find(transfer->source.ref);
+    if (iter == currentTransfers.end() || iter->second != transfer)
+        return;
+
+    const u8 *data = transfer->rawAssetData.size() > 0 ? &transfer->rawAssetData[0] : 0;
+    AssetLoadState loadState = transfer->asset->LoadFromFileInMemory(data, transfer->rawAssetData.size());
+
+    // If the asset is still processing the load it will itself invoke the callback,
+    // otherwise do it here for completed or failed asset loads.
+    if (loadState != ASSET_LOAD_PROCESSING)
+        OnTransferAssetLoadCompleted(transfer->source.ref, loadState);
+}
+
+void AssetAPI::UpdateLoadStatistics(f64 frametime)
+{
+    bool loading = !currentTransfers.empty() || !decodedTransfers.empty();
+    if (loading && !loadStartTime)
+    {
+        loadStartTime = GetCurrentClockTime();
+        firstAssetLoadTime = 0;
+        numAssetsLoaded = 0;
+        longestLoadFrame = 0;
+    }
+    else if (loading)
+    {
+        longestLoadFrame = std::max(longestLoadFrame, frametime);
+    }
+    else if (loadStartTime)
+    {
+        const f64 freq = (f64)GetCurrentClockFreq();
+        f64 total = (GetCurrentClockTime() - loadStartTime) / freq;
+        f64 first = firstAssetLoadTime ? (firstAssetLoadTime - loadStartTime) / freq : total;
+        if (numAssetsLoaded > 0)
+            LogInfo("Loaded " + QString::number(numAssetsLoaded) + " assets in " + QString::number(total, 'f', 3) + " s. The first asset was loaded after " +
+                QString::number(first, 'f', 3) + " s, the longest frame took " + QString::number(longestLoadFrame * 1000.0, 'f', 1) + " ms.");
+        loadStartTime = 0;
+    }
 }
 
 QString GuaranteeTrailingSlash(const QString &source)
@@ -871,23 +1052,26 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
         return;
     }
 
-    // Save this asset to cache, and find out which file will represent a cached version of this asset.
-    QString assetDiskSource = transfer->DiskSource(); // The asset provider may have specified an explicit filename to use as a disk source.
-    if (transfer->CachingAllowed() && transfer->rawAssetData.size() > 0)
-        assetDiskSource = assetCache->StoreAsset(&transfer->rawAssetData[0], transfer->rawAssetData.size(), transfer->source.ref, ""); ///\todo Specify the content hash.
-
     // Save for the asset the storage and provider it came from.
-    transfer->asset->SetDiskSource(assetDiskSource.trimmed());
     transfer->asset->SetAssetStorage(transfer->storage.lock());
     transfer->asset->SetAssetProvider(transfer->provider.lock());
     transfer->asset->SetAssetTransfer(transfer);
 
-    AssetLoadState loadState = transfer->asset->LoadFromFileInMemory(&transfer->rawAssetData[0], transfer->rawAssetData.size());
-
-    // If the asset is still processing the load it will itself invoke the callback,
-    // otherwise do it here for completed or failed asset loads.
-    if (loadState != ASSET_LOAD_PROCESSING)
-        OnTransferAssetLoadCompleted(transfer->source.ref, loadState);
+    // Decode the asset in a worker thread. The rest of the load is done in the main thread by Update, within the load time budget.
+    // The continuation keeps the transfer, and so the asset and its data, alive until the decoding has finished.
+    // The data is stored in the asset cache after decoding, with the content hash computed by the decoding job.
+    Foundation::JobSystemPtr jobs = framework->GetJobSystem();
+    if (jobs && transfer->rawAssetData.size() > 0)
+    {
+        Foundation::JobPtr job = jobs->Spawn(boost::bind(&IAsset::PrepareFromFileInMemory, transfer->asset.get(),
+            &transfer->rawAssetData[0], transfer->rawAssetData.size()));
+        jobs->ContinueOnMainThread(job, boost::bind(&AssetAPI::AssetTransferDecoded, this, transfer));
+    }
+    else
+    {
+        StoreTransferToCache(transfer);
+        decodedTransfers.push_back(transfer);
+    }
 }
 
 void AssetAPI::OnTransferAssetLoadCompleted(const QString assetRef, AssetLoadState result)
@@ -909,6 +1093,10 @@ void AssetAPI::OnTransferAssetLoadCompleted(const QString assetRef, AssetLoadSta
 
     if (result == ASSET_LOAD_SUCCESFULL)
     {
+        if (loadStartTime && !firstAssetLoadTime)
+            firstAssetLoadTime = GetCurrentClockTime();
+        ++numAssetsLoaded;
+
         // Add the loaded asset to the internal asset map
         AssetMap::iterator iter2 = assets.find(transfer->source.ref);
         if (iter2 != assets.end())
@@ -1057,6 +1245,10 @@ void AssetAPI::RequestAssetDependencies(AssetPtr asset)
     // Make sure we have most up-to-date internal view of the asset dependencies.
     NotifyAssetDependenciesChanged(asset);
 
+    // The dependencies are loaded at least with the priority of the asset that needs them.
+    AssetTransferPtr parentTransfer = GetPendingTransfer(asset->Name());
+    float priority = parentTransfer ? parentTransfer->Priority() : 0.f;
+
     std::vector<AssetReference> refs = asset->FindReferences();
     for(size_t i = 0; i < refs.size(); ++i)
     {
@@ -1070,7 +1262,9 @@ void AssetAPI::RequestAssetDependencies(AssetPtr asset)
         else // We don't have the given asset yet, request it.
         {
             LogDebug("Asset " + asset->ToString() + " depends on asset " + ref + " which has not been loaded yet. Requesting..");
-            RequestAsset(ref);
+            AssetTransferPtr transfer = RequestAsset(ref);
+            if (transfer && transfer->Priority() < priority)
+                transfer->SetPriority(priority);
         }
     }
 }
@@ -4,11 +4,13 @@
 #define incl_Asset_AssetAPI_h
 
 #include <QObject>
+#include <QHash>
 #include <vector>
 #include <utility>
 #include <map>
 
 #include "CoreTypes.h"
+#include "HighPerfClock.h"
 #include "AssetFwd.h"
 #include "AssetEnum.h"
 
@@ -35,7 +37,7 @@ class AssetAPI : public QObject
     Q_OBJECT
 
 public:
-    AssetAPI(bool isHeadless);
+    AssetAPI(Foundation::Framework *framework, bool isHeadless);
 
     ~AssetAPI();
 
@@ -68,6 +70,9 @@ public:
     /// Returns all the currently ongoing or waiting asset transfers.
     std::vector<AssetTransferPtr> PendingTransfers();
 
+    /// Orders the asset transfers by priority, the highest priority first. Use with std::stable_sort to keep the request order within a priority.
+    static bool HasHigherPriority(const AssetTransferPtr &a, const AssetTransferPtr &b);
+
     /// Performs internal tick-based updates of the whole asset system. This function is intended to be called only by the core, do not call
     /// it yourself.
     void Update(f64 frametime);
@@ -138,6 +143,14 @@ public slots:
     /// Same as RequestAsset(assetRef, assetType), but provided for convenience with the AssetReference type.
     AssetTransferPtr RequestAsset(const AssetReference &ref);
 
+    /// Sets the time the main thread may spend each frame on loading the assets that have been downloaded and decoded.
+    /** The assets are loaded in the order of the priorities of their transfers. At least one asset is loaded each frame.
+        @param milliseconds The time budget per frame. 0 loads all the decoded assets each frame. */
+    void SetLoadTimeBudget(float milliseconds) { loadTimeBudget = milliseconds; }
+
+    /// Returns the time the main thread may spend each frame on loading assets, in milliseconds.
+    float LoadTimeBudget() const { return loadTimeBudget; }
+
     /// Returns the asset provider that is used to fetch assets from the given full URL.
     /** Example: GetProviderForAssetRef("local://my.mesh") will return an instance of LocalAssetProvider.
         @param assetRef The asset reference name to query a provider for.
@@ -179,8 +192,12 @@ public slots:
     AssetPtr GetAsset(QString assetRef);
     
     /// Returns the given asset by the specified SHA-1 content hash. If no such asset exists, returns null.
+    /// If several loaded assets have the same content, the one loaded last is returned.
     AssetPtr GetAssetByHash(QString assetHash);
 
+    /// Called by IAsset when the content hash of an asset changes as it is loaded. Do not call this function from client code.
+    void NotifyAssetContentHashChanged(AssetPtr asset);
+
     /// Returns the asset cache object that genereates a disk source for all assets.
     AssetCache *GetAssetCache() { return assetCache; }
 
@@ -235,7 +252,8 @@ public slots:
 
     /// Recursively iterates through the given path and all its subdirectories and tries to find the given file.
     /** Returns the absolute path for that file, if it exists. The path contains the filename,
-        i.e. it is of form "C:\folder\file.ext" or "/home/username/file.ext". */
+        i.e. it is of form "C:\folder\file.ext" or "/home/username/file.ext".
+        The directory tree is indexed on the first call for each path, and the index is used by the later calls. */
     static QString RecursiveFindFile(QString basePath, QString filename);
 
     /// Removes the given asset from the system and frees up all resources related to it. Any assets depending on this asset will break.
@@ -300,6 +318,10 @@ public slots:
         @note Do not dereference any asset pointers that might have been left over after calling this function. */
     void ForgetAllAssets();
 
+    /// Drops the transfers whose assets have been decoded, but not loaded yet.
+    /** Framework calls this at exit before unloading the modules, so that the assets are not released after the modules that implement them. */
+    void ClearDecodedTransfers();
+
     /// Returns a pointer to an existing asset transfer if one is in-progress for the given assetRef. Returns a null pointer if no transfer exists, in which
     /// case the asset may already have been loaded to the system (or not). It can be that an asset is loaded to the system, but one or more of its dependencies
     /// have not, in which case there exists both an IAssetTransfer and IAsset to this particular assetRef (so the existence of these two objects is not
@@ -339,6 +361,27 @@ private slots:
     void OnAssetDiskSourceChanged(const QString &path);
 
 private:
+    /// Queues a transfer, whose asset has been decoded in a worker thread, to be loaded within the load time budget.
+    void AssetTransferDecoded(AssetTransferPtr transfer);
+
+    /// Stores the data of a downloaded transfer in the asset cache, if caching is allowed, and sets the asset's disk source.
+    /// Uses the content hash computed when the asset was decoded, if any, so that the data is not hashed again.
+    void StoreTransferToCache(AssetTransferPtr transfer);
+
+    /// Finishes a transfer whose asset data was read from the asset cache in a worker thread.
+    void CachedAssetRead(AssetTransferPtr transfer, QString assetFileInCache);
+
+    /// Loads the assets of the decoded transfers, highest priority first, until the load time budget of this frame is used.
+    void LoadDecodedTransfers();
+
+    /// Loads the asset of a decoded transfer in the main thread.
+    void LoadDecodedTransfer(AssetTransferPtr transfer);
+
+    /// Tracks the time it takes to load a burst of assets, and logs it when all the transfers have finished.
+    void UpdateLoadStatistics(f64 frametime);
+
+    Foundation::Framework *framework;
+
     bool isHeadless_;
 
     typedef std::map<QString, AssetTransferPtr, AssetAPI::QStringLessThanNoCase> AssetTransferMap;
@@ -362,6 +405,24 @@ private:
     /// by one frame, so that the client gets a chance to connect his handler's Qt signals to the AssetTransferPtr slots.
     std::vector<AssetTransferPtr> readyTransfers;
 
+    /// The transfers whose assets have been decoded in a worker thread, waiting to be loaded in the main thread.
+    std::vector<AssetTransferPtr> decodedTransfers;
+
+    /// The time the main thread may spend each frame on loading the decoded assets, in milliseconds.
+    float loadTimeBudget;
+
+    /// Time when the current burst of asset loads started, or 0 if no assets are being loaded.
+    tick_t loadStartTime;
+
+    /// Time when the first asset of the current burst was loaded, or 0 if none has been loaded yet.
+    tick_t firstAssetLoadTime;
+
+    /// Number of assets loaded in the current burst.
+    int numAssetsLoaded;
+
+    /// The longest frame during the current burst, in seconds.
+    f64 longestLoadFrame;
+
     /// Contains all known asset storages in the system.
 //    std::vector<AssetStoragePtr> storages;
 
@@ -385,6 +446,10 @@ private:
     /// Stores all the already loaded assets in the system.
     AssetMap assets;
 
+    /// Maps the content hashes to the assets loaded with that content, in load order. The entries are checked on lookup, as assets are
+    /// reloaded and forgotten.
+    QHash<QString, QList<AssetWeakPtr> > assetsByContentHash;
+
     /// Tracks all loaded assets if their DiskSources change, and issues a reload of the assets.
     QFileSystemWatcher *diskSourceChangeWatcher;
 
@@ -13,11 +13,36 @@
 #include <QDataStream>
 #include <QCryptographicHash>
 #include <QScopedPointer>
+#include <QDateTime>
+#include <QPair>
+#include <QSet>
+#include <QtAlgorithms>
 
 #include "MemoryLeakCheck.h"
 
 DEFINE_POCO_LOGGING_FUNCTIONS("AssetCache")
 
+/// Identifies the index log file of the asset cache.
+static const quint32 cIndexMagic = 0x58494341; // "ACIX"
+
+/// Version of the index log format.
+static const quint32 cIndexVersion = 2;
+
+/// The index log is rewritten when opened if it has more than this many records per index entry.
+static const int cMaxIndexRecordsPerEntry = 2;
+
+/// Maximum size of the data in the cache, unless set otherwise.
+static const qint64 cDefaultMaximumCacheSize = 1024LL * 1024 * 1024;
+
+/// The last access time of data is logged at most this often, in seconds, so that reading assets rarely writes to the index log.
+static const uint cAccessTimeResolution = 60;
+
+/// Returns the current time in seconds since the epoch.
+static uint CurrentTime()
+{
+    return QDateTime::currentDateTime().toTime_t();
+}
+
 QString SanitateAssetRefForCache(QString assetRef)
 { 
     assetRef.replace("/", "_");
@@ -38,7 +63,9 @@ QString SanitateAssetRefForCache(QString assetRef)
 AssetCache::AssetCache(AssetAPI *owner, QString assetCacheDirectory) : 
     QNetworkDiskCache(owner),
     assetAPI(owner),
-    cacheDirectory(GuaranteeTrailingSlash(assetCacheDirectory))
+    cacheDirectory(GuaranteeTrailingSlash(assetCacheDirectory)),
+    numIndexRecords(0),
+    totalSize(0)
 {
     LogInfo("Using AssetCache in directory '" + assetCacheDirectory.toStdString() + "'");
 
@@ -63,20 +90,26 @@ AssetCache::AssetCache(AssetAPI *owner, QString assetCacheDirectory) :
 
     // Set for QNetworkDiskCache
     setCacheDirectory(cacheDirectory);
+    setMaximumCacheSize(cDefaultMaximumCacheSize);
+
+    LoadIndex();
+    expire();
 }
 
 QIODevice* AssetCache::data(const QUrl &url)
 {
     QScopedPointer<QFile> dataFile;
-    QString absoluteDataFile = GetAbsoluteFilePath(false, url);
+    QString absoluteDataFile = GetDataFilePath(url);
     if (QFile::exists(absoluteDataFile))
     {
+        // The data can be shared with other urls, so don't allow writing to it.
         dataFile.reset(new QFile(absoluteDataFile));
-        if (!dataFile->open(QIODevice::ReadWrite))
+        if (!dataFile->open(QIODevice::ReadOnly))
         {
             dataFile.reset();
             return 0;
         }
+        Touch(IndexKey(url));
     }
     // It is the callers responsibility to delete this ptr as said by the Qt docs.
     // This will most likely happen when QNetworkReply->deleteLater() is called, meaning next qt mainloop cycle from that call.
@@ -86,12 +119,14 @@ QIODevice* AssetCache::data(const QUrl &url)
 void AssetCache::insert(QIODevice* device)
 {
     // We own this ptr from prepare()
+    QString url;
     QHashIterator<QString, QFile*> it(preparedItems);
     while (it.hasNext())
     {
         it.next();
         if (it.value() == device)
         {
+            url = it.key();
             preparedItems.remove(it.key());
             break;
         }
@@ -100,12 +135,29 @@ void AssetCache::insert(QIODevice* device)
     // use this ptr to deserialize the content to and IAsset after this call return.
     device->close();
     device->deleteLater();
+
+    QFile *dataFile = qobject_cast<QFile*>(device);
+    if (url.isEmpty() || !dataFile)
+        return;
+
+    // Verify the data once here, rather than each time it is read.
+    QUrl dataUrl(url);
+    if (!VerifyCacheContentDigest(dataFile->fileName(), metaDatas.value(IndexKey(dataUrl))))
+    {
+        // Make sure that neither the data nor its metadata is left to be served as the cached asset.
+        LogError("Detected corrupted data, not caching " + url);
+        QFile::remove(dataFile->fileName());
+        UnindexAsset(IndexKey(dataUrl));
+        return;
+    }
+
+    // Move the written data to the content store.
+    StoreDataFile(dataUrl, dataFile->fileName(), "");
 }
 
 QIODevice* AssetCache::prepare(const QNetworkCacheMetaData &metaData)
 {
-    if (!WriteMetadata(GetAbsoluteFilePath(true, metaData.url()), metaData))
-        return 0;
+    SetMetaData(metaData);
     QScopedPointer<QFile> dataFile(new QFile(GetAbsoluteFilePath(false, metaData.url())));
     if (!dataFile->open(QIODevice::ReadWrite))
     {
@@ -155,6 +207,7 @@ bool AssetCache::remove(const QUrl &url)
         success = QFile::remove(absoluteMetaDataFile);
     if (!success)
         return false;
+    UnindexAsset(IndexKey(url));
     QString absoluteDataFile = GetAbsoluteFilePath(false, url);
     if (QFile::exists(absoluteDataFile))
         success = QFile::remove(absoluteDataFile);
@@ -163,6 +216,11 @@ bool AssetCache::remove(const QUrl &url)
 
 QNetworkCacheMetaData AssetCache::metaData(const QUrl &url)
 {
+    QHash<QString, QNetworkCacheMetaData>::const_iterator iter = metaDatas.find(IndexKey(url));
+    if (iter != metaDatas.end())
+        return iter.value();
+
+    // Move the metadata file of an older cache to the index.
     QNetworkCacheMetaData resultMetaData;
     QString absoluteMetaDataFile = GetAbsoluteFilePath(true, url);
     if (QFile::exists(absoluteMetaDataFile))
@@ -174,21 +232,9 @@ QNetworkCacheMetaData AssetCache::metaData(const QUrl &url)
             metaDataStream >> resultMetaData;
             metaDataFile.close();
         }
-    }
-
-    // If we have a cache data file also, verify data integrity.
-    // If the file is corrupted, return empty metadata to trigger a new full fetch for data.
-    if (resultMetaData.isValid())
-    {
-        QString absoluteDataFile = GetAbsoluteFilePath(false, url);
-        if (QFile::exists(absoluteDataFile))
-        {
-            if (!VerifyCacheContentDigest(absoluteDataFile, resultMetaData))
-            {
-                LogError("Detected a corrupted cache file, triggering a full fetch for " + url.toString());
-                return QNetworkCacheMetaData();
-            }
-        }
+        if (resultMetaData.isValid())
+            SetMetaData(resultMetaData);
+        QFile::remove(absoluteMetaDataFile);
     }
 
     return resultMetaData;
@@ -199,7 +245,7 @@ void AssetCache::updateMetaData(const QNetworkCacheMetaData &metaData)
     const QNetworkCacheMetaData oldMetaData = this->metaData(metaData.url());
     if (oldMetaData.isValid())
         if (oldMetaData != metaData)
-            WriteMetadata(GetAbsoluteFilePath(true, metaData.url()), metaData);
+            SetMetaData(metaData);
 }
 
 void AssetCache::clear()
@@ -209,8 +255,10 @@ void AssetCache::clear()
 
 qint64 AssetCache::expire()
 {
-    // Skip keeping cache at some static size, unlimited for now.
-    return maximumCacheSize() / 2;
+    if (totalSize <= maximumCacheSize())
+        return totalSize;
+    // Leave room below the maximum, so that the next insertions do not evict data again.
+    return Evict(maximumCacheSize() - maximumCacheSize() / 10);
 }
 
 QString AssetCache::GetDiskSource(const QString &assetRef)
@@ -225,17 +273,50 @@ QString AssetCache::GetDiskSource(const QString &assetRef)
 
 QString AssetCache::GetDiskSource(const QUrl &assetUrl)
 {
-    QString absolutePath = assetDataDir.absolutePath() + "/" + SanitateAssetRefForCache(assetUrl.toString());
+    QString absolutePath = GetDataFilePath(assetUrl);
+    if (!QFile::exists(absolutePath))
+        return "";
+    Touch(IndexKey(assetUrl));
+    return absolutePath;
+}
+
+QString AssetCache::GetDiskSourceByContentHash(const QString &contentHash)
+{
+    QHash<QString, Content>::const_iterator iter = contents.find(contentHash.trimmed().toLower());
+    if (iter == contents.end())
+        return "";
+    QString absolutePath = assetDataDir.absolutePath() + "/" + iter.value().fileName;
     if (QFile::exists(absolutePath))
         return absolutePath;
     return "";
 }
 
-QString AssetCache::GetDiskSourceByContentHash(const QString &contentHash)
+QString AssetCache::GetContentHash(const QString &assetRef)
 {
-    /// \todo Implement.
-    LogWarning("AssetCache::GetDiskSourceByContentHash not implemented yet.");
-    return "";
+    return assetHashes.value(IndexKey(QUrl(assetRef, QUrl::TolerantMode)));
+}
+
+QString AssetCache::StoreAssetByContentHash(const QString &assetRef, const QString &contentHash)
+{
+    QString hash = contentHash.trimmed().toLower();
+    QString absolutePath = GetDiskSourceByContentHash(hash);
+    if (absolutePath.isEmpty())
+        return "";
+
+    Content content = contents.value(hash);
+    IndexAsset(IndexKey(QUrl(assetRef, QUrl::TolerantMode)), hash, content.fileName, content.size);
+    return absolutePath;
+}
+
+int AssetCache::NumContentReferences(const QString &contentHash) const
+{
+    return contents.value(contentHash.trimmed().toLower()).numRefs;
+}
+
+void AssetCache::SetMaximumSize(qint64 maxBytes)
+{
+    setMaximumCacheSize(maxBytes);
+    expire();
 }
 
 QString AssetCache::GetCacheDirectory() const
@@ -247,15 +328,31 @@ QString AssetCache::StoreAsset(AssetPtr asset)
 {
     std::vector<u8> data;
     asset->SerializeTo(data);
-    return StoreAsset(&data[0], data.size(), asset->Name(), asset->ContentHash()); /// \todo Content hash can mismatch here.
+    if (data.size() == 0)
+        return "";
+    // The serialized data can differ from the data the asset was loaded from, so its content hash is computed again.
+    return StoreAsset(&data[0], data.size(), asset->Name(), "");
 }
 
 QString AssetCache::StoreAsset(const u8 *data, size_t numBytes, const QString &assetName, const QString &assetContentHash)
 {
-    QString absolutePath = GetAbsoluteDataFilePath(assetName);
+    QString contentHash = assetContentHash.trimmed().toLower();
+    if (contentHash.isEmpty())
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData((const char*)data, numBytes);
+        contentHash = hash.result().toHex();
+    }
+
+    // If the same data is already stored, only index the asset.
+    QString absolutePath = StoreAssetByContentHash(assetName, contentHash);
+    if (!absolutePath.isEmpty())
+        return absolutePath;
+
+    absolutePath = GetAbsoluteDataFilePath(assetName);
     bool success = SaveAssetFromMemoryToFile(data, numBytes, absolutePath.toStdString().c_str());
     if (success)
-        return absolutePath;
+        return StoreDataFile(QUrl(assetName, QUrl::TolerantMode), absolutePath, contentHash);
     return "";
 }
 
@@ -274,26 +371,11 @@ void AssetCache::ClearAssetCache()
 {
     ClearDirectory(assetDataDir.absolutePath());
     ClearDirectory(assetMetaDataDir.absolutePath());
-}
-
-bool AssetCache::WriteMetadata(const QString &filePath, const QNetworkCacheMetaData &metaData)
-{
-    QFile metaDataFile(filePath);
-    if (!metaDataFile.open(QIODevice::WriteOnly))
-    {
-        LogError("AssetCache::WriteMetadata Could not open metadata file: " + filePath.toStdString());
-        return false;
-    }
-    if (!metaDataFile.resize(0))
-    {
-        LogError("AssetCache::WriteMetadata Could not reset metadata file: " + filePath.toStdString());
-        return false;
-    }
-
-    QDataStream metaDataStream(&metaDataFile);
-    metaDataStream << metaData;
-    metaDataFile.close();
-    return true;
+    assetHashes.clear();
+    contents.clear();
+    metaDatas.clear();
+    totalSize = 0;
+    WriteIndex();
 }
 
 bool AssetCache::VerifyCacheContentDigest(const QString &absoluteDataFilePath, const QNetworkCacheMetaData &metaData)
@@ -381,6 +463,379 @@ void AssetCache::ClearDirectory(const QString &absoluteDirPath)
     }
 }
 
+QString AssetCache::GetDataFilePath(const QUrl &url)
+{
+    QHash<QString, QString>::const_iterator iter = assetHashes.find(IndexKey(url));
+    if (iter != assetHashes.end())
+    {
+        QHash<QString, Content>::const_iterator content = contents.find(iter.value());
+        if (content != contents.end())
+            return assetDataDir.absolutePath() + "/" + content.value().fileName;
+    }
+    return GetAbsoluteFilePath(false, url);
+}
+
+QString AssetCache::StoreDataFile(const QUrl &url, const QString &absoluteFilePath, const QString &contentHash)
+{
+    QString hash = contentHash.isEmpty() ? ComputeContentHash(absoluteFilePath) : contentHash;
+    if (hash.isEmpty())
+    {
+        LogError("AssetCache::StoreDataFile Could not read data file " + absoluteFilePath.toStdString());
+        QFile::remove(absoluteFilePath);
+        return "";
+    }
+
+    QString fileName;
+    qint64 size = 0;
+    QString existingPath = GetDiskSourceByContentHash(hash);
+    if (!existingPath.isEmpty())
+    {
+        // The same data is already stored for another url.
+        fileName = contents[hash].fileName;
+        size = contents[hash].size;
+        QFile::remove(absoluteFilePath);
+    }
+    else
+    {
+        size = QFileInfo(absoluteFilePath).size();
+        if (totalSize + size > maximumCacheSize())
+            Evict(maximumCacheSize() - maximumCacheSize() / 10 - size);
+
+        // Keep the suffix of the url, Ogre picks the codec of a resource by its file name.
+        QString suffix = SanitateAssetRefForCache(QFileInfo(url.path()).suffix().toLower());
+        fileName = suffix.isEmpty() ? hash : hash + "." + suffix;
+        QString targetPath = assetDataDir.absolutePath() + "/" + fileName;
+        if (QFile::exists(targetPath))
+            QFile::remove(targetPath);
+        if (!QFile::rename(absoluteFilePath, targetPath))
+        {
+            LogError("AssetCache::StoreDataFile Could not move " + absoluteFilePath.toStdString() + " to " + targetPath.toStdString());
+            QFile::remove(absoluteFilePath);
+            return "";
+        }
+    }
+
+    IndexAsset(IndexKey(url), hash, fileName, size);
+    return assetDataDir.absolutePath() + "/" + fileName;
+}
+
+void AssetCache::IndexAsset(const QString &key, const QString &contentHash, const QString &fileName, qint64 size)
+{
+    QString released = AddReference(key, contentHash, fileName, size, CurrentTime());
+    AppendIndexRecord(AssetRecord(key));
+    if (!released.isEmpty())
+        QFile::remove(assetDataDir.absolutePath() + "/" + released);
+}
+
+void AssetCache::UnindexAsset(const QString &key)
+{
+    if (!assetHashes.contains(key) && !metaDatas.contains(key))
+        return;
+
+    metaDatas.remove(key);
+    QString released = RemoveReference(key);
+    AppendIndexRecord(RemovalRecord(key));
+    if (!released.isEmpty())
+        QFile::remove(assetDataDir.absolutePath() + "/" + released);
+}
+
+QString AssetCache::AddReference(const QString &key, const QString &contentHash, const QString &fileName, qint64 size, uint lastAccess)
+{
+    QString released;
+    QString oldHash = assetHashes.value(key);
+    if (!oldHash.isEmpty() && oldHash != contentHash)
+        released = RemoveReference(key);
+
+    QHash<QString, Content>::iterator iter = contents.find(contentHash);
+    if (iter == contents.end())
+    {
+        iter = contents.insert(contentHash, Content());
+        iter.value().size = size;
+        totalSize += size;
+    }
+    Content &content = iter.value();
+    content.fileName = fileName;
+    content.lastAccess = qMax(content.lastAccess, lastAccess);
+    if (oldHash != contentHash)
+    {
+        assetHashes[key] = contentHash;
+        ++content.numRefs;
+    }
+    return released;
+}
+
+QString AssetCache::RemoveReference(const QString &key)
+{
+    QHash<QString, QString>::iterator iter = assetHashes.find(key);
+    if (iter == assetHashes.end())
+        return "";
+    QString contentHash = iter.value();
+    assetHashes.erase(iter);
+
+    QHash<QString, Content>::iterator content = contents.find(contentHash);
+    if (content == contents.end() || --content.value().numRefs > 0)
+        return "";
+    QString fileName = content.value().fileName;
+    totalSize -= content.value().size;
+    contents.erase(content);
+    return fileName;
+}
+
+void AssetCache::Touch(const QString &key)
+{
+    QHash<QString, QString>::const_iterator iter = assetHashes.find(key);
+    if (iter == assetHashes.end())
+        return;
+    QHash<QString, Content>::iterator content = contents.find(iter.value());
+    if (content == contents.end())
+        return;
+
+    uint now = CurrentTime();
+    if (now - content.value().lastAccess < cAccessTimeResolution)
+        return;
+    content.value().lastAccess = now;
+    AppendIndexRecord(AccessRecord(iter.value()));
+}
+
+void AssetCache::SetMetaData(const QNetworkCacheMetaData &metaData)
+{
+    QString key = IndexKey(metaData.url());
+    metaDatas[key] = metaData;
+    AppendIndexRecord(MetaDataRecord(key));
+}
+
+qint64 AssetCache::Evict(qint64 targetSize)
+{
+    // Sort the data by the last access time, the least recently used first.
+    QList<QPair<uint, QString> > byAccess;
+    for(QHash<QString, Content>::const_iterator iter = contents.begin(); iter != contents.end(); ++iter)
+        byAccess.append(qMakePair(iter.value().lastAccess, iter.key()));
+    qSort(byAccess);
+
+    QSet<QString> evicted;
+    qint64 size = totalSize;
+    for(int i = 0; i < byAccess.size() && size > targetSize; ++i)
+    {
+        // Keep the data of loaded assets, it is still used as their disk source.
+        const QString &contentHash = byAccess[i].second;
+        if (assetAPI && assetAPI->GetAssetByHash(contentHash))
+            continue;
+        evicted.insert(contentHash);
+        size -= contents[contentHash].size;
+    }
+    if (evicted.isEmpty())
+        return totalSize;
+
+    QStringList keys;
+    for(QHash<QString, QString>::const_iterator iter = assetHashes.begin(); iter != assetHashes.end(); ++iter)
+        if (evicted.contains(iter.value()))
+            keys.append(iter.key());
+    foreach(const QString &key, keys)
+    {
+        metaDatas.remove(key);
+        QString released = RemoveReference(key);
+        if (!released.isEmpty())
+            QFile::remove(assetDataDir.absolutePath() + "/" + released);
+    }
+
+    LogDebug("AssetCache: Evicted " + QString::number(evicted.size()).toStdString() + " data files of " +
+        QString::number(keys.size()).toStdString() + " assets, " + QString::number(totalSize).toStdString() + " bytes in the cache.");
+
+    // Rewrite the index once rather than logging a removal for each url.
+    WriteIndex();
+    return totalSize;
+}
+
+QString AssetCache::GetIndexFilePath() const
+{
+    return cacheDirectory + "index";
+}
+
+void AssetCache::LoadIndex()
+{
+    QFile indexFile(GetIndexFilePath());
+    if (!indexFile.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&indexFile);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != cIndexMagic || version < 1 || version > cIndexVersion)
+    {
+        LogWarning("AssetCache: Ignoring the index " + GetIndexFilePath().toStdString() + " of an unknown format.");
+        indexFile.close();
+        WriteIndex();
+        return;
+    }
+
+    bool truncated = false;
+    while(!stream.atEnd())
+    {
+        quint8 type = 0;
+        QString key, contentHash, fileName;
+        qint64 size = 0;
+        quint32 lastAccess = 0;
+        QNetworkCacheMetaData metaData;
+
+        if (version == 1)
+        {
+            // Version 1 logged only the urls referring to data, with an empty content hash for removals.
+            stream >> key >> contentHash >> fileName;
+            type = contentHash.isEmpty() ? IndexRecordRemoval : IndexRecordAsset;
+            if (type == IndexRecordAsset)
+            {
+                QFileInfo dataFile(assetDataDir.absolutePath() + "/" + fileName);
+                size = dataFile.size();
+                lastAccess = dataFile.lastModified().toTime_t();
+            }
+        }
+        else
+        {
+            stream >> type;
+            switch(type)
+            {
+            case IndexRecordAsset:
+                stream >> key >> contentHash >> fileName >> size >> lastAccess;
+                break;
+            case IndexRecordRemoval:
+                stream >> key;
+                break;
+            case IndexRecordAccess:
+                stream >> contentHash >> lastAccess;
+                break;
+            case IndexRecordMetaData:
+                stream >> key >> metaData;
+                break;
+            default:
+                stream.setStatus(QDataStream::ReadCorruptData);
+                break;
+            }
+        }
+        if (stream.status() != QDataStream::Ok)
+        {
+            truncated = true;
+            break;
+        }
+
+        if (type == IndexRecordAsset)
+            AddReference(key, contentHash, fileName, size, lastAccess);
+        else if (type == IndexRecordRemoval)
+        {
+            metaDatas.remove(key);
+            RemoveReference(key);
+        }
+        else if (type == IndexRecordAccess)
+        {
+            QHash<QString, Content>::iterator content = contents.find(contentHash);
+            if (content != contents.end())
+                content.value().lastAccess = qMax(content.value().lastAccess, (uint)lastAccess);
+        }
+        else
+            metaDatas[key] = metaData;
+        ++numIndexRecords;
+    }
+    indexFile.close();
+
+    LogDebug("AssetCache: Indexed " + QString::number(assetHashes.size()).toStdString() + " assets with " +
+        QString::number(contents.size()).toStdString() + " distinct contents, " + QString::number(totalSize).toStdString() + " bytes.");
+
+    // Drop the records of removed and replaced assets and the old access times, and a partially written last record.
+    if (truncated || version != cIndexVersion || numIndexRecords > cMaxIndexRecordsPerEntry * NumIndexEntries())
+        WriteIndex();
+}
+
+void AssetCache::WriteIndex()
+{
+    QString tempPath = GetIndexFilePath() + ".tmp";
+    QFile indexFile(tempPath);
+    if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LogError("AssetCache::WriteIndex Could not open index file: " + tempPath.toStdString());
+        return;
+    }
+
+    QDataStream stream(&indexFile);
+    stream << cIndexMagic << cIndexVersion;
+    for(QHash<QString, QString>::const_iterator iter = assetHashes.begin(); iter != assetHashes.end(); ++iter)
+        indexFile.write(AssetRecord(iter.key()));
+    for(QHash<QString, QNetworkCacheMetaData>::const_iterator iter = metaDatas.begin(); iter != metaDatas.end(); ++iter)
+        indexFile.write(MetaDataRecord(iter.key()));
+    indexFile.close();
+
+    QFile::remove(GetIndexFilePath());
+    if (!QFile::rename(tempPath, GetIndexFilePath()))
+        LogError("AssetCache::WriteIndex Could not replace index file: " + GetIndexFilePath().toStdString());
+    numIndexRecords = NumIndexEntries();
+}
+
+void AssetCache::AppendIndexRecord(const QByteArray &record)
+{
+    QFile indexFile(GetIndexFilePath());
+    if (!indexFile.exists())
+        WriteIndex();
+    if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        LogError("AssetCache::AppendIndexRecord Could not open index file: " + GetIndexFilePath().toStdString());
+        return;
+    }
+
+    indexFile.write(record);
+    indexFile.close();
+    ++numIndexRecords;
+}
+
+QByteArray AssetCache::AssetRecord(const QString &key) const
+{
+    QString contentHash = assetHashes.value(key);
+    Content content = contents.value(contentHash);
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << (quint8)IndexRecordAsset << key << contentHash << content.fileName << content.size << (quint32)content.lastAccess;
+    return record;
+}
+
+QByteArray AssetCache::RemovalRecord(const QString &key) const
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << (quint8)IndexRecordRemoval << key;
+    return record;
+}
+
+QByteArray AssetCache::AccessRecord(const QString &contentHash) const
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << (quint8)IndexRecordAccess << contentHash << (quint32)contents.value(contentHash).lastAccess;
+    return record;
+}
+
+QByteArray AssetCache::MetaDataRecord(const QString &key) const
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << (quint8)IndexRecordMetaData << key << metaDatas.value(key);
+    return record;
+}
+
+QString AssetCache::IndexKey(const QUrl &url)
+{
+    return url.toString();
+}
+
+QString AssetCache::ComputeContentHash(const QString &absoluteFilePath)
+{
+    QFile file(absoluteFilePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return "";
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    while(!file.atEnd())
+        hash.addData(file.read(65536));
+    return hash.result().toHex();
+}
+
 CookieJar *AssetCache::NewCookieJar(const QString &cookieDiskFile)
 {
     return new CookieJar(this, cookieDiskFile);
@@ -11,6 +11,7 @@
 #include <QNetworkCacheMetaData>
 #include <QByteArray>
 #include <QHash>
+#include <QStringList>
 #include <QUrl>
 #include <QDir>
 #include <QObject>
@@ -26,6 +27,13 @@ QString SanitateAssetRefForCache(QString assetRef);
 
 /// Subclassing QNetworkDiskCache has the main goal of separating metadata from the raw asset data. The basic implementation of QNetworkDiskCache
 /// will store both in the same file. That did not work very well with our asset system as we need absolute paths to loaded assets for various purpouses.
+/** The asset data is stored by content: each distinct content is stored once, in a data file named by its SHA-1 hash and the suffix of the
+    first asset ref it was stored for. An index maps the asset refs to the content hashes, so the same data served from several URLs or
+    storages is stored only once. The index is kept in memory and logged to the file "index" in the cache directory.
+    Data files of older caches, named by the asset ref, are still found.
+
+    The index also holds the network metadata of the assets and the size and last access time of the data. When the data exceeds
+    the maximum cache size, the least recently used data is evicted, except the data of assets that are loaded. */
 class AssetCache : public QNetworkDiskCache
 {
 
@@ -51,11 +59,11 @@ public:
     /// \note QNetworkDiskCache override. Don't call directly, used by QNetworkAccessManager.
     virtual bool remove(const QUrl &url);
 
-    /// Reads metadata file from hard drive.
+    /// Returns the metadata of the url from the cache index.
     /// \note QNetworkDiskCache override. Don't call directly, used by QNetworkAccessManager.
     virtual QNetworkCacheMetaData metaData(const QUrl &url);
 
-    /// Writes metadata file to hard drive, if metadata is different from known cache metadata.
+    /// Stores the metadata in the cache index, if metadata is different from known cache metadata.
     /// \note QNetworkDiskCache override. Don't call directly, used by QNetworkAccessManager.
     virtual void updateMetaData(const QNetworkCacheMetaData &metaData);
 
@@ -63,11 +71,15 @@ public:
     /// \note QNetworkDiskCache override. Don't call directly, used by QNetworkAccessManager.
     virtual void clear();
 
-    /// Checks if asset cache is currently over the maximum limit.
-    /// This call is ignored untill we decide to limit the disk cache size.
+    /// Evicts the least recently used data until the cache is at most 90% full, if it is over the maximum cache size.
+    /// @return The size of the data in the cache after the eviction.
     /// \note QNetworkDiskCache override. Don't call directly, used by QNetworkAccessManager.
     virtual qint64 expire();
 
+    /// Returns the size of the data in the cache.
+    /// \note QNetworkDiskCache override.
+    virtual qint64 cacheSize() const { return totalSize; }
+
 public slots:
     /// Returns an absolute path to a disk source of the url.
     /// @param QString asset ref
@@ -83,9 +95,17 @@ public slots:
 
     /// Checks whether the asset cache contains an asset with the given content hash, and returns the absolute path name to it, if so.
     /// Otherwise returns an empty string.
-    /// @todo Implement.
+    /// @param contentHash SHA-1 hash of the asset data, as a string of hex digits.
     QString GetDiskSourceByContentHash(const QString &contentHash);
 
+    /// Returns the SHA-1 content hash of the cached data of the given asset, or an empty string if the asset is not in the cache index.
+    QString GetContentHash(const QString &assetRef);
+
+    /// Stores the given asset to the cache by referring to data already in the cache, without the data itself.
+    /// Use this when the content hash of an asset is known before the asset is downloaded.
+    /// @return QString the absolute path name to the asset cache entry, or an empty string if no data with the given hash is in the cache.
+    QString StoreAssetByContentHash(const QString &assetRef, const QString &contentHash);
+
     /// Get the cache directory. Returned path is guaranteed to have a trailing slash /.
     /// @return QString absolute path to the caches data directory
     QString GetCacheDirectory() const;
@@ -110,18 +130,35 @@ public slots:
     /// Will not clear subfolders in the cache folders, or remove any folders.
     void ClearAssetCache();
 
+    /// Returns the number of asset refs in the cache index.
+    int NumIndexedAssets() const { return assetHashes.size(); }
+
+    /// Returns the asset refs in the cache index.
+    QStringList IndexedAssetRefs() const { return assetHashes.keys(); }
+
+    /// Returns the content hashes of all the data stored in the cache.
+    QStringList ContentHashes() const { return contents.keys(); }
+
+    /// Returns the number of asset refs that refer to the data with the given content hash.
+    int NumContentReferences(const QString &contentHash) const;
+
+    /// Sets the maximum size of the data in the cache, and evicts data if the cache is over it.
+    /// @param maxBytes The maximum size in bytes.
+    void SetMaximumSize(qint64 maxBytes);
+
+    /// Returns the maximum size of the data in the cache, in bytes.
+    qint64 MaximumSize() const { return maximumCacheSize(); }
+
     /// Creates a new cookie jar that implements disk writing and reading. Can be used with any QNetworkAccessManager with setCookieJar() function.
     /// \note AssetCache will be the CookieJars parent and it will destroyed by it, don't take ownerwhip of the returned CookieJar.
     /// \param QString File path to the file the jar will read/write cookies to/from.
     CookieJar *NewCookieJar(const QString &cookieDiskFile);
 
 private slots:
-    /// Writes metadata into a file. Helper function for the QNetworkDiskCache overrides.
-    bool WriteMetadata(const QString &filePath, const QNetworkCacheMetaData &metaData);
-
     /// If the metadata for this cache item has Content-MD5 digest, compare them with the data file we are about to pass onwards.
     /// \note If the metadata does not contain the header Content-MD5 this function will do nothing and return true. All http servers don't send this header eg. disabled by default on apache.
-    /// \note In the case that corruption is detected this function will remove the data and metadata files from disk and return false. This will trigger a full fetch for the asset data.
+    /// \note In the case that corruption is detected this function will remove the data and metadata from the cache and return false. This will trigger a full fetch for the asset data.
+    /// \note The digest is checked when the data is inserted to the cache, not when it is read.
     /// \param QString Absolute path to data file. You should validate that the file actually exists.
     /// \param QNetworkCacheMetaData The assets metadata.
     /// \return False if digest did not match with data file, true otherwise.
@@ -137,6 +174,113 @@ private slots:
     void ClearDirectory(const QString &absoluteDirPath);
 
 private:
+    /// Data stored in the cache, by content.
+    struct Content
+    {
+        Content() : numRefs(0), size(0), lastAccess(0) {}
+
+        /// Name of the data file in the data directory.
+        QString fileName;
+        /// Number of asset refs that refer to this data.
+        int numRefs;
+        /// Size of the data file in bytes.
+        qint64 size;
+        /// Time the data was last used, in seconds since the epoch.
+        uint lastAccess;
+    };
+
+    /// Types of the index log records.
+    enum IndexRecordType
+    {
+        IndexRecordAsset = 1, ///< An url refers to data: url, content hash, file name, size, last access time.
+        IndexRecordRemoval, ///< An url and its metadata were removed: url.
+        IndexRecordAccess, ///< Data was used: content hash, access time.
+        IndexRecordMetaData ///< The metadata of an url: url, metadata.
+    };
+
+    /// Returns the absolute path of the data file of an url. Resolves the url through the index, and falls back to the file named by the url.
+    QString GetDataFilePath(const QUrl &url);
+
+    /// Moves the given written data file to the content store, or removes it if the same data is already stored, and indexes it for the url.
+    /// @return The absolute path of the stored data file, or an empty string on failure.
+    QString StoreDataFile(const QUrl &url, const QString &absoluteFilePath, const QString &contentHash);
+
+    /// Makes an url refer to the data with the given hash in the index, and logs the change. Deletes the data the url referred to before,
+    /// if no other url refers to it.
+    /// @param size Size of the data, used if the data is not in the index yet.
+    void IndexAsset(const QString &key, const QString &contentHash, const QString &fileName, qint64 size);
+
+    /// Removes an url and its metadata from the index, and logs the change. Deletes the data the url referred to, if no other url refers to it.
+    void UnindexAsset(const QString &key);
+
+    /// Makes an url refer to the data with the given hash in the in-memory index.
+    /// @param size Size of the data, used if the data is not in the index yet.
+    /// @param lastAccess Last access time of the data, used if it is later than the one in the index.
+    /// @return The file name of the data no longer referred to by any url, or an empty string.
+    QString AddReference(const QString &key, const QString &contentHash, const QString &fileName, qint64 size, uint lastAccess);
+
+    /// Removes an url from the in-memory index.
+    /// @return The file name of the data no longer referred to by any url, or an empty string.
+    QString RemoveReference(const QString &key);
+
+    /// Marks the data of an url as used now.
+    void Touch(const QString &key);
+
+    /// Stores the metadata of an url in the index, and logs the change.
+    void SetMetaData(const QNetworkCacheMetaData &metaData);
+
+    /// Evicts the least recently used data that is not in use until the size of the data in the cache is at most the given size.
+    /// @return The size of the data in the cache after the eviction.
+    qint64 Evict(qint64 targetSize);
+
+    /// Returns the absolute path of the index log.
+    QString GetIndexFilePath() const;
+
+    /// Reads the index log. Rewrites it if it is mostly made of stale records, or written by an older version.
+    void LoadIndex();
+
+    /// Writes the whole index to the index log, replacing the old log.
+    void WriteIndex();
+
+    /// Appends a record to the index log.
+    void AppendIndexRecord(const QByteArray &record);
+
+    /// Returns the index log record of an url referring to its data.
+    QByteArray AssetRecord(const QString &key) const;
+
+    /// Returns the index log record of the removal of an url.
+    QByteArray RemovalRecord(const QString &key) const;
+
+    /// Returns the index log record of the last access of data.
+    QByteArray AccessRecord(const QString &contentHash) const;
+
+    /// Returns the index log record of the metadata of an url.
+    QByteArray MetaDataRecord(const QString &key) const;
+
+    /// Returns the number of live entries in the index.
+    int NumIndexEntries() const { return assetHashes.size() + metaDatas.size(); }
+
+    /// Returns the key of an url in the index.
+    static QString IndexKey(const QUrl &url);
+
+    /// Returns the SHA-1 hash of a file as a string of hex digits, or an empty string if the file cannot be read.
+    static QString ComputeContentHash(const QString &absoluteFilePath);
+
+    /// Maps the asset urls to the content hashes of their data.
+    QHash<QString, QString> assetHashes;
+
+    /// Maps the content hashes to the stored data.
+    QHash<QString, Content> contents;
+
+    /// Maps the asset urls to their network metadata.
+    QHash<QString, QNetworkCacheMetaData> metaDatas;
+
+    /// Number of records in the index log.
+    int numIndexRecords;
+
+    /// Total size of the data in the cache, in bytes.
+    qint64 totalSize;
+
     /// Cache directory, passed here from AssetAPI in the ctor.
     QString cacheDirectory;
 
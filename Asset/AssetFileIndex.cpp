@@ -0,0 +1,195 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "DebugOperatorNew.h"
+
+#include "AssetFileIndex.h"
+#include "AssetAPI.h"
+#include "LoggingFunctions.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSet>
+
+#include "MemoryLeakCheck.h"
+
+DEFINE_POCO_LOGGING_FUNCTIONS("AssetFileIndex")
+
+AssetFileIndex::AssetFileIndex(const QString &rootDirectory, bool watch) :
+    root(QDir(rootDirectory).absolutePath()),
+    built(false),
+    numFiles(0),
+    watcher(0)
+{
+    if (watch)
+    {
+        watcher = new QFileSystemWatcher(this);
+        connect(watcher, SIGNAL(directoryChanged(const QString &)), this, SLOT(DirectoryChanged(const QString &)));
+    }
+}
+
+AssetFileIndex::~AssetFileIndex()
+{
+}
+
+QString AssetFileIndex::FindDirectory(const QString &filename)
+{
+    if (!built)
+        Rebuild();
+
+    QHash<QString, QStringList>::const_iterator iter = files.find(Key(filename));
+    if (iter == files.end())
+        return "";
+
+    // The file may have been removed after the last directory change was reported, so check the one file found.
+    QString directory = iter.value().first();
+    if (QFile::exists(GuaranteeTrailingSlash(directory) + filename))
+        return directory;
+
+    DirectoryChanged(directory);
+    iter = files.find(Key(filename));
+    return iter != files.end() ? iter.value().first() : QString();
+}
+
+void AssetFileIndex::Rebuild()
+{
+    if (watcher && !watcher->directories().isEmpty())
+        watcher->removePaths(watcher->directories());
+    files.clear();
+    directories.clear();
+    numFiles = 0;
+
+    ScanDirectory(root);
+    built = true;
+
+    LogDebug("Indexed " + QString::number(numFiles) + " files in " + QString::number(directories.size()) + " directories of " + root);
+}
+
+QStringList AssetFileIndex::Collisions() const
+{
+    QStringList collisions;
+    for(QHash<QString, QStringList>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+        if (iter.value().size() > 1)
+            collisions.append(iter.key());
+    return collisions;
+}
+
+void AssetFileIndex::DirectoryChanged(const QString &path)
+{
+    QHash<QString, Directory>::const_iterator iter = directories.find(path);
+    if (iter == directories.end())
+        return;
+    Directory old = iter.value();
+
+    if (!QDir(path).exists())
+    {
+        RemoveDirectory(path);
+        return;
+    }
+
+    Directory current;
+    ListDirectory(path, current);
+
+    QSet<QString> oldFiles = old.files.toSet();
+    QSet<QString> currentFiles = current.files.toSet();
+    foreach(const QString &file, old.files)
+        if (!currentFiles.contains(file))
+            RemoveFile(file, path);
+    foreach(const QString &file, current.files)
+        if (!oldFiles.contains(file))
+            AddFile(file, path);
+
+    QSet<QString> oldSubdirs = old.subdirs.toSet();
+    QSet<QString> currentSubdirs = current.subdirs.toSet();
+    foreach(const QString &subdir, old.subdirs)
+        if (!currentSubdirs.contains(subdir))
+            RemoveDirectory(subdir);
+
+    directories[path] = current;
+
+    foreach(const QString &subdir, current.subdirs)
+        if (!oldSubdirs.contains(subdir))
+            ScanDirectory(subdir);
+}
+
+void AssetFileIndex::ListDirectory(const QString &path, Directory &contents) const
+{
+    QFileInfoList entries = QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    foreach(const QFileInfo &entry, entries)
+    {
+        if (!entry.isDir())
+            contents.files.append(entry.fileName());
+        else if (!entry.isSymLink())
+            contents.subdirs.append(entry.absoluteFilePath());
+    }
+}
+
+void AssetFileIndex::ScanDirectory(const QString &path)
+{
+    // Scan breadth first, so that of files with the same name, the ones closer to the root are found first
+    QStringList pending(path);
+    QStringList scanned;
+    while(!pending.isEmpty())
+    {
+        QString current = pending.takeFirst();
+        Directory contents;
+        ListDirectory(current, contents);
+        foreach(const QString &file, contents.files)
+            AddFile(file, current);
+        pending.append(contents.subdirs);
+        directories[current] = contents;
+        scanned.append(current);
+    }
+
+    if (watcher)
+        watcher->addPaths(scanned);
+}
+
+void AssetFileIndex::RemoveDirectory(const QString &path)
+{
+    QHash<QString, Directory>::iterator iter = directories.find(path);
+    if (iter == directories.end())
+        return;
+    Directory contents = iter.value();
+    directories.erase(iter);
+
+    foreach(const QString &file, contents.files)
+        RemoveFile(file, path);
+    foreach(const QString &subdir, contents.subdirs)
+        RemoveDirectory(subdir);
+
+    if (watcher && watcher->directories().contains(path))
+        watcher->removePath(path);
+}
+
+void AssetFileIndex::AddFile(const QString &filename, const QString &directory)
+{
+    QStringList &dirs = files[Key(filename)];
+    dirs.append(directory);
+    ++numFiles;
+
+    if (dirs.size() > 1)
+        LogWarning("Asset file \"" + filename + "\" exists in both " + dirs.first() + " and " + directory + ". Using the one in " + dirs.first() + ".");
+}
+
+void AssetFileIndex::RemoveFile(const QString &filename, const QString &directory)
+{
+    QHash<QString, QStringList>::iterator iter = files.find(Key(filename));
+    if (iter == files.end())
+        return;
+
+    if (iter.value().removeOne(directory))
+        --numFiles;
+    if (iter.value().isEmpty())
+        files.erase(iter);
+}
+
+QString AssetFileIndex::Key(const QString &filename)
+{
+#ifdef _WINDOWS
+    return filename.toLower();
+#else
+    return filename;
+#endif
+}
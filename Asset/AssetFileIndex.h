@@ -0,0 +1,96 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Asset_AssetFileIndex_h
+#define incl_Asset_AssetFileIndex_h
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+class QFileSystemWatcher;
+
+/// An index of the files in a directory and all its subdirectories, by filename.
+/** Asset references refer to local files by filename only, so finding a file in a directory tree would otherwise require
+    walking the whole tree. The index is built on first use. If the index is watched, the directories are monitored for
+    changes (with inotify on Linux) and only the changed directories are scanned again.
+
+    If the same filename exists in several directories, a warning is logged and the file closest to the root, in alphabetical
+    order of the directories, is used. */
+class AssetFileIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// @param rootDirectory The directory to index, with all its subdirectories.
+    /// @param watch If true, the directories are watched for changes and the index is updated as they change.
+    AssetFileIndex(const QString &rootDirectory, bool watch);
+
+    ~AssetFileIndex();
+
+    /// Returns the absolute path of the directory that contains the given file, or "" if there is no such file.
+    /** Builds the index if it has not been built yet.
+        @param filename The name of the file, without any directory. */
+    QString FindDirectory(const QString &filename);
+
+    /// Discards the index and scans the whole directory tree again.
+    void Rebuild();
+
+    /// Returns whether the index has been built.
+    bool IsBuilt() const { return built; }
+
+    /// Returns the number of files in the index.
+    int NumFiles() const { return numFiles; }
+
+    /// Returns the number of directories in the index.
+    int NumDirectories() const { return directories.size(); }
+
+    /// Returns the names of the files that exist in more than one directory.
+    QStringList Collisions() const;
+
+    /// Returns the directory this index covers.
+    QString RootDirectory() const { return root; }
+
+private slots:
+    /// Scans the changed directory again, and updates the index with the files and subdirectories added and removed.
+    void DirectoryChanged(const QString &path);
+
+private:
+    /// The contents of an indexed directory.
+    struct Directory
+    {
+        QStringList files;
+        /// Absolute paths of the subdirectories.
+        QStringList subdirs;
+    };
+
+    /// Lists the files and subdirectories of a directory. Hidden entries and symbolic links to directories are skipped.
+    void ListDirectory(const QString &path, Directory &contents) const;
+
+    /// Adds the files of a directory and all its subdirectories to the index.
+    void ScanDirectory(const QString &path);
+
+    /// Removes the files of a directory and all its subdirectories from the index.
+    void RemoveDirectory(const QString &path);
+
+    void AddFile(const QString &filename, const QString &directory);
+    void RemoveFile(const QString &filename, const QString &directory);
+
+    /// Returns the key of a filename in the index. Filenames are case insensitive on Windows.
+    static QString Key(const QString &filename);
+
+    QString root;
+    bool built;
+    int numFiles;
+
+    /// The directory change listener, or null if the index is not watched.
+    QFileSystemWatcher *watcher;
+
+    /// Maps a filename key to the directories that have a file with that name. The first one is used.
+    QHash<QString, QStringList> files;
+
+    /// Maps the absolute path of each indexed directory to its contents.
+    QHash<QString, Directory> directories;
+};
+
+#endif
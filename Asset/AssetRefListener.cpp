@@ -18,16 +18,16 @@ AssetPtr AssetRefListener::Asset()
     return asset.lock();
 }
 
-void AssetRefListener::HandleAssetRefChange(IAttribute *assetRef, const QString& assetType)
+AssetTransferPtr AssetRefListener::HandleAssetRefChange(IAttribute *assetRef, const QString& assetType)
 {
     Attribute<AssetReference> *attr = dynamic_cast<Attribute<AssetReference> *>(assetRef);
     if (!attr)
-        return; ///\todo Log out warning.
+        return AssetTransferPtr(); ///\todo Log out warning.
 
-    HandleAssetRefChange(attr->GetOwner()->GetFramework()->Asset(), attr->Get().ref, assetType);
+    return HandleAssetRefChange(attr->GetOwner()->GetFramework()->Asset(), attr->Get().ref, assetType);
 }
 
-void AssetRefListener::HandleAssetRefChange(AssetAPI *assetApi, QString assetRef, const QString& assetType)
+AssetTransferPtr AssetRefListener::HandleAssetRefChange(AssetAPI *assetApi, QString assetRef, const QString& assetType)
 {
     assert(assetApi);
 
@@ -35,7 +35,7 @@ void AssetRefListener::HandleAssetRefChange(AssetAPI *assetApi, QString assetRef
 
     AssetTransferPtr transfer = assetApi->RequestAsset(assetRef, assetType);
     if (!transfer)
-        return; ///\todo Log out warning.
+        return transfer; ///\todo Log out warning.
 
     connect(transfer.get(), SIGNAL(Downloaded(IAssetTransfer*)), this, SLOT(EmitDownloaded(IAssetTransfer*)), Qt::UniqueConnection);
 //    connect(transfer.get(), SIGNAL(Decoded(AssetPtr)), this, SLOT(EmitDecoded(AssetPtr)), Qt::UniqueConnection);
@@ -45,6 +45,7 @@ void AssetRefListener::HandleAssetRefChange(AssetAPI *assetApi, QString assetRef
     if (assetData)
         disconnect(assetData.get(), SIGNAL(Loaded(AssetPtr)), this, SIGNAL(Loaded(AssetPtr)));
     asset = AssetPtr();
+    return transfer;
 }
 
 void AssetRefListener::EmitDownloaded(IAssetTransfer *transfer)
@@ -16,12 +16,14 @@ public:
     /// Issues a new asset request to the given AssetReference.
     /// @param assetRef A pointer to an attribute of type AssetReference.
     /// @param assetType Optional asset type name
-    void HandleAssetRefChange(IAttribute *assetRef, const QString& assetType = "");
+    /// @return The transfer of the requested asset, or null if the request failed.
+    AssetTransferPtr HandleAssetRefChange(IAttribute *assetRef, const QString& assetType = "");
 
     /// Issues a new asset request to the given assetRef URL.
     /// @param assetApi Pass a pointer to the system Asset API into this function (This utility object doesn't keep reference to framework).
     /// @param assetType Optional asset type name
-    void HandleAssetRefChange(AssetAPI *assetApi, QString assetRef, const QString& assetType = "");
+    /// @return The transfer of the requested asset, or null if the request failed.
+    AssetTransferPtr HandleAssetRefChange(AssetAPI *assetApi, QString assetRef, const QString& assetType = "");
     
     /// Returns the asset currently stored in this asset reference.
     AssetPtr Asset();
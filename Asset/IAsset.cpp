@@ -120,16 +120,22 @@ AssetLoadState IAsset::LoadFromFileInMemory(const u8 *data, size_t numBytes)
         return ASSET_LOAD_FAILED;
     }
 
-    // Before loading the asset, recompute the content hash for the asset data.
-    QCryptographicHash hash(QCryptographicHash::Sha1);
-    hash.addData((const char*)data, numBytes);
+    // Before loading the asset, recompute the content hash for the asset data, unless it was already computed in a worker thread.
+    QString hashNow = preparedContentHash;
+    preparedContentHash = "";
+    if (hashNow.isEmpty())
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData((const char*)data, numBytes);
+        hashNow = hash.result().toHex();
+    }
 
     // Check the hash and update it if needed, set change boolean
-    QString hashNow(hash.result().toHex());
     if (hashNow != contentHash)
     {
         contentHash = hashNow;
         contentHashChanged = true;
+        assetAPI->NotifyAssetContentHashChanged(shared_from_this());
     }  
     else
         contentHashChanged = false;
@@ -137,6 +143,18 @@ AssetLoadState IAsset::LoadFromFileInMemory(const u8 *data, size_t numBytes)
     return DeserializeFromData(data, numBytes);
 }
 
+void IAsset::PrepareFromFileInMemory(const u8 *data, size_t numBytes)
+{
+    if (!data || numBytes == 0)
+        return;
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData((const char*)data, numBytes);
+    preparedContentHash = hash.result().toHex();
+
+    PrepareFromData(data, numBytes);
+}
+
 void IAsset::HandleLoadError(const QString &loadError)
 {
     LogError(loadError.toStdString());
@@ -110,6 +110,13 @@ public:
     /// Returns true if loading succeeded, false otherwise.
     AssetLoadState LoadFromFileInMemory(const u8 *data, size_t numBytes);
 
+    /// Does the CPU-side work of loading this asset from the specified file data in memory. Called by the Asset API in a worker thread
+    /// before LoadFromFileInMemory is called with the same data in the main thread. The main thread does not access the asset meanwhile.
+    void PrepareFromFileInMemory(const u8 *data, size_t numBytes);
+
+    /// Returns the SHA-1 hash computed by PrepareFromFileInMemory, or an empty string if it has not been called since the last load.
+    QString PreparedContentHash() const { return preparedContentHash; }
+
     /// Called whenever another asset this asset depends on is loaded.
     virtual void DependencyLoaded(AssetPtr dependee) { }
 
@@ -144,6 +151,11 @@ protected:
     /// Loads this asset by deserializing it from the given data. The data pointer that is passed in is never null, and numBytes is always greater than zero.
     virtual AssetLoadState DeserializeFromData(const u8 *data, size_t numBytes) = 0;
 
+    /// Decodes the given data in a worker thread, so that the following DeserializeFromData call with the same data has less work to do.
+    /// The default implementation does nothing. Subclasses that reimplement this must not create or access any renderer resources,
+    /// Qt objects or other assets here.
+    virtual void PrepareFromData(const u8 *data, size_t numBytes) {}
+
     /// Private-implementation of the unloading of an asset.
     virtual void DoUnload() = 0;
 
@@ -171,6 +183,9 @@ protected:
     /// Stores the SHA-1 hash of this content, saved as a string for convenience for script access. 
     QString contentHash;
 
+    /// The SHA-1 hash computed by PrepareFromFileInMemory, used by the following LoadFromFileInMemory. Empty if there is none.
+    QString preparedContentHash;
+
     /// Boolean if assets content hash has changed.
     /// @note This is reseted to false always after Loaded() signal is emitted.
     bool contentHashChanged;
@@ -1,5 +1,6 @@
 #include "IAssetTransfer.h"
 #include "IAsset.h"
+#include "AssetAPI.h"
 
 void IAssetTransfer::EmitAssetDownloaded()
 {
@@ -23,6 +24,12 @@ void IAssetTransfer::EmitAssetLoaded()
     */
 }
 
+void IAssetTransfer::ReadRawAssetData(QString filename)
+{
+    if (!LoadFileToVector(filename.toStdString().c_str(), rawAssetData))
+        rawAssetData.clear();
+}
+
 void IAssetTransfer::EmitAssetFailed(QString reason)
 {
     emit Failed(this, reason);
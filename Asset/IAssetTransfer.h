@@ -19,7 +19,8 @@ class IAssetTransfer : public QObject, public boost::enable_shared_from_this<IAs
 
 public:
     IAssetTransfer()
-    :cachingAllowed(true)
+    :cachingAllowed(true),
+    priority(0.f)
     {
     }
 
@@ -54,6 +55,9 @@ public:
     /// Stores the raw asset bytes for this asset.
     std::vector<u8> rawAssetData;
 
+    /// Reads the raw asset bytes from a file. If the file cannot be read, the data is left empty. Can be called from a worker thread.
+    void ReadRawAssetData(QString filename);
+
 public slots:
     /// Returns the current transfer progress in the range [0, 1].
     // float Progress() const;
@@ -72,6 +76,13 @@ public slots:
 
     bool CachingAllowed() const { return cachingAllowed; }
 
+    /// Sets the priority of this transfer. Of the transfers waiting to be loaded, the ones with the highest priority are loaded first.
+    /// The default priority is 0. For example, the assets of objects close to the camera can be given a higher priority.
+    /// The dependencies of an asset are requested with at least the priority of the asset.
+    void SetPriority(float priority_) { priority = priority_; }
+
+    float Priority() const { return priority; }
+
     // Script getters for public attributes
     QByteArray GetRawData() { return QByteArray::fromRawData((const char*)&rawAssetData[0], rawAssetData.size()); }
     QString GetSourceUrl() { return source.ref; }
@@ -95,6 +106,8 @@ private:
     bool cachingAllowed;
 
     QString diskSource;
+
+    float priority;
 };
 
 #endif
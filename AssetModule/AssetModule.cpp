@@ -13,8 +13,55 @@
 #include "CoreException.h"
 #include "AssetAPI.h"
 #include "ConsoleAPI.h"
+#include "AssetFileIndex.h"
+#include "AssetCache.h"
+#include "HighPerfClock.h"
+#include "CoreStringUtils.h"
 
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+#include <limits>
+
+namespace
+{
+    /// Returns the milliseconds elapsed since a clock time.
+    double MsecSince(tick_t start)
+    {
+        return (GetCurrentClockTime() - start) * 1000.0 / (double)GetCurrentClockFreq();
+    }
+
+    /// Returns the rate of lookups per second.
+    double LookupsPerSecond(int numLookups, double msec)
+    {
+        return msec > 0.0 ? numLookups / (msec / 1000.0) : 0.0;
+    }
+
+    /// Looks up a key, returning an empty string if it is not found.
+    typedef boost::function<QString (const QString &)> LookupFunction;
+
+    /// Times the lookup of numLookups keys, visited in a scattered order so that consecutive lookups do not hit neighbouring entries.
+    /** @param missingKey If not empty, each lookup is followed by the lookup of a key that does not exist, made by replacing %1 with
+            a running number.
+        @param found Incremented by the number of keys found.
+        @return Elapsed time in milliseconds. */
+    double TimeLookups(const LookupFunction &lookup, const QStringList &keys, int numLookups, const QString &missingKey, int &found)
+    {
+        tick_t start = GetCurrentClockTime();
+        for(int i = 0; i < numLookups; ++i)
+        {
+            if (!lookup(keys[(int)((i * 7919LL) % keys.size())]).isEmpty())
+                ++found;
+            if (!missingKey.isEmpty())
+                lookup(missingKey.arg(i));
+        }
+        return MsecSince(start);
+    }
+}
 
 namespace Asset
 {
@@ -59,6 +106,18 @@ namespace Asset
             "AddHttpStorage", "Adds a new Http asset storage to the known storages. Usage: AddHttpStorage(url, name)", 
             ConsoleBind(this, &AssetModule::AddHttpStorage)));
 
+        framework_->Console()->RegisterCommand(CreateConsoleCommand(
+            "AssetLookupBenchmark", "Measures the local asset file index in a generated tree of files. Usage: AssetLookupBenchmark(number of files)",
+            ConsoleBind(this, &AssetModule::ConsoleAssetLookupBenchmark)));
+
+        framework_->Console()->RegisterCommand(CreateConsoleCommand(
+            "AssetCacheBenchmark", "Reports the deduplication of the asset cache and measures cache lookups. Usage: AssetCacheBenchmark(number of lookups)",
+            ConsoleBind(this, &AssetModule::ConsoleAssetCacheBenchmark)));
+
+        framework_->Console()->RegisterCommand(CreateConsoleCommand(
+            "AssetCacheOpenBenchmark", "Measures opening, looking up and evicting entries of a generated asset cache. Usage: AssetCacheOpenBenchmark(number of entries)",
+            ConsoleBind(this, &AssetModule::ConsoleAssetCacheOpenBenchmark)));
+
         ProcessCommandLineOptions();
     }
 
@@ -68,6 +127,12 @@ namespace Asset
 
         const boost::program_options::variables_map &options = framework_->ProgramOptions();
 
+        if (options.count("assetcachesize") > 0 && framework_->Asset()->GetAssetCache())
+        {
+            int maxMegabytes = std::max(0, options["assetcachesize"].as<int>());
+            framework_->Asset()->GetAssetCache()->SetMaximumSize((qint64)maxMegabytes * 1024 * 1024);
+        }
+
         if (options.count("file") > 0)
         {
             std::string startup_scene_ = QString(options["file"].as<std::string>().c_str()).trimmed().toStdString();
@@ -136,6 +201,139 @@ namespace Asset
         framework_->Asset()->AddAssetStorage(params[0].c_str(), params[1].c_str(), true);       
         return ConsoleResultSuccess();
     }
+
+    ConsoleCommandResult AssetModule::ConsoleAssetLookupBenchmark(const StringVector &params)
+    {
+        const int numFiles = params.size() > 0 ? std::max(1, ParseString<int>(params[0], 100000)) : 100000;
+        const int filesPerDirectory = 100;
+
+        // Spread the files over a tree of directories, ten subdirectories per directory
+        QString root = QDir::tempPath() + "/AssetLookupBenchmark";
+        boost::filesystem::remove_all(root.toStdString());
+        QStringList filenames;
+        for(int i = 0; i < numFiles; ++i)
+        {
+            QString path = root;
+            for(int d = i / filesPerDirectory; d > 0; d /= 10)
+                path += "/d" + QString::number(d % 10);
+            if (i % filesPerDirectory == 0)
+                QDir().mkpath(path);
+            QString filename = "asset" + QString::number(i) + ".dat";
+            QFile file(path + "/" + filename);
+            if (!file.open(QIODevice::WriteOnly))
+            {
+                boost::filesystem::remove_all(root.toStdString());
+                return ConsoleResultFailure("Could not create " + file.fileName().toStdString());
+            }
+            filenames.append(filename);
+        }
+
+        AssetFileIndex index(root, false);
+        tick_t start = GetCurrentClockTime();
+        index.Rebuild();
+        double buildTime = MsecSince(start);
+
+        int found = 0;
+        double lookupTime = TimeLookups(boost::bind(&AssetFileIndex::FindDirectory, &index, _1), filenames, numFiles, "missing%1.dat", found);
+
+        boost::filesystem::remove_all(root.toStdString());
+
+        char str[256];
+        sprintf(str, "Indexed %d files in %d directories in %.1f ms. %d lookups in %.1f ms (%.0f lookups/s), %d of %d files found.",
+            index.NumFiles(), index.NumDirectories(), buildTime, 2 * numFiles, lookupTime, LookupsPerSecond(2 * numFiles, lookupTime),
+            found, numFiles);
+        return ConsoleResultSuccess(str);
+    }
+
+    ConsoleCommandResult AssetModule::ConsoleAssetCacheBenchmark(const StringVector &params)
+    {
+        const int numLookups = params.size() > 0 ? std::max(1, ParseString<int>(params[0], 100000)) : 100000;
+
+        AssetCache *cache = framework_->Asset()->GetAssetCache();
+        if (!cache)
+            return ConsoleResultFailure("The asset cache is not in use.");
+
+        QStringList hashes = cache->ContentHashes();
+        QStringList refs = cache->IndexedAssetRefs();
+        if (hashes.isEmpty() || refs.isEmpty())
+            return ConsoleResultSuccess("The asset cache index is empty.");
+
+        // Each distinct content is stored once, but would be stored once per asset ref without the deduplication
+        qint64 storedBytes = 0;
+        qint64 assetBytes = 0;
+        foreach(const QString &hash, hashes)
+        {
+            qint64 size = QFileInfo(cache->GetDiskSourceByContentHash(hash)).size();
+            storedBytes += size;
+            assetBytes += size * cache->NumContentReferences(hash);
+        }
+
+        int found = 0;
+        double hashLookupTime = TimeLookups(boost::bind(&AssetCache::GetDiskSourceByContentHash, cache, _1), hashes, numLookups, "", found);
+        double refLookupTime = TimeLookups(boost::bind(&AssetCache::GetContentHash, cache, _1), refs, numLookups, "", found);
+
+        char str[512];
+        sprintf(str, "%d cached assets share %d distinct contents (%.2f assets per content). %.2f MB stored for %.2f MB of assets. "
+            "%d lookups by content hash in %.1f ms, %d lookups by asset ref in %.1f ms, %d of %d found.",
+            cache->NumIndexedAssets(), hashes.size(), (double)cache->NumIndexedAssets() / hashes.size(),
+            storedBytes / (1024.0 * 1024.0), assetBytes / (1024.0 * 1024.0),
+            numLookups, hashLookupTime, numLookups, refLookupTime, found, 2 * numLookups);
+        return ConsoleResultSuccess(str);
+    }
+
+    ConsoleCommandResult AssetModule::ConsoleAssetCacheOpenBenchmark(const StringVector &params)
+    {
+        const int numEntries = params.size() > 0 ? std::max(1, ParseString<int>(params[0], 100000)) : 100000;
+
+        QString directory = QDir::tempPath() + "/AssetCacheBenchmark";
+        boost::filesystem::remove_all(directory.toStdString());
+        QStringList refs;
+
+        // Fill a cache with distinct small assets
+        tick_t start = GetCurrentClockTime();
+        AssetCache *cache = new AssetCache(framework_->Asset(), directory);
+        cache->SetMaximumSize(std::numeric_limits<qint64>::max());
+        for(int i = 0; i < numEntries; ++i)
+        {
+            QString ref = "local://asset" + QString::number(i) + ".dat";
+            QByteArray data = ref.toAscii();
+            if (cache->StoreAsset((const u8*)data.data(), data.size(), ref, "").isEmpty())
+            {
+                delete cache;
+                boost::filesystem::remove_all(directory.toStdString());
+                return ConsoleResultFailure("Could not store " + ref.toStdString());
+            }
+            refs.append(ref);
+        }
+        double fillTime = MsecSince(start);
+        delete cache;
+
+        start = GetCurrentClockTime();
+        cache = new AssetCache(framework_->Asset(), directory);
+        double openTime = MsecSince(start);
+        cache->SetMaximumSize(std::numeric_limits<qint64>::max());
+
+        QString (AssetCache::*getDiskSource)(const QString &) = &AssetCache::GetDiskSource;
+        int found = 0;
+        double lookupTime = TimeLookups(boost::bind(getDiskSource, cache, _1), refs, numEntries, "local://missing%1.dat", found);
+
+        // Evict half of the data
+        int numIndexed = cache->NumIndexedAssets();
+        start = GetCurrentClockTime();
+        cache->SetMaximumSize(cache->cacheSize() / 2);
+        double evictTime = MsecSince(start);
+        int numEvicted = numIndexed - cache->NumIndexedAssets();
+
+        delete cache;
+        boost::filesystem::remove_all(directory.toStdString());
+
+        char str[512];
+        sprintf(str, "Stored %d assets in %.1f ms. Opened the cache in %.1f ms. %d lookups in %.1f ms (%.0f lookups/s), %d of %d found. "
+            "Evicted %d assets in %.1f ms.",
+            numIndexed, fillTime, openTime, 2 * numEntries, lookupTime, LookupsPerSecond(2 * numEntries, lookupTime),
+            found, numEntries, numEvicted, evictTime);
+        return ConsoleResultSuccess(str);
+    }
 }
 
 extern "C" void POCO_LIBRARY_API SetProfiler(Foundation::Profiler *profiler);
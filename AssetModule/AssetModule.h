@@ -37,6 +37,15 @@ namespace Asset
 
         ConsoleCommandResult AddHttpStorage(const StringVector &params);
 
+        //! Measures building and looking up the index of local asset files, in a generated directory tree
+        ConsoleCommandResult ConsoleAssetLookupBenchmark(const StringVector &params);
+
+        //! Reports the deduplication of the asset cache contents and measures looking up cached assets by content hash and by asset ref
+        ConsoleCommandResult ConsoleAssetCacheBenchmark(const StringVector &params);
+
+        //! Measures opening, looking up and evicting entries of an asset cache, generated in a temporary directory
+        ConsoleCommandResult ConsoleAssetCacheOpenBenchmark(const StringVector &params);
+
         //! returns name of this module. Needed for logging.
         static const std::string &NameStatic() { return type_name_static_; }
 
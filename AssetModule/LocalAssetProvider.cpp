@@ -14,11 +14,15 @@
 #include "IAssetUploadTransfer.h"
 #include "IAssetTransfer.h"
 #include "AssetAPI.h"
+#include "JobSystem.h"
+#include <boost/bind.hpp>
 #include <QByteArray>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
 
+#include <algorithm>
+
 namespace Asset
 {
 
@@ -190,10 +194,17 @@ AssetUploadTransferPtr LocalAssetProvider::UploadAssetFromFileInMemory(const u8
 
 void LocalAssetProvider::CompletePendingFileDownloads()
 {
-    while(pendingDownloads.size() > 0)
+    if (pendingDownloads.empty())
+        return;
+
+    std::vector<AssetTransferPtr> downloads;
+    downloads.swap(pendingDownloads);
+    std::stable_sort(downloads.begin(), downloads.end(), &AssetAPI::HasHigherPriority);
+
+    Foundation::JobSystemPtr jobs = framework->GetJobSystem();
+    for(size_t i = 0; i < downloads.size(); ++i)
     {
-        AssetTransferPtr transfer = pendingDownloads.back();
-        pendingDownloads.pop_back();
+        AssetTransferPtr transfer = downloads[i];
 
         QString ref = transfer->source.ref;
 
@@ -222,25 +233,40 @@ void LocalAssetProvider::CompletePendingFileDownloads()
         QFileInfo file(GuaranteeTrailingSlash(path) + ref);
         QString absoluteFilename = file.absoluteFilePath();
 
-        bool success = LoadFileToVector(absoluteFilename.toStdString().c_str(), transfer->rawAssetData);
-        if (!success)
-        {
-            QString reason = "Failed to read asset data for asset \"" + ref + "\" from file \"" + absoluteFilename + "\"";
-//            AssetModule::LogError(reason.toStdString());
-            framework->Asset()->AssetTransferFailed(transfer.get(), reason);
-            continue;
-        }
-        
         // Tell the Asset API that this asset should not be cached into the asset cache, and instead the original filename should be used
         // as a disk source, rather than generating a cache file for it.
         transfer->SetCachingBehavior(false, absoluteFilename.toStdString().c_str());
 
         transfer->storage = storage;
-//        AssetModule::LogDebug("Downloaded asset \"" + ref.toStdString() + "\" from file " + absoluteFilename.toStdString());
 
-        // Signal the Asset API that this asset is now successfully downloaded.
-        framework->Asset()->AssetTransferCompleted(transfer.get());
+        // Read the file in a worker thread. The continuation keeps the transfer alive until the read has finished.
+        if (jobs)
+        {
+            Foundation::JobPtr job = jobs->Spawn(boost::bind(&IAssetTransfer::ReadRawAssetData, transfer.get(), absoluteFilename));
+            jobs->ContinueOnMainThread(job, boost::bind(&LocalAssetProvider::PendingFileDownloadRead, shared_from_this(), transfer, absoluteFilename));
+        }
+        else
+        {
+            transfer->ReadRawAssetData(absoluteFilename);
+            PendingFileDownloadRead(transfer, absoluteFilename);
+        }
+    }
+}
+
+void LocalAssetProvider::PendingFileDownloadRead(AssetTransferPtr transfer, QString absoluteFilename)
+{
+    if (transfer->rawAssetData.size() == 0)
+    {
+        QString reason = "Failed to read asset data for asset \"" + transfer->source.ref + "\" from file \"" + absoluteFilename + "\"";
+//        AssetModule::LogError(reason.toStdString());
+        framework->Asset()->AssetTransferFailed(transfer.get(), reason);
+        return;
     }
+
+//    AssetModule::LogDebug("Downloaded asset \"" + transfer->source.ref.toStdString() + "\" from file " + absoluteFilename.toStdString());
+
+    // Signal the Asset API that this asset is now successfully downloaded.
+    framework->Asset()->AssetTransferCompleted(transfer.get());
 }
 
 void LocalAssetProvider::CompletePendingFileUploads()
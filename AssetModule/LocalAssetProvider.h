@@ -71,9 +71,12 @@ namespace Asset
         /// The following asset downloads are pending to be completed by this provider.
         std::vector<AssetTransferPtr> pendingDownloads;
 
-        /// Takes all the pending file download transfers and finishes them.
+        /// Takes all the pending file download transfers, and starts reading their files in worker threads, highest priority first.
         void CompletePendingFileDownloads();
 
+        /// Signals the Asset API that the file of a download transfer has been read, or that the read failed.
+        void PendingFileDownloadRead(AssetTransferPtr transfer, QString absoluteFilename);
+
         /// Takes all the pending file upload transfers and finishes them.
         void CompletePendingFileUploads();
 
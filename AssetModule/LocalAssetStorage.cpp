@@ -6,16 +6,16 @@
 #include "LocalAssetStorage.h"
 #include "LocalAssetProvider.h"
 #include "AssetAPI.h"
+#include "AssetFileIndex.h"
 
-#include <QFileSystemWatcher>
 #include <QDir>
 #include <utility>
 
 namespace Asset
 {
 
-LocalAssetStorage::LocalAssetStorage()
-//:changeWatcher(0)
+LocalAssetStorage::LocalAssetStorage() :
+    fileIndex(0)
 {
 }
 
@@ -33,6 +33,10 @@ QString LocalAssetStorage::GetFullPathForAsset(const QString &assetname, bool re
     if (!recursive || !recursiveLookup)
         return "";
 
+    // Plain filenames are looked up in the index. Names with a subdirectory are rare, and still need a walk of the tree.
+    if (fileIndex && !assetname.contains('/') && !assetname.contains('\\'))
+        return fileIndex->FindDirectory(assetname);
+
     try
     {
         boost::filesystem::recursive_directory_iterator iter(directory.toStdString());
@@ -59,32 +63,17 @@ QString LocalAssetStorage::GetFullAssetURL(const QString &localName)
 
 void LocalAssetStorage::SetupWatcher()
 {
-    /* This watcher is not used for now. -jj. will be removed.
-    if (changeWatcher) // Remove the old watcher if one exists.
+    if (fileIndex) // Remove the old watcher if one exists.
         RemoveWatcher();
 
-    changeWatcher = new QFileSystemWatcher();
-
-    // Add a watcher to listen to if the directory contents change.
-    changeWatcher->addPath(directory);
-
-    // Add a watcher to each file in the directory.
-    QDir dir(directory);
-    QFileInfoList files = dir.entryInfoList(QDir::Files);
-    foreach(QFileInfo i, files)
-        changeWatcher->addPath(i.absoluteFilePath());
-
-    ///\todo The QFileSystemWatcher is severely lacking in functionality. Replace the above with some custom method that can tell
-    /// which files change.
-    */
+    if (recursive)
+        fileIndex = new AssetFileIndex(directory, true);
 }
 
 void LocalAssetStorage::RemoveWatcher()
 {
-    /* This watcher is not used for now. -jj. will be removed.
-    delete changeWatcher;
-    changeWatcher = 0;
-    */
+    delete fileIndex;
+    fileIndex = 0;
 }
 
 } // ~Asset
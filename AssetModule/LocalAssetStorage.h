@@ -6,7 +6,7 @@
 #include "AssetModuleApi.h"
 #include "IAssetStorage.h"
 
-class QFileSystemWatcher;
+class AssetFileIndex;
 
 namespace Asset
 {
@@ -29,6 +29,8 @@ public:
     bool recursive;
 
     /// Starts listening on the local directory this asset storage points to.
+    /** For a recursive storage, creates the index of the files in the directory tree. The index is built on the first lookup
+        and kept up to date by listening on changes to the directories. */
     void SetupWatcher();
 
     /// Stops and deallocates the directory change listener.
@@ -47,8 +49,6 @@ public slots:
     /// \note LocalAssetStorage ignores all subdirectory specifications, so GetFullAssetURL("data/assets/my.mesh") would also return "local://my.mesh".
     QString GetFullAssetURL(const QString &localName);
 
-//    QFileSystemWatcher *changeWatcher;
-
     QString Name() const { return name; }
 
     QString BaseURL() const { return "local://"; }
@@ -58,6 +58,9 @@ public slots:
 private:
     void operator=(const LocalAssetStorage &);
     LocalAssetStorage(const LocalAssetStorage &);
+
+    /// Index of the files in the subdirectories of a recursive storage, or null if not recursive.
+    AssetFileIndex *fileIndex;
 };
 
 }
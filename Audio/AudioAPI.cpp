@@ -9,6 +9,7 @@
 #include "AssetAPI.h"
 #include "AudioAsset.h"
 #include "SoundChannel.h"
+#include "SoundStream.h"
 #include "LoggingFunctions.h"
 
 #ifndef Q_WS_MAC
@@ -52,6 +53,8 @@ public:
     float masterGain;
     /// Master gain for individual sound types
     std::map<SoundChannel::SoundType, float> soundMasterGain;
+    /// Decoder thread of the streamed sounds
+    SoundStreamDecoder *decoder;
 
 //    boost::mutex mutex;
 };
@@ -72,6 +75,7 @@ assetAPI(assetAPI_)
     impl->soundMasterGain[SoundChannel::Ambient] = 1.f;
     impl->soundMasterGain[SoundChannel::Voice] = 1.f;
     impl->listenerPosition = Vector3df(0.0, 0.0, 0.0);
+    impl->decoder = new SoundStreamDecoder();
     
     // By default, initialize default playback device
     Initialize();
@@ -88,6 +92,8 @@ assetAPI(assetAPI_)
 AudioAPI::~AudioAPI()
 {
     Uninitialize();
+    // The channels, and with them the streams, are gone now
+    delete impl->decoder;
     delete impl;
 /*
     framework_->GetDefaultConfig().SetSetting<float>("SoundSystem", "masterGain", masterGain);
@@ -252,7 +258,7 @@ SoundChannelPtr AudioAPI::PlaySound(AssetPtr audioAsset, SoundChannel::SoundType
     if (!channel)
     {
         sound_id_t newId = GetNextSoundChannelID();
-        channel = SoundChannelPtr(new SoundChannel(newId, type));
+        channel = SoundChannelPtr(new SoundChannel(newId, type, impl->decoder));
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -271,7 +277,7 @@ SoundChannelPtr AudioAPI::PlaySound3D(const Vector3df &position, AssetPtr audioA
     if (!channel)
     {
         sound_id_t newId = GetNextSoundChannelID();
-        channel = SoundChannelPtr(new SoundChannel(newId, type));
+        channel = SoundChannelPtr(new SoundChannel(newId, type, impl->decoder));
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -291,7 +297,7 @@ SoundChannelPtr AudioAPI::PlaySoundBuffer(const SoundBuffer &buffer, SoundChanne
     if (!channel)
     {
         sound_id_t newId = GetNextSoundChannelID();
-        channel = SoundChannelPtr(new SoundChannel(newId, type));
+        channel = SoundChannelPtr(new SoundChannel(newId, type, impl->decoder));
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -312,7 +318,7 @@ SoundChannelPtr AudioAPI::PlaySoundBuffer3D(const SoundBuffer &buffer, SoundChan
     if (!channel)
     {
         sound_id_t newId = GetNextSoundChannelID();
-        channel = SoundChannelPtr(new SoundChannel(newId, type));
+        channel = SoundChannelPtr(new SoundChannel(newId, type, impl->decoder));
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -357,6 +363,16 @@ void AudioAPI::SetMasterGain(float masterGain)
     ApplyMasterGain();
 }
 
+void AudioAPI::SetStreamingThreshold(uint bytes)
+{
+    AudioAsset::SetStreamingThreshold(bytes);
+}
+
+uint AudioAPI::GetStreamingThreshold() const
+{
+    return (uint)AudioAsset::StreamingThreshold();
+}
+
 float AudioAPI::GetMasterGain()
 {
     return impl ? impl->masterGain : 0.f;
@@ -51,6 +51,14 @@ public slots:
     /// Sets master gain of certain sound types
     float GetSoundMasterGain(SoundChannel::SoundType type);        
     
+    /// Sets the size from which on .ogg sounds are streamed instead of decoded whole when loaded
+    /** \param bytes Size of the .ogg file in bytes. 0 disables streaming.
+        Affects the sounds loaded after the call. */
+    void SetStreamingThreshold(uint bytes);
+    
+    /// Gets the size from which on .ogg sounds are streamed
+    uint GetStreamingThreshold() const;
+    
     /// Plays non-positional sound
     /** \param name Sound file name or asset id
         \param local If true, name is interpreted as filename. Otherwise asset id
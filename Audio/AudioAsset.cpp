@@ -20,6 +20,9 @@
 
 DEFINE_POCO_LOGGING_FUNCTIONS("AudioAsset")
 
+// A few seconds of compressed music decode into megabytes, so by default anything over 256 KB is streamed.
+size_t AudioAsset::streamingThreshold = 256 * 1024;
+
 AudioAsset::AudioAsset(AssetAPI *owner, const QString &type_, const QString &name_)
 :IAsset(owner, type_, name_), handle(0)
 {
@@ -37,6 +40,7 @@ void AudioAsset::DoUnload()
         alDeleteBuffers(1, &handle);
         handle = 0;
     }
+    streamData.reset();
 }
 
 AssetLoadState AudioAsset::DeserializeFromData(const u8 *data, size_t numBytes)
@@ -44,7 +48,11 @@ AssetLoadState AudioAsset::DeserializeFromData(const u8 *data, size_t numBytes)
     if (WavLoader::IdentifyWavFileInMemory(data, numBytes) && this->Name().endsWith(".wav", Qt::CaseInsensitive)) // Detect whether this file is Wav data or not.
         return (LoadFromWavFileInMemory(data, numBytes) ? ASSET_LOAD_SUCCESFULL : ASSET_LOAD_FAILED);
     else if (this->Name().endsWith(".ogg", Qt::CaseInsensitive))
+    {
+        if (streamingThreshold > 0 && numBytes >= streamingThreshold)
+            return (LoadStreamFromOggVorbisFileInMemory(data, numBytes) ? ASSET_LOAD_SUCCESFULL : ASSET_LOAD_FAILED);
         return (LoadFromOggVorbisFileInMemory(data, numBytes) ? ASSET_LOAD_SUCCESFULL : ASSET_LOAD_FAILED);
+    }
     else
         LogError("Unable to serialize audio asset data. Unknown format!");
     return ASSET_LOAD_FAILED;
@@ -70,6 +78,19 @@ bool AudioAsset::LoadFromOggVorbisFileInMemory(const u8 *data, size_t numBytes)
     return LoadFromRawPCMWavData(&buf.data[0], buf.data.size(), buf.stereo, buf.is16Bit, buf.frequency);
 }
 
+bool AudioAsset::LoadStreamFromOggVorbisFileInMemory(const u8 *data, size_t numBytes)
+{
+    DoUnload();
+
+    // Only check that the headers can be read, the actual decoding is done while playing
+    OggVorbisLoader::OggVorbisDecoder decoder;
+    if (!decoder.Open(data, numBytes))
+        return false;
+
+    streamData = boost::shared_ptr<std::vector<u8> >(new std::vector<u8>(data, data + numBytes));
+    return true;
+}
+
 bool AudioAsset::LoadFromRawPCMWavData(const u8 *data, size_t numBytes, bool stereo, bool is16Bit, int frequency)
 {
     // Clean up the previous OpenAL audio buffer handle, if old data existed.
@@ -134,5 +155,5 @@ bool AudioAsset::CreateBuffer()
 
 bool AudioAsset::IsLoaded() const
 {
-    return handle != 0;
+    return handle != 0 || streamData.get() != 0;
 }
@@ -27,6 +27,10 @@ public:
     /// Loads this audio asset from the given .ogg file in memory.
     bool LoadFromOggVorbisFileInMemory(const u8 *data, size_t numBytes);
 
+    /// Loads this audio asset from the given .ogg file in memory for streamed playback.
+    /// The file is kept compressed, and decoded while playing.
+    bool LoadStreamFromOggVorbisFileInMemory(const u8 *data, size_t numBytes);
+
     /// Loads this audio asset from the given raw PCM WAV data.
     /// @param data Contains the source data. This data is copied to internal AudioAsset memory, and does not need
     ///    to be stored in memory afterwards.
@@ -47,7 +51,26 @@ public:
 
     bool IsLoaded() const;
 
+    /// Returns true if this asset is played by streaming. Streamed assets have no OpenAL buffer, see GetStreamData().
+    bool IsStreamed() const { return streamData.get() != 0; }
+
+    /// Returns the compressed sound data of a streamed asset, or null if the asset is not streamed.
+    boost::shared_ptr<std::vector<u8> > GetStreamData() const { return streamData; }
+
+    /// Sets the .ogg file size, in bytes, from which on .ogg assets are streamed instead of decoded fully when loaded.
+    /// 0 disables streaming.
+    static void SetStreamingThreshold(size_t numBytes) { streamingThreshold = numBytes; }
+
+    /// Returns the .ogg file size from which on .ogg assets are streamed.
+    static size_t StreamingThreshold() { return streamingThreshold; }
+
 private:
+    /// The .ogg file size from which on .ogg assets are streamed.
+    static size_t streamingThreshold;
+
+    /// The compressed sound data, if this asset is streamed. Shared with the playing streams.
+    boost::shared_ptr<std::vector<u8> > streamData;
+
     /// The actual sound data is stored in an OpenAL internal audio buffer. This handle specifies the buffer.
     /// If == 0, then this AudioAsset is unloaded.
     ALuint handle;
@@ -18,6 +18,12 @@ typedef boost::weak_ptr<SoundChannel> SoundChannelWeakPtr;
 
 typedef std::map<sound_id_t, SoundChannelPtr> SoundChannelMap;
 
+class SoundStream;
+typedef boost::shared_ptr<SoundStream> SoundStreamPtr;
+typedef boost::weak_ptr<SoundStream> SoundStreamWeakPtr;
+
+class SoundStreamDecoder;
+
 class AudioAsset;
 typedef boost::shared_ptr<AudioAsset> AudioAssetPtr;
 typedef boost::weak_ptr<AudioAsset> AudioAssetWeakPtr;
@@ -92,63 +92,131 @@ long OggTellCallback(void* datasource)
 namespace OggVorbisLoader
 {
 
-bool LoadOggVorbisFromFileInMemory(const u8 *fileData, size_t numBytes, std::vector<u8> &dst, bool *isStereo, bool *is16Bit, int *frequency)
+struct OggVorbisDecoder::Impl
+{
+    Impl(const u8 *data, size_t numBytes) : source(data, (uint)numBytes) {}
+
+    OggMemDataSource source;
+    OggVorbis_File vf;
+};
+
+OggVorbisDecoder::OggVorbisDecoder() :
+    impl(0),
+    stereo(false),
+    frequency(0)
+{
+}
+
+OggVorbisDecoder::~OggVorbisDecoder()
+{
+    Close();
+}
+
+bool OggVorbisDecoder::Open(const u8 *fileData, size_t numBytes)
 {
+    Close();
+
     if (!fileData || numBytes == 0)
     {
         LogError("Null input data passed in");
         return false;
     }
 
-    if (!isStereo || !is16Bit || !frequency)
-    {
-        LogError("Outputs not set");
-        return false;
-    }
-    
-    OggVorbis_File vf;
-    OggMemDataSource src(fileData, numBytes);
-    
+    impl = new Impl(fileData, numBytes);
+
     ov_callbacks cb;
     cb.read_func = &OggReadCallback;
     cb.seek_func = &OggSeekCallback;
     cb.tell_func = &OggTellCallback;
     cb.close_func = 0;
-                   
-    int ret = ov_open_callbacks(&src, &vf, 0, 0, cb);
+
+    int ret = ov_open_callbacks(&impl->source, &impl->vf, 0, 0, cb);
     if (ret < 0)
     {
         LogError("Not ogg vorbis format");
-        ov_clear(&vf);
+        ov_clear(&impl->vf);
+        delete impl;
+        impl = 0;
         return false;
     }
-    
-    vorbis_info* vi = ov_info(&vf, -1);
+
+    vorbis_info* vi = ov_info(&impl->vf, -1);
     if (!vi)
     {
         LogError("No ogg vorbis stream info");
-        ov_clear(&vf);
+        Close();
         return false;
     }
 
     std::ostringstream msg;
-    msg << "Decoding ogg vorbis stream with " << vi->channels << " channels, frequency " << vi->rate; 
-    LogDebug(msg.str()); 
+    msg << "Decoding ogg vorbis stream with " << vi->channels << " channels, frequency " << vi->rate;
+    LogDebug(msg.str());
 
-    *frequency = vi->rate;
-    *isStereo = (vi->channels > 1);
+    frequency = vi->rate;
+    stereo = (vi->channels > 1);
     if (vi->channels != 1 && vi->channels != 2)
         LogWarning("Warning: Loaded Ogg Vorbis data contains an unsupported number of channels: " + QString::number(vi->channels).toStdString());
 
-    uint decoded_bytes = 0;
+    return true;
+}
+
+size_t OggVorbisDecoder::Decode(u8 *dst, size_t maxBytes)
+{
+    if (!impl)
+        return 0;
+
+    // ov_read returns at most one packet at a time, so keep reading until the output is full
+    size_t decoded_bytes = 0;
+    while(decoded_bytes < maxBytes)
+    {
+        int bitstream;
+        long ret = ov_read(&impl->vf, (char*)dst + decoded_bytes, (int)(maxBytes - decoded_bytes), 0, 2, 1, &bitstream);
+        if (ret <= 0)
+            break;
+        decoded_bytes += ret;
+    }
+    return decoded_bytes;
+}
+
+bool OggVorbisDecoder::Rewind()
+{
+    return impl && ov_raw_seek(&impl->vf, 0) == 0;
+}
+
+void OggVorbisDecoder::Close()
+{
+    if (impl)
+    {
+        ov_clear(&impl->vf);
+        delete impl;
+        impl = 0;
+    }
+}
+
+bool LoadOggVorbisFromFileInMemory(const u8 *fileData, size_t numBytes, std::vector<u8> &dst, bool *isStereo, bool *is16Bit, int *frequency)
+{
+    if (!isStereo || !is16Bit || !frequency)
+    {
+        LogError("Outputs not set");
+        return false;
+    }
+
+    OggVorbisDecoder decoder;
+    if (!decoder.Open(fileData, numBytes))
+        return false;
+
+    *frequency = decoder.Frequency();
+    *isStereo = decoder.IsStereo();
+    *is16Bit = true;
+
+    size_t decoded_bytes = 0;
     dst.clear();
     for(;;)
     {
         static const int MAX_DECODE_SIZE = 16384;
         dst.resize(decoded_bytes + MAX_DECODE_SIZE);
-        int bitstream;
-        long ret = ov_read(&vf, (char*)&dst[decoded_bytes], MAX_DECODE_SIZE, 0, 2, 1, &bitstream);
-        if (ret <= 0)
+        size_t ret = decoder.Decode(&dst[decoded_bytes], MAX_DECODE_SIZE);
+        if (ret == 0)
             break;
         decoded_bytes += ret;
     }
@@ -160,8 +228,7 @@ bool LoadOggVorbisFromFileInMemory(const u8 *fileData, size_t numBytes, std::vec
         msg << "Decoded " << decoded_bytes << " bytes of ogg vorbis sound data";
         LogDebug(msg.str());
     }
-     
-    ov_clear(&vf);
+
     return true;
 }
 
@@ -26,6 +26,47 @@ inline bool AUDIO_API LoadOggVorbisFileToSoundBuffer(const u8 *data, size_t numB
     return LoadOggVorbisFromFileInMemory(data, numBytes, dst.data, &dst.stereo, &dst.is16Bit, &dst.frequency);
 }
 
+/// Decodes a .ogg file in memory piece by piece, for streamed playback.
+/** The file data is not copied, and must stay valid as long as the decoder is used.
+    The output is always 16 bits per sample. */
+class AUDIO_API OggVorbisDecoder
+{
+public:
+    OggVorbisDecoder();
+    ~OggVorbisDecoder();
+
+    /// Opens the given .ogg file in memory and reads its headers.
+    /// @return True on success, false if the data is not Ogg Vorbis.
+    bool Open(const u8 *fileData, size_t numBytes);
+
+    /// Decodes the next raw PCM WAV data.
+    /// @param dst [out] Receives the data.
+    /// @param maxBytes The size of dst, in bytes.
+    /// @return The number of bytes decoded, 0 at the end of the stream or on error.
+    size_t Decode(u8 *dst, size_t maxBytes);
+
+    /// Seeks back to the start of the stream.
+    bool Rewind();
+
+    /// Returns whether the decoded data is stereo (true) or mono (false).
+    bool IsStereo() const { return stereo; }
+
+    /// Returns the sample frequency of the decoded data.
+    int Frequency() const { return frequency; }
+
+private:
+    OggVorbisDecoder(const OggVorbisDecoder &);
+    void operator=(const OggVorbisDecoder &);
+
+    /// Closes the stream.
+    void Close();
+
+    struct Impl;
+    Impl *impl;
+    bool stereo;
+    int frequency;
+};
+
 /// Returns true the header of the given file in memory matches a .ogg file. \todo Implement this.
 /// bool AUDIO_API IdentifyOggVorbisFileInMemory(const u8 *fileData, size_t numBytes);
 
@@ -5,6 +5,7 @@
 #include <QList>
 #include "MemoryLeakCheck.h"
 #include "SoundChannel.h"
+#include "SoundStream.h"
 #include "LoggingFunctions.h"
 
 #ifndef Q_WS_MAC
@@ -21,8 +22,10 @@ static const float MINIMUM_ROLLOFF = 0.1f;
 static const float DEFAULT_ROLLOFF = 2.0f;
 static const float DEFAULT_INNER_RADIUS = 1.0f;
 static const float DEFAULT_OUTER_RADIUS = 50.0f;
+/// Number of OpenAL buffers a streamed sound is played through
+static const uint NUM_STREAM_BUFFERS = 4;
 
-SoundChannel::SoundChannel(sound_id_t channelId_, SoundType type) :
+SoundChannel::SoundChannel(sound_id_t channelId_, SoundType type, SoundStreamDecoder *decoder) :
     type_(type),
     handle_(0),
     pitch_(1.0f),
@@ -37,7 +40,8 @@ SoundChannel::SoundChannel(sound_id_t channelId_, SoundType type) :
     looped_(false),
     buffered_mode_(false),
     state_(Stopped),
-    channelId(channelId_)
+    channelId(channelId_),
+    decoder_(decoder)
 { 
 }
 
@@ -50,6 +54,16 @@ void SoundChannel::Update(const Vector3df& listener_pos)
 {   
     CalculateAttenuation(listener_pos);
     SetAttenuatedGain();
+
+    // A streamed sound may be started only once its asset has loaded, as before that it's not known to be streamed
+    if (!stream_ && !buffered_mode_ && pending_sounds_.size() > 0 && pending_sounds_.front() && pending_sounds_.front()->IsStreamed())
+        StartStream();
+    if (stream_)
+    {
+        UpdateStream();
+        return;
+    }
+
     QueueBuffers();
     UnqueueBuffers();
     
@@ -133,6 +147,13 @@ void SoundChannel::DeleteSource()
         alDeleteSources(1, &handle_);
         handle_ = 0;
     }
+
+    if (stream_buffers_.size() > 0)
+    {
+        alDeleteBuffers(stream_buffers_.size(), &stream_buffers_[0]);
+        stream_buffers_.clear();
+        free_stream_buffers_.clear();
+    }
 }
 
 void SoundChannel::Stop()
@@ -144,6 +165,7 @@ void SoundChannel::Stop()
         alSourcei(handle_, AL_BUFFER, 0);
     }
     
+    StopStream();
     pending_sounds_.clear();
     playing_sounds_.clear();
     
@@ -152,6 +174,8 @@ void SoundChannel::Stop()
 
 QString SoundChannel::GetSoundName() const
 {   
+    if (stream_asset_)
+        return stream_asset_->Name();
     AudioAssetPtr asset = playing_sounds_.size() > 0 ? playing_sounds_.front() : AudioAssetPtr();
     if (asset)
         return asset->Name();
@@ -183,7 +207,10 @@ void SoundChannel::SetLooped(bool enable)
         enable = false;
     
     looped_ = enable;
-    if (handle_)
+    // Streams loop by decoding the sound again, OpenAL would only loop the buffers queued at the moment
+    if (stream_)
+        stream_->SetLooped(looped_);
+    else if (handle_)
         alSourcei(handle_, AL_LOOPING, looped_ ? AL_TRUE : AL_FALSE);
 }
 
@@ -379,3 +406,107 @@ void SoundChannel::UnqueueBuffers()
         }
     }
 }
+
+void SoundChannel::StartStream()
+{
+    AudioAssetPtr asset = pending_sounds_.front();
+    pending_sounds_.clear();
+
+    if (!decoder_)
+    {
+        LogError("Can not play streamed sound " + asset->Name().toStdString() + ", no stream decoder");
+        state_ = Stopped;
+        return;
+    }
+
+    if (!CreateSource())
+    {
+        state_ = Stopped;
+        return;
+    }
+
+    if (stream_buffers_.size() == 0)
+    {
+        stream_buffers_.resize(NUM_STREAM_BUFFERS);
+        alGetError();
+        alGenBuffers(stream_buffers_.size(), &stream_buffers_[0]);
+        if (alGetError() != AL_NONE)
+        {
+            LogError("Could not create OpenAL sound buffers for streaming");
+            stream_buffers_.clear();
+            state_ = Stopped;
+            return;
+        }
+    }
+
+    stream_ = SoundStreamPtr(new SoundStream(asset->GetStreamData(), looped_));
+    if (!stream_->IsValid())
+    {
+        stream_.reset();
+        state_ = Stopped;
+        return;
+    }
+
+    stream_asset_ = asset;
+    free_stream_buffers_ = stream_buffers_;
+    alSourcei(handle_, AL_LOOPING, AL_FALSE);
+    decoder_->AddStream(stream_);
+    state_ = Pending;
+}
+
+void SoundChannel::UpdateStream()
+{
+    // Take back the buffers OpenAL has played
+    int processed = 0;
+    alGetSourcei(handle_, AL_BUFFERS_PROCESSED, &processed);
+    while (processed-- > 0)
+    {
+        ALuint buffer = 0;
+        alSourceUnqueueBuffers(handle_, 1, &buffer);
+        if (buffer)
+            free_stream_buffers_.push_back(buffer);
+    }
+
+    // Refill them with the chunks decoded meanwhile
+    ALenum openALFormat = stream_->IsStereo() ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
+    bool consumed = false;
+    while (free_stream_buffers_.size() > 0)
+    {
+        const std::vector<u8> *chunk = stream_->FrontChunk();
+        if (!chunk)
+            break;
+        ALuint buffer = free_stream_buffers_.back();
+        alBufferData(buffer, openALFormat, &(*chunk)[0], chunk->size(), stream_->Frequency());
+        alSourceQueueBuffers(handle_, 1, &buffer);
+        free_stream_buffers_.pop_back();
+        stream_->PopChunk();
+        consumed = true;
+    }
+    if (consumed)
+        decoder_->Wake();
+
+    int queued = 0;
+    alGetSourcei(handle_, AL_BUFFERS_QUEUED, &queued);
+    if (queued > 0)
+    {
+        // Starts the playback, or resumes it if the decoder fell behind and the source ran out of buffers
+        ALint playing;
+        alGetSourcei(handle_, AL_SOURCE_STATE, &playing);
+        if (playing != AL_PLAYING)
+            alSourcePlay(handle_);
+        state_ = Playing;
+    }
+    else if (stream_->IsFinished())
+        Stop();
+}
+
+void SoundChannel::StopStream()
+{
+    if (!stream_)
+        return;
+
+    // Stop() has already detached the queued buffers from the source
+    stream_.reset();
+    stream_asset_.reset();
+    free_stream_buffers_ = stream_buffers_;
+}
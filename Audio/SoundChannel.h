@@ -33,11 +33,16 @@ public:
         Voice
     };
 
-    SoundChannel(sound_id_t channelId, SoundType type);
+    /// Constructor.
+    /** \param channelId Channel id
+        \param type Sound type
+        \param decoder Decoder thread for streamed sounds. If null, streamed sounds can't be played on this channel. */
+    SoundChannel(sound_id_t channelId, SoundType type, SoundStreamDecoder *decoder = 0);
 
     ~SoundChannel();
     
     /// Start playing sound. Set to pending state if sound is actually not loaded yet
+    /** Streamed assets are decoded while playing, see AudioAsset::IsStreamed(). */
     void Play(AudioAssetPtr audioAsset);
 
     /// Add a sound buffer and play.
@@ -101,6 +106,12 @@ private:
     void QueueBuffers();
     /// Remove processed buffers
     void UnqueueBuffers();
+    /// Start playing a streamed sound, when the asset is loaded
+    void StartStream();
+    /// Refill processed stream buffers with decoded data and keep the stream playing
+    void UpdateStream();
+    /// Stop the stream and detach its buffers from the source
+    void StopStream();
     /// Create OpenAL source if one does not exist yet
     bool CreateSource();
     /// Delete OpenAL source
@@ -146,6 +157,16 @@ private:
     SoundState state_;
     /// Specifies an unique ID for this sound channel. Note that this ID should not be treated as a "channel index" or anything like that.
     sound_id_t channelId;
+    /// Decoder thread for streamed sounds
+    SoundStreamDecoder *decoder_;
+    /// Streamed asset being played, if any
+    AudioAssetPtr stream_asset_;
+    /// Stream being played, if any
+    SoundStreamPtr stream_;
+    /// OpenAL buffers of the stream
+    std::vector<ALuint> stream_buffers_;
+    /// Stream buffers not queued to the source
+    std::vector<ALuint> free_stream_buffers_;
 };
 
 typedef boost::shared_ptr<SoundChannel> SoundChannelPtr;
@@ -0,0 +1,166 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "DebugOperatorNew.h"
+#include <QList>
+#include "MemoryLeakCheck.h"
+#include "SoundStream.h"
+#include "LoggingFunctions.h"
+
+#include <boost/bind.hpp>
+
+DEFINE_POCO_LOGGING_FUNCTIONS("SoundStream")
+
+/// Number of decoded chunks in the ring of a stream.
+static const size_t cNumChunks = 4;
+
+SoundStream::SoundStream(const boost::shared_ptr<std::vector<u8> > &data_, bool looped_) :
+    data(data_),
+    chunks(cNumChunks),
+    readIndex(0),
+    numReady(0),
+    endOfStream(false),
+    looped(looped_),
+    valid(false)
+{
+    for(size_t i = 0; i < chunks.size(); ++i)
+        chunks[i].reserve(cChunkSize);
+
+    if (data && data->size() > 0)
+        valid = decoder.Open(&(*data)[0], data->size());
+    if (!valid)
+        LogError("Could not open sound stream for decoding");
+}
+
+void SoundStream::SetLooped(bool looped_)
+{
+    MutexLock lock(mutex);
+    looped = looped_;
+}
+
+bool SoundStream::DecodeNext()
+{
+    size_t index;
+    bool loop;
+    {
+        MutexLock lock(mutex);
+        if (!valid || endOfStream || numReady == chunks.size())
+            return false;
+        index = (readIndex + numReady) % chunks.size();
+        loop = looped;
+    }
+
+    // The chunk is not visible to the consumer until numReady is incremented, so it is filled without holding the lock
+    std::vector<u8> &chunk = chunks[index];
+    chunk.resize(cChunkSize);
+    size_t numBytes = decoder.Decode(&chunk[0], cChunkSize);
+    if (numBytes < cChunkSize && loop && decoder.Rewind())
+        numBytes += decoder.Decode(&chunk[numBytes], cChunkSize - numBytes);
+    chunk.resize(numBytes);
+
+    MutexLock lock(mutex);
+    if (numBytes == 0)
+    {
+        endOfStream = true;
+        return false;
+    }
+    ++numReady;
+    return true;
+}
+
+const std::vector<u8> *SoundStream::FrontChunk()
+{
+    MutexLock lock(mutex);
+    if (numReady == 0)
+        return 0;
+    return &chunks[readIndex];
+}
+
+void SoundStream::PopChunk()
+{
+    MutexLock lock(mutex);
+    if (numReady == 0)
+        return;
+    readIndex = (readIndex + 1) % chunks.size();
+    --numReady;
+}
+
+bool SoundStream::IsFinished()
+{
+    MutexLock lock(mutex);
+    return !valid || (endOfStream && numReady == 0);
+}
+
+SoundStreamDecoder::SoundStreamDecoder() :
+    woken(false),
+    stop(false)
+{
+    Thread(boost::bind(&SoundStreamDecoder::Run, this)).swap(thread);
+}
+
+SoundStreamDecoder::~SoundStreamDecoder()
+{
+    {
+        MutexLock lock(mutex);
+        stop = true;
+    }
+    workAvailable.notify_one();
+    thread.join();
+}
+
+void SoundStreamDecoder::AddStream(const SoundStreamPtr &stream)
+{
+    {
+        MutexLock lock(mutex);
+        streams.push_back(stream);
+    }
+    Wake();
+}
+
+void SoundStreamDecoder::Wake()
+{
+    {
+        MutexLock lock(mutex);
+        woken = true;
+    }
+    workAvailable.notify_one();
+}
+
+void SoundStreamDecoder::Run()
+{
+    std::vector<SoundStreamPtr> active;
+    for(;;)
+    {
+        {
+            ScopedLock lock(mutex);
+            while(!stop && !woken)
+                workAvailable.wait(lock);
+            if (stop)
+                return;
+            woken = false;
+
+            for(std::list<SoundStreamWeakPtr>::iterator iter = streams.begin(); iter != streams.end();)
+            {
+                SoundStreamPtr stream = iter->lock();
+                if (stream)
+                {
+                    active.push_back(stream);
+                    ++iter;
+                }
+                else
+                    iter = streams.erase(iter);
+            }
+        }
+
+        // Decode one chunk per stream at a time, so that a stream just started doesn't wait for the others to fill up
+        bool decoded = true;
+        while(decoded)
+        {
+            decoded = false;
+            for(size_t i = 0; i < active.size(); ++i)
+                if (active[i]->DecodeNext())
+                    decoded = true;
+        }
+
+        active.clear();
+    }
+}
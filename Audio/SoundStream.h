@@ -0,0 +1,111 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_Audio_SoundStream_h
+#define incl_Audio_SoundStream_h
+
+#include "CoreTypes.h"
+#include "CoreThread.h"
+#include "AudioApiExports.h"
+#include "AudioFwd.h"
+#include "OggVorbisLoader.h"
+
+#include <vector>
+#include <list>
+
+/// A sound decoded piece by piece for streamed playback.
+/** The SoundStreamDecoder thread decodes the sound into a small ring of chunks, and the SoundChannel playing it
+    moves the decoded chunks into its OpenAL buffers. Only the compressed sound data and the ring are kept in memory. */
+class AUDIO_API SoundStream
+{
+public:
+    /// Size of one decoded chunk, in bytes.
+    static const size_t cChunkSize = 65536;
+
+    /// Opens a stream of the given .ogg file data.
+    /// @param data The .ogg file. Shared with the AudioAsset, so that the asset can be unloaded while the stream plays.
+    /// @param looped Whether to start over at the end of the sound.
+    SoundStream(const boost::shared_ptr<std::vector<u8> > &data, bool looped);
+
+    /// Returns whether the data could be opened for decoding.
+    bool IsValid() const { return valid; }
+
+    /// Sets whether to start over at the end of the sound.
+    void SetLooped(bool looped);
+
+    /// Returns whether the decoded data is stereo (true) or mono (false). The data is always 16 bits per sample.
+    bool IsStereo() const { return decoder.IsStereo(); }
+
+    /// Returns the sample frequency of the decoded data.
+    int Frequency() const { return decoder.Frequency(); }
+
+    /// Decodes the next chunk, if there is a free one. Called by the decoder thread.
+    /// @return True if a chunk was decoded, false if the ring is full or the stream has ended.
+    bool DecodeNext();
+
+    /// Returns the oldest decoded chunk, or null if none is ready. The chunk stays valid until PopChunk().
+    const std::vector<u8> *FrontChunk();
+
+    /// Releases the chunk returned by FrontChunk() for decoding.
+    void PopChunk();
+
+    /// Returns true when the whole sound has been decoded and all chunks consumed.
+    bool IsFinished();
+
+private:
+    /// The .ogg file data.
+    boost::shared_ptr<std::vector<u8> > data;
+    /// The decoder. Only used by the decoder thread after construction.
+    OggVorbisLoader::OggVorbisDecoder decoder;
+    /// Ring of decoded chunks. The size of each vector is the number of bytes decoded into it.
+    std::vector<std::vector<u8> > chunks;
+    /// Index of the oldest decoded chunk.
+    size_t readIndex;
+    /// Number of decoded chunks not yet consumed.
+    size_t numReady;
+    /// Whether the decoder has reached the end of the sound.
+    bool endOfStream;
+    /// Whether to start over at the end of the sound.
+    bool looped;
+    /// Whether the data could be opened.
+    bool valid;
+    /// Guards the ring indices and the flags. Not held while decoding or while a chunk is read.
+    Mutex mutex;
+};
+
+/// Thread that decodes the playing sound streams.
+class AUDIO_API SoundStreamDecoder
+{
+public:
+    /// Starts the decoder thread.
+    SoundStreamDecoder();
+
+    /// Stops the decoder thread.
+    ~SoundStreamDecoder();
+
+    /// Starts decoding the given stream. The stream is dropped when no one else holds it anymore.
+    void AddStream(const SoundStreamPtr &stream);
+
+    /// Wakes up the decoder thread, e.g. when a chunk has been consumed.
+    void Wake();
+
+private:
+    SoundStreamDecoder(const SoundStreamDecoder &);
+    void operator=(const SoundStreamDecoder &);
+
+    /// Decoder thread main loop.
+    void Run();
+
+    /// The streams being decoded.
+    std::list<SoundStreamWeakPtr> streams;
+    /// Guards streams and the flags.
+    Mutex mutex;
+    /// Signaled when there may be work for the decoder thread.
+    Condition workAvailable;
+    /// Whether Wake() has been called since the decoder thread last went through the streams.
+    bool woken;
+    /// Tells the decoder thread to exit.
+    bool stop;
+    /// The decoder thread.
+    Thread thread;
+};
+
+#endif
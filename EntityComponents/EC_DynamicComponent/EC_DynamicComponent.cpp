@@ -9,6 +9,7 @@
 #include "Entity.h"
 #include "LoggingFunctions.h"
 #include "SceneManager.h"
+#include "SceneDesc.h"
 
 #include <QScriptEngine>
 #include <QScriptValueIterator>
@@ -99,6 +100,18 @@ void EC_DynamicComponent::DeserializeFrom(QDomElement& element, AttributeChange:
     DeserializeCommon(deserializedAttributes, change);
 }
 
+void EC_DynamicComponent::DeserializeFrom(const ComponentDesc &desc, AttributeChange::Type change)
+{
+    if (!BeginDeserialization(desc))
+        return;
+
+    std::vector<DeserializeData> deserializedAttributes;
+    foreach(const AttributeDesc &a, desc.attributes)
+        deserializedAttributes.push_back(DeserializeData(a.name.toStdString(), a.typeName.toStdString(), a.value.toStdString()));
+
+    DeserializeCommon(deserializedAttributes, change);
+}
+
 void EC_DynamicComponent::DeserializeCommon(std::vector<DeserializeData>& deserializedAttributes, AttributeChange::Type change)
 {
     // Sort both lists in alphabetical order.
@@ -93,6 +93,9 @@ public:
     /// IComponent override.
     void DeserializeFrom(QDomElement& element, AttributeChange::Type change);
 
+    /// IComponent override.
+    void DeserializeFrom(const ComponentDesc &desc, AttributeChange::Type change);
+
     void DeserializeCommon(std::vector<DeserializeData>& deserializedAttributes, AttributeChange::Type change);
 
     /// Constructs a new attribute of type Attribute<T>.
@@ -16,6 +16,13 @@
 #include "TerrainDecoder.h"
 #include "EnvironmentModule.h"
 
+// The vectorized IDCT performs the same float operations in the same order as the scalar one, so it gives bit-exact results
+// as long as the scalar code is also compiled to SSE instructions instead of the x87 FPU, i.e. when targeting SSE2.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAIN_IDCT_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace Environment
 {
 
@@ -175,6 +182,7 @@ void DecodeTerrainPatch(int *patches, ProtocolUtilities::BitStream &bits, const
     }
 }
 
+#ifndef TERRAIN_IDCT_SSE2
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
 /// Performs IDCT on a single column of 16 elements of data. (stride assumed to be 16 elements)
 void IDCTColumn16(const float *linein, float *lineout, int column)
@@ -214,10 +222,73 @@ void IDCTLine16(const float *linein, float *lineout, int line)
     }
 }
 
+/// Performs IDCT on a 16x16 block of data.
+/// @param block [in, out] The data.
+/// @param temp Scratch space of 16x16 elements.
+void IDCT16x16(float *block, float *temp)
+{
+    for (int o = 0; o < 16; o++)
+        IDCTColumn16(block, temp, o);
+    for (int o = 0; o < 16; o++)
+        IDCTLine16(temp, block, o);
+}
+
+#else
+
+/// Performs IDCT on all the 16 columns of 16 elements of data, four columns at a time. Same as IDCTColumn16 for each column.
+void IDCTColumns16SSE2(const float *linein, float *lineout)
+{
+    const int cStride = 16;
+    const __m128 oosqrt2 = _mm_set1_ps(OO_SQRT2);
+
+    for (int n = 0; n < 16; n++)
+        for (int column = 0; column < 16; column += 4)
+        {
+            __m128 total = _mm_mul_ps(oosqrt2, _mm_loadu_ps(linein + column));
+
+            for (int u = 1; u < 16; u++)
+                total = _mm_add_ps(total, _mm_mul_ps(_mm_loadu_ps(linein + u*cStride + column), _mm_set1_ps(precompTables.cosineTable16[u*cStride + n])));
+
+            _mm_storeu_ps(lineout + 16 * n + column, total);
+        }
+}
+
+/// Performs IDCT on all the 16 rows of 16 elements of data, four outputs of a row at a time. Same as IDCTLine16 for each row.
+void IDCTLines16SSE2(const float *linein, float *lineout)
+{
+    const __m128 oosob = _mm_set1_ps(2.0f / 16.0f);
+
+    for (int line = 0; line < 16; line++)
+    {
+        int lineSize = line * 16;
+        const __m128 first = _mm_set1_ps(OO_SQRT2 * linein[lineSize]);
+
+        for (int n = 0; n < 16; n += 4)
+        {
+            __m128 total = first;
+
+            for (int u = 1; u < 16; u++)
+                total = _mm_add_ps(total, _mm_mul_ps(_mm_set1_ps(linein[lineSize + u]), _mm_loadu_ps(precompTables.cosineTable16 + u * 16 + n)));
+
+            _mm_storeu_ps(lineout + lineSize + n, _mm_mul_ps(total, oosob));
+        }
+    }
+}
+
+/// Performs IDCT on a 16x16 block of data.
+/// @param block [in, out] The data.
+/// @param temp Scratch space of 16x16 elements.
+void IDCT16x16(float *block, float *temp)
+{
+    IDCTColumns16SSE2(block, temp);
+    IDCTLines16SSE2(temp, block);
+}
+
+#endif
+
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
-void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const TerrainPatchHeader &patchHeader, const TerrainPatchGroupHeader &groupHeader)
+void DecompressTerrainPatch(std::vector<float> &output, const int *patchData, const TerrainPatchHeader &patchHeader, const TerrainPatchGroupHeader &groupHeader)
 {
-    std::vector<float> block(groupHeader.patchSize * groupHeader.patchSize);
     output.clear();
     output.resize(groupHeader.patchSize * groupHeader.patchSize);
 
@@ -233,17 +304,14 @@ void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const Te
         return;
     }
 
+    float block[16*16];
     for(int n = 0; n < 16 * 16; n++)
         block[n] = patchData[precompTables.copyMatrix16[n]] * precompTables.dequantizeTable16[n];
 
-    std::vector<float> ftemp(16*16);
-
-    for (int o = 0; o < 16; o++)
-        IDCTColumn16(&block[0], &ftemp[0], o);
-    for (int o = 0; o < 16; o++)
-        IDCTLine16(&ftemp[0], &block[0], o);
+    float ftemp[16*16];
+    IDCT16x16(block, ftemp);
 
-    for (int j = 0; j < block.size(); j++)
+    for (int j = 0; j < 16 * 16; j++)
         output[j] = block[j] * mult + addval;
 }
 
@@ -252,30 +320,42 @@ void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const Te
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
 void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader)
 {
+    if (groupHeader.patchSize != 16)
+    {
+        EnvironmentModule::LogWarning("TerrainDecoder:DecompressLand: Unsupported patch size present!");
+        return;
+    }
+
+    // Read the coefficients of all the patches of the group first. Reading the bit stream is sequential,
+    // but the transforms of the patches are independent of each other and are done as one batch after that.
+    const size_t firstPatch = patches.size();
+    const size_t patchElems = groupHeader.patchSize * groupHeader.patchSize;
+    std::vector<int> patchData;
+
     while(bits.BitsLeft() > 0)
     {
-        DecodedTerrainPatch patch;
-        patch.header = DecodePatchHeader(bits);
+        TerrainPatchHeader header = DecodePatchHeader(bits);
 
-        if (patch.header.quantWBits == cEndOfPatches)
+        if (header.quantWBits == cEndOfPatches)
             break;
 
         const int cPatchesPerEdge = 16;
 
         // The MSB of header.x and header.y are unused, or used for some other purpose?
-        if (patch.header.x >= cPatchesPerEdge || patch.header.y >= cPatchesPerEdge)
+        if (header.x >= cPatchesPerEdge || header.y >= cPatchesPerEdge)
         {
             EnvironmentModule::LogWarning("TerrainDecoder:DecompressLand: Invalid patch data!");
-            return;
+            break;
         }
 
-        int patchData[16*16];
-        DecodeTerrainPatch(patchData, bits, patch.header, groupHeader.patchSize);
-
-        DecompressTerrainPatch(patch.heightData, patchData, patch.header, groupHeader);
-
-        patches.push_back(patch); ///\todo Can optimize out a copy of heavy struct by push_backing early in the loop.
+        patches.push_back(DecodedTerrainPatch());
+        patches.back().header = header;
+        patchData.resize(patchData.size() + patchElems);
+        DecodeTerrainPatch(&patchData[patchData.size() - patchElems], bits, header, groupHeader.patchSize);
     }
+
+    for(size_t i = firstPatch; i < patches.size(); ++i)
+        DecompressTerrainPatch(patches[i].heightData, &patchData[(i - firstPatch) * patchElems], patches[i].header, groupHeader);
 }
 
 }
@@ -19,6 +19,7 @@ bool EventManager::AddSubscriber(T* subscriber, QList<U>& subscribers, int prior
         {
             subscribers[i].priority_ = priority;
             qSort(subscribers.begin(), subscribers.end());
+            InvalidateDispatchTable();
             return true;
         }
 
@@ -27,6 +28,7 @@ bool EventManager::AddSubscriber(T* subscriber, QList<U>& subscribers, int prior
     new_subscriber.priority_ = priority;
     subscribers.append(new_subscriber);
     qSort(subscribers.begin(), subscribers.end());
+    InvalidateDispatchTable();
 
     return true;
 }
@@ -58,6 +60,7 @@ bool EventManager::RemoveSubscriber(T* subscriber, QList<U>& subscribers )
         if (subscribers[i].subscriber_ == subscriber)
         {
             subscribers.erase(subscribers.begin() + i);
+            InvalidateDispatchTable();
             return true;
         }
 
@@ -103,6 +106,8 @@ bool EventManager::UnregisterEventSubscriber(T* subscriber)
             else
                 ++iter;
         }
+        if (ret2)
+            InvalidateDispatchTable();
 
         return (ret || ret2);
     }
@@ -140,10 +145,62 @@ bool EventManager::HasEventSubscriber(T* subscriber)
     return false;
  }
 
+template <typename T, typename U>
+bool EventManager::AddSubscription(T* subscriber, QList<U>& subscribers, event_category_id_t category_id, event_id_t event_id, bool whole_category)
+{
+    for(int i = 0; i < subscribers.size(); ++i)
+        if (subscribers[i].subscriber_ == subscriber)
+        {
+            subscribers[i].catch_all_ = false;
+            if (whole_category)
+                subscribers[i].categories_.insert(category_id);
+            else
+                subscribers[i].events_.insert(qMakePair(category_id, event_id));
+            InvalidateDispatchTable();
+            return true;
+        }
+
+    RootLogError("Tried to declare events for a module or component that is not an event subscriber");
+    return false;
+}
+
+template <typename T>
+bool EventManager::RegisterEventSubscription(T* subscriber, event_category_id_t category_id, event_id_t event_id)
+{
+    if (!subscriber || category_id == IllegalEventCategory)
+        return false;
+
+    IModule* module = dynamic_cast<IModule* >(subscriber);
+    if ( module != 0)
+        return AddSubscription(module, module_subscribers_, category_id, event_id, false);
+
+    IComponent* component = dynamic_cast<IComponent* >(subscriber);
+    if ( component != 0 )
+        return AddSubscription(component, component_subscribers_, category_id, event_id, false);
+
+    return false;
+}
+
+template <typename T>
+bool EventManager::RegisterEventSubscription(T* subscriber, event_category_id_t category_id)
+{
+    if (!subscriber || category_id == IllegalEventCategory)
+        return false;
+
+    IModule* module = dynamic_cast<IModule* >(subscriber);
+    if ( module != 0)
+        return AddSubscription(module, module_subscribers_, category_id, 0, true);
+
+    IComponent* component = dynamic_cast<IComponent* >(subscriber);
+    if ( component != 0 )
+        return AddSubscription(component, component_subscribers_, category_id, 0, true);
+
+    return false;
+}
+
 template <typename T>
-bool EventManager::SendEvent(const EventSubscriber<T>& subs, event_category_id_t category_id, event_id_t event_id, IEventData* data) const
+bool EventManager::SendEvent(T* subscriber, event_category_id_t category_id, event_id_t event_id, IEventData* data) const
  {
-    T* subscriber = subs.subscriber_;
     if (subscriber)
     {
         try
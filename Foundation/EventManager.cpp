@@ -8,6 +8,7 @@
 #include "IEventData.h"
 #include "ModuleManager.h"
 #include "CoreException.h"
+#include "HighPerfClock.h"
 
 #include "AssetAPI.h"
 
@@ -24,7 +25,8 @@ EventManager::EventManager(Foundation::Framework *framework) :
     framework_(framework),
     next_category_id_(1),
 //    next_request_tag_(1),
-    main_thread_id_(QThread::currentThreadId())
+    main_thread_id_(QThread::currentThreadId()),
+    subscription_generation_(0)
 {
 }
 
@@ -116,35 +118,91 @@ bool EventManager::SendEvent(event_category_id_t category_id, event_id_t event_i
         return false;
     }
 
-    // Send event in priority order, until someone returns true
-    for (int i = 0; i < module_subscribers_.size(); ++i)
-        if (SendEvent(module_subscribers_[i], category_id, event_id, data))
-            return true;
+    // Look up the subscribers of the event, collecting them on the first send
+    QPair<event_category_id_t, event_id_t> key = qMakePair(category_id, event_id);
+    QHash<QPair<event_category_id_t, event_id_t>, DispatchList>::const_iterator iter = dispatch_table_.find(key);
+    if (iter == dispatch_table_.end())
+        iter = dispatch_table_.insert(key, BuildDispatchList(category_id, event_id));
+    // Copy the (implicitly shared) lists, as the handlers may change the subscribers
+    DispatchList dispatch = iter.value();
 
-    // After that send events to components
-    for (int i = 0; i < component_subscribers_.size(); ++i)
-        if (SendEvent(component_subscribers_[i], category_id, event_id, data))
-            return true;
+    tick_t start = GetCurrentClockTime();
+    u64 num_calls = 0;
+    bool handled = SendEvent(dispatch, category_id, event_id, data, num_calls);
 
-    // Then go through 
-    QPair<event_category_id_t, event_id_t> group = qMakePair<event_category_id_t, event_id_t>(category_id, event_id);
-   
-    if ( specialEvents_.contains(group) )
+    DispatchStats &stats = dispatch_stats_[category_id];
+    ++stats.num_events_;
+    stats.num_handler_calls_ += num_calls;
+    stats.elapsed_ += GetCurrentClockTime() - start;
+
+    return handled;
+}
+
+bool EventManager::SendEvent(const DispatchList& dispatch, event_category_id_t category_id, event_id_t event_id, IEventData* data, u64& num_calls)
+{
+    uint generation = subscription_generation_;
+
+    // Send event in priority order, until someone returns true. If a handler changed the subscribers,
+    // skip the ones that are no longer subscribed, as they may have been deleted.
+    for (int i = 0; i < dispatch.modules_.size(); ++i)
     {
-        QList<IComponent* >& lst = specialEvents_[group];
-        for ( int i = 0; i < lst.size(); ++i)
-        {
-            EventSubscriber<IComponent> subs;
-            subs.subscriber_ = lst[i];
+        IModule* module = dispatch.modules_[i];
+        if (generation != subscription_generation_ && !EventSubscriberExist(module, module_subscribers_))
+            continue;
+        ++num_calls;
+        if (SendEvent(module, category_id, event_id, data))
+            return true;
+    }
 
-            if (SendEvent(subs, category_id, event_id, data))
-                return true;
-        }
+    // After that send events to components, including the ones registered for this event only
+    for (int i = 0; i < dispatch.components_.size(); ++i)
+    {
+        IComponent* component = dispatch.components_[i];
+        if (generation != subscription_generation_ && !IsComponentSubscribed(component, category_id, event_id))
+            continue;
+        ++num_calls;
+        if (SendEvent(component, category_id, event_id, data))
+            return true;
     }
 
     return false;
 }
 
+EventManager::DispatchList EventManager::BuildDispatchList(event_category_id_t category_id, event_id_t event_id) const
+{
+    DispatchList dispatch;
+    for (int i = 0; i < module_subscribers_.size(); ++i)
+        if (module_subscribers_[i].Handles(category_id, event_id))
+            dispatch.modules_.append(module_subscribers_[i].subscriber_);
+
+    for (int i = 0; i < component_subscribers_.size(); ++i)
+        if (component_subscribers_[i].Handles(category_id, event_id))
+            dispatch.components_.append(component_subscribers_[i].subscriber_);
+
+    QMap<QPair<event_category_id_t, event_id_t>, QList<IComponent* > >::const_iterator special =
+        specialEvents_.find(qMakePair(category_id, event_id));
+    if (special != specialEvents_.end())
+        dispatch.components_.append(special.value());
+
+    return dispatch;
+}
+
+bool EventManager::IsComponentSubscribed(IComponent* component, event_category_id_t category_id, event_id_t event_id)
+{
+    if (EventSubscriberExist(component, component_subscribers_))
+        return true;
+
+    QMap<QPair<event_category_id_t, event_id_t>, QList<IComponent* > >::const_iterator special =
+        specialEvents_.find(qMakePair(category_id, event_id));
+    return special != specialEvents_.end() && special.value().contains(component);
+}
+
+void EventManager::InvalidateDispatchTable()
+{
+    dispatch_table_.clear();
+    ++subscription_generation_;
+}
+
 bool EventManager::SendEvent(const std::string& category, event_id_t event_id, IEventData* data)
 {
     return SendEvent(QueryEventCategory(category), event_id, data);
@@ -188,6 +246,7 @@ bool EventManager::RegisterEventSubscriber(IComponent* component, event_category
         lst.append(component);
         specialEvents_.insert(group,lst);
     }
+    InvalidateDispatchTable();
 
     return true;
 }
@@ -206,6 +265,7 @@ bool EventManager::UnregisterEventSubscriber(IComponent* component, event_catego
         
         if (lst.empty())
             specialEvents_.remove(group);
+        InvalidateDispatchTable();
         
         return true;
    }
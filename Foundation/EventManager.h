@@ -12,6 +12,8 @@
 #include <QList>
 #include <QtAlgorithms>
 #include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QPair>
 
 class EventManager
@@ -115,6 +117,44 @@ public:
     template <typename T>
     bool HasEventSubscriber(T* subscriber);
 
+    //! Declares that a module or component handles an event
+    /*! A subscriber that has declared the events it handles is sent only those events, in its priority order.
+        Subscribers that have declared nothing are sent all events, as before. The subscriber must be registered
+        with RegisterEventSubscriber() first. Do not call while responding to an event!
+        \param subscriber Module or component
+        \param category_id Event category ID
+        \param event_id Event ID
+        \return true if the subscriber was registered
+     */
+    template <typename T>
+    bool RegisterEventSubscription(T* subscriber, event_category_id_t category_id, event_id_t event_id);
+
+    //! Declares that a module or component handles all the events of a category
+    /*! \sa RegisterEventSubscription(T*, event_category_id_t, event_id_t)
+     */
+    template <typename T>
+    bool RegisterEventSubscription(T* subscriber, event_category_id_t category_id);
+
+    //! Dispatch cost of the events of a category
+    struct DispatchStats
+    {
+        DispatchStats() : num_events_(0), num_handler_calls_(0), elapsed_(0) {}
+
+        //! Number of events sent
+        u64 num_events_;
+        //! Number of HandleEvent calls made for the events
+        u64 num_handler_calls_;
+        //! Clock ticks spent sending the events, including the handlers and the events they sent
+        u64 elapsed_;
+    };
+    typedef std::map<event_category_id_t, DispatchStats> DispatchStatsMap;
+
+    //! Returns the dispatch cost of each event category since the last ResetDispatchStats()
+    const DispatchStatsMap &GetDispatchStats() const { return dispatch_stats_; }
+
+    //! Resets the dispatch cost counters
+    void ResetDispatchStats() { dispatch_stats_.clear(); }
+
     //! Clears all delayed events. Called by the framework.
     /*! Called before unloading modules so that shared pointers left in the delayed event queue do not cause trouble
         (for example Ogre textures that would otherwise freed after Ogre uninit, leading to a crash)
@@ -162,11 +202,24 @@ private:
    class EventSubscriber
    {
    public:
-       EventSubscriber() : priority_(0), subscriber_(0) {}
+       EventSubscriber() : subscriber_(0), priority_(0), catch_all_(true) {}
        virtual ~EventSubscriber() { subscriber_ = 0; }
        
        T* subscriber_;
        int priority_;
+
+       //! Whether the subscriber is sent all events, i.e. has not declared the events it handles
+       bool catch_all_;
+       //! Categories the subscriber handles all events of
+       QSet<event_category_id_t> categories_;
+       //! Single events the subscriber handles
+       QSet<QPair<event_category_id_t, event_id_t> > events_;
+
+       //! Returns whether the subscriber should be sent the event
+       bool Handles(event_category_id_t category_id, event_id_t event_id) const
+       {
+           return catch_all_ || categories_.contains(category_id) || events_.contains(qMakePair(category_id, event_id));
+       }
       
        bool operator<(const EventSubscriber& rhs) const
        {
@@ -184,7 +237,16 @@ private:
         f64 delay_;
    };
 
-    /// Sends event to a module in the subscriber vector
+   //! The subscribers of an event, in the order they are sent the event. Used internally by EventManager.
+   struct DispatchList
+   {
+        //! Module subscribers in priority order
+        QList<IModule*> modules_;
+        //! Component subscribers in priority order, followed by the components registered for this event only
+        QList<IComponent*> components_;
+   };
+
+    /// Sends event to a module or component
     /** @param subscriber Which subscriber to send to
         @param category_id Event category ID
         @param event_id Event ID
@@ -192,7 +254,26 @@ private:
         @return true if event handled and further subscribers should not be processed
     */
    template <typename T>
-   bool SendEvent(const EventSubscriber<T>& subs, event_category_id_t category_id, event_id_t event_id, IEventData* data) const;
+   bool SendEvent(T* subscriber, event_category_id_t category_id, event_id_t event_id, IEventData* data) const;
+
+   /// Sends event to the subscribers of a dispatch list, until one of them handles it
+   /** @param dispatch The subscribers
+       @param num_calls [out] Number of subscribers sent the event
+       @return true if event was handled
+   */
+   bool SendEvent(const DispatchList& dispatch, event_category_id_t category_id, event_id_t event_id, IEventData* data, u64& num_calls);
+
+   /// Collects the subscribers of an event
+   DispatchList BuildDispatchList(event_category_id_t category_id, event_id_t event_id) const;
+
+   /// Returns whether the component is still subscribed to the event
+   bool IsComponentSubscribed(IComponent* component, event_category_id_t category_id, event_id_t event_id);
+
+   /// Drops the dispatch lists after a change of subscribers
+   void InvalidateDispatchTable();
+
+   template <typename T, typename U>
+   bool AddSubscription(T* subscriber, QList<U>& subscribers, event_category_id_t category_id, event_id_t event_id, bool whole_category);
 
    template <typename T, typename U>
    bool AddSubscriber(T* subscriber, QList<U>& subscribers, int priority);
@@ -236,6 +317,15 @@ private:
     Qt::HANDLE main_thread_id_;
 
     QMap<QPair<event_category_id_t, event_id_t>, QList<IComponent* > > specialEvents_;
+
+    /// Subscribers of each event sent so far. Built on first send of the event, dropped when the subscribers change.
+    QHash<QPair<event_category_id_t, event_id_t>, DispatchList> dispatch_table_;
+
+    /// Incremented whenever the subscribers change, so that an event being sent notices subscribers removed by its handlers
+    uint subscription_generation_;
+
+    /// Dispatch cost of each event category
+    DispatchStatsMap dispatch_stats_;
 };
 
 #include "EventManager-templates.h"
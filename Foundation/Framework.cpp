@@ -13,6 +13,7 @@
 #include "ComponentManager.h"
 #include "ServiceManager.h"
 #include "ThreadTaskManager.h"
+#include "JobSystem.h"
 #include "RenderServiceInterface.h"
 #include "CoreException.h"
 #include "InputAPI.h"
@@ -44,6 +45,8 @@
 #include <QIcon>
 #include <QMetaMethod>
 
+#include <boost/bind.hpp>
+
 #include "MemoryLeakCheck.h"
 
 namespace Task
@@ -77,6 +80,10 @@ namespace Foundation
         audio(0),
         debug(new DebugAPI(this)),
         scene(new SceneAPI(this))
+#ifdef PROFILING
+        ,profiler_trace_interval_(0.f),
+        profiler_trace_timer_(0.f)
+#endif
     {
         ParseProgramOptions();
 
@@ -104,6 +111,9 @@ namespace Foundation
             config_manager_->DeclareSetting(Framework::ConfigurationGroup(), std::string("window_title"), std::string("realXtend Naali"));
             config_manager_->DeclareSetting(Framework::ConfigurationGroup(), std::string("log_console"), bool(true));
             config_manager_->DeclareSetting(Framework::ConfigurationGroup(), std::string("log_level"), std::string("information"));
+#ifdef PROFILING
+            profiler_trace_interval_ = config_manager_->DeclareSetting(Framework::ConfigurationGroup(), std::string("profiler_trace_interval"), 0.f);
+#endif
 
             platform_->PrepareApplicationDataDirectory(); // depends on config
 
@@ -145,6 +155,7 @@ namespace Foundation
             service_manager_ = ServiceManagerPtr(new ServiceManager());
             event_manager_ = EventManagerPtr(new EventManager(this));
             thread_task_manager_ = ThreadTaskManagerPtr(new ThreadTaskManager(this));
+            job_system_ = JobSystemPtr(new JobSystem());
 
             // Register task and scene events
             Task::Events::RegisterTaskEvents(event_manager_);
@@ -152,7 +163,7 @@ namespace Foundation
 
             initialized_ = true;
 
-            asset = new AssetAPI(headless_);
+            asset = new AssetAPI(this, headless_);
             const char cDefaultAssetCachePath[] = "/assetcache";
             asset->OpenAssetCache((GetPlatform()->GetApplicationDataDirectory() + cDefaultAssetCachePath).c_str());
 
@@ -185,6 +196,7 @@ namespace Foundation
 
     Framework::~Framework()
     {
+        job_system_.reset();
         thread_task_manager_.reset();
         event_manager_.reset();
         service_manager_.reset();
@@ -316,6 +328,7 @@ namespace Foundation
             ("run", po::value<std::vector<std::string> >(), "Run script on startup") // JavaScriptModule
             ("file", po::value<std::string>(), "Load scene on startup. Accepts absolute and relative paths, local:// and http:// are accepted and fetched via the AssetAPI.") // TundraLogicModule & AssetModule
               ("storage", po::value<std::vector<std::string> >(), "Adds the given directory as a local storage directory on startup") // AssetModule
+            ("assetcachesize", po::value<int>(), "Specifies the maximum size of the asset cache in megabytes. Default: 1024") // AssetModule
             ("login", po::value<std::string>(), "Automatically login to server using provided data. Url syntax: {tundra|http|https}://host[:port]/?username=x[&password=y&avatarurl=z&protocol={udp|tcp}]. Minimum information needed to try a connection in the url are host and username")
             ///\todo The following options seem to be unused in the system. These should be removed or reimplemented. -jj.
             ("user", po::value<std::string>(), "OpenSim login name")
@@ -380,6 +393,12 @@ namespace Foundation
             thread_task_manager_->SendResultEvents();
         }
 
+        // Run the main thread continuations of finished jobs
+        {
+            PROFILE(Update_Jobs);
+            job_system_->Update();
+        }
+
         // Process delayed events
         {
             PROFILE(Update_DelayedEvents);
@@ -419,6 +438,19 @@ namespace Foundation
             PROFILE(Update_FrameAPI);
             frame->Update(frametime);
         }
+
+#ifdef PROFILING
+        // Rolling trace export, so that a headless server can be profiled without a console
+        if (profiler_trace_interval_ > 0.f)
+        {
+            profiler_trace_timer_ += (float)frametime;
+            if (profiler_trace_timer_ >= profiler_trace_interval_)
+            {
+                profiler_trace_timer_ = 0.f;
+                profiler_.ExportTrace(platform_->GetApplicationDataDirectory() + "/profiler_trace.json");
+            }
+        }
+#endif
     }
 
     void Framework::UpdateRendering(double frametime)
@@ -449,6 +481,12 @@ namespace Foundation
         // Qt main loop execution has ended, we are existing.
         exit_signal_ = true;
 
+        // Finish the jobs in flight and drop their continuations and the decoded assets, as they may run or hold module code.
+        if (job_system_)
+            job_system_->Drain();
+        if (asset)
+            asset->ClearDecodedTransfers();
+
         // Unload modules
         UnloadModules();
 
@@ -646,6 +684,98 @@ namespace Foundation
             level -= 2;
     }
 
+    ConsoleCommandResult Framework::ConsoleEventStats(const StringVector &params)
+    {
+        if (params.size() > 0 && params.front() == "reset")
+        {
+            event_manager_->ResetDispatchStats();
+            return ConsoleResultSuccess("Event dispatch statistics reset.");
+        }
+
+        double freq = (double)GetCurrentClockFreq();
+        const EventManager::DispatchStatsMap &stats = event_manager_->GetDispatchStats();
+        for(EventManager::DispatchStatsMap::const_iterator iter = stats.begin(); iter != stats.end(); ++iter)
+        {
+            const EventManager::DispatchStats &s = iter->second;
+            double elapsed = s.elapsed_ / freq;
+            char str[512];
+            sprintf(str, "%s: events: %lu, handler calls: %lu (%.1f per event), elapsed: %s, avg: %s",
+                event_manager_->QueryEventCategoryName(iter->first).c_str(), (unsigned long)s.num_events_,
+                (unsigned long)s.num_handler_calls_, s.num_events_ ? (double)s.num_handler_calls_ / s.num_events_ : 0.0,
+                FormatTime(elapsed).c_str(), FormatTime(s.num_events_ ? elapsed / s.num_events_ : 0.0).c_str());
+            if (console)
+                console->Print(str);
+        }
+        return ConsoleResultSuccess();
+    }
+
+    namespace
+    {
+        void EmptyJob()
+        {
+        }
+
+        void Increment(int *value)
+        {
+            ++*value;
+        }
+
+        //! Spawns jobs from a worker thread and waits for them, so that the other workers have to steal them
+        void FanOutJob(JobSystem *jobs, int count)
+        {
+            JobVector children;
+            children.reserve(count);
+            for(int i = 0; i < count; ++i)
+                children.push_back(jobs->Spawn(&EmptyJob));
+            for(int i = 0; i < count; ++i)
+                jobs->Wait(children[i]);
+        }
+    }
+
+    ConsoleCommandResult Framework::ConsoleJobBenchmark(const StringVector &params)
+    {
+        const int count = params.size() > 0 ? std::max(1, ParseString<int>(params[0], 10000)) : 10000;
+        JobSystem &jobs = *job_system_;
+        double nsec_per_tick = 1000000000.0 / (double)GetCurrentClockFreq();
+
+        // Spawn from the main thread, and run
+        tick_t start = GetCurrentClockTime();
+        JobVector spawned;
+        spawned.reserve(count);
+        for(int i = 0; i < count; ++i)
+            spawned.push_back(jobs.Spawn(&EmptyJob));
+        for(int i = 0; i < count; ++i)
+            jobs.Wait(spawned[i]);
+        double spawn = (GetCurrentClockTime() - start) * nsec_per_tick / count;
+        spawned.clear();
+
+        // Spawn from a worker, run by it and the workers stealing from it
+        start = GetCurrentClockTime();
+        jobs.Wait(jobs.Spawn(boost::bind(&FanOutJob, &jobs, count)));
+        double steal = (GetCurrentClockTime() - start) * nsec_per_tick / count;
+
+        // Chain of jobs, each depending on the previous one
+        start = GetCurrentClockTime();
+        JobPtr previous;
+        for(int i = 0; i < count; ++i)
+            previous = jobs.Spawn(&EmptyJob, previous);
+        jobs.Wait(previous);
+        double chain = (GetCurrentClockTime() - start) * nsec_per_tick / count;
+
+        // Main thread continuations of finished jobs
+        int continued = 0;
+        start = GetCurrentClockTime();
+        for(int i = 0; i < count; ++i)
+            jobs.ContinueOnMainThread(previous, boost::bind(&Increment, &continued));
+        jobs.Update();
+        double continuation = (GetCurrentClockTime() - start) * nsec_per_tick / count;
+
+        char str[256];
+        sprintf(str, "%d jobs on %u threads, per job: spawn and run %.0f ns, fan-out from a worker %.0f ns, dependency chain %.0f ns, continuation %.0f ns",
+            count, jobs.NumThreads(), spawn, steal, chain, continuation);
+        return ConsoleResultSuccess(str);
+    }
+
     ConsoleCommandResult Framework::ConsoleProfile(const StringVector &params)
     {
 #ifdef PROFILING
@@ -665,6 +795,38 @@ namespace Foundation
         return ConsoleResultSuccess();
     }
 
+    ConsoleCommandResult Framework::ConsoleProfilerTrace(const StringVector &params)
+    {
+#ifdef PROFILING
+        std::string filename = params.size() > 0 ? params[0] : platform_->GetApplicationDataDirectory() + "/profiler_trace.json";
+        if (!profiler_.ExportTrace(filename))
+            return ConsoleResultFailure("Could not write " + filename);
+        return ConsoleResultSuccess("Wrote profiler trace to " + filename);
+#else
+        return ConsoleResultFailure("Profiling is disabled in this build.");
+#endif
+    }
+
+    ConsoleCommandResult Framework::ConsoleProfilerOverhead(const StringVector &params)
+    {
+#ifdef PROFILING
+        const int count = 100000;
+        boost::int64_t start = GetCurrentClockTime();
+        for(int i = 0; i < count; ++i)
+        {
+            PROFILE(FW_ProfilerOverhead);
+        }
+        boost::int64_t end = GetCurrentClockTime();
+        double nsec = (double)(end - start) * 1000000000.0 / (double)GetCurrentClockFreq() / count;
+
+        char str[128];
+        sprintf(str, "Empty PROFILE block: %.1f ns (%d runs)", nsec, count);
+        return ConsoleResultSuccess(str);
+#else
+        return ConsoleResultFailure("Profiling is disabled in this build.");
+#endif
+    }
+
     void Framework::RegisterConsoleCommands()
     {
         console->RegisterCommand(CreateConsoleCommand("LoadModule",
@@ -683,10 +845,26 @@ namespace Foundation
             "Sends an internal event. Only for events that contain no data. Usage: SendEvent(event category name, event id)",
             ConsoleBind(this, &Framework::ConsoleSendEvent)));
 
+        console->RegisterCommand(CreateConsoleCommand("JobBenchmark",
+            "Measures the spawn, steal, dependency and continuation latencies of the job system. Usage: JobBenchmark(number of jobs)",
+            ConsoleBind(this, &Framework::ConsoleJobBenchmark)));
+
+        console->RegisterCommand(CreateConsoleCommand("EventStats",
+            "Outputs the event dispatch cost of each event category. Usage: EventStats() or EventStats(reset)",
+            ConsoleBind(this, &Framework::ConsoleEventStats)));
+
 #ifdef PROFILING
         console->RegisterCommand(CreateConsoleCommand("Profile", 
             "Outputs profiling data. Usage: Profile() for full, or Profile(name) for specific profiling block",
             ConsoleBind(this, &Framework::ConsoleProfile)));
+
+        console->RegisterCommand(CreateConsoleCommand("ProfilerTrace",
+            "Writes the latest profiling blocks of each thread as a Chrome trace (chrome://tracing). Usage: ProfilerTrace(file)",
+            ConsoleBind(this, &Framework::ConsoleProfilerTrace)));
+
+        console->RegisterCommand(CreateConsoleCommand("ProfilerOverhead",
+            "Measures the time taken by an empty profiling block.",
+            ConsoleBind(this, &Framework::ConsoleProfilerOverhead)));
 #endif
     }
 
@@ -732,6 +910,11 @@ namespace Foundation
         return thread_task_manager_;
     }
 
+    JobSystemPtr Framework::GetJobSystem()
+    {
+        return job_system_;
+    }
+
     ConfigurationManager &Framework::GetDefaultConfig()
     {
         return *(config_manager_.get());
@@ -128,6 +128,9 @@ namespace Foundation
         /// Returns thread task manager.
         ThreadTaskManagerPtr GetThreadTaskManager();
 
+        /// Returns the job system, for running short jobs on all the cores.
+        JobSystemPtr GetJobSystem();
+
         /// Cancel a pending exit
         void CancelExit();
 
@@ -179,6 +182,18 @@ namespace Foundation
         /// Output profiling data
         ConsoleCommandResult ConsoleProfile(const StringVector &params);
 
+        /// Output the event dispatch cost of each event category
+        ConsoleCommandResult ConsoleEventStats(const StringVector &params);
+
+        /// Measure the latencies of the job system
+        ConsoleCommandResult ConsoleJobBenchmark(const StringVector &params);
+
+        /// Write the latest profiling blocks as a Chrome trace
+        ConsoleCommandResult ConsoleProfilerTrace(const StringVector &params);
+
+        /// Measure the cost of a profiling block
+        ConsoleCommandResult ConsoleProfilerOverhead(const StringVector &params);
+
         /// limit frames
         ConsoleCommandResult ConsoleLimitFrames(const StringVector &params);
 
@@ -293,12 +308,15 @@ namespace Foundation
         EventManagerPtr event_manager_; ///< Event manager.
         PlatformPtr platform_; ///< Platform.
         ThreadTaskManagerPtr thread_task_manager_; ///< Thread task manager.
+        JobSystemPtr job_system_; ///< Job system.
         ConfigurationManagerPtr config_manager_; ///< Default configuration
         bool exit_signal_; ///< If true, exit application.
         std::vector<Poco::Channel*> log_channels_; ///< Logger channels
         Poco::Formatter *log_formatter_; ///< Logger default formatter
 #ifdef PROFILING
         Profiler profiler_; ///< Profiler.
+        float profiler_trace_interval_; ///< Seconds between the rolling trace exports, 0 if disabled.
+        float profiler_trace_timer_; ///< Seconds since the last rolling trace export.
 #endif
         boost::program_options::variables_map commandLineVariables; ///< program options
         boost::program_options::options_description commandLineDescriptions; ///< program option descriptions
@@ -0,0 +1,268 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "JobSystem.h"
+#include "ForwardDefines.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+namespace Foundation
+{
+    JobSystem::JobSystem(uint num_threads) :
+        current_queue_(&JobSystem::KeepQueue),
+        next_queue_(0),
+        num_queued_(0),
+        num_unfinished_(0),
+        stop_(false)
+    {
+        if (!num_threads)
+            num_threads = std::max(1, (int)boost::thread::hardware_concurrency() - 1);
+
+        for(uint i = 0; i < num_threads; ++i)
+        {
+            boost::shared_ptr<WorkerQueue> queue(new WorkerQueue());
+            queue->index_ = i;
+            queues_.push_back(queue);
+        }
+        for(uint i = 0; i < num_threads; ++i)
+            workers_.create_thread(boost::bind(&JobSystem::Run, this, queues_[i].get()));
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            MutexLock lock(sleep_mutex_);
+            stop_ = true;
+        }
+        work_available_.notify_all();
+        workers_.join_all();
+    }
+
+    JobPtr JobSystem::Spawn(const JobFunction &func)
+    {
+        JobPtr job(new Job(func));
+        num_unfinished_.ref();
+        Release(job);
+        return job;
+    }
+
+    JobPtr JobSystem::Spawn(const JobFunction &func, const JobPtr &dependency)
+    {
+        JobVector dependencies;
+        if (dependency)
+            dependencies.push_back(dependency);
+        return Spawn(func, dependencies);
+    }
+
+    JobPtr JobSystem::Spawn(const JobFunction &func, const JobVector &dependencies)
+    {
+        JobPtr job(new Job(func));
+        num_unfinished_.ref();
+        for(size_t i = 0; i < dependencies.size(); ++i)
+        {
+            if (!dependencies[i])
+                continue;
+            MutexLock lock(dependencies[i]->mutex_);
+            if (!dependencies[i]->finished_)
+            {
+                job->unfinished_.ref();
+                dependencies[i]->dependents_.push_back(job);
+            }
+        }
+
+        // Drop the reference held while spawning. If the dependencies have all been run, the job is queued now.
+        Release(job);
+        return job;
+    }
+
+    void JobSystem::ContinueOnMainThread(const JobPtr &job, const JobFunction &func)
+    {
+        if (!job)
+            return;
+
+        {
+            MutexLock lock(job->mutex_);
+            if (!job->finished_)
+            {
+                job->continuations_.push_back(func);
+                return;
+            }
+        }
+
+        MutexLock lock(continuations_mutex_);
+        continuations_.push_back(func);
+    }
+
+    void JobSystem::Wait(const JobPtr &job)
+    {
+        if (!job)
+            return;
+
+        while(!job->IsFinished())
+        {
+            JobPtr other = FindJob();
+            if (other)
+                Execute(other);
+            else
+                boost::this_thread::yield();
+        }
+    }
+
+    void JobSystem::Update()
+    {
+        std::vector<JobFunction> continuations;
+        {
+            MutexLock lock(continuations_mutex_);
+            continuations.swap(continuations_);
+        }
+
+        for(size_t i = 0; i < continuations.size(); ++i)
+            continuations[i]();
+    }
+
+    void JobSystem::Drain()
+    {
+        while((int)num_unfinished_ > 0)
+        {
+            JobPtr job = FindJob();
+            if (job)
+                Execute(job);
+            else
+                boost::this_thread::yield();
+        }
+
+        // Release whatever the continuations hold here, in the calling thread
+        std::vector<JobFunction> continuations;
+        {
+            MutexLock lock(continuations_mutex_);
+            continuations.swap(continuations_);
+        }
+    }
+
+    void JobSystem::Run(WorkerQueue *queue)
+    {
+        current_queue_.reset(queue);
+
+        for(;;)
+        {
+            JobPtr job = FindJob();
+            if (job)
+            {
+                Execute(job);
+                continue;
+            }
+
+            ScopedLock lock(sleep_mutex_);
+            while(!stop_ && (int)num_queued_ <= 0)
+                work_available_.wait(lock);
+            if (stop_)
+                break;
+        }
+
+        current_queue_.release();
+    }
+
+    void JobSystem::Schedule(const JobPtr &job)
+    {
+        // Workers queue their own jobs, so that the jobs spawned by a job are likely run by the same thread
+        WorkerQueue *queue = current_queue_.get();
+        if (!queue)
+            queue = queues_[(uint)next_queue_.fetchAndAddRelaxed(1) % queues_.size()].get();
+
+        {
+            MutexLock lock(queue->mutex_);
+            queue->jobs_.push_back(job);
+        }
+        num_queued_.ref();
+
+        MutexLock lock(sleep_mutex_);
+        work_available_.notify_one();
+    }
+
+    JobPtr JobSystem::FindJob()
+    {
+        JobPtr job;
+
+        // Run the newest job of the own queue first, its data is the most likely to be in the cache
+        WorkerQueue *own = current_queue_.get();
+        if (own)
+        {
+            MutexLock lock(own->mutex_);
+            if (!own->jobs_.empty())
+            {
+                job = own->jobs_.back();
+                own->jobs_.pop_back();
+            }
+        }
+
+        // Steal the oldest job of another queue
+        if (!job)
+        {
+            uint start = own ? own->index_ + 1 : (uint)(int)next_queue_;
+            for(uint i = 0; i < queues_.size() && !job; ++i)
+            {
+                WorkerQueue *queue = queues_[(start + i) % queues_.size()].get();
+                if (queue == own)
+                    continue;
+                MutexLock lock(queue->mutex_);
+                if (!queue->jobs_.empty())
+                {
+                    job = queue->jobs_.front();
+                    queue->jobs_.pop_front();
+                }
+            }
+        }
+
+        if (job)
+            num_queued_.deref();
+        return job;
+    }
+
+    void JobSystem::Execute(const JobPtr &job)
+    {
+        try
+        {
+            job->func_();
+        }
+        catch(const std::exception &e)
+        {
+            RootLogError(std::string("Job threw an exception: ") + (e.what() ? e.what() : "(null)"));
+        }
+        catch(...)
+        {
+            RootLogError("Job threw an unknown exception");
+        }
+
+        // Release whatever the function holds
+        job->func_ = JobFunction();
+
+        std::vector<JobPtr> dependents;
+        {
+            // Queue the continuations before releasing the job, so that ones added after it has finished run after them
+            MutexLock lock(job->mutex_);
+            job->finished_ = true;
+            dependents.swap(job->dependents_);
+            if (!job->continuations_.empty())
+            {
+                MutexLock continuationsLock(continuations_mutex_);
+                continuations_.insert(continuations_.end(), job->continuations_.begin(), job->continuations_.end());
+            }
+            job->continuations_.clear();
+        }
+
+        for(size_t i = 0; i < dependents.size(); ++i)
+            Release(dependents[i]);
+        num_unfinished_.deref();
+    }
+
+    void JobSystem::Release(const JobPtr &job)
+    {
+        if (!job->unfinished_.deref())
+            Schedule(job);
+    }
+}
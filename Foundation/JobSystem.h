@@ -0,0 +1,190 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_JobSystem_h
+#define incl_Foundation_JobSystem_h
+
+#include "CoreTypes.h"
+#include "CoreThread.h"
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <QAtomicInt>
+
+#include <deque>
+#include <vector>
+
+namespace Foundation
+{
+    class JobSystem;
+
+    //! Function run by a job
+    typedef boost::function<void()> JobFunction;
+
+    //! A unit of work run by the JobSystem.
+    /*! Created by JobSystem::Spawn(). Keep the pointer to declare dependencies on the job, to attach continuations to it
+        or to wait for it.
+     */
+    class Job
+    {
+        friend class JobSystem;
+
+    public:
+        //! Returns whether the job has been run
+        bool IsFinished() const
+        {
+            MutexLock lock(mutex_);
+            return finished_;
+        }
+
+    private:
+        explicit Job(const JobFunction &func) : func_(func), unfinished_(1), finished_(false) {}
+
+        //! The work
+        JobFunction func_;
+
+        //! Number of unfinished dependencies, plus one while the job is being spawned. The job is queued when this reaches zero.
+        QAtomicInt unfinished_;
+
+        //! Set when the job has been run. Guarded by mutex_.
+        bool finished_;
+
+        //! Jobs waiting for this job. Guarded by mutex_.
+        std::vector<boost::shared_ptr<Job> > dependents_;
+
+        //! Functions to run in the main thread when this job has been run. Guarded by mutex_.
+        std::vector<JobFunction> continuations_;
+
+        mutable Mutex mutex_;
+    };
+
+    typedef boost::shared_ptr<Job> JobPtr;
+    typedef std::vector<JobPtr> JobVector;
+
+    //! Runs short jobs on a pool of worker threads, one per hardware thread.
+    /*! Each worker has its own queue of jobs. Jobs spawned by a worker go to its own queue and are run newest first,
+        while idle workers steal the oldest jobs from the other queues. Jobs spawned by other threads are spread over
+        the queues. A job can depend on other jobs, in which case it is queued only when they have all been run, and can
+        have continuations that are run in the main thread by Update().
+
+        Jobs should not block on network I/O or locks held for long, though reading a local file is fine; use a ThreadTask
+        for long running work. There exists a system-wide JobSystem in the framework.
+     */
+    class JobSystem
+    {
+    public:
+        //! Starts the worker threads
+        /*! \param num_threads Number of worker threads. 0 uses one thread less than there are hardware threads, but at least one.
+         */
+        explicit JobSystem(uint num_threads = 0);
+
+        //! Stops the worker threads. Jobs not yet started are not run.
+        ~JobSystem();
+
+        //! Spawns a job
+        /*! \param func Function to run in a worker thread
+            \return The job
+         */
+        JobPtr Spawn(const JobFunction &func);
+
+        //! Spawns a job that is run after another job
+        /*! \param func Function to run in a worker thread
+            \param dependency Job that must have been run first. May be null.
+         */
+        JobPtr Spawn(const JobFunction &func, const JobPtr &dependency);
+
+        //! Spawns a job that is run after other jobs
+        /*! \param func Function to run in a worker thread
+            \param dependencies Jobs that must have been run first
+         */
+        JobPtr Spawn(const JobFunction &func, const JobVector &dependencies);
+
+        //! Runs a function in the main thread after a job has been run
+        /*! The function is run by the next Update() after the job has been run, in the order the continuations were added.
+            \param job The job
+            \param func Function to run in the main thread
+         */
+        void ContinueOnMainThread(const JobPtr &job, const JobFunction &func);
+
+        //! Waits until a job has been run, running other jobs meanwhile
+        void Wait(const JobPtr &job);
+
+        //! Runs the main thread continuations of the jobs that have been run. Framework calls this on each run of the main loop.
+        void Update();
+
+        //! Waits until all the spawned jobs have been run, running jobs meanwhile, and discards the continuations that have not been run
+        /*! Framework calls this before unloading the modules, so that no job or continuation is left to run module code, or to
+            release objects of a module, after the module has been unloaded.
+         */
+        void Drain();
+
+        //! Returns the number of worker threads
+        uint NumThreads() const { return (uint)queues_.size(); }
+
+    private:
+        JobSystem(const JobSystem&);
+        void operator=(const JobSystem&);
+
+        //! Job queue of a worker thread
+        struct WorkerQueue
+        {
+            //! Jobs ready to run. The owner pushes and pops at the back, thieves take from the front.
+            std::deque<JobPtr> jobs_;
+            Mutex mutex_;
+            //! Index of the queue
+            uint index_;
+        };
+
+        //! Cleanup function of current_queue_. The queues are owned by queues_.
+        static void KeepQueue(WorkerQueue *queue) {}
+
+        //! Worker thread main loop
+        void Run(WorkerQueue *queue);
+
+        //! Queues a job whose dependencies have all been run
+        void Schedule(const JobPtr &job);
+
+        //! Takes a job from the queue of this thread, or steals one from another queue
+        JobPtr FindJob();
+
+        //! Runs a job and releases the jobs and continuations waiting for it
+        void Execute(const JobPtr &job);
+
+        //! Releases the spawning reference of a job, queueing it if it has no unfinished dependencies
+        void Release(const JobPtr &job);
+
+        //! Worker queues
+        std::vector<boost::shared_ptr<WorkerQueue> > queues_;
+
+        //! Queue of the current thread, null for threads that are not workers of this JobSystem
+        boost::thread_specific_ptr<WorkerQueue> current_queue_;
+
+        //! Queue that the next job spawned from outside the workers goes to
+        QAtomicInt next_queue_;
+
+        //! Number of jobs in the queues. Checked under sleep_mutex_ before a worker goes to sleep.
+        QAtomicInt num_queued_;
+
+        //! Number of spawned jobs that have not been run yet, including the ones waiting for dependencies
+        QAtomicInt num_unfinished_;
+
+        //! Set to stop the workers. Guarded by sleep_mutex_.
+        bool stop_;
+
+        Mutex sleep_mutex_;
+
+        //! Signaled when jobs are queued
+        Condition work_available_;
+
+        //! Continuations ready to run in the main thread
+        std::vector<JobFunction> continuations_;
+
+        Mutex continuations_mutex_;
+
+        boost::thread_group workers_;
+    };
+}
+
+#endif
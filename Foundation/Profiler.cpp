@@ -9,6 +9,8 @@
 #include "CoreStringUtils.h"
 #include "HighPerfClock.h"
 
+#include <fstream>
+
 namespace Foundation
 {
     bool ProfilerBlock::supported_ = false;
@@ -33,12 +35,25 @@ namespace Foundation
     boost::int64_t ProfilerBlock::frequency_;
     boost::int64_t ProfilerBlock::api_overhead_;
     
-    void Profiler::StartBlock(const std::string &name)
+    void ProfilerTraceBuffer::Snapshot(std::vector<Event> &events) const
+    {
+        unsigned int begin = (unsigned int)written_.fetchAndAddAcquire(0);
+        std::vector<Event> copy(events_);
+        unsigned int end = (unsigned int)written_.fetchAndAddAcquire(0);
+
+        // Events written while copying may have overwritten the oldest ones of the copy, and the event being written after them,
+        // number end, is in the slot of event end - cCapacity
+        unsigned int first = begin - std::min(begin, cCapacity);
+        if (end - first >= cCapacity)
+            first = end - cCapacity + 1;
+        for(unsigned int i = first; (int)(begin - i) > 0; ++i)
+            events.push_back(copy[i & (cCapacity - 1)]);
+    }
+
+    ProfilerNodeTree *Profiler::GetCurrentNode()
     {
-#ifdef PROFILING
         // Get the current topmost profiling node in the stack, or 
         // if none exists, get the root node or create a new root node.
-        // This will be the parent node of the new block we're starting.
         ProfilerNodeTree *parent = current_node_.get();
         if (!parent)
         {
@@ -46,20 +61,11 @@ namespace Foundation
             current_node_.reset(parent);
         }
         assert(parent);
+        return parent;
+    }
 
-        // If parent name == new block name, we assume that we're
-        // recursively re-entering the same function (with a single
-        // profiling block).
-        ProfilerNodeTree *node = (name != parent->Name()) ? parent->GetChild(name) : parent;
-
-        // We're entering this PROFILE() block for the first time,
-        // need to allocate the memory for it.
-        if (!node)
-        {
-            node = new ProfilerNode(name);
-            parent->AddChild(boost::shared_ptr<ProfilerNodeTree>(node));
-        }
-
+    void Profiler::EnterBlock(ProfilerNodeTree *parent, ProfilerNodeTree *node)
+    {
         assert (parent->recursion_ >= 0);
 
         // If a recursive call, just increment recursion count, the timer has already
@@ -74,18 +80,51 @@ namespace Foundation
 
             checked_static_cast<ProfilerNode*>(node)->block_.Start();
         }
+    }
+
+    void Profiler::StartBlock(const std::string &name)
+    {
+#ifdef PROFILING
+        // This will be the parent node of the new block we're starting.
+        ProfilerNodeTree *parent = GetCurrentNode();
+
+        // If parent name == new block name, we assume that we're
+        // recursively re-entering the same function (with a single
+        // profiling block).
+        ProfilerNodeTree *node = (name != parent->Name()) ? parent->GetChild(name) : parent;
+
+        // We're entering this PROFILE() block for the first time,
+        // need to allocate the memory for it.
+        if (!node)
+        {
+            node = new ProfilerNode(name);
+            parent->AddChild(boost::shared_ptr<ProfilerNodeTree>(node));
+        }
+
+        EnterBlock(parent, node);
 #endif
     }
 
-    void Profiler::EndBlock(const std::string &name)
+    void Profiler::StartBlock(const ProfilerSite &site)
     {
 #ifdef PROFILING
-        using namespace std;
+        ProfilerNodeTree *parent = GetCurrentNode();
+
+        // Same site as the parent means recursion. Only the addresses are compared, the name is used when the node is created.
+        ProfilerNodeTree *node = (&site != parent->Site()) ? parent->GetChild(&site) : parent;
+        if (!node)
+        {
+            node = new ProfilerNode(site.name, &site);
+            parent->AddChild(boost::shared_ptr<ProfilerNodeTree>(node));
+        }
 
-        ProfilerNodeTree *treeNode = current_node_.get();
-        assert (treeNode->Name() == name && "New profiling block started before old one ended!");
+        EnterBlock(parent, node);
+#endif
+    }
 
-        ProfilerNode* node = checked_static_cast<ProfilerNode*>(treeNode);
+    void Profiler::LeaveBlock()
+    {
+        ProfilerNode* node = checked_static_cast<ProfilerNode*>(current_node_.get());
         node->block_.Stop();
         node->num_called_total_++;
         node->num_called_current_++;
@@ -109,9 +148,118 @@ namespace Foundation
             --node->recursion_;
         else
         {
+            // A recursive block is traced once, from its outermost start to its outermost end
+            if (node->Trace())
+                node->Trace()->Record(&node->Name(), node->block_.StartTime(), node->block_.EndTime());
+
             current_node_.release();
             current_node_.reset(node->Parent());
         }
+    }
+
+    void Profiler::EndBlock(const std::string &name)
+    {
+#ifdef PROFILING
+        assert (current_node_.get()->Name() == name && "New profiling block started before old one ended!");
+        LeaveBlock();
+#endif
+    }
+
+    void Profiler::EndBlock(const ProfilerSite &site)
+    {
+#ifdef PROFILING
+        assert (current_node_.get()->Site() == &site && "New profiling block started before old one ended!");
+        LeaveBlock();
+#endif
+    }
+
+    namespace
+    {
+        //! Escapes a string for a JSON string literal
+        std::string JsonEscape(const std::string &str)
+        {
+            std::string escaped;
+            escaped.reserve(str.size());
+            for(size_t i = 0; i < str.size(); ++i)
+            {
+                char c = str[i];
+                if (c == '"' || c == '\\')
+                {
+                    escaped += '\\';
+                    escaped += c;
+                }
+                else if ((unsigned char)c < 0x20)
+                {
+                    char code[8];
+                    sprintf(code, "\\u%04x", (unsigned int)(unsigned char)c);
+                    escaped += code;
+                }
+                else
+                    escaped += c;
+            }
+            return escaped;
+        }
+    }
+
+    bool Profiler::ExportTrace(const std::string &filename)
+    {
+#ifdef PROFILING
+        typedef std::vector<ProfilerTraceBuffer::Event> EventVector;
+        std::vector<std::pair<std::string, EventVector> > threads;
+
+        // The thread root blocks, and the names of the nodes, stay alive while the mutex is held
+        mutex_.lock();
+        for(std::list<ProfilerNodeTree*>::iterator iter = thread_root_nodes_.begin(); iter != thread_root_nodes_.end(); ++iter)
+        {
+            if (!(*iter)->Trace())
+                continue;
+            threads.push_back(std::make_pair((*iter)->Name(), EventVector()));
+            (*iter)->Trace()->Snapshot(threads.back().second);
+        }
+
+        std::string json;
+        boost::int64_t origin = 0;
+        bool first_event = true;
+        for(size_t i = 0; i < threads.size(); ++i)
+            for(size_t j = 0; j < threads[i].second.size(); ++j)
+                if (first_event || threads[i].second[j].start < origin)
+                {
+                    origin = threads[i].second[j].start;
+                    first_event = false;
+                }
+
+        double usec_per_tick = 1000000.0 / (double)GetCurrentClockFreq();
+        json += "{\"traceEvents\":[\n";
+        bool first = true;
+        for(size_t i = 0; i < threads.size(); ++i)
+        {
+            char str[256];
+            sprintf(str, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", first ? "" : ",\n", (int)i + 1);
+            json += str;
+            json += JsonEscape(threads[i].first);
+            json += "\"}}";
+            first = false;
+
+            const EventVector &events = threads[i].second;
+            for(size_t j = 0; j < events.size(); ++j)
+            {
+                json += ",\n{\"name\":\"";
+                json += JsonEscape(*events[j].name);
+                sprintf(str, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", (int)i + 1,
+                    (events[j].start - origin) * usec_per_tick, std::max<boost::int64_t>(events[j].end - events[j].start, 0) * usec_per_tick);
+                json += str;
+            }
+        }
+        mutex_.unlock();
+        json += "\n]}\n";
+
+        std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+        if (!file.is_open())
+            return false;
+        file.write(json.data(), json.size());
+        return file.good();
+#else
+        return false;
 #endif
     }
 
@@ -142,6 +290,7 @@ namespace Foundation
         std::string rootObjectName = GetThisThreadRootBlockName();
 
         ProfilerNodeTree *root = new ProfilerNodeTree(rootObjectName);
+        root->trace_ = boost::shared_ptr<ProfilerTraceBuffer>(new ProfilerTraceBuffer());
         thread_specific_root_.reset(root);
 
         // Each thread root block is added as a child of a dummy node root_ owned by
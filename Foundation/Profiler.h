@@ -10,6 +10,8 @@
 
 #include "HighPerfClock.h"
 
+#include <QAtomicInt>
+
 // Disable warning C4244 coming from boost
 #pragma warning ( push )
 #pragma warning( disable : 4244 )
@@ -21,9 +23,12 @@
 /*! Name of the profiling block must be unique in the scope, so do not use the name of the function
     as the name of the profiling block!
 
+    The block is identified by a statically allocated site, so entering it does not construct or compare strings.
+
     \param x Unique name for the profiling block, use without quotes, f.ex. PROFILE(name_of_the_block)
 */
-#   define PROFILE(x) Foundation::ProfilerSection x ## __profiler__(#x);
+#   define PROFILE(x) static const Foundation::ProfilerSite x ## __profiler_site__ = { #x }; \
+        Foundation::ProfilerSection x ## __profiler__(x ## __profiler_site__);
 
 //! Optionally ends the current profiling block
 /*! Use when you wish to end a profiling block before it goes out of scope
@@ -46,6 +51,16 @@ namespace Foundation
 {
     class ProfilerNodeTree;
 
+    //! A PROFILE() site in the code.
+    /*! Sites are statically allocated and constant initialized by the PROFILE macro, and the profiling nodes of
+        a site are found by its address instead of its name.
+    */
+    struct ProfilerSite
+    {
+        //! Name of the profiling block
+        const char *name;
+    };
+
     //! Profiles a block of code
     class ProfilerBlock
     {
@@ -101,6 +116,12 @@ namespace Foundation
             }
         }
 
+        //! Returns the clock time of the last Start()
+        boost::int64_t StartTime() const { return start_time_; }
+
+        //! Returns the clock time of the last Stop()
+        boost::int64_t EndTime() const { return end_time_; }
+
         //! Returns elapsed time in microseconds
         boost::int64_t ElapsedTimeMicroSeconds()
         {
@@ -130,6 +151,48 @@ namespace Foundation
 
     class Profiler;
 
+    //! Ring of the latest profiling blocks run by a thread, for exporting as a trace.
+    /*! Written only by the profiled thread and read by the thread exporting the trace. The writer never waits:
+        the reader copies the ring and drops the events that the writer may have overwritten meanwhile.
+    */
+    class ProfilerTraceBuffer
+    {
+    public:
+        //! A run of a profiling block
+        struct Event
+        {
+            //! Name of the block. Owned by its profiling node.
+            const std::string *name;
+            boost::int64_t start;
+            boost::int64_t end;
+        };
+
+        //! Number of events in the ring. A power of two.
+        static const unsigned int cCapacity = 16384;
+
+        ProfilerTraceBuffer() : events_(cCapacity) {}
+
+        //! Records a run of a block. Called by the profiled thread only.
+        void Record(const std::string *name, boost::int64_t start, boost::int64_t end)
+        {
+            unsigned int written = (unsigned int)(int)written_;
+            Event &event = events_[written & (cCapacity - 1)];
+            event.name = name;
+            event.start = start;
+            event.end = end;
+            // Publishes the event to the reader
+            written_.fetchAndStoreRelease((int)(written + 1));
+        }
+
+        //! Copies the events in the ring, oldest first. Can be called from any thread.
+        void Snapshot(std::vector<Event> &events) const;
+
+    private:
+        std::vector<Event> events_;
+        //! Total number of events recorded, wrapping around.
+        mutable QAtomicInt written_;
+    };
+
     //! N-ary tree structure for profiling nodes
     class ProfilerNodeTree
     {
@@ -139,8 +202,9 @@ namespace Foundation
     public:
         typedef std::list<boost::shared_ptr<ProfilerNodeTree> > NodeList;
 
-        //! constructor that takes a name for the node
-        explicit ProfilerNodeTree(const std::string &name) : name_(name), parent_(0), recursion_(0), owner_(0) {}
+        //! constructor that takes a name for the node, and the site of the node if it has one
+        explicit ProfilerNodeTree(const std::string &name, const ProfilerSite *site = 0) :
+            parent_(0), owner_(0), name_(name), recursion_(0), site_(site), last_child_(0) {}
 
         //! destructor
         virtual ~ProfilerNodeTree()
@@ -163,6 +227,8 @@ namespace Foundation
         {
             children_.push_back(node);
             node->parent_ = this;
+            if (!node->trace_)
+                node->trace_ = trace_;
         }
 
         //! Removes the child node.
@@ -172,6 +238,8 @@ namespace Foundation
                 for(NodeList::iterator iter = children_.begin(); iter != children_.end(); ++iter)
                     if ((*iter).get() == node)
                     {
+                        if (last_child_ == node)
+                            last_child_ = 0;
                         children_.erase(iter);
                         return;
                     }
@@ -190,9 +258,34 @@ namespace Foundation
                     return (*it).get();
             return 0;
         }
+        //! Returns the child node of a site
+        /*!
+          \param site Site of the child node
+          \return Child node or 0 if the node was not child
+        */
+        ProfilerNodeTree* GetChild(const ProfilerSite *site)
+        {
+            // Blocks are usually entered in the same order on each frame, so the child found last is often the one looked for next
+            if (last_child_ && last_child_->site_ == site)
+                return last_child_;
+            for (NodeList::iterator it = children_.begin() ; it != children_.end() ; ++it)
+                if ((*it)->site_ == site)
+                {
+                    last_child_ = (*it).get();
+                    return last_child_;
+                }
+            return 0;
+        }
+
         //! Returns the name of this node
         const std::string &Name() const { return name_; }
 
+        //! Returns the site of this node, or null if the node was created by name
+        const ProfilerSite *Site() const { return site_; }
+
+        //! Returns the trace ring of the thread of this node
+        ProfilerTraceBuffer *Trace() const { return trace_.get(); }
+
         //! Returns the parent of this node
         ProfilerNodeTree *Parent() { return parent_; }
 
@@ -213,6 +306,15 @@ namespace Foundation
 
         //! helper counter for recursion
         int recursion_;
+
+        //! Site of this node, null if the node was created by name
+        const ProfilerSite *site_;
+
+        //! Child returned by the last GetChild(site)
+        ProfilerNodeTree *last_child_;
+
+        //! Trace ring of the thread of this node, shared by all the nodes of the thread
+        boost::shared_ptr<ProfilerTraceBuffer> trace_;
     };
     typedef boost::shared_ptr<ProfilerNodeTree> ProfilerNodeTreePtr;
 
@@ -223,9 +325,9 @@ namespace Foundation
         ProfilerNode(); // N/I
         ProfilerNode(const ProfilerNode &rhs); // N/I
     public:
-        //! constructor that takes a name for the node
-        explicit ProfilerNode(const std::string &name) : 
-        ProfilerNodeTree(name),
+        //! constructor that takes a name for the node, and the site of the node if it has one
+        explicit ProfilerNode(const std::string &name, const ProfilerSite *site = 0) : 
+        ProfilerNodeTree(name, site),
             num_called_total_(0),
             num_called_(0),
             num_called_current_(0),
@@ -356,6 +458,9 @@ namespace Foundation
         */
         void StartBlock(const std::string &name);
 
+        //! Start a profiling block of a static site. Used by the PROFILE macro.
+        void StartBlock(const ProfilerSite &site);
+
         //! End the profiling block
         /*! Each StartBlock() should have a matching EndBlock(). Recursion is supported.
             
@@ -363,6 +468,15 @@ namespace Foundation
         */
         void EndBlock(const std::string &name);
 
+        //! End the profiling block of a static site
+        void EndBlock(const ProfilerSite &site);
+
+        //! Writes the latest profiling blocks run by each thread to a file in the Chrome Trace Event format.
+        /*! The file can be opened in chrome://tracing. Can be called from any thread.
+            \return True if the file was written
+        */
+        bool ExportTrace(const std::string &filename);
+
         //! Reset profiling data for the current thread. Don't call directly, use RESETPROFILER macro instead.
         void ThreadedReset();
 
@@ -391,6 +505,15 @@ namespace Foundation
         ProfilerNodeTree *GetRoot() { return &root_; }
 
     private:
+        //! Returns the current topmost profiling node of this thread, creating the thread root block if needed
+        ProfilerNodeTree *GetCurrentNode();
+
+        //! Makes node the current node, starting its timer unless it is the parent itself
+        void EnterBlock(ProfilerNodeTree *parent, ProfilerNodeTree *node);
+
+        //! Stops the timer of the current node and makes its parent the current node
+        void LeaveBlock();
+
         //! The single global root node object. This is a dummy root node that doesn't track any
         //! timing statistics, but just contains all the root blocks of each thread as its children.
         //! This root_ node doesn't own any of the memory of any of its children, those are owned 
@@ -416,12 +539,18 @@ namespace Foundation
         ProfilerSection(); // N/I
         ProfilerSection(const ProfilerSection &rhs);
     public:
-        explicit ProfilerSection(const std::string &name) : name_(name), destroyed_(false)
+        explicit ProfilerSection(const std::string &name) : site_(0), name_(name), destroyed_(false)
         {
             assert (profiler_ && "Trying to profile before profiler initialized.");
             GetProfiler()->StartBlock(name);
         }
 
+        explicit ProfilerSection(const ProfilerSite &site) : site_(&site), destroyed_(false)
+        {
+            assert (profiler_ && "Trying to profile before profiler initialized.");
+            GetProfiler()->StartBlock(site);
+        }
+
         ~ProfilerSection()
         {
             if (!destroyed_)
@@ -435,7 +564,10 @@ namespace Foundation
         {
             assert (profiler_ && "Trying to profile before profiler initialized.");
 
-            GetProfiler()->EndBlock(name_);
+            if (site_)
+                GetProfiler()->EndBlock(*site_);
+            else
+                GetProfiler()->EndBlock(name_);
             destroyed_ = true;
         }
         static Profiler *GetProfiler() { return profiler_; }
@@ -446,7 +578,10 @@ namespace Foundation
         //! Parent profiler used by this section
         static Profiler *profiler_;
 
-        //! Name of this profiling section
+        //! Site of this profiling section, null if the section was started by name
+        const ProfilerSite *site_;
+
+        //! Name of this profiling section, if started by name
         const std::string name_;
 
         //! True if this section has explicitly been destroyed before it run out of scope
@@ -14,6 +14,8 @@ class EC_Script;
 
 class JavascriptModule;
 class JavascriptInstance;
+class ScriptScheduler;
+class ScriptFrame;
 class ScriptAsset;
 
 typedef boost::shared_ptr<ScriptAsset> ScriptAssetPtr;
@@ -17,6 +17,9 @@
 #include "IModule.h"
 #include "AssetAPI.h"
 #include "IAssetProvider.h" //to check if the code was loaded from a local or remote storage
+#include "ScriptScheduler.h"
+#include "Framework.h"
+#include "FrameAPI.h"
 
 #include "LoggingFunctions.h"
 DEFINE_POCO_LOGGING_FUNCTIONS("JavascriptInstance")
@@ -34,24 +37,33 @@ JavascriptInstance::JavascriptInstance(const QString &fileName, JavascriptModule
     engine_(0),
     sourceFile(fileName),
     module_(module),
+    frame_(new ScriptFrame(module->GetFramework()->Frame(), this)),
     evaluated(false)
 {
     CreateEngine();
     Load();
+    if (module_->GetScheduler())
+        module_->GetScheduler()->Register(this);
 }
 
-JavascriptInstance::JavascriptInstance(ScriptAssetPtr scriptRef, JavascriptModule *module) :
+JavascriptInstance::JavascriptInstance(ScriptAssetPtr scriptRef, JavascriptModule *module, const ComponentPtr &owner) :
     engine_(0),
     scriptRef_(scriptRef),
+    owner_(owner),
     module_(module),
+    frame_(new ScriptFrame(module->GetFramework()->Frame(), this)),
     evaluated(false)
 {
     CreateEngine();
     Load();
+    if (module_->GetScheduler())
+        module_->GetScheduler()->Register(this);
 }
 
 JavascriptInstance::~JavascriptInstance()
 {
+    if (module_->GetScheduler())
+        module_->GetScheduler()->Unregister(this);
     DeleteEngine();
 }
 
@@ -90,11 +102,12 @@ void JavascriptInstance::Load()
     QString scriptSourceFilename = (scriptRef_.get() ? scriptRef_->Name() : sourceFile);
     QString &scriptContent = (scriptRef_.get() ? scriptRef_->scriptContent : program_);
 
-    QScriptSyntaxCheckResult syntaxResult = engine_->checkSyntax(scriptContent);
-    if (syntaxResult.state() != QScriptSyntaxCheckResult::Valid)
+    // The syntax check is done once per distinct script, and the parsed program is shared with other instances of the same script
+    parsedProgram_ = module_->GetProgramCache().Get(scriptContent, scriptSourceFilename);
+    if (!parsedProgram_->valid)
     {
-        LogError("Syntax error in script " + scriptSourceFilename.toStdString() + "," + QString::number(syntaxResult.errorLineNumber()).toStdString() +
-            ": " + syntaxResult.errorMessage().toStdString());
+        LogError("Syntax error in script " + scriptSourceFilename.toStdString() + "," + QString::number(parsedProgram_->errorLine).toStdString() +
+            ": " + parsedProgram_->errorMessage.toStdString());
 
         // Delete our loaded script content (if any exists).
         program_ == "";
@@ -178,7 +191,13 @@ void JavascriptInstance::Run()
     QString &scriptContent = (scriptRef_.get() ? scriptRef_->scriptContent : program_);
 
     included_files_.clear();
+    if (!parsedProgram_ || parsedProgram_->source != scriptContent)
+        parsedProgram_ = module_->GetProgramCache().Get(scriptContent, scriptSourceFilename);
+#if QT_VERSION >= 0x040700
+    QScriptValue result = engine_->evaluate(parsedProgram_->program);
+#else
     QScriptValue result = engine_->evaluate(scriptContent, scriptSourceFilename);
+#endif
     if (engine_->hasUncaughtException())
     {
         LogError("In run/evaluate: " + result.toString().toStdString());
@@ -244,15 +263,20 @@ void JavascriptInstance::IncludeFile(const QString &path)
     context->setActivationObject(context->parentContext()->activationObject());
     context->setThisObject(context->parentContext()->thisObject());
 
-    QScriptSyntaxCheckResult syntaxResult = engine_->checkSyntax(script);
-    if(syntaxResult.state() != QScriptSyntaxCheckResult::Valid)
+    // Included files are typically shared by many scripts, so their parsed programs are cached as well
+    ScriptProgramCache::ProgramPtr program = module_->GetProgramCache().Get(script, path);
+    if (!program->valid)
     {
-        LogError("JavascriptInstance::IncludeFile: Syntax error in " + path.toStdString() + syntaxResult.errorMessage().toStdString()
-            + " In line:" + QString::number(syntaxResult.errorLineNumber()).toStdString());
+        LogError("JavascriptInstance::IncludeFile: Syntax error in " + path.toStdString() + program->errorMessage.toStdString()
+            + " In line:" + QString::number(program->errorLine).toStdString());
         return;
     }
 
+#if QT_VERSION >= 0x040700
+    QScriptValue result = engine_->evaluate(program->program);
+#else
     QScriptValue result = engine_->evaluate(script);
+#endif
 
     included_files_.push_back(path);
     
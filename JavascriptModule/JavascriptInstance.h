@@ -12,6 +12,7 @@
 #include "SceneFwd.h"
 #include "AssetFwd.h"
 #include "JavascriptFwd.h"
+#include "ScriptProgramCache.h"
 
 //#include <QtScript>
 //#ifndef QT_NO_SCRIPTTOOLS
@@ -33,8 +34,9 @@ public:
 
     /// Creates script engine for this script instance and loads the script but doesn't run it yet.
     /** @param scriptRef Script asset reference.
-        @param module Javascript module. */
-    JavascriptInstance(ScriptAssetPtr scriptRef, JavascriptModule *module);
+        @param module Javascript module.
+        @param owner Owner (EC_Script) component, if existing. */
+    JavascriptInstance(ScriptAssetPtr scriptRef, JavascriptModule *module, const ComponentPtr &owner = ComponentPtr());
 
     /// Destroys script engine created for this script instance.
     virtual ~JavascriptInstance();
@@ -62,6 +64,12 @@ public:
     */
     void SetOwnerComponent(const ComponentPtr &owner) { owner_ = owner; }
 
+    /// Returns owner (EC_Script) component, or null if none.
+    ComponentPtr GetOwnerComponent() const { return owner_.lock(); }
+
+    /// Returns the frame object exposed to the script, through which ScriptScheduler sends the frame updates.
+    ScriptFrame *GetFrame() const { return frame_; }
+
 public slots:
     /// Loads a given script in engine. This function can be used to create a property as you could include js-files.
     /** Multiple inclusion of same file is prevented. (by using simple string compare)
@@ -97,8 +105,12 @@ private:
     /// Current script name that is loaded into this instance. Exposed via GetCurrentScriptName().
     QString currentScriptName;
 
+    /// Parsed script program, shared with the other instances running the same script.
+    ScriptProgramCache::ProgramPtr parsedProgram_;
+
     ComponentWeakPtr owner_; ///< Owner (EC_Script) component, if existing.
     JavascriptModule *module_; ///< Javascript module.
+    ScriptFrame *frame_; ///< Frame object exposed to the script.
     bool evaluated; ///< Has the script program been evaluated.
     //QScriptEngineDebugger *debugger_;
 
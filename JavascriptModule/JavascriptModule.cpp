@@ -12,6 +12,7 @@
 #include "ScriptMetaTypeDefines.h"
 #include "JavascriptInstance.h"
 #include "ScriptCoreTypeDefines.h"
+#include "ScriptScheduler.h"
 
 #include "SceneAPI.h"
 #include "Entity.h"
@@ -38,7 +39,8 @@ JavascriptModule *javascriptModuleInstance_ = 0;
 
 JavascriptModule::JavascriptModule() :
     IModule(type_name_static_),
-    engine(new QScriptEngine(this))
+    engine(new QScriptEngine(this)),
+    scheduler_(0)
 {
 }
 
@@ -70,6 +72,11 @@ void JavascriptModule::Initialize()
     framework_->GetServiceManager()->RegisterService(Service::ST_JavascriptScripting, service);
 
     engine->globalObject().setProperty("print", engine->newFunction(Print));
+
+    // Frame update time allowed for one script instance per frame, and the time after which a frame update handler is aborted, in milliseconds
+    float frameBudget = framework_->GetDefaultConfig().DeclareSetting("JavascriptModule", "frame_budget_ms", 10.f);
+    float frameHardLimit = framework_->GetDefaultConfig().DeclareSetting("JavascriptModule", "frame_hard_limit_ms", 1000.f);
+    scheduler_ = new ScriptScheduler(framework_, frameBudget, frameHardLimit);
 }
 
 void JavascriptModule::PostInitialize()
@@ -99,7 +106,6 @@ void JavascriptModule::PostInitialize()
         for(std::vector<std::string>::iterator i = sv.begin(); i != sv.end(); ++i)
         {
             JavascriptInstance *jsInstance = new JavascriptInstance(i->c_str(), this);
-            PrepareScriptInstance(jsInstance);
             startupScripts_.push_back(jsInstance);
             jsInstance->Run();
         }
@@ -108,7 +114,10 @@ void JavascriptModule::PostInitialize()
 
 void JavascriptModule::Uninitialize()
 {
+    if (programCache_.Hits() + programCache_.Misses() > 0)
+        LogDebug("Script program cache: " + ToString(programCache_.Hits()) + " hits, " + ToString(programCache_.Misses()) + " misses");
     UnloadStartupScripts();
+    SAFE_DELETE(scheduler_);
 }
 
 void JavascriptModule::Update(f64 frametime)
@@ -137,6 +146,8 @@ ConsoleCommandResult JavascriptModule::ConsoleRunFile(const StringVector &params
 
 ConsoleCommandResult JavascriptModule::ConsoleReloadScripts(const StringVector &params)
 {
+    // Drop the cached programs, so that the scripts are parsed again from their current content
+    programCache_.Clear();
     LoadStartupScripts();
 
     return ConsoleResultSuccess();
@@ -199,7 +210,6 @@ void JavascriptModule::ScriptAssetChanged(ScriptAssetPtr newScript)
 
     if (newScript->Name().endsWith(".js") || scriptType == "js") // We're positively using QtScript.
     {
-        JavascriptInstance *jsInstance = new JavascriptInstance(newScript, this);
         ComponentPtr comp;
         try
         {
@@ -210,12 +220,10 @@ void JavascriptModule::ScriptAssetChanged(ScriptAssetPtr newScript)
             return;
         }
 
-        jsInstance->SetOwnerComponent(comp);
+        // The instance registers all core APIs and names to its script engine when creating it.
+        JavascriptInstance *jsInstance = new JavascriptInstance(newScript, this, comp);
         sender->SetScriptInstance(jsInstance);
 
-        // Register all core APIs and names to this script engine.
-        PrepareScriptInstance(jsInstance, sender);
-
         if (sender->runOnLoad.Get())
             sender->Run();
     }
@@ -264,7 +272,6 @@ void JavascriptModule::LoadStartupScripts()
     for (uint i = 0; i < scripts.size(); ++i)
     {
         JavascriptInstance* jsInstance = new JavascriptInstance(QString::fromStdString(scripts[i]), this);
-        PrepareScriptInstance(jsInstance);
         startupScripts_.push_back(jsInstance);
         jsInstance->Run();
     }
@@ -290,7 +297,11 @@ void JavascriptModule::PrepareScriptInstance(JavascriptInstance* instance, EC_Sc
     {
         QString name = properties[i];
         QObject* serviceobject = framework_->property(name.toStdString().c_str()).value<QObject*>();
-        instance->RegisterService(serviceobject, name);
+        // Scripts get their frame updates from ScriptScheduler through their own frame object
+        if (name == "frame" && instance->GetFrame())
+            instance->RegisterService(instance->GetFrame(), name);
+        else
+            instance->RegisterService(serviceobject, name);
         
         if (checked.find(serviceobject) == checked.end())
         {
@@ -305,9 +316,6 @@ void JavascriptModule::PrepareScriptInstance(JavascriptInstance* instance, EC_Sc
 
     instance->RegisterService(framework_, "framework");
     instance->RegisterService(instance, "engine");
-    
-    for(int i = 0; i < properties.size(); ++i)
-        instance->RegisterService(framework_->property(properties[i]).value<QObject*>(), properties[i]);
 
     if (comp)
     {
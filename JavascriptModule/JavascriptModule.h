@@ -16,6 +16,7 @@
 #include "AssetFwd.h"
 #include "SceneFwd.h"
 #include "JavascriptFwd.h"
+#include "ScriptProgramCache.h"
 
 #include <QObject>
 
@@ -68,6 +69,12 @@ public:
     */
     void PrepareScriptInstance(JavascriptInstance* instance, EC_Script *comp = 0);
 
+    /// Returns the cache of parsed script programs shared by the script instances.
+    ScriptProgramCache &GetProgramCache() { return programCache_; }
+
+    /// Returns the scheduler of the frame updates of the script instances, or null if the module is not initialized.
+    ScriptScheduler *GetScheduler() const { return scheduler_; }
+
 public slots:
     //! New scene has been added to foundation.
     void SceneAdded(const QString &name);
@@ -106,6 +113,12 @@ private:
     /// Engines for executing startup (possibly persistent) scripts
     std::vector<JavascriptInstance *> startupScripts_;
 
+    /// Parsed script programs.
+    ScriptProgramCache programCache_;
+
+    /// Scheduler of the frame updates of the script instances.
+    ScriptScheduler *scheduler_;
+
 };
 
 // API things
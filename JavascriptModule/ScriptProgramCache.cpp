@@ -0,0 +1,70 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   ScriptProgramCache.cpp
+ *  @brief  Cache of parsed script programs, shared by the script instances running the same script.
+ */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "ScriptProgramCache.h"
+
+#include <QScriptEngine>
+#include <QHash>
+
+#include "MemoryLeakCheck.h"
+
+/// Number of cached programs above which the unused ones are dropped.
+static const size_t cMaxPrograms = 64;
+
+ScriptProgramCache::ScriptProgramCache() :
+    hits_(0),
+    misses_(0)
+{
+}
+
+ScriptProgramCache::ProgramPtr ScriptProgramCache::Get(const QString &source, const QString &fileName)
+{
+    uint hash = qHash(source);
+    std::pair<ProgramMap::iterator, ProgramMap::iterator> range = programs_.equal_range(hash);
+    for(ProgramMap::iterator iter = range.first; iter != range.second; ++iter)
+        if (iter->second->fileName == fileName && iter->second->source == source)
+        {
+            ++hits_;
+            return iter->second;
+        }
+
+    ++misses_;
+    if (programs_.size() >= cMaxPrograms)
+        Prune();
+
+    ProgramPtr program(new Program());
+    program->source = source;
+    program->fileName = fileName;
+    QScriptSyntaxCheckResult syntaxResult = QScriptEngine::checkSyntax(source);
+    program->valid = syntaxResult.state() == QScriptSyntaxCheckResult::Valid;
+    program->errorLine = syntaxResult.errorLineNumber();
+    program->errorMessage = syntaxResult.errorMessage();
+#if QT_VERSION >= 0x040700
+    program->program = QScriptProgram(source, fileName);
+#endif
+
+    programs_.insert(std::make_pair(hash, program));
+    return program;
+}
+
+void ScriptProgramCache::Clear()
+{
+    programs_.clear();
+}
+
+void ScriptProgramCache::Prune()
+{
+    for(ProgramMap::iterator iter = programs_.begin(); iter != programs_.end();)
+    {
+        if (iter->second.unique())
+            programs_.erase(iter++);
+        else
+            ++iter;
+    }
+}
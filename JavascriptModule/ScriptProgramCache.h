@@ -0,0 +1,68 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   ScriptProgramCache.h
+ *  @brief  Cache of parsed script programs, shared by the script instances running the same script.
+ */
+
+#ifndef incl_JavascriptModule_ScriptProgramCache_h
+#define incl_JavascriptModule_ScriptProgramCache_h
+
+#include <QString>
+#include <QtGlobal>
+#if QT_VERSION >= 0x040700
+#include <QScriptProgram>
+#endif
+
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+
+/// Cache of parsed script programs, keyed by a hash of the script content.
+/** Scenes usually run the same few script assets in many EC_Script components. The syntax check is done once per distinct script,
+    and with Qt 4.7 and later the instances evaluate the same QScriptProgram instead of the source text.
+*/
+class ScriptProgramCache
+{
+public:
+    /// Parsed script.
+    struct Program
+    {
+        QString source; ///< Script source.
+        QString fileName; ///< File name used in error messages.
+        bool valid; ///< Whether the syntax is valid.
+        int errorLine; ///< Line of the syntax error, if not valid.
+        QString errorMessage; ///< Syntax error, if not valid.
+#if QT_VERSION >= 0x040700
+        QScriptProgram program; ///< Program to evaluate.
+#endif
+    };
+
+    typedef boost::shared_ptr<Program> ProgramPtr;
+
+    ScriptProgramCache();
+
+    /// Returns the parsed program of a script, parsing it if it is not in the cache.
+    ProgramPtr Get(const QString &source, const QString &fileName);
+
+    /// Drops all programs. Programs still used by script instances stay alive until released.
+    void Clear();
+
+    /// Returns the number of lookups that found the program in the cache.
+    uint Hits() const { return hits_; }
+
+    /// Returns the number of lookups that parsed the program.
+    uint Misses() const { return misses_; }
+
+private:
+    /// Drops the programs no script instance uses anymore.
+    void Prune();
+
+    typedef std::multimap<uint, ProgramPtr> ProgramMap;
+
+    ProgramMap programs_; ///< Programs by hash of the source.
+    uint hits_;
+    uint misses_;
+};
+
+#endif
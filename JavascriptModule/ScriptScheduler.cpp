@@ -0,0 +1,213 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   ScriptScheduler.cpp
+ *  @brief  Dispatches the frame updates of the script instances within a per-frame CPU time budget.
+ */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "ScriptScheduler.h"
+#include "JavascriptInstance.h"
+
+#include "Framework.h"
+#include "FrameAPI.h"
+#include "Entity.h"
+#include "IComponent.h"
+#include "CoreStringUtils.h"
+
+#include <QScriptEngine>
+
+#include <algorithm>
+
+#include "LoggingFunctions.h"
+DEFINE_POCO_LOGGING_FUNCTIONS("ScriptScheduler")
+
+#include "MemoryLeakCheck.h"
+
+/// Number of frames an instance can be skipped at most to pay back a single overrun.
+static const int cMaxDeferredFrames = 60;
+
+ScriptFrame::ScriptFrame(FrameAPI *frame, QObject *parent) :
+    QObject(parent),
+    frame_(frame)
+{
+}
+
+float ScriptFrame::GetWallClockTime() const
+{
+    return frame_->GetWallClockTime();
+}
+
+DelayedSignal *ScriptFrame::DelayedExecute(float time)
+{
+    return frame_->DelayedExecute(time);
+}
+
+void ScriptFrame::Update(float frametime)
+{
+    emit Updated(frametime);
+}
+
+ScriptScheduler::ScriptScheduler(Foundation::Framework *framework, float budget, float hardLimit) :
+    QObject(framework),
+    dispatching_(false),
+    removed_(false),
+    budget_(budget),
+    hardLimit_(hardLimit),
+    running_(0),
+    abortedRunning_(false)
+{
+    watchdog_.setSingleShot(true);
+    connect(&watchdog_, SIGNAL(timeout()), SLOT(AbortRunningHandler()));
+    connect(framework->Frame(), SIGNAL(Updated(float)), SLOT(Update(float)));
+}
+
+void ScriptScheduler::Register(JavascriptInstance *instance)
+{
+    for(size_t i = 0; i < instances_.size(); ++i)
+        if (instances_[i].instance == instance)
+            return;
+    instances_.push_back(InstanceState(instance));
+}
+
+void ScriptScheduler::Unregister(JavascriptInstance *instance)
+{
+    for(size_t i = 0; i < instances_.size(); ++i)
+        if (instances_[i].instance == instance)
+        {
+            if (dispatching_)
+            {
+                // Dispatch() goes through instances_ by index, so the slot is only cleared here and erased after the dispatch
+                instances_[i].instance = 0;
+                removed_ = true;
+            }
+            else
+                instances_.erase(instances_.begin() + i);
+            return;
+        }
+}
+
+const ScriptScheduler::Stats *ScriptScheduler::GetStats(JavascriptInstance *instance) const
+{
+    for(size_t i = 0; i < instances_.size(); ++i)
+        if (instances_[i].instance == instance)
+            return &instances_[i].stats;
+    return 0;
+}
+
+void ScriptScheduler::Update(float frametime)
+{
+    if (instances_.empty())
+        return;
+
+    PROFILE(ScriptScheduler_Update);
+
+    dispatching_ = true;
+    // Instances registered by the handlers get their first update on the next frame
+    const size_t count = instances_.size();
+    for(size_t i = 0; i < count; ++i)
+    {
+        InstanceState &state = instances_[i];
+        if (!state.instance)
+            continue;
+
+        state.pendingTime += frametime;
+        if (budget_ > 0.f && state.debt > 0.0)
+        {
+            // Pay back the time spent over the budget on the earlier frames by skipping this one
+            state.debt -= budget_;
+            ++state.stats.deferred;
+            continue;
+        }
+
+        Dispatch(i);
+    }
+    dispatching_ = false;
+
+    if (removed_)
+    {
+        for(size_t i = 0; i < instances_.size();)
+        {
+            if (!instances_[i].instance)
+                instances_.erase(instances_.begin() + i);
+            else
+                ++i;
+        }
+        removed_ = false;
+    }
+}
+
+void ScriptScheduler::Dispatch(size_t index)
+{
+    JavascriptInstance *instance = instances_[index].instance;
+    QScriptEngine *engine = instance->GetEngine();
+    float frametime = instances_[index].pendingTime;
+    instances_[index].pendingTime = 0.f;
+    if (!engine || !instance->GetFrame())
+        return;
+
+    if (instances_[index].name.empty())
+    {
+        // Name the instance by its script and the entity of its EC_Script, if any, so that the profiler shows which script eats the frame
+        instances_[index].name = "JS_" + instance->GetLoadedScriptName().toStdString();
+        ComponentPtr owner = instance->GetOwnerComponent();
+        if (owner && owner->GetParentEntity())
+            instances_[index].name += "_" + ToString(owner->GetParentEntity()->GetId());
+    }
+
+    if (hardLimit_ > 0.f)
+    {
+        // The engine processes events at intervals while a handler runs, which lets the watchdog abort the handler
+        engine->setProcessEventsInterval(std::max(1, (int)(hardLimit_ / 4.f)));
+        running_ = engine;
+        abortedRunning_ = false;
+        watchdog_.start((int)hardLimit_);
+    }
+
+    u64 startTime = GetCurrentClockTime();
+    {
+#ifdef PROFILING
+        Foundation::ProfilerSection section(instances_[index].name);
+#endif
+        instance->GetFrame()->Update(frametime);
+    }
+    double elapsed = (double)(GetCurrentClockTime() - startTime) * 1000.0 / GetCurrentClockFreq();
+
+    bool aborted = false;
+    if (hardLimit_ > 0.f)
+    {
+        watchdog_.stop();
+        aborted = abortedRunning_;
+        running_ = 0;
+        abortedRunning_ = false;
+    }
+
+    // The handlers may have deleted the instance or replaced its engine
+    InstanceState &state = instances_[index];
+    if (state.instance != instance)
+        return;
+    if (instance->GetEngine() == engine)
+        engine->setProcessEventsInterval(-1);
+
+    ++state.stats.updates;
+    state.stats.totalTime += elapsed;
+    state.stats.maxTime = std::max(state.stats.maxTime, elapsed);
+    if (aborted)
+    {
+        ++state.stats.aborted;
+        LogWarning("Aborted frame update of " + state.name + " after " + ToString((int)elapsed) + " ms.");
+    }
+
+    if (budget_ > 0.f && elapsed > budget_)
+        state.debt = std::min(elapsed - budget_, (double)budget_ * cMaxDeferredFrames);
+}
+
+void ScriptScheduler::AbortRunningHandler()
+{
+    if (running_ && running_->isEvaluating())
+    {
+        running_->abortEvaluation();
+        abortedRunning_ = true;
+    }
+}
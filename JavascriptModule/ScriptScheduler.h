@@ -0,0 +1,144 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   ScriptScheduler.h
+ *  @brief  Dispatches the frame updates of the script instances within a per-frame CPU time budget.
+ */
+
+#ifndef incl_JavascriptModule_ScriptScheduler_h
+#define incl_JavascriptModule_ScriptScheduler_h
+
+#include "CoreTypes.h"
+#include "JavascriptFwd.h"
+
+#include <QObject>
+#include <QTimer>
+
+#include <vector>
+
+class FrameAPI;
+class DelayedSignal;
+
+namespace Foundation
+{
+    class Framework;
+}
+
+/// Frame object exposed to a single script instance as "frame".
+/** Forwards to FrameAPI, except that Updated() is emitted by ScriptScheduler instead of the framework,
+    so that the frame updates of each script instance can be timed, deferred and aborted separately.
+*/
+class ScriptFrame : public QObject
+{
+    Q_OBJECT
+
+    friend class ScriptScheduler;
+
+public:
+    /// Constructor.
+    /** @param frame Frame API to forward to.
+        @param parent Parent object.
+    */
+    ScriptFrame(FrameAPI *frame, QObject *parent);
+
+public slots:
+    /// Return wall clock time of Framework in seconds.
+    float GetWallClockTime() const;
+
+    /// Triggers DelayedSignal::Triggered(float) signal when spesified amount of time has elapsed.
+    /** @param time Time in seconds.
+        @note Never store the returned pointer.
+    */
+    DelayedSignal *DelayedExecute(float time);
+
+signals:
+    /// Emitted after one frame is processed.
+    /** If the script exceeded its budget, the updates of the next frames are skipped and the skipped time is added to the next update.
+        @param frametime Elapsed time in seconds since the last update of this script.
+    */
+    void Updated(float frametime);
+
+private:
+    /// Emits Updated(). Called by ScriptScheduler.
+    void Update(float frametime);
+
+    FrameAPI *frame_; ///< Frame API.
+};
+
+/// Dispatches the frame updates of the script instances within a per-frame CPU time budget.
+/** Each script instance gets its frame updates through its own ScriptFrame, one instance at a time. The time spent in the handlers
+    is measured per instance and shown in the profiler. An instance that spends more than the budget is skipped in the following frames
+    until the overrun has been paid back, and a handler running longer than the hard limit is aborted.
+*/
+class ScriptScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// Constructor.
+    /** @param framework Framework.
+        @param budget Frame update time allowed for one script instance per frame, in milliseconds. 0 disables the deferring.
+        @param hardLimit Time after which a running frame update handler is aborted, in milliseconds. 0 disables the aborting.
+    */
+    ScriptScheduler(Foundation::Framework *framework, float budget, float hardLimit);
+
+    /// Adds a script instance to receive frame updates.
+    void Register(JavascriptInstance *instance);
+
+    /// Removes a script instance. Can be called while dispatching frame updates.
+    void Unregister(JavascriptInstance *instance);
+
+    /// Sets the frame update time allowed for one script instance per frame, in milliseconds.
+    void SetBudget(float budget) { budget_ = budget; }
+
+    /// Sets the time after which a running frame update handler is aborted, in milliseconds.
+    void SetHardLimit(float hardLimit) { hardLimit_ = hardLimit; }
+
+    /// Frame update statistics of a script instance.
+    struct Stats
+    {
+        Stats() : updates(0), deferred(0), aborted(0), totalTime(0), maxTime(0) {}
+        uint updates; ///< Number of frame updates dispatched.
+        uint deferred; ///< Number of frame updates skipped because of the budget.
+        uint aborted; ///< Number of handlers aborted because of the hard limit.
+        double totalTime; ///< Total time spent in the handlers, in milliseconds.
+        double maxTime; ///< Longest frame update, in milliseconds.
+    };
+
+    /// Returns the statistics of a script instance, or null if it's not registered.
+    const Stats *GetStats(JavascriptInstance *instance) const;
+
+private slots:
+    /// Dispatches the frame updates of the script instances.
+    void Update(float frametime);
+
+    /// Aborts the handler being run, when the hard limit is reached.
+    void AbortRunningHandler();
+
+private:
+    /// Scheduling state of a script instance.
+    struct InstanceState
+    {
+        InstanceState(JavascriptInstance *inst) : instance(inst), pendingTime(0), debt(0) {}
+        JavascriptInstance *instance; ///< Script instance, null if unregistered during the dispatch.
+        float pendingTime; ///< Frame time not yet passed to the instance, in seconds.
+        double debt; ///< Time spent over the budget and not yet paid back, in milliseconds.
+        std::string name; ///< Name of the instance in the profiler and the log.
+        Stats stats; ///< Statistics.
+    };
+
+    /// Runs the frame update handlers of one script instance.
+    /** @param index Index of the instance in instances_. */
+    void Dispatch(size_t index);
+
+    std::vector<InstanceState> instances_; ///< Registered script instances.
+    bool dispatching_; ///< Whether frame updates are being dispatched.
+    bool removed_; ///< Whether instances were unregistered during the dispatch.
+    float budget_; ///< Frame update time allowed per instance per frame, in milliseconds.
+    float hardLimit_; ///< Time after which a frame update handler is aborted, in milliseconds.
+    QScriptEngine *running_; ///< Engine running a frame update handler, if any.
+    bool abortedRunning_; ///< Whether the running handler was aborted.
+    QTimer watchdog_; ///< Fires when the running handler reaches the hard limit.
+};
+
+#endif
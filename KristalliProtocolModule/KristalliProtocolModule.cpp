@@ -94,6 +94,7 @@ KristalliProtocolModule::KristalliProtocolModule()
 , serverConnection(0)
 , server(0)
 , reconnectAttempts(0)
+, nextConnectionID(1)
 , cleanup(false)
 {
     serverIp_list_.clear();
@@ -334,6 +335,10 @@ void KristalliProtocolModule::StopServer()
     {
         network.StopServer();
         connections.clear();
+        connectionsByID.clear();
+        connectionsBySource.clear();
+        freeConnectionIDs.clear();
+        nextConnectionID = 1;
         LogInfo("Stopped server");
         server = 0;
     }
@@ -353,12 +358,14 @@ void KristalliProtocolModule::NewConnectionEstablished(kNet::MessageConnection *
     connection->userID = AllocateNewConnectionID();
     connection->connection = source;
     connections.push_back(connection);
+    connectionsByID[connection->userID] = connection;
+    connectionsBySource[source] = connection;
 
     // For TCP mode sockets, set the TCP_NODELAY option to improve latency for the messages we send.
     if (source->GetSocket() && source->GetSocket()->TransportLayer() == kNet::SocketOverTCP)
         source->GetSocket()->SetNaglesAlgorithmEnabled(false);
 
-    LogInfo("User connected from " + source->RemoteEndPoint().ToString() + ", connection ID " + ToString((int)connection->userID));
+    LogInfo("User connected from " + source->RemoteEndPoint().ToString() + ", connection ID " + ToString(connection->userID));
     
     Events::KristalliUserConnected msg(connection);
     framework_->GetEventManager()->SendEvent(networkEventCategory, Events::USER_CONNECTED, &msg);
@@ -367,19 +374,22 @@ void KristalliProtocolModule::NewConnectionEstablished(kNet::MessageConnection *
 void KristalliProtocolModule::ClientDisconnected(MessageConnection *source)
 {
     // Delete from connection list if it was a known user
-    for(UserConnectionList::iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        if ((*iter)->connection == source)
-        {
-            Events::KristalliUserDisconnected msg((*iter));
-            framework_->GetEventManager()->SendEvent(networkEventCategory, Events::USER_DISCONNECTED, &msg);
-            
-            LogInfo("User disconnected, connection ID " + ToString((int)(*iter)->userID));
-            delete(*iter);
-            connections.erase(iter);
-            return;
-        }
-
-    LogInfo("Unknown user disconnected");
+    UserConnection* user = GetUserConnection(source);
+    if (!user)
+    {
+        LogInfo("Unknown user disconnected");
+        return;
+    }
+    
+    Events::KristalliUserDisconnected msg(user);
+    framework_->GetEventManager()->SendEvent(networkEventCategory, Events::USER_DISCONNECTED, &msg);
+    
+    LogInfo("User disconnected, connection ID " + ToString(user->userID));
+    connectionsBySource.erase(source);
+    connectionsByID.erase(user->userID);
+    connections.remove(user);
+    ReleaseConnectionID(user->userID);
+    delete user;
 }
 
 void KristalliProtocolModule::HandleMessage(MessageConnection *source, message_id_t id, const char *data, size_t numBytes)
@@ -404,29 +414,37 @@ bool KristalliProtocolModule::HandleEvent(event_category_id_t category_id, event
     return false;
 }
 
-u8 KristalliProtocolModule::AllocateNewConnectionID() const
+u32 KristalliProtocolModule::AllocateNewConnectionID()
 {
-    u8 newID = 1;
-    for(UserConnectionList::const_iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        newID = std::max((int)newID, (int)((*iter)->userID+1));
+    if (!freeConnectionIDs.empty())
+    {
+        u32 newID = freeConnectionIDs.front();
+        freeConnectionIDs.pop_front();
+        return newID;
+    }
     
-    return newID;
+    return nextConnectionID++;
+}
+
+void KristalliProtocolModule::ReleaseConnectionID(u32 id)
+{
+    freeConnectionIDs.push_back(id);
 }
 
 UserConnection* KristalliProtocolModule::GetUserConnection(MessageConnection* source)
 {
-    for (UserConnectionList::iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        if ((*iter)->connection == source)
-            return (*iter);
+    boost::unordered_map<kNet::MessageConnection*, UserConnection*>::const_iterator iter = connectionsBySource.find(source);
+    if (iter != connectionsBySource.end())
+        return iter->second;
 
     return 0;
 }
 
-UserConnection* KristalliProtocolModule::GetUserConnection(u8 id)
+UserConnection* KristalliProtocolModule::GetUserConnection(u32 id)
 {
-    for (UserConnectionList::iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        if ((*iter)->userID == id)
-            return (*iter);
+    boost::unordered_map<u32, UserConnection*>::const_iterator iter = connectionsByID.find(id);
+    if (iter != connectionsByID.end())
+        return iter->second;
 
     return 0;
 }
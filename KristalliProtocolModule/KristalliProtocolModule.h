@@ -15,6 +15,10 @@
 #include <QMap>
 #include <QMutableMapIterator>
 
+#include <boost/unordered_map.hpp>
+
+#include <deque>
+
 namespace KristalliProtocol
 {
     //  warning C4275: non dll-interface class 'IMessageHandler' used as base for dll-interface class 'KristalliProtocolModule'
@@ -93,7 +97,7 @@ namespace KristalliProtocol
         /// Gets user by message connection. Returns null if no such connection
         UserConnection* GetUserConnection(kNet::MessageConnection* source);
         /// Gets user by connection ID. Returns null if no such connection
-        UserConnection* GetUserConnection(u8 id);
+        UserConnection* GetUserConnection(u32 id);
 
         /// What trasport layer to use. Read on startup from --protocol udp/tcp. Defaults to TCP if no start param was given.
         kNet::SocketTransportLayer defaultTransport;
@@ -124,8 +128,11 @@ namespace KristalliProtocol
 
         void PerformConnection();
 
-        /// Allocate a  connection ID for new connection
-        u8 AllocateNewConnectionID() const;
+        /// Allocate a connection ID for new connection
+        u32 AllocateNewConnectionID();
+        
+        /// Return a connection ID of a disconnected user for reuse
+        void ReleaseConnectionID(u32 id);
         
         kNet::Network network;
 
@@ -133,6 +140,18 @@ namespace KristalliProtocol
         
         /// Users that are connected to server
         UserConnectionList connections;
+        
+        /// Users by connection ID
+        boost::unordered_map<u32, UserConnection*> connectionsByID;
+        
+        /// Users by message connection
+        boost::unordered_map<kNet::MessageConnection*, UserConnection*> connectionsBySource;
+        
+        /// Next never used connection ID
+        u32 nextConnectionID;
+        
+        /// Released connection IDs, reused oldest first so that an ID stays unused as long as possible
+        std::deque<u32> freeConnectionIDs;
 
         event_category_id_t networkEventCategory;
         
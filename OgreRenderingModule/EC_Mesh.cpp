@@ -644,6 +644,16 @@ void EC_Mesh::SetCastShadows(bool enabled)
     castShadows.Set(enabled, AttributeChange::LocalOnly);
 }
 
+OgreMeshAsset* EC_Mesh::GetMeshAsset() const
+{
+    if (!meshAsset)
+        return 0;
+    OgreMeshAsset *mesh = dynamic_cast<OgreMeshAsset*>(meshAsset->Asset().get());
+    if (!mesh || !mesh->IsLoaded())
+        return 0;
+    return mesh;
+}
+
 uint EC_Mesh::GetNumMaterials() const
 {
     if (!entity_)
@@ -955,7 +965,9 @@ void EC_Mesh::OnAttributeUpdated(IAttribute *attribute)
         */
         if (meshRef.Get().ref.trimmed().isEmpty())
             LogDebug("Warning: Mesh \"" + this->parent_entity_->GetName().toStdString() + "\" mesh ref was set to an empty reference!");
-        meshAsset->HandleAssetRefChange(&meshRef);
+        AssetTransferPtr transfer = meshAsset->HandleAssetRefChange(&meshRef);
+        if (transfer)
+            transfer->SetPriority(GetAssetLoadPriority());
     }
     else if (attribute == &meshMaterial)
     {
@@ -975,10 +987,13 @@ void EC_Mesh::OnAttributeUpdated(IAttribute *attribute)
         while(materialAssets.size() < materials.Size())
             materialAssets.push_back(boost::shared_ptr<AssetRefListener>(new AssetRefListener));
 
+        float priority = GetAssetLoadPriority();
         for(int i = 0; i < materials.Size(); ++i)
         {
             connect(materialAssets[i].get(), SIGNAL(Loaded(AssetPtr)), this, SLOT(OnMaterialAssetLoaded(AssetPtr)), Qt::UniqueConnection);
-            materialAssets[i]->HandleAssetRefChange(framework_->Asset(), materials[i].ref);
+            AssetTransferPtr transfer = materialAssets[i]->HandleAssetRefChange(framework_->Asset(), materials[i].ref);
+            if (transfer)
+                transfer->SetPriority(priority);
         }
     }
     else if((attribute == &skeletonRef) && (!skeletonRef.Get().ref.isEmpty()))
@@ -1159,6 +1174,21 @@ bool EC_Mesh::HasMaterialsChanged() const
     return false;
 }
 
+float EC_Mesh::GetAssetLoadPriority() const
+{
+    RendererPtr renderer = renderer_.lock();
+    if (!renderer || !renderer->GetCurrentCamera() || !placeable_)
+        return 0.f;
+
+    Ogre::SceneNode* node = checked_static_cast<EC_Placeable*>(placeable_.get())->GetSceneNode();
+    if (!node)
+        return 0.f;
+
+    // Map the distance to the range ]0, 1], so that the meshes are loaded before the assets requested with the default priority 0
+    float distance = node->_getDerivedPosition().distance(renderer->GetCurrentCamera()->getDerivedPosition());
+    return 1.f / (1.f + distance);
+}
+
 bool EC_Mesh::AttachMeshToBone(QObject* targetMesh, const QString& boneName)
 {
     if (!entity_)
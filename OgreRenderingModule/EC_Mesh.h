@@ -309,6 +309,9 @@ public slots:
     //! returns Ogre mesh entity
     Ogre::Entity* GetEntity() const { return entity_; }
 
+    //! returns the loaded mesh asset, or null if the mesh is not from an asset or not loaded yet
+    OgreMeshAsset* GetMeshAsset() const;
+
    //! returns Ogre attachment mesh entity
     Ogre::Entity* GetAttachmentEntity(uint index) const;
 
@@ -427,6 +430,9 @@ private:
     void DetachEntity();
 
     bool HasMaterialsChanged() const;
+
+    //! returns the priority to request the mesh and material assets with. The closer the mesh is to the camera, the higher the priority
+    float GetAssetLoadPriority() const;
     
     //! placeable component 
     ComponentPtr placeable_;
@@ -41,13 +41,14 @@ EC_Placeable::EC_Placeable(IModule* module) :
     drawDebug(this, "Show bounding box", false),
     visible(this, "Visible", true)
 {
-    // Enable network interpolation for the transform
+    // Enable network interpolation and compact replication for the transform
     static AttributeMetadata transAttrData;
     static AttributeMetadata nonDesignableAttrData;
     static bool metadataInitialized = false;
     if(!metadataInitialized)
     {
         transAttrData.interpolation = AttributeMetadata::Interpolate;
+        transAttrData.networkEncoding = AttributeMetadata::QuantizedEncoding;
         nonDesignableAttrData.designable = false;
         metadataInitialized = true;
     }
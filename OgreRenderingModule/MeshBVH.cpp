@@ -0,0 +1,285 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "MeshBVH.h"
+
+#include <Ogre.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "MemoryLeakCheck.h"
+
+/// Maximum number of triangles in a leaf of the tree.
+static const uint cMaxLeafTriangles = 4;
+
+/// Maximum depth of the tree traversal stack. The tree is split at the median, so its depth is log2 of the triangle count.
+static const int cMaxStackDepth = 64;
+
+namespace
+{
+    /// Orders triangles by their centroid on one axis.
+    struct CentroidLess
+    {
+        CentroidLess(const std::vector<Ogre::Vector3> &centroids_, int axis_) : centroids(centroids_), axis(axis_) {}
+        bool operator()(uint a, uint b) const { return centroids[a][axis] < centroids[b][axis]; }
+        const std::vector<Ogre::Vector3> &centroids;
+        int axis;
+    };
+
+    /// Slab test of a ray against a box. Returns the entry distance in tNear.
+    bool IntersectBox(const Ogre::Vector3 &min, const Ogre::Vector3 &max, const Ogre::Vector3 &origin, const Ogre::Vector3 &invDir,
+        float maxDistance, float &tNear)
+    {
+        float tMin = 0.f;
+        float tMax = maxDistance;
+        for(int i = 0; i < 3; ++i)
+        {
+            float t1 = (min[i] - origin[i]) * invDir[i];
+            float t2 = (max[i] - origin[i]) * invDir[i];
+            if (t1 > t2)
+                std::swap(t1, t2);
+            tMin = std::max(tMin, t1);
+            tMax = std::min(tMax, t2);
+            if (tMin > tMax)
+                return false;
+        }
+        tNear = tMin;
+        return true;
+    }
+}
+
+MeshBVH::MeshBVH(Ogre::Mesh *mesh)
+{
+    PROFILE(MeshBVH_Build);
+
+    // Read back the vertices and triangles in mesh-local space. The shared vertex data is read only once.
+    size_t sharedOffset = 0;
+    bool addedShared = false;
+    for(unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+    {
+        Ogre::SubMesh *submesh = mesh->getSubMesh(i);
+        Ogre::VertexData *vertexData = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+        if (!vertexData || !submesh->indexData)
+            continue;
+
+        size_t offset = vertices.size();
+        if (submesh->useSharedVertices && addedShared)
+            offset = sharedOffset;
+        else
+        {
+            if (submesh->useSharedVertices)
+            {
+                addedShared = true;
+                sharedOffset = offset;
+            }
+
+            const Ogre::VertexElement *posElem = vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+            const Ogre::VertexElement *texElem = vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_TEXTURE_COORDINATES);
+            if (!posElem)
+                continue;
+
+            vertices.resize(offset + vertexData->vertexCount);
+            texcoords.resize(offset + vertexData->vertexCount, Ogre::Vector2(0.0f, 0.0f));
+
+            Ogre::HardwareVertexBufferSharedPtr posBuf = vertexData->vertexBufferBinding->getBuffer(posElem->getSource());
+            unsigned char *vertex = static_cast<unsigned char*>(posBuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+            float *pReal = 0;
+            for(size_t j = 0; j < vertexData->vertexCount; ++j, vertex += posBuf->getVertexSize())
+            {
+                posElem->baseVertexPointerToElement(vertex, &pReal);
+                vertices[offset + j] = Ogre::Vector3(pReal[0], pReal[1], pReal[2]);
+            }
+            posBuf->unlock();
+
+            if (texElem)
+            {
+                Ogre::HardwareVertexBufferSharedPtr texBuf = vertexData->vertexBufferBinding->getBuffer(texElem->getSource());
+                vertex = static_cast<unsigned char*>(texBuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+                for(size_t j = 0; j < vertexData->vertexCount; ++j, vertex += texBuf->getVertexSize())
+                {
+                    texElem->baseVertexPointerToElement(vertex, &pReal);
+                    texcoords[offset + j] = Ogre::Vector2(pReal[0], pReal[1]);
+                }
+                texBuf->unlock();
+            }
+        }
+
+        Ogre::IndexData *indexData = submesh->indexData;
+        Ogre::HardwareIndexBufferSharedPtr ibuf = indexData->indexBuffer;
+        if (ibuf.isNull())
+            continue;
+        size_t numTris = indexData->indexCount / 3;
+        bool use32BitIndices = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
+        void *indices = ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY);
+        for(size_t j = 0; j < numTris; ++j)
+        {
+            Triangle triangle;
+            for(size_t k = 0; k < 3; ++k)
+            {
+                size_t index = indexData->indexStart + j * 3 + k;
+                uint vertexIndex = use32BitIndices ? static_cast<uint*>(indices)[index] : static_cast<u16*>(indices)[index];
+                triangle.corners[k] = vertexIndex + (uint)offset;
+            }
+            triangle.submesh = i;
+            if (triangle.corners[0] < vertices.size() && triangle.corners[1] < vertices.size() && triangle.corners[2] < vertices.size())
+                triangles.push_back(triangle);
+        }
+        ibuf->unlock();
+    }
+
+    if (triangles.empty())
+        return;
+
+    std::vector<Ogre::Vector3> centroids(triangles.size());
+    for(size_t i = 0; i < triangles.size(); ++i)
+    {
+        const Triangle &t = triangles[i];
+        centroids[i] = (vertices[t.corners[0]] + vertices[t.corners[1]] + vertices[t.corners[2]]) / 3.0f;
+    }
+
+    std::vector<uint> order(triangles.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        order[i] = (uint)i;
+
+    nodes.reserve(2 * triangles.size() / cMaxLeafTriangles + 1);
+    Build(0, (uint)order.size(), order, centroids);
+
+    // Store the triangles in leaf order
+    std::vector<Triangle> ordered(triangles.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        ordered[i] = triangles[order[i]];
+    triangles.swap(ordered);
+}
+
+uint MeshBVH::Build(uint first, uint count, std::vector<uint> &order, const std::vector<Ogre::Vector3> &centroids)
+{
+    uint index = (uint)nodes.size();
+    nodes.push_back(Node());
+
+    Ogre::Vector3 min(std::numeric_limits<float>::max());
+    Ogre::Vector3 max(-std::numeric_limits<float>::max());
+    Ogre::Vector3 centroidMin = min;
+    Ogre::Vector3 centroidMax = max;
+    for(uint i = first; i < first + count; ++i)
+    {
+        const Triangle &t = triangles[order[i]];
+        for(int k = 0; k < 3; ++k)
+        {
+            min.makeFloor(vertices[t.corners[k]]);
+            max.makeCeil(vertices[t.corners[k]]);
+        }
+        centroidMin.makeFloor(centroids[order[i]]);
+        centroidMax.makeCeil(centroids[order[i]]);
+    }
+    nodes[index].min = min;
+    nodes[index].max = max;
+
+    if (count <= cMaxLeafTriangles)
+    {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        return index;
+    }
+
+    // Split at the median centroid on the longest axis of the centroid bounds
+    Ogre::Vector3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent[axis])
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+    uint half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, CentroidLess(centroids, axis));
+
+    Build(first, half, order, centroids);
+    uint right = Build(first + half, count - half, order, centroids);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+bool MeshBVH::Raycast(const Ogre::Ray &ray, bool flipped, Hit &hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    const Ogre::Vector3 &origin = ray.getOrigin();
+    const Ogre::Vector3 &dir = ray.getDirection();
+    Ogre::Vector3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+    float closest = std::numeric_limits<float>::max();
+    const Triangle *closestTriangle = 0;
+
+    uint stack[cMaxStackDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0)
+    {
+        const Node &node = nodes[stack[--stackSize]];
+        float tNear;
+        if (!IntersectBox(node.min, node.max, origin, invDir, closest, tNear))
+            continue;
+
+        if (node.count > 0)
+        {
+            for(uint i = node.first; i < node.first + node.count; ++i)
+            {
+                const Triangle &t = triangles[i];
+                // Cull the back faces like the world space test does. A mirroring transform turns the triangles inside out.
+                std::pair<bool, Ogre::Real> result = Ogre::Math::intersects(ray, vertices[t.corners[0]], vertices[t.corners[1]],
+                    vertices[t.corners[2]], !flipped, flipped);
+                if (result.first && result.second < closest)
+                {
+                    closest = result.second;
+                    closestTriangle = &t;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first, so that the farther one can be culled by the hits found in it
+        uint left = (uint)(&node - &nodes[0]) + 1;
+        uint right = node.first;
+        float tLeft = std::numeric_limits<float>::max();
+        float tRight = std::numeric_limits<float>::max();
+        bool hitLeft = IntersectBox(nodes[left].min, nodes[left].max, origin, invDir, closest, tLeft);
+        bool hitRight = IntersectBox(nodes[right].min, nodes[right].max, origin, invDir, closest, tRight);
+        if (hitLeft && hitRight)
+        {
+            stack[stackSize++] = tLeft < tRight ? right : left;
+            stack[stackSize++] = tLeft < tRight ? left : right;
+        }
+        else if (hitLeft)
+            stack[stackSize++] = left;
+        else if (hitRight)
+            stack[stackSize++] = right;
+    }
+
+    if (!closestTriangle)
+        return false;
+
+    hit.distance = closest;
+    hit.submesh = closestTriangle->submesh;
+    hit.uv = FindUV(*closestTriangle, ray.getPoint(closest));
+    return true;
+}
+
+Ogre::Vector2 MeshBVH::FindUV(const Triangle &triangle, const Ogre::Vector3 &point) const
+{
+    // The area ratios are kept by affine transforms, so this gives the same result as interpolating in world space
+    Ogre::Vector3 v1 = point - vertices[triangle.corners[0]];
+    Ogre::Vector3 v2 = point - vertices[triangle.corners[1]];
+    Ogre::Vector3 v3 = point - vertices[triangle.corners[2]];
+
+    float area1 = (v2.crossProduct(v3)).length() / 2.0f;
+    float area2 = (v1.crossProduct(v3)).length() / 2.0f;
+    float area3 = (v1.crossProduct(v2)).length() / 2.0f;
+    float sum_area = area1 + area2 + area3;
+    if (sum_area == 0.0)
+        return Ogre::Vector2(0.0f, 0.0f);
+
+    Ogre::Vector3 bary(area1 / sum_area, area2 / sum_area, area3 / sum_area);
+    return texcoords[triangle.corners[0]] * bary.x + texcoords[triangle.corners[1]] * bary.y + texcoords[triangle.corners[2]] * bary.z;
+}
@@ -0,0 +1,85 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderingModule_MeshBVH_h
+#define incl_OgreRenderingModule_MeshBVH_h
+
+#include "OgreModuleApi.h"
+#include "CoreTypes.h"
+
+#include <OgreVector2.h>
+#include <OgreVector3.h>
+#include <OgreRay.h>
+
+#include <vector>
+
+namespace Ogre
+{
+    class Mesh;
+}
+
+/// Bounding volume hierarchy of the triangles of an Ogre mesh, for raycasting the mesh without testing every triangle.
+/** The triangles are read back from the mesh once, in mesh-local space, so one tree serves all the entities using the mesh.
+    Skeletal and vertex animation are not taken into account. */
+class OGRE_MODULE_API MeshBVH
+{
+public:
+    /// Result of a raycast.
+    struct Hit
+    {
+        /// Distance along the ray, in units of the ray direction.
+        float distance;
+        /// Index of the submesh the hit triangle belongs to.
+        uint submesh;
+        /// Texture coordinates at the hit point.
+        Ogre::Vector2 uv;
+    };
+
+    /// Builds the tree from the vertex and index data of the mesh.
+    explicit MeshBVH(Ogre::Mesh *mesh);
+
+    /// Finds the closest triangle hit by the ray.
+    /** @param ray The ray in mesh-local space. The direction need not be unit length.
+        @param flipped Whether the mesh is mirrored by its transform, in which case the front faces of its triangles are the other side.
+        @param hit [out] The closest hit, if any.
+        @return True if a triangle was hit. */
+    bool Raycast(const Ogre::Ray &ray, bool flipped, Hit &hit) const;
+
+    /// Returns the number of triangles in the tree.
+    size_t NumTriangles() const { return triangles.size(); }
+
+private:
+    /// A node of the tree. The left child of an inner node follows it in the node array.
+    struct Node
+    {
+        /// Bounding box of the triangles under the node.
+        Ogre::Vector3 min;
+        Ogre::Vector3 max;
+        /// For a leaf, the index of its first triangle. For an inner node, the index of its right child.
+        uint first;
+        /// Number of triangles in a leaf, 0 for an inner node.
+        uint count;
+    };
+
+    /// A triangle of the mesh.
+    struct Triangle
+    {
+        /// Indices of the corners to the vertices array.
+        uint corners[3];
+        /// Index of the submesh of the triangle.
+        uint submesh;
+    };
+
+    /// Builds the subtree of the triangles order[first, first+count) into nodes, reordering them. Returns the index of the subtree root.
+    uint Build(uint first, uint count, std::vector<uint> &order, const std::vector<Ogre::Vector3> &centroids);
+
+    /// Interpolates the texture coordinates at the given point of the triangle.
+    Ogre::Vector2 FindUV(const Triangle &triangle, const Ogre::Vector3 &point) const;
+
+    std::vector<Ogre::Vector3> vertices;
+    std::vector<Ogre::Vector2> texcoords;
+    /// The triangles, ordered so that the triangles of each leaf are consecutive.
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+};
+
+#endif
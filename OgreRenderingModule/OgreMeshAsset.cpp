@@ -158,6 +158,7 @@ void OgreMeshAsset::HandleLoadError(const QString &loadError)
 
 void OgreMeshAsset::DoUnload()
 {
+    raycastTree.reset();
     if (ogreMesh.isNull())
         return;
 
@@ -192,6 +193,15 @@ bool OgreMeshAsset::IsLoaded() const
     return ogreMesh.get() != 0;
 }
 
+const MeshBVH *OgreMeshAsset::GetRaycastTree()
+{
+    if (ogreMesh.isNull())
+        return 0;
+    if (!raycastTree)
+        raycastTree = boost::shared_ptr<MeshBVH>(new MeshBVH(ogreMesh.get()));
+    return raycastTree.get();
+}
+
 bool OgreMeshAsset::SerializeTo(std::vector<u8> &data, const QString &serializationParameters) const
 {
     if (ogreMesh.isNull())
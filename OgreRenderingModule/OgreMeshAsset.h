@@ -5,6 +5,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include "IAsset.h"
+#include "MeshBVH.h"
 
 #include <OgreMesh.h>
 #include <OgreResourceBackgroundQueue.h>
@@ -43,12 +44,19 @@ public:
 
     bool IsLoaded() const;
 
+    /// Returns the triangle tree for raycasting the mesh. The tree is built on the first call after the mesh is loaded.
+    /** @return The tree, or null if the mesh is not loaded. */
+    const MeshBVH *GetRaycastTree();
+
     /// This points to the loaded mesh asset, if it is present.
     Ogre::MeshPtr ogreMesh;
 
     /// Ticket for ogres threaded loading operation.
     Ogre::BackgroundProcessTicket loadTicket_;
 
+    /// Triangle tree for raycasting, built lazily by GetRaycastTree().
+    boost::shared_ptr<MeshBVH> raycastTree;
+
     /// Specifies the unique mesh name Ogre uses in its asset pool for this mesh.
     //QString ogreAssetName;
 
@@ -56,5 +56,7 @@ namespace OgreRenderer
 
 class EC_Placeable;
 class EC_Mesh;
+class OgreMeshAsset;
+class MeshBVH;
 
 #endif
@@ -9,9 +9,12 @@
 #include "OgreRenderingModule.h"
 #include "OgreConversionUtils.h"
 #include "EC_Placeable.h"
+#include "EC_Mesh.h"
 #include "EC_OgreCamera.h"
 #include "EC_OgreMovableTextOverlay.h"
 #include "RenderWindow.h"
+#include "OgreMeshAsset.h"
+#include "MeshBVH.h"
 
 #include "OgreShadowCameraSetupFocusedPSSM.h"
 #include "CompositionHandler.h"
@@ -978,6 +981,26 @@ namespace OgreRenderer
         return t;
     }
 
+    // Get the raycast tree of the mesh asset shown by the given Ogre entity. Returns null if the entity is animated or its mesh is not from an asset.
+    const MeshBVH *GetMeshBVH(Scene::Entity *entity, Ogre::Entity *ogre_entity)
+    {
+        // The tree holds the mesh in its bind pose
+        if (ogre_entity->hasSkeleton() || ogre_entity->hasVertexAnimation())
+            return 0;
+
+        std::vector<boost::shared_ptr<EC_Mesh> > meshes = entity->GetComponents<EC_Mesh>();
+        for(size_t i = 0; i < meshes.size(); ++i)
+        {
+            if (meshes[i]->GetEntity() != ogre_entity)
+                continue;
+            OgreMeshAsset *asset = meshes[i]->GetMeshAsset();
+            if (asset && asset->ogreMesh.get() == ogre_entity->getMesh().get())
+                return asset->GetRaycastTree();
+            return 0;
+        }
+        return 0;
+    }
+
     RaycastResult* Renderer::RaycastFromTo(Vector3df pos, Vector3df dir)
     {
         static RaycastResult result;
@@ -1121,6 +1144,40 @@ namespace OgreRenderer
                 Ogre::Entity* ogre_entity = static_cast<Ogre::Entity*>(entry.movable);
                 assert(ogre_entity != 0);
 
+                const Ogre::Vector3 &scale = ogre_entity->getParentNode()->_getDerivedScale();
+                const MeshBVH *bvh = 0;
+                if (scale.x != 0.0f && scale.y != 0.0f && scale.z != 0.0f)
+                    bvh = GetMeshBVH(entity, ogre_entity);
+                if (bvh)
+                {
+                    // Raycast the tree in mesh-local space. The ray direction is not renormalised, so the hit distance is the same as in world space.
+                    Ogre::Quaternion inv_orient = ogre_entity->getParentNode()->_getDerivedOrientation().Inverse();
+                    Ogre::Ray local_ray((inv_orient * (ray.getOrigin() - ogre_entity->getParentNode()->_getDerivedPosition())) / scale,
+                        (inv_orient * ray.getDirection()) / scale);
+                    MeshBVH::Hit hit;
+                    if (bvh->Raycast(local_ray, scale.x * scale.y * scale.z < 0.0f, hit))
+                    {
+                        if ((closest_distance < 0.0f) || (hit.distance < closest_distance) || (current_priority > closest_priority))
+                        {
+                            if (current_priority >= closest_priority)
+                            {
+                                // this is the closest/best so far, save it
+                                closest_distance = hit.distance;
+                                closest_priority = current_priority;
+
+                                Ogre::Vector3 point = ray.getPoint(closest_distance);
+
+                                result.entity_ = entity;
+                                result.pos_ = Vector3df(point.x, point.y, point.z);
+                                result.submesh_ = hit.submesh;
+                                result.u_ = hit.uv.x;
+                                result.v_ = hit.uv.y;
+                            }
+                        }
+                    }
+                    continue;
+                }
+
                 // get the mesh information
                 GetMeshInformation(ogre_entity, vertices, texcoords, indices, submeshstartindex,
                     ogre_entity->getParentNode()->_getDerivedPosition(),
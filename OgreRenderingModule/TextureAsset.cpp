@@ -37,7 +37,11 @@ AssetLoadState TextureAsset::DeserializeFromData(const u8 *data, size_t numBytes
 	    return ASSET_LOAD_FAILED;
     }
 
-    if (OGRE_THREAD_SUPPORT != 0)
+    // Use the image decoded in a worker thread, if there is one.
+    boost::shared_ptr<Ogre::Image> image = preparedImage;
+    preparedImage.reset();
+
+    if (!image && OGRE_THREAD_SUPPORT != 0)
     {
         // We can only do threaded loading from disk, and not any disk location but only from asset cache.
         // local:// refs will return empty string here and those will fall back to the non-threaded loading.
@@ -56,29 +60,32 @@ AssetLoadState TextureAsset::DeserializeFromData(const u8 *data, size_t numBytes
     
     try
     {
-        // Convert the data into Ogre's own DataStream format.
-        std::vector<u8> tempData(data, data + numBytes);
+        if (!image)
+        {
+            // Convert the data into Ogre's own DataStream format.
+            std::vector<u8> tempData(data, data + numBytes);
 #include "DisableMemoryLeakCheck.h"
-        Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream(&tempData[0], tempData.size(), false));
+            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream(&tempData[0], tempData.size(), false));
 #include "EnableMemoryLeakCheck.h"
-        // Load up the image as an Ogre CPU image object.
-        Ogre::Image image;
-        image.load(stream);
+            // Load up the image as an Ogre CPU image object.
+            image = boost::shared_ptr<Ogre::Image>(new Ogre::Image());
+            image->load(stream);
+        }
 
         if (ogreTexture.isNull()) // If we are creating this texture for the first time, create a new Ogre::Texture object.
         {
             ogreAssetName = OgreRenderer::SanitateAssetIdForOgre(this->Name().toStdString()).c_str();
-            ogreTexture = Ogre::TextureManager::getSingleton().loadImage(ogreAssetName.toStdString(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, image);
+            ogreTexture = Ogre::TextureManager::getSingleton().loadImage(ogreAssetName.toStdString(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, *image);
         }
         else // If we're loading on top of an Ogre::Texture we've created before, don't lose the old Ogre::Texture object, but reuse the old.
         {    // This will allow all existing materials to keep referring to this texture, and they'll get the updated texture image immediately.
             ogreTexture->freeInternalResources(); 
 
-            if (image.getWidth() != ogreTexture->getWidth() || image.getHeight() != ogreTexture->getHeight() || image.getFormat() != ogreTexture->getFormat())
+            if (image->getWidth() != ogreTexture->getWidth() || image->getHeight() != ogreTexture->getHeight() || image->getFormat() != ogreTexture->getFormat())
             {
-                ogreTexture->setWidth(image.getWidth());
-                ogreTexture->setHeight(image.getHeight());
-                ogreTexture->setFormat(image.getFormat());
+                ogreTexture->setWidth(image->getWidth());
+                ogreTexture->setHeight(image->getHeight());
+                ogreTexture->setFormat(image->getFormat());
             }
 
             if (ogreTexture->getBuffer().isNull())
@@ -87,7 +94,7 @@ AssetLoadState TextureAsset::DeserializeFromData(const u8 *data, size_t numBytes
                 return ASSET_LOAD_FAILED;
             }
 
-            Ogre::PixelBox pixelBox(Ogre::Box(0,0, image.getWidth(), image.getHeight()), image.getFormat(), (void*)image.getData());
+            Ogre::PixelBox pixelBox(Ogre::Box(0,0, image->getWidth(), image->getHeight()), image->getFormat(), (void*)image->getData());
             ogreTexture->getBuffer()->blitFromMemory(pixelBox);
 
             ogreTexture->createInternalResources();
@@ -102,6 +109,33 @@ AssetLoadState TextureAsset::DeserializeFromData(const u8 *data, size_t numBytes
     }
 }
 
+void TextureAsset::PrepareFromData(const u8 *data, size_t numBytes)
+{
+    if (!data || numBytes == 0 || assetAPI->IsHeadless())
+        return;
+
+    // Without thread support Ogre must not be used outside the main thread, so DeserializeFromData decodes the image there.
+    if (OGRE_THREAD_SUPPORT == 0)
+        return;
+
+    // Decoding the image only needs the Ogre image codecs. Creating the texture is left for DeserializeFromData in the main thread.
+    try
+    {
+        // The stream is read only, so the data need not be copied.
+#include "DisableMemoryLeakCheck.h"
+        Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)data, numBytes, false, true));
+#include "EnableMemoryLeakCheck.h"
+        boost::shared_ptr<Ogre::Image> image(new Ogre::Image());
+        image->load(stream);
+        preparedImage = image;
+    }
+    catch (Ogre::Exception &)
+    {
+        // DeserializeFromData decodes the data again and reports the error.
+        preparedImage.reset();
+    }
+}
+
 void TextureAsset::operationCompleted(Ogre::BackgroundProcessTicket ticket, const Ogre::BackgroundProcessResult &result)
 {
     if (ticket != loadTicket_)
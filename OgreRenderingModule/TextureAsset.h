@@ -25,6 +25,9 @@ public:
     /// Load texture from memory. IAsset override.
     virtual AssetLoadState DeserializeFromData(const u8 *data_, size_t numBytes);
 
+    /// Decode the texture image in a worker thread. IAsset override.
+    virtual void PrepareFromData(const u8 *data_, size_t numBytes);
+
     /// Load texture into memory. IAsset override.
     virtual bool SerializeTo(std::vector<u8> &data, const QString &serializationParameters) const;
 
@@ -48,6 +51,9 @@ public:
     QString ogreAssetName;
 
     Ogre::BackgroundProcessTicket loadTicket_;
+
+    /// The image decoded by PrepareFromData, waiting to be uploaded to the texture by DeserializeFromData. Null if there is none.
+    boost::shared_ptr<Ogre::Image> preparedImage;
 };
 
 typedef boost::shared_ptr<TextureAsset> TextureAssetPtr;
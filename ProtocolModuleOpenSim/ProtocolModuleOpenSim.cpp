@@ -73,6 +73,8 @@ namespace OpenSimProtocol
         networkManager_ = boost::shared_ptr<ProtocolUtilities::NetMessageManager>(new ProtocolUtilities::NetMessageManager(filename));
         assert(networkManager_);
         networkManager_->RegisterNetworkListener(this);
+        // Time in seconds the inbound packets are processed per frame. The rest are left queued for the next frame.
+        networkManager_->SetMaxProcessTime(framework_->GetDefaultConfig().DeclareSetting("ProtocolModuleOpenSim", "max_packet_process_time", 0.1f));
 
         // Send event that other modules can query above categories
         boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> thisModule = framework_->GetModuleManager()->GetModule<ProtocolModuleOpenSim>().lock();
@@ -69,6 +69,8 @@ namespace TaigaProtocol
         networkManager_ = boost::shared_ptr<ProtocolUtilities::NetMessageManager>(new ProtocolUtilities::NetMessageManager(filename));
         assert(networkManager_);
         networkManager_->RegisterNetworkListener(this);
+        // Time in seconds the inbound packets are processed per frame. The rest are left queued for the next frame.
+        networkManager_->SetMaxProcessTime(framework_->GetDefaultConfig().DeclareSetting("ProtocolModuleTaiga", "max_packet_process_time", 0.1f));
 
         // Send event that other modules can query above categories
         boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> thisModule = framework_->GetModuleManager()->GetModule<ProtocolModuleTaiga>().lock();
@@ -2,42 +2,88 @@
 #include "StableHeaders.h"
 
 #include <utility>
+#include <cstring>
 
 #include "NetworkConnection.h"
 
+#include <boost/bind.hpp>
+
+#include <Poco/Net/NetException.h>
+
 using namespace std;
 
 namespace ProtocolUtilities
 {
 
-NetworkConnection::NetworkConnection(const char *address, int port): bOpen(true)
+/// Number of packet buffers in the receive ring. When the ring is full, the datagrams queue up in the socket receive buffer.
+static const size_t cNumPacketBuffers = 512;
+
+/// How often the receive thread checks whether it should exit, in milliseconds.
+static const int cReceivePollMsecs = 50;
+
+NetworkConnection::NetworkConnection(const char *address, int port):
+    bOpen(true),
+    packets(cNumPacketBuffers),
+    readIndex(0),
+    writeIndex(0),
+    stopReceiving(false)
 {
     socket.connect(Poco::Net::SocketAddress(address, port));
-    
+
     const size_t cBufferSize = 100000;
     socket.setReceiveBufferSize(cBufferSize);
     socket.setSendBufferSize(cBufferSize);
+
+    Thread(boost::bind(&NetworkConnection::ReceiveThread, this)).swap(receiveThread);
 }
 
 NetworkConnection::~NetworkConnection()
 {
+    Close();
 }
 
 bool NetworkConnection::PacketsAvailable() const
 {
     if (!bOpen)
         return false;
-    
-    return socket.available() != 0;
+
+    MutexLock lock(indexMutex);
+    return readIndex != writeIndex;
+}
+
+NetworkConnection::Packet *NetworkConnection::FrontPacket()
+{
+    // The packets left in the ring of a closed connection are not processed.
+    if (!bOpen)
+        return 0;
+
+    MutexLock lock(indexMutex);
+    if (readIndex == writeIndex)
+        return 0;
+    return &packets[readIndex];
+}
+
+void NetworkConnection::PopPacket()
+{
+    {
+        MutexLock lock(indexMutex);
+        if (readIndex == writeIndex)
+            return;
+        readIndex = (readIndex + 1) % packets.size();
+    }
+    packetReleased.notify_one();
 }
 
 int NetworkConnection::ReceiveBytes(uint8_t *bytes, size_t maxCount)
 {
-    int numBytes = min((int)maxCount, socket.available());
-    if (numBytes == 0)
-        return numBytes;
+    const Packet *packet = FrontPacket();
+    if (!packet)
+        return 0;
 
-    return socket.receiveBytes(bytes, numBytes);
+    size_t numBytes = min(maxCount, packet->numBytes);
+    memcpy(bytes, packet->data, numBytes);
+    PopPacket();
+    return (int)numBytes;
 }
 
 void NetworkConnection::SendBytes(const uint8_t *bytes, size_t count)
@@ -47,8 +93,59 @@ void NetworkConnection::SendBytes(const uint8_t *bytes, size_t count)
 
 void NetworkConnection::Close()
 {
+    if (!bOpen)
+        return;
+
+    {
+        MutexLock lock(indexMutex);
+        stopReceiving = true;
+    }
+    packetReleased.notify_one();
+    receiveThread.join();
+
     socket.close();
     bOpen = false;
 }
 
-}
\ No newline at end of file
+void NetworkConnection::ReceiveThread()
+{
+    const Poco::Timespan pollTimeout(cReceivePollMsecs * 1000);
+
+    while(!stopReceiving)
+    {
+        // Wait for a free packet buffer. The last buffer is kept unused to tell a full ring from an empty one.
+        size_t index;
+        {
+            ScopedLock lock(indexMutex);
+            while(!stopReceiving && (writeIndex + 1) % packets.size() == readIndex)
+                packetReleased.timed_wait(lock, boost::posix_time::milliseconds(cReceivePollMsecs));
+            index = writeIndex;
+        }
+        if (stopReceiving)
+            break;
+
+        // Receive straight into the packet buffer.
+        Packet &packet = packets[index];
+        try
+        {
+            if (!socket.poll(pollTimeout, Poco::Net::Socket::SELECT_READ))
+                continue;
+            int numBytes = socket.receiveBytes(packet.data, (int)cMaxPacketSize);
+            if (numBytes <= 0)
+                continue;
+            packet.numBytes = (size_t)numBytes;
+            packet.receiveTime = GetCurrentClockTime();
+        }
+        catch(Poco::Exception &e)
+        {
+            // E.g. an ICMP port unreachable reported for an earlier send. The socket stays usable.
+            std::cout << "NetworkConnection: Receiving a datagram failed: " << e.displayText() << std::endl;
+            continue;
+        }
+
+        MutexLock lock(indexMutex);
+        writeIndex = (index + 1) % packets.size();
+    }
+}
+
+}
@@ -4,21 +4,51 @@
 
 #include "Poco/Net/DatagramSocket.h"
 #include "RexTypes.h"
+#include "HighPerfClock.h"
+#include "CoreThread.h"
+
+#include <vector>
 
 namespace ProtocolUtilities
 {
     /// NetworkConnection represents the socket of a bidirectional UDP connection.
+    /// The socket is read by a dedicated receive thread, which stores the datagrams into a bounded ring of preallocated packet buffers.
+    /// The ring has a single producer (the receive thread) and a single consumer (the thread calling FrontPacket() and PopPacket()).
     class NetworkConnection
     {
     public:
-        /// Connects to the given address.
+        /// The maximum size of a datagram. Larger datagrams are truncated.
+        static const size_t cMaxPacketSize = 2048;
+
+        /// A received datagram.
+        struct Packet
+        {
+            /// The datagram contents.
+            uint8_t data[cMaxPacketSize];
+
+            /// The number of bytes in data.
+            size_t numBytes;
+
+            /// Clock time when the datagram was received.
+            tick_t receiveTime;
+        };
+
+        /// Connects to the given address and starts the receive thread.
         NetworkConnection(const char *address, int port);
+
+        /// Stops the receive thread and closes the socket.
         ~NetworkConnection();
 
-        /// @return True if there are available UDP packets in the stream and the socket is open. 
+        /// @return True if there are received UDP packets waiting and the socket is open.
         bool PacketsAvailable() const;
 
-        /// Reads bytes from the socket. Doesn't block, but returns 0 if no bytes available.
+        /// @return The oldest received packet, or null if none or the connection is closed. The packet stays valid until PopPacket() is called.
+        Packet *FrontPacket();
+
+        /// Releases the packet returned by FrontPacket() back to the receive thread.
+        void PopPacket();
+
+        /// Reads the oldest received packet. Doesn't block, but returns 0 if no packets available.
         /// @param maxCount The maximum number of bytes to fill into the buffer.
         /// @return The number of bytes that was actually filled into the buffer.
         int ReceiveBytes(uint8_t *bytes, size_t maxCount);
@@ -26,18 +56,45 @@ namespace ProtocolUtilities
         /// Pushes out a packet with the given contents.
         void SendBytes(const uint8_t *bytes, size_t count);
 
-        /// Closes the socket.
+        /// Stops the receive thread and closes the socket.
         void Close();
 
         /// @return True if the socket is open.
         bool Open() const { return bOpen; }
 
     private:
+        NetworkConnection(const NetworkConnection &);
+        void operator=(const NetworkConnection &);
+
+        /// Receive thread main loop.
+        void ReceiveThread();
+
         /// PoCo UDP socket.
         Poco::Net::DatagramSocket socket;
 
         /// Signals that socket is open for use. ///\todo Remove this boolean altogether. -jj.
         bool bOpen;
+
+        /// Ring of packet buffers. Allocated once, when the connection is created.
+        std::vector<Packet> packets;
+
+        /// Index of the oldest received packet. Only written by the consumer.
+        size_t readIndex;
+
+        /// Index of the packet buffer the receive thread fills next. Only written by the receive thread.
+        size_t writeIndex;
+
+        /// Guards readIndex and writeIndex. Never held while a packet buffer is read or filled.
+        mutable Mutex indexMutex;
+
+        /// Signaled when the consumer releases a packet buffer while the ring is full.
+        Condition packetReleased;
+
+        /// Tells the receive thread to exit.
+        volatile bool stopReceiving;
+
+        /// The receive thread.
+        Thread receiveThread;
     };
 }
 
@@ -18,6 +18,8 @@
 #include <sstream>
 #include <vector>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 #include <boost/timer.hpp>
 
@@ -133,6 +135,24 @@ namespace ProtocolUtilities
        return (uint32_t)ntohl(*(u_long*)&data[1]);//((data[1] << 24) + (data[2] << 16) + (data[3] << 8) + data[4]);    
     }
 
+    /// Length of one slot of the resend timing wheel, in milliseconds.
+    static const double cResendWheelSlotMsecs = 20.0;
+
+    /// Number of slots in the resend timing wheel. The wheel must span cMaxRetransmitTimeout.
+    static const size_t cNumResendWheelSlots = 512;
+
+    /// Retransmission timeout used until the first round-trip time is measured, in milliseconds.
+    static const double cInitialRetransmitTimeout = 3000.0;
+
+    /// Lower bound of the retransmission timeout, in milliseconds.
+    static const double cMinRetransmitTimeout = 500.0;
+
+    /// Upper bound of the retransmission timeout, also when backing off, in milliseconds.
+    static const double cMaxRetransmitTimeout = 5000.0;
+
+    /// Number of sequence numbers in the window used to detect duplicate inbound packets.
+    static const uint32_t cReceivedWindowSize = 4096;
+
     const char *VariableTypeToStr(NetVariableType type)
     {
         const char *data[] = { "Invalid", "U8", "U16", "U32", "U64", "S8", "S16", "S32", "S64", "F32", "F64", "LLVector3", "LLVector3d",
@@ -162,14 +182,23 @@ namespace ProtocolUtilities
     ,lastHeardSince(0.0)
     ,lastHeardSinceTick(0)
     ,pingId(0)
+    ,ackRoundTripTime(0.0)
+    ,ackRoundTripTimeVariance(0.0)
+    ,retransmitTimeout(cInitialRetransmitTimeout)
+    ,resendWheel(cNumResendWheelSlots)
+    ,bytesInResendQueue(0)
+    ,hasAckRoundTripTime(false)
+    ,receivedWindow(cReceivedWindowSize / 32, 0)
+    ,receivedWindowTop(0)
+    ,maxProcessTime(0.1)
     {
-        receivedSequenceNumbers.clear();
+        ticksPerWheelSlot = std::max<tick_t>(1, (tick_t)(GetCurrentClockFreq() * cResendWheelSlotMsecs / 1000.0));
+        resendWheelPosition = GetCurrentClockTime() / ticksPerWheelSlot;
     }
 
     NetMessageManager::~NetMessageManager()
     {
         ClearMessagePoolMemory();
-        receivedSequenceNumbers.clear();
     }
 
     void NetMessageManager::DumpNetworkMessage(NetMsgID id, NetInMessage *msg)
@@ -251,9 +280,8 @@ namespace ProtocolUtilities
 
 #endif
 
-    void NetMessageManager::HandleInboundBytes(std::vector<uint8_t> &data)
+    void NetMessageManager::HandleInboundBytes(uint8_t *data, size_t numBytes)
     {
-        const size_t numBytes = data.size();
 #ifdef PROFILING
         receivedDatagrams.InsertRecord(1.0);
         receivedDatabytes.InsertRecord(numBytes);
@@ -266,13 +294,12 @@ namespace ProtocolUtilities
             return;
         }
 
-        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(&data[0], numBytes);
+        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(data, numBytes);
 
 #ifdef PROFILING
-        if (receivedSequenceNumbers.size() > 0 && seqNum - lastReceivedSequenceNumber < 16)
-            for(int i = lastReceivedSequenceNumber+1; i < seqNum; ++i)
-                if (receivedSequenceNumbers.find(i) == receivedSequenceNumbers.end())
-                    lostPackets.InsertRecord(1.0);
+        if (receivedWindowTop != 0 && seqNum > receivedWindowTop && seqNum - receivedWindowTop < 16)
+            for(uint32_t i = receivedWindowTop+1; i < seqNum; ++i)
+                lostPackets.InsertRecord(1.0);
 #endif
         lastReceivedSequenceNumber = seqNum;
 
@@ -280,10 +307,8 @@ namespace ProtocolUtilities
         if ((data[0] & NetFlagReliable) != 0)
             QueuePacketACK(seqNum);
 
-        // We need to do pruning of inbound duplicates, so add the sequence number to the set of received sequence numbers, 
-        // and check if we've seen this packet before.
-        pair<set<uint32_t>::iterator, bool> ret = receivedSequenceNumbers.insert(seqNum);
-        if (ret.second == false) 
+        // We need to do pruning of inbound duplicates, so mark the sequence number received, and check if we've seen this packet before.
+        if (!MarkSequenceNumberReceived(seqNum))
         {
 #ifdef PROFILING
             duplicatesReceived.InsertRecord(1.0);
@@ -345,17 +370,46 @@ namespace ProtocolUtilities
         }
     }
 
-    static void FlipBits(std::vector<uint8_t> &data, int numBitsToFlip)
+    bool NetMessageManager::MarkSequenceNumberReceived(uint32_t seqNum)
+    {
+        if (seqNum > receivedWindowTop)
+        {
+            // Slide the window forward, clearing the bits of the sequence numbers that enter it.
+            if (receivedWindowTop == 0 || seqNum - receivedWindowTop >= cReceivedWindowSize)
+                std::fill(receivedWindow.begin(), receivedWindow.end(), 0);
+            else
+                for(uint32_t i = receivedWindowTop + 1; i <= seqNum; ++i)
+                    receivedWindow[(i % cReceivedWindowSize) / 32] &= ~(1u << (i % 32));
+            receivedWindowTop = seqNum;
+        }
+        else if (receivedWindowTop - seqNum >= cReceivedWindowSize)
+            return true; // Older than the window, so we can't tell. Let it through rather than drop a late resend.
+
+        uint32_t &bits = receivedWindow[(seqNum % cReceivedWindowSize) / 32];
+        const uint32_t mask = 1u << (seqNum % 32);
+        if (bits & mask)
+            return false;
+        bits |= mask;
+        return true;
+    }
+
+    void NetMessageManager::ClearReceivedSequenceNumbers()
+    {
+        std::fill(receivedWindow.begin(), receivedWindow.end(), 0);
+        receivedWindowTop = 0;
+    }
+
+    static void FlipBits(uint8_t *data, size_t numBytes, int numBitsToFlip)
     {
         while(numBitsToFlip-- > 0)
         {
-            int idx = rand() % data.size();
+            int idx = rand() % numBytes;
             uint8_t bit = 1 << (rand() % 8);
             data[idx] ^= bit;
         }
     }
 
-    /// Polls the inbound socket until the message queue is empty. Also resends any timed out reliable messages.
+    /// Processes the packets queued by the receive thread until the queue is empty or the time budget is spent. Also resends any timed out reliable messages.
     void NetMessageManager::ProcessMessages()
     {
         PROFILE (NetMessageManager_ProcessMessages);
@@ -365,24 +419,17 @@ namespace ProtocolUtilities
         if (!ResendQueueIsEmpty())
             ProcessResendQueue();
 
-        // Process network messages for max. 0.1 seconds, to prevent lack of rendering/mainloop execution during heavy processing
-        static const double MAX_PROCESS_TIME = 0.1;
-        boost::timer timer;
+        // Process network messages for max. maxProcessTime seconds, to prevent lack of rendering/mainloop execution during heavy processing.
+        // The packets left over stay in the receive ring, and the receive thread keeps reading the socket meanwhile.
+        const tick_t startTime = GetCurrentClockTime();
+        const tick_t maxProcessTicks = (tick_t)(maxProcessTime * GetCurrentClockFreq());
 
         PROFILE(NetMessageManager_WhilePacketsAvailable);
-        while(connection->PacketsAvailable() && timer.elapsed() < MAX_PROCESS_TIME)
+        NetworkConnection::Packet *packet = 0;
+        while((packet = connection->FrontPacket()) != 0)
         {
-            const int cMaxPayload = 2048;
-            std::vector<uint8_t> data(cMaxPayload, 0);
-            int numBytes = connection->ReceiveBytes(&data[0], cMaxPayload);
-            if (numBytes == 0)
-                break;
-
-            data.resize(numBytes);
-
-            tick_t now = GetCurrentClockTime();
-            lastHeardSince = (double)(now - lastHeardSinceTick) / GetCurrentClockFreq() * 1000;
-            lastHeardSinceTick = now;
+            lastHeardSince = (double)(packet->receiveTime - lastHeardSinceTick) / GetCurrentClockFreq() * 1000;
+            lastHeardSinceTick = packet->receiveTime;
 
 #ifdef PROTOCOL_STRESS_TEST
             const int numDuplications = 10;
@@ -390,20 +437,19 @@ namespace ProtocolUtilities
             for(int i = 0; i < numDuplications; ++i)
             {
 #endif
-                HandleInboundBytes(data);
+                HandleInboundBytes(packet->data, packet->numBytes);
 #ifdef PROTOCOL_STRESS_TEST
-                FlipBits(data, (int)ceil(data.size() * bitErrorRate));
+                FlipBits(packet->data, packet->numBytes, (int)ceil(packet->numBytes * bitErrorRate));
             }
 #endif
+            connection->PopPacket();
+
+            if (GetCurrentClockTime() - startTime >= maxProcessTicks)
+                break;
         }
         if (!connection->Open())
             connection.reset();
 
-        // To keep memory footprint down and to defend against memory attacks, keep the list of seen sequence numbers to a fixed size.
-        const size_t cMaxSeqNumMemorySize = 300;
-        while(receivedSequenceNumbers.size() > cMaxSeqNumMemorySize)
-            receivedSequenceNumbers.erase(receivedSequenceNumbers.begin()); // We remove from the front to guarantee the smallest(oldest) are removed first.
-
         // Acknowledge all the new accumulated packets that the server sent as reliable.
         SendPendingACKs();
 
@@ -429,7 +475,7 @@ namespace ProtocolUtilities
     {
         connection->Close();
         ClearMessagePoolMemory();
-        receivedSequenceNumbers.clear();
+        ClearReceivedSequenceNumbers();
     }
 
     NetOutMessage *NetMessageManager::StartNewMessage(NetMsgID id)
@@ -552,12 +598,15 @@ namespace ProtocolUtilities
         for(std::list<NetOutMessage*>::iterator iter = usedMessagePool.begin(); iter != usedMessagePool.end(); ++iter)
             delete *iter;
 
-        for(MessageResendList::iterator iter = messageResendQueue.begin(); iter != messageResendQueue.end(); ++iter)
-            delete iter->second;
+        for(MessageResendMap::iterator iter = messageResendQueue.begin(); iter != messageResendQueue.end(); ++iter)
+            delete iter->second.msg;
 
         unusedMessagePool.clear();
         usedMessagePool.clear();
         messageResendQueue.clear();
+        for(size_t i = 0; i < resendWheel.size(); ++i)
+            resendWheel[i].clear();
+        bytesInResendQueue = 0;
     }
 
     ///\todo Have better delay method for pending ACKs, currently sends everything accumulated just over one frame
@@ -654,63 +703,123 @@ namespace ProtocolUtilities
         FinishMessage(m);
     }
 
-    /// A unary find predicate that looks for a NetOutMessage that has the given desired sequence number in a resendqueue container.
-    class MsgSeqNumMatchPred
-    {
-    public:
-        MsgSeqNumMatchPred(uint32_t seqNum_):seqNum(seqNum_) {}
-
-        bool operator()(const std::pair<time_t, NetOutMessage*> &elem) const { return elem.second && elem.second->GetSequenceNumber() == seqNum; }
-    private:
-        uint32_t seqNum;
-    };
-
     void NetMessageManager::AddMessageToResendQueue(NetOutMessage *msg)
     {
         // Don't add this message to the queue, if it already exists in the queue, i.e. it has already been resent once due to a timeout.
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(msg->GetSequenceNumber()));
+        const uint32_t packetID = msg->GetSequenceNumber();
+        MessageResendMap::iterator it = messageResendQueue.find(packetID);
         if (it != messageResendQueue.end())
         {
             // If the sequence numbers matched but these are different message structs, add the message to unusedMessagePool, it's extraneous.
-            if (it->second != msg)
+            if (it->second.msg != msg)
                 unusedMessagePool.push_back(msg);
             return;
         }
 
-        messageResendQueue.push_back(std::make_pair(time(0), msg));
+        const tick_t timeNow = GetCurrentClockTime();
+        ResendEntry &entry = messageResendQueue[packetID];
+        entry.msg = msg;
+        entry.sendTime = timeNow;
+        entry.deadline = timeNow + (tick_t)(retransmitTimeout * GetCurrentClockFreq() / 1000.0);
+        entry.numResends = 0;
+        bytesInResendQueue += msg->BytesFilled();
+        ScheduleResend(packetID, entry.deadline);
     }
 
     void NetMessageManager::RemoveMessageFromResendQueue(uint32_t packetID)
     {
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(packetID));
+        MessageResendMap::iterator it = messageResendQueue.find(packetID);
+        if (it == messageResendQueue.end())
+            return;
 
-        if (it != messageResendQueue.end())
+        // The ACK of a resent message can't be matched to one of its sends, so only messages sent once are used to measure the round-trip time.
+        if (it->second.numResends == 0)
+            UpdateRetransmitTimeout((double)(GetCurrentClockTime() - it->second.sendTime) / GetCurrentClockFreq() * 1000);
+
+        // The sequence number is left in the timing wheel, and skipped when its slot is processed.
+        bytesInResendQueue -= it->second.msg->BytesFilled();
+        unusedMessagePool.push_back(it->second.msg);
+        messageResendQueue.erase(it);
+    }
+
+    void NetMessageManager::ScheduleResend(uint32_t packetID, tick_t deadline)
+    {
+        // Use the first slot that starts after the deadline, so that the message is due when its slot is processed.
+        u64 slot = deadline / ticksPerWheelSlot + 1;
+        if (slot <= resendWheelPosition)
+            slot = resendWheelPosition + 1;
+        resendWheel[slot % resendWheel.size()].push_back(packetID);
+    }
+
+    void NetMessageManager::UpdateRetransmitTimeout(double rtt)
+    {
+        // Round-trip time estimation as in RFC 6298.
+        if (!hasAckRoundTripTime)
+        {
+            ackRoundTripTime = rtt;
+            ackRoundTripTimeVariance = rtt / 2.0;
+            hasAckRoundTripTime = true;
+        }
+        else
         {
-            unusedMessagePool.push_back(it->second);
-            messageResendQueue.erase(it);
+            ackRoundTripTimeVariance = 0.75 * ackRoundTripTimeVariance + 0.25 * fabs(ackRoundTripTime - rtt);
+            ackRoundTripTime = 0.875 * ackRoundTripTime + 0.125 * rtt;
         }
+
+        retransmitTimeout = std::min(std::max(ackRoundTripTime + 4.0 * ackRoundTripTimeVariance, cMinRetransmitTimeout), cMaxRetransmitTimeout);
     }
 
     void NetMessageManager::ProcessResendQueue()
     {
         PROFILE(NetMessageManager_ProcessResendQueue);
-        const int cTimeoutSeconds = 5;
 
-        const time_t timeNow = time(0);
-        for(MessageResendList::iterator it = messageResendQueue.begin(); it != messageResendQueue.end(); ++it)
+        const tick_t timeNow = GetCurrentClockTime();
+        const u64 currentSlot = timeNow / ticksPerWheelSlot;
+        if (currentSlot <= resendWheelPosition)
+            return;
+
+        // All deadlines are within one turn of the wheel, so after a long pause it is enough to go through each slot once.
+        u64 slot = resendWheelPosition + 1;
+        if (currentSlot - resendWheelPosition > resendWheel.size())
+            slot = currentSlot - resendWheel.size() + 1;
+
+        std::vector<uint32_t> due;
+        for(; slot <= currentSlot; ++slot)
         {
-            if (timeNow - it->first >= cTimeoutSeconds)
+            std::vector<uint32_t> &packetIDs = resendWheel[slot % resendWheel.size()];
+            due.insert(due.end(), packetIDs.begin(), packetIDs.end());
+            packetIDs.clear();
+        }
+        resendWheelPosition = currentSlot;
+
+        for(size_t i = 0; i < due.size(); ++i)
+        {
+            MessageResendMap::iterator it = messageResendQueue.find(due[i]);
+            if (it == messageResendQueue.end())
+                continue; // Acked already.
+
+            ResendEntry &entry = it->second;
+            if (entry.deadline > timeNow)
             {
-                it->first = timeNow;
-                it->second->MarkResend();
-                SendProcessedMessage(it->second);
-                //std::cout << "Resending packet " << it->second->GetSequenceNumber() << std::endl;
+                ScheduleResend(due[i], entry.deadline);
+                continue;
+            }
+
+            // Back off exponentially while the message stays unacked.
+            ++entry.numResends;
+            const double timeout = std::min(retransmitTimeout * (1 << std::min<uint32_t>(entry.numResends, 8)), cMaxRetransmitTimeout);
+            entry.sendTime = timeNow;
+            entry.deadline = timeNow + (tick_t)(timeout * GetCurrentClockFreq() / 1000.0);
+            entry.msg->MarkResend();
+            SendProcessedMessage(entry.msg);
+            ScheduleResend(due[i], entry.deadline);
+            //std::cout << "Resending packet " << due[i] << std::endl;
 #ifdef PROFILING
-                resentPackets.InsertRecord(1.0);
+            resentPackets.InsertRecord(1.0);
 #endif
-            }
         }
     }
+
     void NetMessageManager::ManagePingSends()
     {
         const double interval = 2.0;
@@ -731,14 +840,7 @@ namespace ProtocolUtilities
 
     int NetMessageManager::NumBytesInUnackedReliablePackets() const
     {
-        size_t bytes = 0;
-        MessageResendList::const_iterator it = messageResendQueue.begin();
-        while(it != messageResendQueue.end())
-        {
-            bytes += it->second->BytesFilled();
-            ++it;
-        }
-        return bytes;
+        return bytesInResendQueue;
     }
 }
 
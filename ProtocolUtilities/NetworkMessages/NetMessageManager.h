@@ -5,8 +5,10 @@
 
 #include <list>
 #include <set>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "NetMessage.h"
 #include "EventHistory.h"
@@ -47,10 +49,14 @@ namespace ProtocolUtilities
         /// To tell the manager that building the message is now finished and can be put into the outbound queue, call this.
         void FinishMessage(NetOutMessage *message);
 
-        /// Reads in all inbound UDP messages and processes them forward to the application through the listener.
-        /// Checks and resends any timed out reliable outbound messages. This could be moved into a separate thread, but not that timing specific so not necessary atm.
+        /// Processes the inbound UDP messages received by the network receive thread forward to the application through the listener,
+        /// for at most the time set with SetMaxProcessTime(). Checks and resends any timed out reliable outbound messages.
         void ProcessMessages();
 
+        /// Sets how long ProcessMessages() may process inbound messages per call. The rest stay queued for the next call.
+        /// @param seconds Time in seconds.
+        void SetMaxProcessTime(double seconds) { maxProcessTime = seconds; }
+
         /// Interprets the given byte stream as a message and dumps it contents out to the log. Useful only for diagnostics and such.
         void DumpNetworkMessage(NetMsgID id, NetInMessage *msg);
 
@@ -106,6 +112,15 @@ namespace ProtocolUtilities
         /// How much time has elapsed in milliseconds since we've heard from the server last time.
         double lastHeardSince;
 
+        /// Smoothened round-trip time of reliable messages in milliseconds, measured from the ACKs.
+        double ackRoundTripTime;
+
+        /// Smoothened variance of the round-trip time of reliable messages in milliseconds.
+        double ackRoundTripTimeVariance;
+
+        /// Time in milliseconds after which an unacked reliable message is resent. Adapts to ackRoundTripTime.
+        double retransmitTimeout;
+
         /// Returns number of unacked reliable packets.
         int NumUnackedReliablePackets() const;
 
@@ -129,7 +144,14 @@ namespace ProtocolUtilities
         void SendPendingACKs();
 
         /// Processes a single raw datagram received from the network.
-        void HandleInboundBytes(std::vector<uint8_t> &data);
+        void HandleInboundBytes(uint8_t *data, size_t numBytes);
+
+        /// Marks an inbound sequence number as received.
+        /// @return False if the sequence number had already been received, i.e. the packet is a duplicate.
+        bool MarkSequenceNumberReceived(uint32_t seqNum);
+
+        /// Clears the window of received sequence numbers.
+        void ClearReceivedSequenceNumbers();
 
         /// Processes a received PacketAck message.
         void ProcessPacketACK(NetInMessage *msg);
@@ -165,9 +187,18 @@ namespace ProtocolUtilities
         /// @return True, if the resend queue is empty, false otherwise.
         bool ResendQueueIsEmpty() const { return messageResendQueue.empty(); }
 
-        /// Checks each reliable message in outbound queue and resends any of the if an Ack was not received within a time-out period.
+        /// Resends the reliable messages whose Ack was not received within the retransmission timeout.
         void ProcessResendQueue();
 
+        /// Schedules the resend of a reliable message to the timing wheel.
+        /// @param packetID Sequence number of the message.
+        /// @param deadline Clock time when the message is resent if not acked by then.
+        void ScheduleResend(uint32_t packetID, tick_t deadline);
+
+        /// Updates the round-trip time estimates and the retransmission timeout with a new round-trip time sample.
+        /// @param rtt Round-trip time in milliseconds.
+        void UpdateRetransmitTimeout(double rtt);
+
         /// Manages ping sending.
         void ManagePingSends();
 
@@ -189,10 +220,42 @@ namespace ProtocolUtilities
         /// Packet acks pending to be sent
         std::set<uint32_t> pendingACKs;
 
-        typedef std::list<std::pair<time_t, NetOutMessage*> > MessageResendList;
-        /// A pool of NetOutMessages that are in the outbound queue. Need to keep the unacked reliable messages in
+        /// An unacked reliable message.
+        struct ResendEntry
+        {
+            /// The message.
+            NetOutMessage *msg;
+
+            /// Clock time when the message was last sent.
+            tick_t sendTime;
+
+            /// Clock time when the message is resent if not acked by then.
+            tick_t deadline;
+
+            /// How many times the message has been resent.
+            uint32_t numResends;
+        };
+
+        typedef boost::unordered_map<uint32_t, ResendEntry> MessageResendMap;
+        /// The NetOutMessages that are in the outbound queue, by sequence number. Need to keep the unacked reliable messages in
         /// memory for possible resending.
-        MessageResendList messageResendQueue;
+        MessageResendMap messageResendQueue;
+
+        /// Timing wheel of the resend deadlines. Each slot holds the sequence numbers of the messages due during one slot interval.
+        /// Acked messages are only removed from messageResendQueue, their stale sequence numbers are skipped when the slot is processed.
+        std::vector<std::vector<uint32_t> > resendWheel;
+
+        /// Index of the last processed timing wheel slot, counted from clock time zero.
+        u64 resendWheelPosition;
+
+        /// Length of one timing wheel slot in clock ticks.
+        tick_t ticksPerWheelSlot;
+
+        /// Number of bytes in the unacked reliable messages.
+        size_t bytesInResendQueue;
+
+        /// Whether ackRoundTripTime has been measured yet.
+        bool hasAckRoundTripTime;
 
         /// A running sequence number for outbound messages.
         size_t sequenceNumber;
@@ -201,8 +264,15 @@ namespace ProtocolUtilities
         /// Note that this can go up and down if we receive data out of order (or if we receive spoofed data)
         size_t lastReceivedSequenceNumber;
 
-        /// A set of received messages' sequence numbers.
-        std::set<uint32_t> receivedSequenceNumbers;
+        /// Bitmap of the received sequence numbers in the window (receivedWindowTop - window size, receivedWindowTop].
+        /// Used to drop duplicate inbound packets.
+        std::vector<uint32_t> receivedWindow;
+
+        /// The highest received sequence number, or 0 if none yet.
+        uint32_t receivedWindowTop;
+
+        /// How long ProcessMessages() may process inbound messages per call, in seconds.
+        double maxProcessTime;
 
         /// Timer for sending pings.
         boost::timer pingSendTimer;
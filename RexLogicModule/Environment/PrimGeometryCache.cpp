@@ -0,0 +1,114 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PrimGeometryCache.cpp
+ *  @brief  Cache of meshed prim shapes, meshed by worker threads.
+ */
+
+#include "StableHeaders.h"
+#include "Environment/PrimGeometryCache.h"
+#include "Environment/PrimMesher.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+namespace RexLogic
+{
+
+PrimGeometryCache::PrimGeometryCache(uint num_threads) :
+    generation_(0),
+    completed_(false),
+    stop_(false),
+    hits_(0),
+    misses_(0)
+{
+    if (!num_threads)
+        num_threads = std::max(1, (int)boost::thread::hardware_concurrency() - 1);
+    for(uint i = 0; i < num_threads; ++i)
+        workers_.create_thread(boost::bind(&PrimGeometryCache::Run, this));
+}
+
+PrimGeometryCache::~PrimGeometryCache()
+{
+    {
+        MutexLock lock(mutex_);
+        stop_ = true;
+    }
+    work_available_.notify_all();
+    workers_.join_all();
+}
+
+PrimGeometryCache::ShapeState PrimGeometryCache::Request(const PrimShapeParams& shape, PrimFacesPtr& faces, bool repeat)
+{
+    {
+        MutexLock lock(mutex_);
+        ShapeMap::const_iterator iter = shapes_.find(shape);
+        if (iter != shapes_.end())
+        {
+            if (!repeat)
+                ++hits_;
+            faces = iter->second.faces;
+            return iter->second.state;
+        }
+
+        ++misses_;
+        shapes_[shape] = Entry();
+        queue_.push_back(shape);
+    }
+    work_available_.notify_one();
+    return ShapePending;
+}
+
+bool PrimGeometryCache::TakeCompleted()
+{
+    MutexLock lock(mutex_);
+    bool completed = completed_;
+    completed_ = false;
+    return completed;
+}
+
+void PrimGeometryCache::Clear()
+{
+    MutexLock lock(mutex_);
+    shapes_.clear();
+    queue_.clear();
+    completed_ = false;
+    ++generation_;
+    hits_ = 0;
+    misses_ = 0;
+}
+
+size_t PrimGeometryCache::Size() const
+{
+    MutexLock lock(mutex_);
+    return shapes_.size();
+}
+
+void PrimGeometryCache::Run()
+{
+    for(;;)
+    {
+        ScopedLock lock(mutex_);
+        while(!stop_ && queue_.empty())
+            work_available_.wait(lock);
+        if (stop_)
+            return;
+        PrimShapeParams shape = queue_.front();
+        queue_.pop_front();
+        uint generation = generation_;
+
+        lock.unlock();
+        PrimFacesPtr faces = MeshPrimShape(shape);
+        lock.lock();
+
+        if (generation != generation_)
+            continue;
+        Entry &entry = shapes_[shape];
+        entry.state = faces ? ShapeReady : ShapeFailed;
+        entry.faces = faces;
+        completed_ = true;
+    }
+}
+
+}
@@ -0,0 +1,112 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PrimGeometryCache.h
+ *  @brief  Cache of meshed prim shapes, meshed by worker threads.
+ */
+
+#ifndef incl_RexLogicModule_PrimGeometryCache_h
+#define incl_RexLogicModule_PrimGeometryCache_h
+
+#include "Environment/PrimGeometryUtils.h"
+#include "CoreThread.h"
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <deque>
+
+namespace RexLogic
+{
+    //! Cache of meshed prim shapes, keyed by the shape parameters.
+    /*! Most prims of a region share their shape with many others, so each shape is meshed once and its faces are shared by all
+        the prims that have it. Shapes not in the cache are meshed by a pool of worker threads. The faces are turned into Ogre
+        geometry by the main thread, as the colors, materials and texture mapping are per prim.
+     */
+    class PrimGeometryCache
+    {
+    public:
+        //! State of a shape in the cache
+        enum ShapeState
+        {
+            ShapeReady, ///< The faces are available
+            ShapePending, ///< A worker thread is meshing the shape
+            ShapeFailed ///< The shape could not be meshed
+        };
+
+        //! Starts the worker threads
+        /*! \param num_threads Number of worker threads. 0 uses one thread less than there are hardware threads, but at least one.
+         */
+        explicit PrimGeometryCache(uint num_threads = 0);
+
+        //! Stops the worker threads
+        ~PrimGeometryCache();
+
+        //! Gets the faces of a shape. If the shape is not in the cache, queues it for meshing.
+        /*! \param shape Shape parameters
+            \param faces [out] The faces, if the shape is ready
+            \param repeat True if the shape was already requested for the same prim and was pending, so that the request is not counted as a hit
+            \return State of the shape
+         */
+        ShapeState Request(const PrimShapeParams& shape, PrimFacesPtr& faces, bool repeat = false);
+
+        //! Returns whether shapes have been meshed since the last call
+        bool TakeCompleted();
+
+        //! Removes all the shapes. Shapes being meshed are dropped when done.
+        void Clear();
+
+        //! Number of first requests that found their shape in the cache, ready or pending
+        uint Hits() const { return hits_; }
+
+        //! Number of requests that queued a new shape
+        uint Misses() const { return misses_; }
+
+        //! Number of shapes in the cache
+        size_t Size() const;
+
+    private:
+        PrimGeometryCache(const PrimGeometryCache&);
+        void operator=(const PrimGeometryCache&);
+
+        //! A shape in the cache
+        struct Entry
+        {
+            Entry() : state(ShapePending) {}
+            ShapeState state;
+            PrimFacesPtr faces;
+        };
+
+        typedef boost::unordered_map<PrimShapeParams, Entry, boost::hash<PrimShapeParams> > ShapeMap;
+
+        //! Worker thread main loop
+        void Run();
+
+        //! The shapes. Guarded by mutex_.
+        ShapeMap shapes_;
+
+        //! Shapes waiting for a worker thread. Guarded by mutex_.
+        std::deque<PrimShapeParams> queue_;
+
+        //! Incremented by Clear(), so that the workers drop the shapes they were meshing. Guarded by mutex_.
+        uint generation_;
+
+        //! Whether shapes have been meshed since the last TakeCompleted(). Guarded by mutex_.
+        bool completed_;
+
+        //! Tells the worker threads to exit. Guarded by mutex_.
+        bool stop_;
+
+        mutable Mutex mutex_;
+
+        //! Signaled when shapes are queued
+        Condition work_available_;
+
+        boost::thread_group workers_;
+
+        uint hits_;
+        uint misses_;
+    };
+}
+
+#endif
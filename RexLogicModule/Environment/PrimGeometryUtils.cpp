@@ -50,6 +50,8 @@
 
 #include <Ogre.h>
 
+#include <boost/functional/hash.hpp>
+
 namespace RexLogic
 {
     static Ogre::ManualObject* prim_manual_object = 0;
@@ -82,58 +84,77 @@ namespace RexLogic
         return true;
     }
 
-    Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled)
+    PrimShapeParams::PrimShapeParams(const EC_OpenSimPrim& primitive) :
+        profileCurve(primitive.ProfileCurve.Get()),
+        profileBegin(primitive.ProfileBegin.Get()),
+        profileEnd(primitive.ProfileEnd.Get()),
+        profileHollow(primitive.ProfileHollow.Get()),
+        pathCurve(primitive.PathCurve.Get()),
+        pathBegin(primitive.PathBegin.Get()),
+        pathEnd(primitive.PathEnd.Get()),
+        pathScaleX(primitive.PathScaleX.Get()),
+        pathScaleY(primitive.PathScaleY.Get()),
+        pathShearX(primitive.PathShearX.Get()),
+        pathShearY(primitive.PathShearY.Get()),
+        pathTwist(primitive.PathTwist.Get()),
+        pathTwistBegin(primitive.PathTwistBegin.Get()),
+        pathRadiusOffset(primitive.PathRadiusOffset.Get()),
+        pathTaperX(primitive.PathTaperX.Get()),
+        pathTaperY(primitive.PathTaperY.Get()),
+        pathRevolutions(primitive.PathRevolutions.Get()),
+        pathSkew(primitive.PathSkew.Get())
     {
-        PROFILE(Primitive_CreateGeometry)
-        
-        if (!primitive.HasPrimShapeData)
-            return 0;
-        
-        // Create only a single manual object for prim geometry and reuse it over and over, to avoid Ogre generating
-        // a huge load of unnecessary D3D resources, that are never used for anything visible (the manual object will
-        // be converted to a mesh anyway)
-        if (!prim_manual_object)
-        {
-            OgreRenderer::RendererPtr renderer = framework->GetServiceManager()->GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
-            if (!renderer)
-                return 0;
-            Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
-            prim_manual_object = sceneMgr->createManualObject(renderer->GetUniqueObjectName("Prim"));
-            if (!prim_manual_object)
-                return 0;
-        }
-        
-        std::string mat_override;
-        if ((primitive.Materials[0].Type == RexTypes::RexAT_MaterialScript) && (!RexTypes::IsNull(primitive.Materials[0].asset_id)))
-        {
-            mat_override = primitive.Materials[0].asset_id;
+    }
 
-/* ///\todo Regression. Reimplement using the new Asset API. -jj.
-            // If cannot find the override material, use default
-            // We will probably get resource ready event later for the material & redo this prim
-            boost::shared_ptr<OgreRenderer::Renderer> renderer = framework->GetServiceManager()->
-                GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
-            if (!renderer->GetResource(mat_override, OgreRenderer::OgreMaterialResource::GetTypeStatic()))
-            {
-                mat_override = "LitTextured";
-            }
-*/
-        }
-            
+    bool PrimShapeParams::operator ==(const PrimShapeParams& rhs) const
+    {
+        return profileCurve == rhs.profileCurve && profileBegin == rhs.profileBegin && profileEnd == rhs.profileEnd &&
+            profileHollow == rhs.profileHollow && pathCurve == rhs.pathCurve && pathBegin == rhs.pathBegin && pathEnd == rhs.pathEnd &&
+            pathScaleX == rhs.pathScaleX && pathScaleY == rhs.pathScaleY && pathShearX == rhs.pathShearX && pathShearY == rhs.pathShearY &&
+            pathTwist == rhs.pathTwist && pathTwistBegin == rhs.pathTwistBegin && pathRadiusOffset == rhs.pathRadiusOffset &&
+            pathTaperX == rhs.pathTaperX && pathTaperY == rhs.pathTaperY && pathRevolutions == rhs.pathRevolutions && pathSkew == rhs.pathSkew;
+    }
+
+    size_t hash_value(const PrimShapeParams& shape)
+    {
+        size_t seed = 0;
+        boost::hash_combine(seed, shape.profileCurve);
+        boost::hash_combine(seed, shape.profileBegin);
+        boost::hash_combine(seed, shape.profileEnd);
+        boost::hash_combine(seed, shape.profileHollow);
+        boost::hash_combine(seed, shape.pathCurve);
+        boost::hash_combine(seed, shape.pathBegin);
+        boost::hash_combine(seed, shape.pathEnd);
+        boost::hash_combine(seed, shape.pathScaleX);
+        boost::hash_combine(seed, shape.pathScaleY);
+        boost::hash_combine(seed, shape.pathShearX);
+        boost::hash_combine(seed, shape.pathShearY);
+        boost::hash_combine(seed, shape.pathTwist);
+        boost::hash_combine(seed, shape.pathTwistBegin);
+        boost::hash_combine(seed, shape.pathRadiusOffset);
+        boost::hash_combine(seed, shape.pathTaperX);
+        boost::hash_combine(seed, shape.pathTaperY);
+        boost::hash_combine(seed, shape.pathRevolutions);
+        boost::hash_combine(seed, shape.pathSkew);
+        return seed;
+    }
+
+    PrimFacesPtr MeshPrimShape(const PrimShapeParams& shape)
+    {
         try
         {
-            float profileBegin = primitive.ProfileBegin.Get();
-            float profileEnd = 1.0f - primitive.ProfileEnd.Get();
-            float profileHollow = primitive.ProfileHollow.Get();
+            float profileBegin = shape.profileBegin;
+            float profileEnd = 1.0f - shape.profileEnd;
+            float profileHollow = shape.profileHollow;
 
             int sides = 4;
-            if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_EQUILATERAL_TRIANGLE)
+            if ((shape.profileCurve & 0x07) == RexTypes::SHAPE_EQUILATERAL_TRIANGLE)
                 sides = 3;
-            else if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_CIRCLE)
+            else if ((shape.profileCurve & 0x07) == RexTypes::SHAPE_CIRCLE)
                 // Reduced prim lod!!!
                 sides = 12;
                 //sides = 24;
-            else if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_HALF_CIRCLE)
+            else if ((shape.profileCurve & 0x07) == RexTypes::SHAPE_HALF_CIRCLE)
             {
                 // half circle, prim is a sphere
                 // Reduced prim lod!!!
@@ -145,66 +166,129 @@ namespace RexLogic
             }
 
             int hollowSides = sides;
-            if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_CIRCLE)
+            if ((shape.profileCurve & 0xf0) == RexTypes::HOLLOW_CIRCLE)
                 // Reduced prim lod!!!
                 hollowSides = 12;
                 //hollowSides = 24;
-            else if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_SQUARE)
+            else if ((shape.profileCurve & 0xf0) == RexTypes::HOLLOW_SQUARE)
                 hollowSides = 4;
-            else if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_TRIANGLE)
+            else if ((shape.profileCurve & 0xf0) == RexTypes::HOLLOW_TRIANGLE)
                 hollowSides = 3;
             
             PrimMesher::PrimMesh primMesh(sides, profileBegin, profileEnd, profileHollow, hollowSides);
-            primMesh.topShearX = primitive.PathShearX.Get();
-            primMesh.topShearY = primitive.PathShearY.Get();
-            primMesh.pathCutBegin = primitive.PathBegin.Get();
-            primMesh.pathCutEnd = 1.0f - primitive.PathEnd.Get();
+            primMesh.topShearX = shape.pathShearX;
+            primMesh.topShearY = shape.pathShearY;
+            primMesh.pathCutBegin = shape.pathBegin;
+            primMesh.pathCutEnd = 1.0f - shape.pathEnd;
 
-            if (primitive.PathCurve.Get() == RexTypes::EXTRUSION_STRAIGHT)
+            if (shape.pathCurve == RexTypes::EXTRUSION_STRAIGHT)
             {
-                primMesh.twistBegin = primitive.PathTwistBegin.Get() * 180;
-                primMesh.twistEnd = primitive.PathTwist.Get() * 180;
-                primMesh.taperX = primitive.PathScaleX.Get() - 1.0f;
-                primMesh.taperY = primitive.PathScaleY.Get() - 1.0f;
+                primMesh.twistBegin = shape.pathTwistBegin * 180;
+                primMesh.twistEnd = shape.pathTwist * 180;
+                primMesh.taperX = shape.pathScaleX - 1.0f;
+                primMesh.taperY = shape.pathScaleY - 1.0f;
                 primMesh.ExtrudeLinear();
             }
             else
             {
-                primMesh.holeSizeX = (2.0f - primitive.PathScaleX.Get());
-                primMesh.holeSizeY = (2.0f - primitive.PathScaleY.Get());
-                primMesh.radius = primitive.PathRadiusOffset.Get();
-                primMesh.revolutions = primitive.PathRevolutions.Get();
-                primMesh.skew = primitive.PathSkew.Get();
-                primMesh.twistBegin = primitive.PathTwistBegin.Get() * 360;
-                primMesh.twistEnd = primitive.PathTwist.Get() * 360;
-                primMesh.taperX = primitive.PathTaperX.Get();
-                primMesh.taperY = primitive.PathTaperY.Get();
+                primMesh.holeSizeX = (2.0f - shape.pathScaleX);
+                primMesh.holeSizeY = (2.0f - shape.pathScaleY);
+                primMesh.radius = shape.pathRadiusOffset;
+                primMesh.revolutions = shape.pathRevolutions;
+                primMesh.skew = shape.pathSkew;
+                primMesh.twistBegin = shape.pathTwistBegin * 360;
+                primMesh.twistEnd = shape.pathTwist * 360;
+                primMesh.taperX = shape.pathTaperX;
+                primMesh.taperY = shape.pathTaperY;
                 primMesh.ExtrudeCircular();
             }
             
-            PROFILE(Primitive_CreateManualObject)
-            prim_manual_object->clear();
-            prim_manual_object->setBoundingBox(Ogre::AxisAlignedBox());
-            
             // Check for highly illegal coordinates in any of the faces
             for (int i = 0; i < primMesh.viewerFaces.size(); ++i)
             {
                 if (!(CheckCoord(primMesh.viewerFaces[i].v1) && CheckCoord(primMesh.viewerFaces[i].v2) && CheckCoord(primMesh.viewerFaces[i].v3)))
                 {
                     RexLogicModule::LogError("NaN or infinite number encountered in prim face coordinates. Skipping geometry creation.");
-                    return 0;
+                    return PrimFacesPtr();
                 }
             }
             
+            boost::shared_ptr<PrimFaceVector> faces(new PrimFaceVector);
+            faces->swap(primMesh.viewerFaces);
+            return faces;
+        }
+        catch (Exception& e)
+        {
+            RexLogicModule::LogError(std::string("Exception while creating primitive geometry: ") + e.what());
+            return PrimFacesPtr();
+        }
+    }
+
+    Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled)
+    {
+        if (!primitive.HasPrimShapeData)
+            return 0;
+        
+        PrimFacesPtr faces = MeshPrimShape(PrimShapeParams(primitive));
+        if (!faces)
+            return 0;
+        return CreatePrimGeometry(framework, primitive, *faces, optimisations_enabled);
+    }
+
+    Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, const PrimFaceVector& faces,
+        bool optimisations_enabled)
+    {
+        PROFILE(Primitive_CreateGeometry)
+        
+        if (!primitive.HasPrimShapeData)
+            return 0;
+        
+        // Create only a single manual object for prim geometry and reuse it over and over, to avoid Ogre generating
+        // a huge load of unnecessary D3D resources, that are never used for anything visible (the manual object will
+        // be converted to a mesh anyway)
+        if (!prim_manual_object)
+        {
+            OgreRenderer::RendererPtr renderer = framework->GetServiceManager()->GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
+            if (!renderer)
+                return 0;
+            Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
+            prim_manual_object = sceneMgr->createManualObject(renderer->GetUniqueObjectName("Prim"));
+            if (!prim_manual_object)
+                return 0;
+        }
+        
+        std::string mat_override;
+        if ((primitive.Materials[0].Type == RexTypes::RexAT_MaterialScript) && (!RexTypes::IsNull(primitive.Materials[0].asset_id)))
+        {
+            mat_override = primitive.Materials[0].asset_id;
+
+/* ///\todo Regression. Reimplement using the new Asset API. -jj.
+            // If cannot find the override material, use default
+            // We will probably get resource ready event later for the material & redo this prim
+            boost::shared_ptr<OgreRenderer::Renderer> renderer = framework->GetServiceManager()->
+                GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
+            if (!renderer->GetResource(mat_override, OgreRenderer::OgreMaterialResource::GetTypeStatic()))
+            {
+                mat_override = "LitTextured";
+            }
+*/
+        }
+            
+        try
+        {
+            PROFILE(Primitive_CreateManualObject)
+            prim_manual_object->clear();
+            prim_manual_object->setBoundingBox(Ogre::AxisAlignedBox());
+            
             std::string mat_name;
             std::string prev_mat_name;
             
             uint indices = 0;
             bool first_face = true;
             
-            for (int i = 0; i < primMesh.viewerFaces.size(); ++i)
+            for (int i = 0; i < faces.size(); ++i)
             {
-                int facenum = primMesh.viewerFaces[i].primFaceNumber;
+                int facenum = faces[i].primFaceNumber;
                 
                 Color color = primitive.PrimDefaultColor;
                 ColorMap::const_iterator c = primitive.PrimColors.find(facenum);
@@ -289,17 +373,17 @@ namespace RexLogic
                     }
                 }
                 
-                Ogre::Vector3 pos1(primMesh.viewerFaces[i].v1.X, primMesh.viewerFaces[i].v1.Y, primMesh.viewerFaces[i].v1.Z);
-                Ogre::Vector3 pos2(primMesh.viewerFaces[i].v2.X, primMesh.viewerFaces[i].v2.Y, primMesh.viewerFaces[i].v2.Z);
-                Ogre::Vector3 pos3(primMesh.viewerFaces[i].v3.X, primMesh.viewerFaces[i].v3.Y, primMesh.viewerFaces[i].v3.Z);
+                Ogre::Vector3 pos1(faces[i].v1.X, faces[i].v1.Y, faces[i].v1.Z);
+                Ogre::Vector3 pos2(faces[i].v2.X, faces[i].v2.Y, faces[i].v2.Z);
+                Ogre::Vector3 pos3(faces[i].v3.X, faces[i].v3.Y, faces[i].v3.Z);
 
-                Ogre::Vector3 n1(primMesh.viewerFaces[i].n1.X, primMesh.viewerFaces[i].n1.Y, primMesh.viewerFaces[i].n1.Z);
-                Ogre::Vector3 n2(primMesh.viewerFaces[i].n2.X, primMesh.viewerFaces[i].n2.Y, primMesh.viewerFaces[i].n2.Z);
-                Ogre::Vector3 n3(primMesh.viewerFaces[i].n3.X, primMesh.viewerFaces[i].n3.Y, primMesh.viewerFaces[i].n3.Z);
+                Ogre::Vector3 n1(faces[i].n1.X, faces[i].n1.Y, faces[i].n1.Z);
+                Ogre::Vector3 n2(faces[i].n2.X, faces[i].n2.Y, faces[i].n2.Z);
+                Ogre::Vector3 n3(faces[i].n3.X, faces[i].n3.Y, faces[i].n3.Z);
                 
-                Ogre::Vector2 uv1(primMesh.viewerFaces[i].uv1.U, primMesh.viewerFaces[i].uv1.V);
-                Ogre::Vector2 uv2(primMesh.viewerFaces[i].uv2.U, primMesh.viewerFaces[i].uv2.V);
-                Ogre::Vector2 uv3(primMesh.viewerFaces[i].uv3.U, primMesh.viewerFaces[i].uv3.V);
+                Ogre::Vector2 uv1(faces[i].uv1.U, faces[i].uv1.V);
+                Ogre::Vector2 uv2(faces[i].uv2.U, faces[i].uv2.V);
+                Ogre::Vector2 uv3(faces[i].uv3.U, faces[i].uv3.V);
 
                 TransformUV(uv1, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
                 TransformUV(uv2, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
@@ -5,6 +5,9 @@
 
 #include "RexLogicModuleApi.h"
 
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
 class EC_OpenSimPrim;
 
 namespace Ogre
@@ -12,13 +15,66 @@ namespace Ogre
     class ManualObject;
 }
 
+namespace PrimMesher
+{
+    struct ViewerFace;
+}
+
 namespace RexLogic
 {
+    //! Faces of a meshed prim shape, before the per-face colors, materials and texture mapping are applied
+    typedef std::vector<PrimMesher::ViewerFace> PrimFaceVector;
+    typedef boost::shared_ptr<const PrimFaceVector> PrimFacesPtr;
+
+    //! The shape parameters of a prim. Prims with equal shape parameters have the same faces.
+    struct REXLOGIC_MODULE_API PrimShapeParams
+    {
+        //! Reads the shape parameters of the prim
+        explicit PrimShapeParams(const EC_OpenSimPrim& primitive);
+
+        bool operator ==(const PrimShapeParams& rhs) const;
+        bool operator !=(const PrimShapeParams& rhs) const { return !(*this == rhs); }
+
+        int profileCurve;
+        float profileBegin;
+        float profileEnd;
+        float profileHollow;
+        int pathCurve;
+        float pathBegin;
+        float pathEnd;
+        float pathScaleX;
+        float pathScaleY;
+        float pathShearX;
+        float pathShearY;
+        float pathTwist;
+        float pathTwistBegin;
+        float pathRadiusOffset;
+        float pathTaperX;
+        float pathTaperY;
+        float pathRevolutions;
+        float pathSkew;
+    };
+
+    //! Hash of the shape parameters, for boost::hash
+    REXLOGIC_MODULE_API size_t hash_value(const PrimShapeParams& shape);
+
+    //! Runs the prim mesher for the shape. Does not touch Ogre, so can be called from any thread.
+    /*! \return The faces, or null if the shape could not be meshed
+     */
+    REXLOGIC_MODULE_API PrimFacesPtr MeshPrimShape(const PrimShapeParams& shape);
+
     //! Generates prim geometry into an Ogre manual object from prim parameters and returns it or 0 if something went wrong
     /*! Note that the same manual object is returned for each call, so you should immediately CommitChanges() into an
         EC_OgreCustomObject before calling CreatePrimGeometry again.
      */
     REXLOGIC_MODULE_API Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled = true);
+
+    //! Generates prim geometry into an Ogre manual object from faces already meshed for the prim's shape
+    /*! Applies the per-face colors, materials and texture mapping of the prim. The same manual object is returned for each call,
+        as with the other overload.
+     */
+    REXLOGIC_MODULE_API Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive,
+        const PrimFaceVector& faces, bool optimisations_enabled = true);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -22,6 +22,7 @@
 #include "QuatUtils.h"
 #include "SceneEvents.h"
 #include "Environment/PrimGeometryUtils.h"
+#include "Environment/PrimGeometryCache.h"
 #include "SceneManager.h"
 #include "AudioAPI.h"
 #include "GenericMessageUtils.h"
@@ -48,7 +49,9 @@
 namespace RexLogic
 {
 
-Primitive::Primitive(RexLogicModule *rexlogicmodule) : rexlogicmodule_(rexlogicmodule)
+Primitive::Primitive(RexLogicModule *rexlogicmodule) :
+    rexlogicmodule_(rexlogicmodule),
+    geometry_cache_(new PrimGeometryCache())
 {
 }
 
@@ -60,6 +63,16 @@ void Primitive::Update(f64 frametime)
 {
     // Comment line to disable old freedata messaging system
     // SerializeECsToNetwork();
+
+    // Create the geometry of the prims whose shapes the worker threads have meshed meanwhile
+    if (geometry_cache_->TakeCompleted() && !pending_geometry_.empty())
+    {
+        PROFILE(Primitive_CreatePendingGeometry);
+        // HandlePrimGeometry() removes the prims from the set, so go through a copy
+        std::vector<entity_id_t> pending(pending_geometry_.begin(), pending_geometry_.end());
+        for(size_t i = 0; i < pending.size(); ++i)
+            HandlePrimGeometry(pending[i]);
+    }
 }
 
 Scene::EntityPtr Primitive::GetOrCreatePrimEntity(entity_id_t entityid, const RexUUID &fullid, bool *created)
@@ -1192,16 +1205,7 @@ void Primitive::HandleDrawType(entity_id_t entityid)
         HandlePrimTexturesAndMaterial(entityid);
 
         // Create/update geometry
-        if (prim.HasPrimShapeData)
-        {
-            Ogre::ManualObject* manual = CreatePrimGeometry(rexlogicmodule_->GetFramework(), prim);
-            custom.CommitChanges(manual);
-            
-            Scene::Events::EntityEventData event_data;
-            event_data.entity = entity;
-            EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
-            event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
-        }
+        HandlePrimGeometry(entityid);
     }
 
 /* Regression: Should convert to using the new Particle System asset, instead of the old resource. -jj.
@@ -1246,6 +1250,38 @@ void Primitive::HandleDrawType(entity_id_t entityid)
 */
 }
 
+void Primitive::HandlePrimGeometry(entity_id_t entityid)
+{
+    // A prim still pending has already been counted in the cache statistics
+    bool repeat = pending_geometry_.erase(entityid) > 0;
+
+    Scene::EntityPtr entity = rexlogicmodule_->GetPrimEntity(entityid);
+    if (!entity)
+        return;
+    EC_OpenSimPrim *prim = entity->GetComponent<EC_OpenSimPrim>().get();
+    EC_OgreCustomObject *custom = entity->GetComponent<EC_OgreCustomObject>().get();
+    if (!prim || !custom || prim->DrawType != RexTypes::DRAWTYPE_PRIM || !prim->HasPrimShapeData)
+        return;
+
+    PrimFacesPtr faces;
+    PrimGeometryCache::ShapeState state = geometry_cache_->Request(PrimShapeParams(*prim), faces, repeat);
+    if (state == PrimGeometryCache::ShapePending)
+    {
+        pending_geometry_.insert(entityid);
+        return;
+    }
+    if (state == PrimGeometryCache::ShapeFailed)
+        return;
+
+    Ogre::ManualObject* manual = CreatePrimGeometry(rexlogicmodule_->GetFramework(), *prim, *faces);
+    custom->CommitChanges(manual);
+
+    Scene::Events::EntityEventData event_data;
+    event_data.entity = entity;
+    EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
+    event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
+}
+
 void Primitive::HandlePrimTexturesAndMaterial(entity_id_t entityid)
 {
     Scene::EntityPtr entity = rexlogicmodule_->GetPrimEntity(entityid);
@@ -1771,16 +1807,7 @@ void Primitive::HandleMaterialResourceReady(entity_id_t entityid, Foundation::Re
         if (custom && prim->Materials.size() && res->GetId() == prim->Materials[0].asset_id && prim->Materials[0].Type == RexTypes::RexAT_MaterialScript)
         {
             // Update geometry now that the material exists
-            if (prim->HasPrimShapeData)
-            {
-                Ogre::ManualObject* manual = CreatePrimGeometry(rexlogicmodule_->GetFramework(), *prim);
-                custom->CommitChanges(manual);
-
-                Scene::Events::EntityEventData event_data;
-                event_data.entity = entity;
-                EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
-                event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
-            }
+            HandlePrimGeometry(entityid);
         }
     }
     
@@ -2209,6 +2236,12 @@ void Primitive::HandleLogout()
     pending_rexprimdata_.clear();
     pending_rexfreedata_.clear();
     local_dirty_entities_.clear();
+
+    if (geometry_cache_->Hits() + geometry_cache_->Misses() > 0)
+        RexLogicModule::LogDebug("Prim geometry cache: " + ToString(geometry_cache_->Size()) + " unique shapes, " +
+            ToString(geometry_cache_->Hits()) + " hits, " + ToString(geometry_cache_->Misses()) + " misses");
+    geometry_cache_->Clear();
+    pending_geometry_.clear();
 }
 
 
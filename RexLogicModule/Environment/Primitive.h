@@ -29,6 +29,7 @@ namespace ProtocolUtilities
 namespace RexLogic
 {
     class RexLogicModule;
+    class PrimGeometryCache;
 
     class Primitive : public QObject
     {
@@ -146,6 +147,10 @@ namespace RexLogic
         //! handles changes in drawtype (mesh/prim). also handles particle scripts.
         //! @param entityid Entity id.
         void HandleDrawType(entity_id_t entityid);
+
+        //! creates the geometry of a prim drawn as a prim. If its shape is not meshed yet, the geometry is created in Update() once it is.
+        //! @param entityid Entity id.
+        void HandlePrimGeometry(entity_id_t entityid);
         
         //! Re-binds all the Ogre materials attached to the given prim entity. If the materials haven't yet been loaded in, requests for
         //! those materials are made and the material binding is delayed until the downloads are complete.
@@ -232,6 +237,12 @@ namespace RexLogic
         typedef std::set<entity_id_t> EntityIdSet;
         //! entities with local EC changes
         EntityIdSet local_dirty_entities_;
+
+        //! meshed prim shapes, shared by the prims with the same shape
+        boost::shared_ptr<PrimGeometryCache> geometry_cache_;
+
+        //! prim entities waiting for their shape to be meshed
+        EntityIdSet pending_geometry_;
     };
 }
 #endif
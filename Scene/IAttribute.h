@@ -47,6 +47,15 @@ public:
         Interpolate
     };
 
+    //! Network wire encoding of the attribute value in scene replication updates
+    enum NetworkEncoding
+    {
+        //! Attribute's own binary serialization
+        DefaultEncoding,
+        //! Quantized delta against the value the receiver last got. Only applies to Transform attributes
+        QuantizedEncoding
+    };
+
     //! ButtonInfo structure will contain all information need to create a QPushButtons to ECEditor.
     struct ButtonInfo
     {
@@ -78,7 +87,7 @@ public:
     typedef std::map<int, std::string> EnumDescMap_t;
 
     //! Default constructor.
-    AttributeMetadata() : interpolation(None), designable(true) {}
+    AttributeMetadata() : interpolation(None), networkEncoding(DefaultEncoding), designable(true) {}
 
     //! Constructor.
     /*! \param desc Description.
@@ -97,6 +106,7 @@ public:
         step(step_),
         enums(enum_desc),
         interpolation(interpolation_),
+        networkEncoding(DefaultEncoding),
         designable(designable_)
     {
     }
@@ -125,6 +135,9 @@ public:
     //! Interpolation mode for clients.
     InterpolationMode interpolation;
 
+    //! Network wire encoding for scene replication updates.
+    NetworkEncoding networkEncoding;
+
     //! Mapping of enumeration's signatures (in readable form) and actual values.
     EnumDescMap_t enums;
 
@@ -15,6 +15,7 @@
 #include "Entity.h"
 #include "SceneManager.h"
 #include "EventManager.h"
+#include "SceneDesc.h"
 
 #include <QDomDocument>
 
@@ -167,6 +168,17 @@ bool IComponent::BeginDeserialization(QDomElement& comp_element)
     return false;
 }
 
+bool IComponent::BeginDeserialization(const ComponentDesc &desc)
+{
+    if (desc.typeName == TypeName())
+    {
+        SetName(desc.name);
+        SetNetworkSyncEnabled(ParseString<bool>(desc.sync.toStdString(), true));
+        return true;
+    }
+    return false;
+}
+
 QString IComponent::ReadAttribute(QDomElement& comp_element, const QString &name) const
 {
     QDomElement attribute_element = comp_element.firstChildElement("attribute");
@@ -273,6 +285,27 @@ void IComponent::DeserializeFrom(QDomElement& element, AttributeChange::Type cha
     }
 }
 
+void IComponent::DeserializeFrom(const ComponentDesc &desc, AttributeChange::Type change)
+{
+    if (!IsSerializable())
+        return;
+
+    if (!BeginDeserialization(desc))
+        return;
+
+    // Same as the XML overload: only apply those attribute values which are present in the description.
+    for (uint i = 0; i < attributes_.size(); ++i)
+    {
+        QString name = attributes_[i]->GetNameString().c_str();
+        foreach(const AttributeDesc &a, desc.attributes)
+            if (a.name == name)
+            {
+                attributes_[i]->FromString(a.value.toStdString(), change);
+                break;
+            }
+    }
+}
+
 void IComponent::SerializeToBinary(kNet::DataSerializer& dest) const
 {
     dest.Add<u8>(attributes_.size());
@@ -21,6 +21,7 @@
 
 class QDomDocument;
 class QDomElement;
+struct ComponentDesc;
 
 namespace Foundation { class Framework; }
 
@@ -124,6 +125,12 @@ public:
     */
     virtual void DeserializeFrom(QDomElement& element, AttributeChange::Type change);
 
+    /// Deserializes this component from a component description, read for example from scene XML.
+    /** Like the XML overload, applies only the attribute values present in the description.
+        @param desc The description. Nothing is done if its type name is not the type of this component.
+        @param change Specifies the source of this change. */
+    virtual void DeserializeFrom(const ComponentDesc &desc, AttributeChange::Type change);
+
     //! Serialize attributes to binary
     /*! Note: does not include syncmode, typename or name. These are left for higher-level logic, and
         it depends on the situation if they are needed or not
@@ -284,6 +291,9 @@ protected:
     */
     bool BeginDeserialization(QDomElement& comp_element);
 
+    /// Helper function for starting deserialization from a component description. Same as the XML overload.
+    bool BeginDeserialization(const ComponentDesc &desc);
+
     /// Helper function for getting an attribute from serialized component.
     QString ReadAttribute(QDomElement& comp_element, const QString &name) const;
 
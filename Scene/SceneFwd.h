@@ -21,6 +21,9 @@ namespace Scene
 {
     class Entity;
     class SceneManager;
+    class SceneLoader;
+    class SceneXmlReader;
+    class SceneSnapshot;
 
     typedef boost::shared_ptr<Entity> EntityPtr;
     typedef boost::shared_ptr<SceneManager> ScenePtr;
@@ -32,6 +35,7 @@ namespace Scene
 }
 
 struct SceneDesc;
+struct EntityDesc;
 
 class IComponentFactory;
 class IComponent;
@@ -0,0 +1,408 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneIndex.h"
+#include "Entity.h"
+#include "IComponent.h"
+#include "IAttribute.h"
+#include "EC_Name.h"
+#include "Transform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "MemoryLeakCheck.h"
+
+namespace Scene
+{
+    // Component type and attribute that give the position of an entity. The Scene module does not know EC_Placeable itself
+    static const QString cPlaceableTypeName("EC_Placeable");
+
+    static Attribute<Transform>* GetTransformAttribute(IComponent* placeable)
+    {
+        const AttributeVector& attributes = placeable->GetAttributes();
+        for (uint i = 0; i < attributes.size(); ++i)
+        {
+            Attribute<Transform>* transform = dynamic_cast<Attribute<Transform>*>(attributes[i]);
+            if (transform)
+                return transform;
+        }
+        return 0;
+    }
+
+    // Return the first component of a type in an entity, skipping one that is being removed
+    static IComponent* GetFirstComponent(Entity* entity, const QString &type_name, IComponent* removing)
+    {
+        const Entity::ComponentVector& components = entity->Components();
+        for (uint i = 0; i < components.size(); ++i)
+            if ((components[i].get() != removing) && (components[i]->TypeName() == type_name))
+                return components[i].get();
+        return 0;
+    }
+
+    size_t SceneIndex::CellHash::operator()(const Cell &cell) const
+    {
+        size_t seed = 0;
+        boost::hash_combine(seed, cell.x);
+        boost::hash_combine(seed, cell.y);
+        boost::hash_combine(seed, cell.z);
+        return seed;
+    }
+
+    SceneIndex::SceneIndex(float cellSize) :
+        cellSize_(cellSize)
+    {
+    }
+
+    void SceneIndex::OnComponentAdded(Entity* entity, IComponent* comp)
+    {
+        ++byComponent_[comp->TypeName()][entity->GetId()];
+
+        if (comp->TypeName() == EC_Name::TypeNameStatic())
+            UpdateName(entity, 0);
+        else if (comp->TypeName() == cPlaceableTypeName)
+            UpdatePosition(entity, 0);
+    }
+
+    void SceneIndex::OnComponentRemoved(Entity* entity, IComponent* comp)
+    {
+        std::map<QString, std::map<entity_id_t, uint> >::iterator i = byComponent_.find(comp->TypeName());
+        if (i != byComponent_.end())
+        {
+            std::map<entity_id_t, uint>::iterator j = i->second.find(entity->GetId());
+            if ((j != i->second.end()) && (--j->second == 0))
+            {
+                i->second.erase(j);
+                if (i->second.empty())
+                    byComponent_.erase(i);
+            }
+        }
+
+        if (comp->TypeName() == EC_Name::TypeNameStatic())
+            UpdateName(entity, comp);
+        else if (comp->TypeName() == cPlaceableTypeName)
+            UpdatePosition(entity, comp);
+    }
+
+    void SceneIndex::OnAttributeChanged(IComponent* comp, IAttribute* attribute)
+    {
+        Entity* entity = comp->GetParentEntity();
+        if (!entity)
+            return;
+
+        // Match against the attributes the index follows, so that any other change costs only the two lookups
+        entity_id_t id = entity->GetId();
+        boost::unordered_map<entity_id_t, SpatialEntry>::iterator i = positions_.find(id);
+        if ((i != positions_.end()) && (i->second.transform_ == attribute))
+        {
+            SetPosition(id, attribute, static_cast<Attribute<Transform>*>(attribute)->Get().position);
+            return;
+        }
+        boost::unordered_map<entity_id_t, NameEntry>::iterator j = names_.find(id);
+        if ((j != names_.end()) && (j->second.attribute_ == attribute))
+            UpdateName(entity, 0);
+    }
+
+    void SceneIndex::OnEntityRemoved(entity_id_t id)
+    {
+        std::map<QString, std::map<entity_id_t, uint> >::iterator i = byComponent_.begin();
+        while (i != byComponent_.end())
+        {
+            i->second.erase(id);
+            if (i->second.empty())
+                byComponent_.erase(i++);
+            else
+                ++i;
+        }
+        RemoveName(id);
+        RemovePosition(id);
+    }
+
+    void SceneIndex::OnEntityIdChanged(entity_id_t oldId, entity_id_t newId)
+    {
+        for (std::map<QString, std::map<entity_id_t, uint> >::iterator i = byComponent_.begin(); i != byComponent_.end(); ++i)
+        {
+            std::map<entity_id_t, uint>::iterator j = i->second.find(oldId);
+            if (j != i->second.end())
+            {
+                i->second[newId] = j->second;
+                i->second.erase(j);
+            }
+        }
+
+        boost::unordered_map<entity_id_t, NameEntry>::iterator name = names_.find(oldId);
+        if (name != names_.end())
+        {
+            NameEntry entry = name->second;
+            RemoveName(oldId);
+            names_[newId] = entry;
+            byName_[entry.name_].insert(newId);
+        }
+
+        boost::unordered_map<entity_id_t, SpatialEntry>::iterator pos = positions_.find(oldId);
+        if (pos != positions_.end())
+        {
+            SpatialEntry entry = pos->second;
+            RemovePosition(oldId);
+            SetPosition(newId, entry.transform_, entry.position_);
+        }
+    }
+
+    void SceneIndex::Clear()
+    {
+        byComponent_.clear();
+        byName_.clear();
+        names_.clear();
+        positions_.clear();
+        cells_.clear();
+    }
+
+    void SceneIndex::GetEntitiesWithComponent(const QString &type_name, std::vector<entity_id_t> &result) const
+    {
+        std::map<QString, std::map<entity_id_t, uint> >::const_iterator i = byComponent_.find(type_name);
+        if (i == byComponent_.end())
+            return;
+        result.reserve(result.size() + i->second.size());
+        for (std::map<entity_id_t, uint>::const_iterator j = i->second.begin(); j != i->second.end(); ++j)
+            result.push_back(j->first);
+    }
+
+    entity_id_t SceneIndex::GetEntityByName(const QString &name) const
+    {
+        std::map<QString, std::set<entity_id_t> >::const_iterator i = byName_.find(name);
+        if ((i == byName_.end()) || (i->second.empty()))
+            return 0;
+        return *i->second.begin();
+    }
+
+    SceneIndex::Cell SceneIndex::CellOf(const Vector3df &pos) const
+    {
+        // Clamp so that far away (or non-finite) positions do not overflow, they just end up in the border cells
+        const float limit = 1000000.0f;
+        Cell cell;
+        cell.x = (int)floor(std::max(-limit, std::min(limit, pos.x / cellSize_)));
+        cell.y = (int)floor(std::max(-limit, std::min(limit, pos.y / cellSize_)));
+        cell.z = (int)floor(std::max(-limit, std::min(limit, pos.z / cellSize_)));
+        return cell;
+    }
+
+    template<typename Func> void SceneIndex::ForEachInBox(const Vector3df &min, const Vector3df &max, Func &func) const
+    {
+        Cell minCell = CellOf(min);
+        Cell maxCell = CellOf(max);
+        if ((minCell.x > maxCell.x) || (minCell.y > maxCell.y) || (minCell.z > maxCell.z))
+            return;
+
+        // If the region covers more cells than there are entities, it is cheaper to check every entity
+        double numCells = (double)(maxCell.x - minCell.x + 1) * (maxCell.y - minCell.y + 1) * (maxCell.z - minCell.z + 1);
+        if (numCells > (double)positions_.size())
+        {
+            for (boost::unordered_map<entity_id_t, SpatialEntry>::const_iterator i = positions_.begin(); i != positions_.end(); ++i)
+                func(i->first, i->second.position_);
+            return;
+        }
+
+        Cell cell;
+        for (cell.z = minCell.z; cell.z <= maxCell.z; ++cell.z)
+            for (cell.y = minCell.y; cell.y <= maxCell.y; ++cell.y)
+                for (cell.x = minCell.x; cell.x <= maxCell.x; ++cell.x)
+                {
+                    CellMap::const_iterator i = cells_.find(cell);
+                    if (i == cells_.end())
+                        continue;
+                    for (uint j = 0; j < i->second.size(); ++j)
+                    {
+                        boost::unordered_map<entity_id_t, SpatialEntry>::const_iterator entry = positions_.find(i->second[j]);
+                        func(entry->first, entry->second.position_);
+                    }
+                }
+    }
+
+    // Collects entities within a sphere
+    struct RadiusCollector
+    {
+        RadiusCollector(const Vector3df &center, float radius, std::vector<entity_id_t> &result) :
+            center_(center), radiusSq_(radius * radius), result_(result) {}
+        void operator()(entity_id_t id, const Vector3df &pos)
+        {
+            if (pos.getDistanceFromSQ(center_) <= radiusSq_)
+                result_.push_back(id);
+        }
+        Vector3df center_;
+        float radiusSq_;
+        std::vector<entity_id_t> &result_;
+    };
+
+    // Collects entities within a box
+    struct BoxCollector
+    {
+        BoxCollector(const Vector3df &min, const Vector3df &max, std::vector<entity_id_t> &result) :
+            min_(min), max_(max), result_(result) {}
+        void operator()(entity_id_t id, const Vector3df &pos)
+        {
+            if ((pos.x >= min_.x) && (pos.y >= min_.y) && (pos.z >= min_.z) && (pos.x <= max_.x) && (pos.y <= max_.y) && (pos.z <= max_.z))
+                result_.push_back(id);
+        }
+        Vector3df min_;
+        Vector3df max_;
+        std::vector<entity_id_t> &result_;
+    };
+
+    // Collects entities within a sphere along with their squared distances
+    struct DistanceCollector
+    {
+        DistanceCollector(const Vector3df &center, float radius, std::vector<std::pair<float, entity_id_t> > &result) :
+            center_(center), radiusSq_(radius * radius), result_(result) {}
+        void operator()(entity_id_t id, const Vector3df &pos)
+        {
+            float distanceSq = pos.getDistanceFromSQ(center_);
+            if (distanceSq <= radiusSq_)
+                result_.push_back(std::make_pair(distanceSq, id));
+        }
+        Vector3df center_;
+        float radiusSq_;
+        std::vector<std::pair<float, entity_id_t> > &result_;
+    };
+
+    void SceneIndex::GetEntitiesInRadius(const Vector3df &center, float radius, std::vector<entity_id_t> &result) const
+    {
+        if (radius < 0.0f)
+            return;
+        Vector3df extent(radius, radius, radius);
+        RadiusCollector collector(center, radius, result);
+        ForEachInBox(center - extent, center + extent, collector);
+    }
+
+    void SceneIndex::GetEntitiesInBox(const Vector3df &min, const Vector3df &max, std::vector<entity_id_t> &result) const
+    {
+        BoxCollector collector(min, max, result);
+        ForEachInBox(min, max, collector);
+    }
+
+    void SceneIndex::GetNearestEntities(const Vector3df &center, uint count, std::vector<entity_id_t> &result) const
+    {
+        if ((!count) || (positions_.empty()))
+            return;
+
+        // Grow the search radius until it contains enough entities. Once it does, the nearest ones are guaranteed to be among them
+        std::vector<std::pair<float, entity_id_t> > found;
+        float radius = cellSize_;
+        for (;;)
+        {
+            found.clear();
+            // When the search region is large, ForEachInBox visits every entity, so infinity finds all there is
+            float cellsPerAxis = 2.0f * radius / cellSize_ + 1.0f;
+            if (cellsPerAxis * cellsPerAxis * cellsPerAxis > (float)positions_.size())
+                radius = std::numeric_limits<float>::infinity();
+            Vector3df extent(radius, radius, radius);
+            DistanceCollector collector(center, radius, found);
+            ForEachInBox(center - extent, center + extent, collector);
+            if ((found.size() >= count) || (radius == std::numeric_limits<float>::infinity()))
+                break;
+            radius *= 2.0f;
+        }
+
+        count = std::min(count, (uint)found.size());
+        std::partial_sort(found.begin(), found.begin() + count, found.end());
+        for (uint i = 0; i < count; ++i)
+            result.push_back(found[i].second);
+    }
+
+    void SceneIndex::UpdateName(Entity* entity, IComponent* removing)
+    {
+        entity_id_t id = entity->GetId();
+        EC_Name* nameComp = static_cast<EC_Name*>(GetFirstComponent(entity, EC_Name::TypeNameStatic(), removing));
+        if (!nameComp)
+        {
+            RemoveName(id);
+            return;
+        }
+
+        const QString& name = nameComp->name.Get();
+        boost::unordered_map<entity_id_t, NameEntry>::iterator i = names_.find(id);
+        if ((i != names_.end()) && (i->second.name_ == name))
+        {
+            i->second.attribute_ = &nameComp->name;
+            return;
+        }
+        RemoveName(id);
+        NameEntry entry;
+        entry.attribute_ = &nameComp->name;
+        entry.name_ = name;
+        names_[id] = entry;
+        byName_[name].insert(id);
+    }
+
+    void SceneIndex::UpdatePosition(Entity* entity, IComponent* removing)
+    {
+        IComponent* placeable = GetFirstComponent(entity, cPlaceableTypeName, removing);
+        Attribute<Transform>* transform = placeable ? GetTransformAttribute(placeable) : 0;
+        if (transform)
+            SetPosition(entity->GetId(), transform, transform->Get().position);
+        else
+            RemovePosition(entity->GetId());
+    }
+
+    void SceneIndex::SetPosition(entity_id_t id, IAttribute* transform, const Vector3df &pos)
+    {
+        Cell cell = CellOf(pos);
+        boost::unordered_map<entity_id_t, SpatialEntry>::iterator i = positions_.find(id);
+        if (i != positions_.end())
+        {
+            i->second.transform_ = transform;
+            i->second.position_ = pos;
+            // Moving within the cell is the common case, and only needs the position updated
+            if (i->second.cell_ == cell)
+                return;
+            RemovePosition(id);
+        }
+
+        SpatialEntry entry;
+        entry.transform_ = transform;
+        entry.position_ = pos;
+        entry.cell_ = cell;
+        positions_[id] = entry;
+        cells_[cell].push_back(id);
+    }
+
+    void SceneIndex::RemovePosition(entity_id_t id)
+    {
+        boost::unordered_map<entity_id_t, SpatialEntry>::iterator i = positions_.find(id);
+        if (i == positions_.end())
+            return;
+
+        CellMap::iterator cell = cells_.find(i->second.cell_);
+        if (cell != cells_.end())
+        {
+            std::vector<entity_id_t>& ids = cell->second;
+            std::vector<entity_id_t>::iterator j = std::find(ids.begin(), ids.end(), id);
+            if (j != ids.end())
+            {
+                *j = ids.back();
+                ids.pop_back();
+            }
+            if (ids.empty())
+                cells_.erase(cell);
+        }
+        positions_.erase(i);
+    }
+
+    void SceneIndex::RemoveName(entity_id_t id)
+    {
+        boost::unordered_map<entity_id_t, NameEntry>::iterator i = names_.find(id);
+        if (i == names_.end())
+            return;
+
+        std::map<QString, std::set<entity_id_t> >::iterator j = byName_.find(i->second.name_);
+        if (j != byName_.end())
+        {
+            j->second.erase(id);
+            if (j->second.empty())
+                byName_.erase(j);
+        }
+        names_.erase(i);
+    }
+}
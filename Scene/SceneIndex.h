@@ -0,0 +1,129 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_SceneManager_SceneIndex_h
+#define incl_SceneManager_SceneIndex_h
+
+#include "SceneFwd.h"
+#include "CoreTypes.h"
+#include "Vector3D.h"
+
+#include <QString>
+
+#include <boost/unordered_map.hpp>
+
+#include <map>
+#include <set>
+#include <vector>
+
+class IComponent;
+class IAttribute;
+
+namespace Scene
+{
+    //! Incrementally maintained lookup structures of a scene
+    /*! Indexes entities by component type, by EC_Name name and by EC_Placeable position. SceneManager feeds it from the
+        component added/removed and attribute changed notifications. Attribute changes made with AttributeChange::Disconnected are not
+        followed; the scene loaders signal the final attribute values once the entities are complete.
+        Positions are those of the Transform attribute of the entity's first EC_Placeable, ie. relative to a possible parent.
+        They are kept in a hash grid of cubic cells, so that region queries only visit the cells the region overlaps.
+
+        \ingroup Scene_group
+    */
+    class SceneIndex
+    {
+    public:
+        //! Constructor
+        /*! \param cellSize Spatial grid cell edge length
+         */
+        explicit SceneIndex(float cellSize = 16.0f);
+
+        //! A component has been added to an entity of the scene
+        void OnComponentAdded(Entity* entity, IComponent* comp);
+
+        //! A component is about to be removed from an entity of the scene. The component is still in the entity
+        void OnComponentRemoved(Entity* entity, IComponent* comp);
+
+        //! An attribute of a component in the scene has changed
+        void OnAttributeChanged(IComponent* comp, IAttribute* attribute);
+
+        //! An entity has been removed from the scene
+        void OnEntityRemoved(entity_id_t id);
+
+        //! An entity has changed its id
+        void OnEntityIdChanged(entity_id_t oldId, entity_id_t newId);
+
+        //! Forget all entities
+        void Clear();
+
+        //! Return ids of entities that have a component of the given type, in ascending order
+        void GetEntitiesWithComponent(const QString &type_name, std::vector<entity_id_t> &result) const;
+
+        //! Return id of the entity with the lowest id that has the given EC_Name name, or 0 if none
+        entity_id_t GetEntityByName(const QString &name) const;
+
+        //! Return ids of positioned entities within a distance from a point
+        void GetEntitiesInRadius(const Vector3df &center, float radius, std::vector<entity_id_t> &result) const;
+
+        //! Return ids of positioned entities inside an axis-aligned box
+        void GetEntitiesInBox(const Vector3df &min, const Vector3df &max, std::vector<entity_id_t> &result) const;
+
+        //! Return ids of the positioned entities nearest to a point, nearest first
+        void GetNearestEntities(const Vector3df &center, uint count, std::vector<entity_id_t> &result) const;
+
+    private:
+        //! Integer coordinates of a grid cell
+        struct Cell
+        {
+            int x, y, z;
+            bool operator == (const Cell &rhs) const { return (x == rhs.x) && (y == rhs.y) && (z == rhs.z); }
+        };
+
+        struct CellHash
+        {
+            size_t operator()(const Cell &cell) const;
+        };
+
+        //! Position record of an entity
+        struct SpatialEntry
+        {
+            //! The Transform attribute the position comes from. Never dereferenced, only used for matching
+            IAttribute* transform_;
+            Vector3df position_;
+            Cell cell_;
+        };
+
+        //! Name record of an entity
+        struct NameEntry
+        {
+            //! The name attribute of the EC_Name the name comes from. Never dereferenced, only used for matching
+            IAttribute* attribute_;
+            QString name_;
+        };
+
+        typedef boost::unordered_map<Cell, std::vector<entity_id_t>, CellHash> CellMap;
+
+        Cell CellOf(const Vector3df &pos) const;
+        void UpdateName(Entity* entity, IComponent* removing);
+        void UpdatePosition(Entity* entity, IComponent* removing);
+        void SetPosition(entity_id_t id, IAttribute* transform, const Vector3df &pos);
+        void RemovePosition(entity_id_t id);
+        void RemoveName(entity_id_t id);
+        //! Call func(id, position) for the positioned entities in the cells overlapping a box
+        template<typename Func> void ForEachInBox(const Vector3df &min, const Vector3df &max, Func &func) const;
+
+        //! Grid cell edge length
+        float cellSize_;
+        //! Entities by component type name, with the number of such components each entity has
+        std::map<QString, std::map<entity_id_t, uint> > byComponent_;
+        //! Entities by name
+        std::map<QString, std::set<entity_id_t> > byName_;
+        //! Indexed name of each named entity
+        boost::unordered_map<entity_id_t, NameEntry> names_;
+        //! Positions of entities
+        boost::unordered_map<entity_id_t, SpatialEntry> positions_;
+        //! Positioned entities by grid cell
+        CellMap cells_;
+    };
+}
+
+#endif
@@ -0,0 +1,142 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneLoader.h"
+#include "SceneManager.h"
+#include "SceneXmlReader.h"
+
+#include "Framework.h"
+#include "FrameAPI.h"
+#include "LoggingFunctions.h"
+
+#include <QFile>
+
+#include <boost/bind.hpp>
+
+DEFINE_POCO_LOGGING_FUNCTIONS("SceneLoader")
+
+#include "MemoryLeakCheck.h"
+
+namespace Scene
+{
+    // How many batches the worker thread may parse ahead of the scene
+    static const uint cBatchesAhead = 4;
+
+    SceneLoader::SceneLoader(SceneManager *scene, const QString &filename, bool clearScene, bool useEntityIDsFromFile,
+        AttributeChange::Type change, uint entitiesPerFrame) :
+        QObject(scene),
+        scene_(scene),
+        filename_(filename),
+        clearScene_(clearScene),
+        useEntityIDsFromFile_(useEntityIDsFromFile),
+        change_(change),
+        entitiesPerFrame_(entitiesPerFrame ? entitiesPerFrame : 1),
+        entitiesLoaded_(0),
+        readDone_(false),
+        abort_(false),
+        thread_(boost::bind(&SceneLoader::ReadFile, this))
+    {
+        connect(scene_->GetFramework()->Frame(), SIGNAL(Updated(float)), this, SLOT(Update(float)));
+    }
+
+    SceneLoader::~SceneLoader()
+    {
+        StopThread();
+    }
+
+    void SceneLoader::Cancel()
+    {
+        MutexLock lock(mutex_);
+        abort_ = true;
+        queue_.clear();
+        queueNotFull_.notify_all();
+    }
+
+    void SceneLoader::StopThread()
+    {
+        {
+            MutexLock lock(mutex_);
+            abort_ = true;
+            queueNotFull_.notify_all();
+        }
+        thread_.join();
+    }
+
+    void SceneLoader::ReadFile()
+    {
+        QFile file(filename_);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            MutexLock lock(mutex_);
+            error_ = "Failed to open file " + filename_ + " when loading scene xml.";
+            readDone_ = true;
+            return;
+        }
+
+        SceneXmlReader reader(&file);
+        const size_t maxQueued = entitiesPerFrame_ * cBatchesAhead;
+        EntityDesc desc;
+        while (reader.ReadEntity(desc))
+        {
+            ScopedLock lock(mutex_);
+            while ((queue_.size() >= maxQueued) && (!abort_))
+                queueNotFull_.wait(lock);
+            if (abort_)
+                break;
+            queue_.push_back(desc);
+        }
+
+        MutexLock lock(mutex_);
+        if (reader.HasError())
+            error_ = "Parsing scene XML from " + filename_ + " failed when loading scene xml: " + reader.ErrorString();
+        readDone_ = true;
+    }
+
+    void SceneLoader::Update(float frametime)
+    {
+        QList<EntityDesc> batch;
+        bool done;
+        bool aborted;
+        QString error;
+        {
+            MutexLock lock(mutex_);
+            while ((!queue_.empty()) && ((uint)batch.size() < entitiesPerFrame_))
+            {
+                batch.append(queue_.front());
+                queue_.pop_front();
+            }
+            queueNotFull_.notify_all();
+            done = (readDone_ || abort_) && (queue_.empty());
+            aborted = abort_;
+            error = error_;
+        }
+
+        if (!batch.empty())
+        {
+            // Purge all old entities only once the file has turned out to contain something. Send events for the removal
+            if (clearScene_)
+            {
+                scene_->RemoveAllEntities(true, change_);
+                clearScene_ = false;
+            }
+
+            entitiesLoaded_ += scene_->CreateContentFromXmlDescs(batch, useEntityIDsFromFile_, change_).size();
+            emit Progress(entitiesLoaded_);
+        }
+
+        if (!done)
+            return;
+
+        disconnect(scene_->GetFramework()->Frame(), SIGNAL(Updated(float)), this, SLOT(Update(float)));
+        StopThread();
+        if (!error.isEmpty())
+            LogError(error.toStdString());
+        else if ((clearScene_) && (!aborted))
+            scene_->RemoveAllEntities(true, change_);
+
+        emit Finished(error.isEmpty() && !aborted, entitiesLoaded_);
+        deleteLater();
+    }
+}
@@ -0,0 +1,94 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_SceneManager_SceneLoader_h
+#define incl_SceneManager_SceneLoader_h
+
+#include "SceneFwd.h"
+#include "SceneDesc.h"
+#include "AttributeChangeType.h"
+#include "CoreThread.h"
+
+#include <QObject>
+#include <QString>
+
+#include <deque>
+
+namespace Scene
+{
+    //! Loads a scene XML file in the background, and adds its content to the scene a batch of entities per frame
+    /*! The file is parsed by a worker thread, which stays at most a few batches ahead of the scene. The entities of a batch
+        are created and their EntityCreated and ComponentChanged signals emitted in the main thread on the next frame update,
+        so the scene is coherent per batch: entities may refer to others that are only added by a later batch.
+        Created with SceneManager::LoadSceneXMLAsync. Deletes itself after emitting Finished.
+
+        \ingroup Scene_group
+    */
+    class SceneLoader : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        //! Constructor. Starts loading.
+        /*! \param scene Scene to load to. Becomes the parent of the loader
+            \param filename File name
+            \param clearScene Whether to remove the existing entities before the first batch is added
+            \param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the file
+            \param change Change type that will be used, when removing the old scene, and deserializing the new
+            \param entitiesPerFrame Maximum number of entities to add per frame
+         */
+        SceneLoader(SceneManager *scene, const QString &filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change,
+            uint entitiesPerFrame);
+
+        //! Destructor. Stops the worker thread
+        ~SceneLoader();
+
+    public slots:
+        //! Stops loading. Entities already added stay in the scene. Finished is emitted on the next frame update
+        void Cancel();
+
+        //! Returns the number of entities added so far
+        int EntitiesLoaded() const { return entitiesLoaded_; }
+
+    signals:
+        //! A batch of entities has been added to the scene
+        void Progress(int entitiesLoaded);
+
+        //! Loading has ended
+        /*! \param success False if the file could not be read or parsed completely, or loading was cancelled
+            \param entitiesLoaded Total number of entities added
+         */
+        void Finished(bool success, int entitiesLoaded);
+
+    private slots:
+        //! Adds the next batch of parsed entities to the scene
+        void Update(float frametime);
+
+    private:
+        Q_DISABLE_COPY(SceneLoader);
+
+        //! Worker thread main function. Parses the file into the queue
+        void ReadFile();
+
+        //! Tells the worker thread to stop, and waits for it
+        void StopThread();
+
+        SceneManager *scene_; //!< Scene to load to.
+        QString filename_; //!< File being loaded.
+        bool clearScene_; //!< Whether the scene is still to be cleared before the first batch.
+        bool useEntityIDsFromFile_; //!< Whether to use the entity ids of the file.
+        AttributeChange::Type change_; //!< Change type for the new content.
+        uint entitiesPerFrame_; //!< Batch size.
+        int entitiesLoaded_; //!< Number of entities added so far.
+
+        Mutex mutex_; //!< Guards the members below, which are shared with the worker thread.
+        Condition queueNotFull_; //!< Signaled when entities have been taken from the queue, or the worker is told to stop.
+        std::deque<EntityDesc> queue_; //!< Parsed entities waiting to be added.
+        bool readDone_; //!< Whether the worker thread has finished reading.
+        bool abort_; //!< Whether the worker thread has been told to stop.
+        QString error_; //!< Error description from the worker thread.
+
+        Thread thread_; //!< Worker thread.
+    };
+}
+
+#endif
@@ -8,6 +8,9 @@
 #include "Entity.h"
 #include "SceneEvents.h"
 #include "SceneDesc.h"
+#include "SceneXmlReader.h"
+#include "SceneLoader.h"
+#include "SceneSnapshot.h"
 #include "IComponent.h"
 #include "IAttribute.h"
 #include "EC_Name.h"
@@ -118,6 +121,10 @@ namespace Scene
     
     Scene::EntityPtr SceneManager::GetEntity(const QString& name) const
     {
+        // Entities without EC_Name have an empty name, and those are not indexed
+        if (!name.isEmpty())
+            return GetEntityByName(name);
+        
         EntityMap::const_iterator it = entities_.begin();
         while (it != entities_.end())
         {
@@ -136,17 +143,10 @@ namespace Scene
 
     Scene::EntityPtr SceneManager::GetEntityByName(const QString& name) const
     {
-        EntityMap::const_iterator it = entities_.begin();
-        while(it != entities_.end())
-        {
-            EntityPtr entity = it->second;
-            if (entity->HasComponent(EC_Name::TypeNameStatic()))
-                if (entity->GetComponent<EC_Name>()->name.Get() == name)
-                    return entity;
-            ++it;
-        }
-
-        return Scene::EntityPtr();
+        entity_id_t id = index_.GetEntityByName(name);
+        if (!id)
+            return Scene::EntityPtr();
+        return GetEntity(id);
     }
 
     entity_id_t SceneManager::GetNextFreeId()
@@ -212,9 +212,10 @@ namespace Scene
             RemoveEntity(new_id, AttributeChange::LocalOnly);
         }
         
-        old_entity->SetNewId(old_id);
+        old_entity->SetNewId(new_id);
         entities_.erase(old_id);
         entities_[new_id] = old_entity;
+        index_.OnEntityIdChanged(old_id, new_id);
     }
     
     void SceneManager::RemoveEntity(entity_id_t id, AttributeChange::Type change)
@@ -232,6 +233,7 @@ namespace Scene
             framework_->GetEventManager()->SendEvent(cat_id, Events::EVENT_ENTITY_DELETED, &event_data);
             
             entities_.erase(it);
+            index_.OnEntityRemoved(id);
             // If entity somehow manages to live, at least it doesn't belong to the scene anymore
             del_entity->SetScene(0);
             del_entity.reset();
@@ -257,27 +259,55 @@ namespace Scene
             ++it;
         }
         entities_.clear();
+        index_.Clear();
         if (send_events)
             emit SceneCleared(this);
     }
     
     EntityList SceneManager::GetEntitiesWithComponent(const QString &type_name) const
+    {
+        std::vector<entity_id_t> ids;
+        index_.GetEntitiesWithComponent(type_name, ids);
+        return GetEntitiesById(ids);
+    }
+    
+    EntityList SceneManager::GetEntitiesInRadius(const Vector3df &center, float radius) const
+    {
+        std::vector<entity_id_t> ids;
+        index_.GetEntitiesInRadius(center, radius, ids);
+        return GetEntitiesById(ids);
+    }
+    
+    EntityList SceneManager::GetEntitiesInBox(const Vector3df &min, const Vector3df &max) const
+    {
+        std::vector<entity_id_t> ids;
+        index_.GetEntitiesInBox(min, max, ids);
+        return GetEntitiesById(ids);
+    }
+    
+    EntityList SceneManager::GetNearestEntities(const Vector3df &center, uint count) const
+    {
+        std::vector<entity_id_t> ids;
+        index_.GetNearestEntities(center, count, ids);
+        return GetEntitiesById(ids);
+    }
+    
+    EntityList SceneManager::GetEntitiesById(const std::vector<entity_id_t> &ids) const
     {
         std::list<EntityPtr> entities;
-        EntityMap::const_iterator it = entities_.begin();
-        while(it != entities_.end())
+        for (uint i = 0; i < ids.size(); ++i)
         {
-            EntityPtr entity = it->second;
-            if (entity->HasComponent(type_name))
-                entities.push_back(entity);
-            ++it;
+            EntityMap::const_iterator it = entities_.find(ids[i]);
+            if (it != entities_.end())
+                entities.push_back(it->second);
         }
-
+        
         return entities;
     }
     
     void SceneManager::EmitComponentAdded(Scene::Entity* entity, IComponent* comp, AttributeChange::Type change)
     {
+        index_.OnComponentAdded(entity, comp);
         if (change == AttributeChange::Disconnected)
             return;
         if (change == AttributeChange::Default)
@@ -287,6 +317,7 @@ namespace Scene
     
     void SceneManager::EmitComponentRemoved(Scene::Entity* entity, IComponent* comp, AttributeChange::Type change)
     {
+        index_.OnComponentRemoved(entity, comp);
         if (change == AttributeChange::Disconnected)
             return;
         if (change == AttributeChange::Default)
@@ -298,6 +329,7 @@ namespace Scene
     {
         if ((!comp) || (!attribute) || (change == AttributeChange::Disconnected))
             return;
+        index_.OnAttributeChanged(comp, attribute);
         if (change == AttributeChange::Default)
             change = comp->GetUpdateMode();
         emit AttributeChanged(comp, attribute, change);
@@ -398,6 +430,39 @@ namespace Scene
         return ret;
     }
 
+    QList<Scene::Entity*> SceneManager::GetEntitiesInRadiusRaw(const Vector3df &center, float radius) const
+    {
+        QList<Scene::Entity*> ret;
+
+        EntityList entities = GetEntitiesInRadius(center, radius);
+        foreach(EntityPtr e, entities)
+            ret.append(e.get());
+
+        return ret;
+    }
+
+    QList<Scene::Entity*> SceneManager::GetEntitiesInBoxRaw(const Vector3df &min, const Vector3df &max) const
+    {
+        QList<Scene::Entity*> ret;
+
+        EntityList entities = GetEntitiesInBox(min, max);
+        foreach(EntityPtr e, entities)
+            ret.append(e.get());
+
+        return ret;
+    }
+
+    QList<Scene::Entity*> SceneManager::GetNearestEntitiesRaw(const Vector3df &center, uint count) const
+    {
+        QList<Scene::Entity*> ret;
+
+        EntityList entities = GetNearestEntities(center, count);
+        foreach(EntityPtr e, entities)
+            ret.append(e.get());
+
+        return ret;
+    }
+
     QList<Entity *> SceneManager::LoadSceneXML(const std::string& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change)
     {
         QList<Entity *> ret;
@@ -409,22 +474,24 @@ namespace Scene
             return ret;
         }
 
-        // Set codec to ISO 8859-1 a.k.a. Latin 1
-        QTextStream stream(&file);
-        stream.setCodec("ISO 8859-1");
-        QDomDocument scene_doc("Scene");
-        if (!scene_doc.setContent(stream.readAll()))
-        {
-            LogError("Parsing scene XML from "+ filename + " failed when loading scene xml.");
-            file.close();
+        // Parse the whole file before touching the scene, so that a broken file leaves the scene as it was
+        SceneXmlReader reader(&file);
+        QList<EntityDesc> descs;
+        if (!ReadSceneXml(reader, descs, filename.c_str()))
             return ret;
-        }
+        file.close();
 
         // Purge all old entities. Send events for the removal
         if (clearScene)
             RemoveAllEntities(true, change);
 
-        return CreateContentFromXml(scene_doc, useEntityIDsFromFile, change);
+        return CreateContentFromXmlDescs(descs, useEntityIDsFromFile, change);
+    }
+
+    SceneLoader* SceneManager::LoadSceneXMLAsync(const QString &filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change,
+        uint entitiesPerFrame)
+    {
+        return new SceneLoader(this, filename, clearScene, useEntityIDsFromFile, change, entitiesPerFrame);
     }
 
     QByteArray SceneManager::GetSceneXML(bool gettemporary, bool getlocal) const
@@ -545,36 +612,69 @@ namespace Scene
         }
     }
 
-    QList<Entity *> SceneManager::CreateContentFromXml(const QString &xml,  bool useEntityIDsFromFile, AttributeChange::Type change)
+    QList<Entity *> SceneManager::LoadSceneSnapshot(const std::string& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change)
     {
         QList<Entity *> ret;
-        QString errorMsg;
-        QDomDocument scene_doc("Scene");
-        if (!scene_doc.setContent(xml, false, &errorMsg))
-        {
-            LogError("Parsing scene XML from text failed: " + errorMsg.toStdString());
+        SceneSnapshot snapshot;
+        if (!snapshot.Open(filename.c_str()))
             return ret;
+
+        if (clearScene)
+            RemoveAllEntities(true, change);
+
+        for(uint i = 0; i < snapshot.NumEntities(); ++i)
+        {
+            EntityPtr entity = snapshot.Materialize(i, this, useEntityIDsFromFile);
+            if (entity)
+                ret.append(entity.get());
         }
 
-        return CreateContentFromXml(scene_doc, useEntityIDsFromFile, change);
+        // All entities & components have been loaded. Trigger change for them now.
+        foreach(Entity *entity, ret)
+        {
+            EmitEntityCreated(entity, change);
+            foreach(ComponentPtr comp, entity->Components())
+                comp->ComponentChanged(change);
+        }
+
+        return ret;
     }
 
-    QList<Entity *> SceneManager::CreateContentFromXml(const QDomDocument &xml, bool useEntityIDsFromFile, AttributeChange::Type change)
+    bool SceneManager::SaveSceneSnapshot(const std::string& filename)
     {
-        QList<Entity *> ret;
-        // Check for existence of the scene element before we begin
-        QDomElement scene_elem = xml.firstChildElement("scene");
-        if (scene_elem.isNull())
+        return SceneSnapshot::Write(*this, filename.c_str());
+    }
+
+    QList<Entity *> SceneManager::CreateContentFromXml(const QString &xml,  bool useEntityIDsFromFile, AttributeChange::Type change)
+    {
+        SceneXmlReader reader(xml);
+        QList<EntityDesc> descs;
+        if (!ReadSceneXml(reader, descs, "text"))
+            return QList<Entity *>();
+
+        return CreateContentFromXmlDescs(descs, useEntityIDsFromFile, change);
+    }
+
+    bool SceneManager::ReadSceneXml(SceneXmlReader &reader, QList<EntityDesc> &descs, const QString &source) const
+    {
+        EntityDesc desc;
+        while (reader.ReadEntity(desc))
+            descs.append(desc);
+
+        if (reader.HasError())
         {
-            LogError("Could not find 'scene' element from XML.");
-            return ret;
+            LogError("Parsing scene XML from " + source.toStdString() + " failed: " + reader.ErrorString().toStdString());
+            return false;
         }
+        return true;
+    }
 
-        QDomElement ent_elem = scene_elem.firstChildElement("entity");
-        while (!ent_elem.isNull())
+    QList<Entity *> SceneManager::CreateContentFromXmlDescs(const QList<EntityDesc> &descs, bool useEntityIDsFromFile, AttributeChange::Type change)
+    {
+        QList<Entity *> ret;
+        foreach(const EntityDesc &e, descs)
         {
-            QString id_str = ent_elem.attribute("id");
-            entity_id_t id = !id_str.isEmpty() ? ParseString<entity_id_t>(id_str.toStdString()) : 0;
+            entity_id_t id = !e.id.isEmpty() ? ParseString<entity_id_t>(e.id.toStdString()) : 0;
             if (!useEntityIDsFromFile || id == 0) // If we don't want to use entity IDs from file, or if file doesn't contain one, generate a new one.
                 id = ((id & LocalEntity) != 0) ? GetNextFreeIdLocal() : GetNextFreeId();
 
@@ -586,28 +686,22 @@ namespace Scene
             }
 
             EntityPtr entity = CreateEntity(id);
-            if (entity)
-            {
-                QDomElement comp_elem = ent_elem.firstChildElement("component");
-                while (!comp_elem.isNull())
-                {
-                    QString type_name = comp_elem.attribute("type");
-                    QString name = comp_elem.attribute("name");
-                    ComponentPtr new_comp = entity->GetOrCreateComponent(type_name, name);
-                    if (new_comp)
-                        // Trigger no signal yet when scene is in incoherent state
-                        new_comp->DeserializeFrom(comp_elem, AttributeChange::Disconnected);
-
-                    comp_elem = comp_elem.nextSiblingElement("component");
-                }
-                ret.append(entity.get());
-            }
-            else
+            if (!entity)
             {
                 LogError("SceneManager::CreateContentFromXml: Failed to create entity with id " + QString::number(id).toStdString() + "!");
+                continue;
             }
 
-            ent_elem = ent_elem.nextSiblingElement("entity");
+            foreach(const ComponentDesc &c, e.components)
+            {
+                ComponentPtr comp = entity->GetOrCreateComponent(c.typeName, c.name);
+                if ((!comp) || (!comp->IsSerializable()))
+                    continue;
+
+                // Trigger no signal yet when scene is in incoherent state
+                comp->DeserializeFrom(c, AttributeChange::Disconnected);
+            }
+            ret.append(entity.get());
         }
 
         // Now that we have each entity spawned to the scene, trigger all the signals for EntityCreated/ComponentChanged messages.
@@ -624,6 +718,52 @@ namespace Scene
         return ret;
     }
 
+    QList<Entity *> SceneManager::CreateContentFromXml(const QDomDocument &xml, bool useEntityIDsFromFile, AttributeChange::Type change)
+    {
+        QList<EntityDesc> descs;
+        if (!ReadSceneDom(xml, descs))
+            return QList<Entity *>();
+
+        return CreateContentFromXmlDescs(descs, useEntityIDsFromFile, change);
+    }
+
+    bool SceneManager::ReadSceneDom(const QDomDocument &xml, QList<EntityDesc> &descs) const
+    {
+        // Check for existence of the scene element before we begin
+        QDomElement scene_elem = xml.firstChildElement("scene");
+        if (scene_elem.isNull())
+        {
+            LogError("Could not find 'scene' element from XML.");
+            return false;
+        }
+
+        QDomElement ent_elem = scene_elem.firstChildElement("entity");
+        while (!ent_elem.isNull())
+        {
+            EntityDesc desc(ent_elem.attribute("id"));
+            QDomElement comp_elem = ent_elem.firstChildElement("component");
+            while (!comp_elem.isNull())
+            {
+                ComponentDesc compDesc;
+                compDesc.typeName = comp_elem.attribute("type");
+                compDesc.name = comp_elem.attribute("name");
+                compDesc.sync = comp_elem.attribute("sync");
+                QDomElement attr_elem = comp_elem.firstChildElement("attribute");
+                while (!attr_elem.isNull())
+                {
+                    AttributeDesc attrDesc = { attr_elem.attribute("type"), attr_elem.attribute("name"), attr_elem.attribute("value") };
+                    compDesc.attributes.append(attrDesc);
+                    attr_elem = attr_elem.nextSiblingElement("attribute");
+                }
+                desc.components.append(compDesc);
+                comp_elem = comp_elem.nextSiblingElement("component");
+            }
+            descs.append(desc);
+            ent_elem = ent_elem.nextSiblingElement("entity");
+        }
+        return true;
+    }
+
     QList<Entity *> SceneManager::CreateContentFromBinary(const QString &filename, bool useEntityIDsFromFile, AttributeChange::Type change)
     {
         QList<Entity *> ret;
@@ -658,60 +798,12 @@ namespace Scene
             uint num_entities = source.Read<u32>();
             for (uint i = 0; i < num_entities; ++i)
             {
-                entity_id_t id = source.Read<u32>();
-                if (!useEntityIDsFromFile || id == 0)
-                    id = ((id & LocalEntity) != 0) ? GetNextFreeIdLocal() : GetNextFreeId();
-
-                if (HasEntity(id)) // If the entity we are about to add conflicts in ID with an existing entity in the scene.
-                {
-                    LogDebug("SceneManager::CreateContentFromBinary: Destroying previous entity with id " + QString::number(id).toStdString() + " to avoid conflict with new created entity with the same id.");
-                    LogError("Warning: Invoking buggy behavior: Object with id " + QString::number(id).toStdString() + "might not replicate properly!");
-                    RemoveEntity(id, AttributeChange::Replicate); ///<@todo Consider do we want to always use Replicate
-                }
-
-                EntityPtr entity = CreateEntity(id);
+                EntityPtr entity = CreateEntityFromBinary(source, useEntityIDsFromFile);
                 if (!entity)
                 {
                     std::cout << "Failed to create entity, stopping scene load" << std::endl;
                     return ret; // If entity creation fails, stream desync is more than likely so stop right here
                 }
-                
-                uint num_components = source.Read<u32>();
-                for (uint i = 0; i < num_components; ++i)
-                {
-                    uint type_hash = source.Read<u32>();
-                    QString name = QString::fromStdString(source.ReadString());
-                    bool sync = source.Read<u8>() ? true : false;
-                    uint data_size = source.Read<u32>();
-                    
-                    // Read the component data into a separate byte array, then deserialize from there.
-                    // This way the whole stream should not desync even if something goes wrong
-                    QByteArray comp_bytes;
-                    comp_bytes.resize(data_size);
-                    if (data_size)
-                        source.ReadArray<u8>((u8*)comp_bytes.data(), comp_bytes.size());
-                    
-                    try
-                    {
-                        ComponentPtr new_comp = entity->GetOrCreateComponent(type_hash, name);
-                        if (new_comp)
-                        {
-                            new_comp->SetNetworkSyncEnabled(sync);
-                            if (data_size)
-                            {
-                                DataDeserializer comp_source(comp_bytes.data(), comp_bytes.size());
-                                // Trigger no signal yet when scene is in incoherent state
-                                new_comp->DeserializeFromBinary(comp_source, AttributeChange::Disconnected);
-                            }
-                        }
-                        else
-                            LogError("Failed to load component " + framework_->GetComponentManager()->GetComponentTypeName(type_hash).toStdString());
-                    }
-                    catch (...)
-                    {
-                        LogError("Failed to load component " + framework_->GetComponentManager()->GetComponentTypeName(type_hash).toStdString());
-                    }
-                }
 
                 ret.append(entity.get());
             }
@@ -734,6 +826,72 @@ namespace Scene
         return ret;
     }
 
+    EntityPtr SceneManager::CreateEntityFromBinary(DataDeserializer &source, bool useEntityIDsFromFile)
+    {
+        entity_id_t id = source.Read<u32>();
+        if (!useEntityIDsFromFile || id == 0)
+            id = ((id & LocalEntity) != 0) ? GetNextFreeIdLocal() : GetNextFreeId();
+
+        if (HasEntity(id)) // If the entity we are about to add conflicts in ID with an existing entity in the scene.
+        {
+            LogDebug("SceneManager::CreateContentFromBinary: Destroying previous entity with id " + QString::number(id).toStdString() + " to avoid conflict with new created entity with the same id.");
+            LogError("Warning: Invoking buggy behavior: Object with id " + QString::number(id).toStdString() + "might not replicate properly!");
+            RemoveEntity(id, AttributeChange::Replicate); ///<@todo Consider do we want to always use Replicate
+        }
+
+        EntityPtr entity = CreateEntity(id);
+        if (!entity)
+            return entity;
+        
+        try
+        {
+            uint num_components = source.Read<u32>();
+            for (uint i = 0; i < num_components; ++i)
+            {
+                uint type_hash = source.Read<u32>();
+                QString name = QString::fromStdString(source.ReadString());
+                bool sync = source.Read<u8>() ? true : false;
+                uint data_size = source.Read<u32>();
+                
+                // Deserialize the component data from a separate deserializer.
+                // This way the whole stream should not desync even if something goes wrong
+                if (data_size > source.BytesLeft())
+                    throw Exception("Component data size exceeds the scene data");
+                const char *comp_data = source.CurrentData();
+                source.SkipBytes(data_size);
+                
+                try
+                {
+                    ComponentPtr new_comp = entity->GetOrCreateComponent(type_hash, name);
+                    if (new_comp)
+                    {
+                        new_comp->SetNetworkSyncEnabled(sync);
+                        if (data_size)
+                        {
+                            DataDeserializer comp_source(comp_data, data_size);
+                            // Trigger no signal yet when scene is in incoherent state
+                            new_comp->DeserializeFromBinary(comp_source, AttributeChange::Disconnected);
+                        }
+                    }
+                    else
+                        LogError("Failed to load component " + framework_->GetComponentManager()->GetComponentTypeName(type_hash).toStdString());
+                }
+                catch (...)
+                {
+                    LogError("Failed to load component " + framework_->GetComponentManager()->GetComponentTypeName(type_hash).toStdString());
+                }
+            }
+        }
+        catch (...)
+        {
+            // The stream is corrupt, do not leave the partially loaded entity in the scene
+            RemoveEntity(id, AttributeChange::Disconnected);
+            throw;
+        }
+
+        return entity;
+    }
+
     QList<Entity *> SceneManager::CreateContentFromSceneDesc(const SceneDesc &desc, bool useEntityIDsFromFile, AttributeChange::Type change)
     {
         QList<Entity *> ret;
@@ -7,11 +7,13 @@
 #include "AttributeChangeType.h"
 #include "EntityAction.h"
 #include "ChangeRequest.h"
+#include "SceneIndex.h"
 
 #include <QObject>
 #include <QVariant>
 
 namespace Foundation { class Framework; }
+namespace kNet { class DataDeserializer; }
 
 class SceneAPI;
 
@@ -177,6 +179,15 @@ namespace Scene
         QVariantList GetEntityIdsWithComponent(const QString &type_name) const;
         QList<Scene::Entity*> GetEntitiesWithComponentRaw(const QString &type_name) const;
 
+        //! Returns entities whose EC_Placeable position is within a distance from a point
+        QList<Scene::Entity*> GetEntitiesInRadiusRaw(const Vector3df &center, float radius) const;
+
+        //! Returns entities whose EC_Placeable position is inside an axis-aligned box
+        QList<Scene::Entity*> GetEntitiesInBoxRaw(const Vector3df &min, const Vector3df &max) const;
+
+        //! Returns the entities with EC_Placeable nearest to a point, nearest first
+        QList<Scene::Entity*> GetNearestEntitiesRaw(const Vector3df &center, uint count) const;
+
         void DeleteEntityById(uint id, AttributeChange::Type change = AttributeChange::Default) { RemoveEntity((entity_id_t)id, change); }
 
         Scene::Entity* GetEntityByNameRaw(const QString& name) const;
@@ -186,6 +197,19 @@ namespace Scene
 
         void LoadSceneXMLRaw(const QString &filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change) { LoadSceneXML(filename.toStdString(), clearScene, useEntityIDsFromFile, change); }
 
+        //! Loads the scene from XML in the background, adding a limited number of entities per frame.
+        /*! \param filename File name
+            \param clearScene Do we want to clear the existing scene. It is cleared when the first entities are added.
+            \param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file. 
+                      If the scene contains any previous entities with conflicting IDs, those are removed. If false, the entity IDs from the files are ignored,
+                      and new IDs are generated for the created entities.
+            \param change Change type that will be used, when removing the old scene, and deserializing the new
+            \param entitiesPerFrame Maximum number of entities to add per frame.
+            \return Loader, which signals the progress and deletes itself when finished.
+         */
+        Scene::SceneLoader* LoadSceneXMLAsync(const QString &filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change,
+            uint entitiesPerFrame = 100);
+
         void EmitEntityCreated(Entity *entity, AttributeChange::Type change = AttributeChange::Default);
         void EmitEntityCreatedRaw(QObject *entity, AttributeChange::Type change = AttributeChange::Default);
 
@@ -248,6 +272,25 @@ namespace Scene
         //! \param type_name Type name of the component
         EntityList GetEntitiesWithComponent(const QString &type_name) const;
 
+        //! Return list of entities whose EC_Placeable position is within a distance from a point
+        /*! Positions are those of the Transform attribute, ie. relative to a possible parent.
+            \param center Center of the sphere
+            \param radius Radius of the sphere
+         */
+        EntityList GetEntitiesInRadius(const Vector3df &center, float radius) const;
+
+        //! Return list of entities whose EC_Placeable position is inside an axis-aligned box
+        /*! \param min Minimum corner of the box
+            \param max Maximum corner of the box
+         */
+        EntityList GetEntitiesInBox(const Vector3df &min, const Vector3df &max) const;
+
+        //! Return list of the entities with EC_Placeable nearest to a point, nearest first
+        /*! \param center Point to measure the distance from
+            \param count Maximum number of entities to return
+         */
+        EntityList GetNearestEntities(const Vector3df &center, uint count) const;
+
         //! Emit notification of an attribute changing. Called by IComponent.
         /*! \param comp Component pointer
             \param attribute Attribute pointer
@@ -349,6 +392,24 @@ namespace Scene
          */
         bool SaveSceneBinary(const std::string& filename);
 
+        //! Loads the scene from a snapshot file. See SceneSnapshot for the format.
+        /*! The file is memory-mapped and the entities are created directly from the mapping.
+            \param filename File name
+            \param clearScene Do we want to clear the existing scene.
+            \param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file. 
+                      If the scene contains any previous entities with conflicting IDs, those are removed. If false, the entity IDs from the files are ignored,
+                      and new IDs are generated for the created entities.
+            \param change Change type that will be used, when removing the old scene, and deserializing the new
+            \return List of created entities.
+         */
+        QList<Scene::Entity *> LoadSceneSnapshot(const std::string& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change);
+
+        //! Save the scene to a snapshot file
+        /*! \param filename File name
+            \return true if successful
+         */
+        bool SaveSceneSnapshot(const std::string& filename);
+
         //! Creates scene content from XML.
         /*! \param xml XML document as string.
             \param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file. 
@@ -466,6 +527,8 @@ namespace Scene
     private:
         Q_DISABLE_COPY(SceneManager);
         friend class ::SceneAPI;
+        friend class SceneLoader;
+        friend class SceneSnapshot;
 
         //! default constructor
         SceneManager();
@@ -485,6 +548,24 @@ namespace Scene
         bool viewEnabled_; //!< View enabled -flag.
         bool interpolating_; //!< Currently doing interpolation-flag.
         std::vector<AttributeInterpolation> interpolations_; //!< Running attribute interpolations.
+        SceneIndex index_; //!< Entities by component type, name and position.
+
+        //! Returns the entities of the given ids that exist in the scene.
+        EntityList GetEntitiesById(const std::vector<entity_id_t> &ids) const;
+
+        //! Creates entities from descriptions read from scene XML, and then emits EntityCreated and ComponentChanged for them.
+        QList<Scene::Entity *> CreateContentFromXmlDescs(const QList<EntityDesc> &descs, bool useEntityIDsFromFile, AttributeChange::Type change);
+
+        //! Creates an entity and its components from the format of Entity::SerializeToBinary. Emits no signals.
+        /*! Returns null if the entity could not be created. Throws if the data is invalid.
+         */
+        EntityPtr CreateEntityFromBinary(kNet::DataDeserializer &source, bool useEntityIDsFromFile);
+
+        //! Reads all entity descriptions of scene XML. Returns false, after logging the error, if the XML could not be parsed.
+        bool ReadSceneXml(SceneXmlReader &reader, QList<EntityDesc> &descs, const QString &source) const;
+
+        //! Reads all entity descriptions of a scene XML document. Returns false, after logging the error, if there is no scene element.
+        bool ReadSceneDom(const QDomDocument &xml, QList<EntityDesc> &descs) const;
     };
 }
 
@@ -0,0 +1,224 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneSnapshot.h"
+#include "SceneManager.h"
+#include "Entity.h"
+#include "IComponent.h"
+#include "LoggingFunctions.h"
+
+#include <kNet/DataDeserializer.h>
+#include <kNet/DataSerializer.h>
+
+#include <vector>
+
+DEFINE_POCO_LOGGING_FUNCTIONS("SceneSnapshot")
+
+#include "MemoryLeakCheck.h"
+
+namespace Scene
+{
+    const u32 SceneSnapshot::cMagic = 0x50534e54; // "TNSP"
+    const u32 SceneSnapshot::cVersion = 1;
+
+    static const uint cHeaderSize = 4 * sizeof(u32);
+    static const uint cTableEntrySize = 3 * sizeof(u32);
+    // Upper bound of the serialized size of one component, see Entity::SerializeToBinary
+    static const uint cMaxComponentSize = sizeof(u32) + 256 + sizeof(u8) + sizeof(u32) + 64 * 1024;
+
+    static void AppendU32(QByteArray &dest, u32 value)
+    {
+        for(uint i = 0; i < 4; ++i)
+            dest.append((char)((value >> (i * 8)) & 0xff));
+    }
+
+    SceneSnapshot::SceneSnapshot() :
+        data_(0),
+        size_(0),
+        numEntities_(0)
+    {
+    }
+
+    SceneSnapshot::~SceneSnapshot()
+    {
+        Close();
+    }
+
+    bool SceneSnapshot::Write(const SceneManager &scene, const QString &filename)
+    {
+        const SceneManager::EntityMap &entities = scene.GetEntityMap();
+        std::vector<Entity*> saved;
+        for(SceneManager::EntityMap::const_iterator iter = entities.begin(); iter != entities.end(); ++iter)
+            if ((iter->second) && (!iter->second->IsTemporary()))
+                saved.push_back(iter->second.get());
+
+        QString tempFilename = filename + ".tmp";
+        QFile file(tempFilename);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate))
+        {
+            LogError("Could not open file " + tempFilename.toStdString() + " for writing when saving scene snapshot");
+            return false;
+        }
+
+        QByteArray header;
+        AppendU32(header, cMagic);
+        AppendU32(header, cVersion);
+        AppendU32(header, saved.size());
+        AppendU32(header, 0);
+
+        // Write the entity records after the table first, as their sizes are known only after serializing them
+        QByteArray table;
+        qint64 offset = cHeaderSize + (qint64)saved.size() * cTableEntrySize;
+        bool success = file.write(header) == header.size() && file.seek(offset);
+        QByteArray bytes;
+        for(uint i = 0; (i < saved.size()) && (success); ++i)
+        {
+            bytes.resize(2 * sizeof(u32) + saved[i]->Components().size() * cMaxComponentSize);
+            kNet::DataSerializer dest(bytes.data(), bytes.size());
+            saved[i]->SerializeToBinary(dest);
+            if (offset + dest.BytesFilled() > 0xffffffffLL)
+            {
+                LogError("Scene is too large for a snapshot");
+                success = false;
+                break;
+            }
+
+            AppendU32(table, saved[i]->GetId());
+            AppendU32(table, (u32)offset);
+            AppendU32(table, dest.BytesFilled());
+            success = file.write(bytes.data(), dest.BytesFilled()) == (qint64)dest.BytesFilled();
+            offset += dest.BytesFilled();
+        }
+
+        success = success && file.seek(cHeaderSize) && file.write(table) == table.size();
+        file.close();
+        if (success)
+        {
+            // QFile::rename does not replace an existing file, so keep the old snapshot as a backup until the new one is in place
+            QString backupFilename = filename + ".bak";
+            QFile::remove(backupFilename);
+            bool hadOld = QFile::exists(filename);
+            success = !hadOld || QFile::rename(filename, backupFilename);
+            if (success)
+            {
+                success = QFile::rename(tempFilename, filename);
+                if (!success && hadOld)
+                    QFile::rename(backupFilename, filename);
+                else if (hadOld)
+                    QFile::remove(backupFilename);
+            }
+        }
+        if (!success)
+        {
+            LogError("Failed to write scene snapshot " + filename.toStdString());
+            QFile::remove(tempFilename);
+        }
+        return success;
+    }
+
+    bool SceneSnapshot::Open(const QString &filename)
+    {
+        Close();
+
+        file_.setFileName(filename);
+        if (!file_.open(QIODevice::ReadOnly))
+        {
+            LogError("Failed to open file " + filename.toStdString() + " when loading scene snapshot.");
+            return false;
+        }
+
+        size_ = file_.size();
+        if (size_ >= cHeaderSize)
+            data_ = file_.map(0, size_);
+        if (!data_)
+        {
+            LogError("Failed to map file " + filename.toStdString() + " when loading scene snapshot.");
+            Close();
+            return false;
+        }
+
+        if ((ReadU32(0) != cMagic) || (ReadU32(4) != cVersion))
+        {
+            LogError("File " + filename.toStdString() + " is not a scene snapshot of a supported version.");
+            Close();
+            return false;
+        }
+
+        numEntities_ = ReadU32(8);
+        if (cHeaderSize + (qint64)numEntities_ * cTableEntrySize > size_)
+        {
+            LogError("Scene snapshot " + filename.toStdString() + " is truncated.");
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void SceneSnapshot::Close()
+    {
+        if (data_)
+            file_.unmap(const_cast<uchar*>(data_));
+        file_.close();
+        data_ = 0;
+        size_ = 0;
+        numEntities_ = 0;
+    }
+
+    u32 SceneSnapshot::ReadU32(uint offset) const
+    {
+        const uchar *ptr = data_ + offset;
+        return (u32)ptr[0] | ((u32)ptr[1] << 8) | ((u32)ptr[2] << 16) | ((u32)ptr[3] << 24);
+    }
+
+    entity_id_t SceneSnapshot::EntityId(uint index) const
+    {
+        assert(index < numEntities_);
+        return ReadU32(cHeaderSize + index * cTableEntrySize);
+    }
+
+    int SceneSnapshot::FindEntity(entity_id_t id) const
+    {
+        uint low = 0;
+        uint high = numEntities_;
+        while (low < high)
+        {
+            uint mid = low + (high - low) / 2;
+            entity_id_t midId = EntityId(mid);
+            if (midId == id)
+                return mid;
+            if (midId < id)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return -1;
+    }
+
+    EntityPtr SceneSnapshot::Materialize(uint index, SceneManager *scene, bool useEntityIDsFromFile) const
+    {
+        if (index >= numEntities_)
+            return EntityPtr();
+
+        uint entry = cHeaderSize + index * cTableEntrySize;
+        u32 offset = ReadU32(entry + 4);
+        u32 size = ReadU32(entry + 8);
+        if ((qint64)offset + size > size_)
+        {
+            LogError("Scene snapshot entity " + ToString(EntityId(index)) + " is out of bounds");
+            return EntityPtr();
+        }
+
+        try
+        {
+            kNet::DataDeserializer source((const char*)data_ + offset, size);
+            return scene->CreateEntityFromBinary(source, useEntityIDsFromFile);
+        }
+        catch (...)
+        {
+            LogError("Failed to load scene snapshot entity " + ToString(EntityId(index)));
+            return EntityPtr();
+        }
+    }
+}
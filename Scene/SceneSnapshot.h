@@ -0,0 +1,87 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_SceneManager_SceneSnapshot_h
+#define incl_SceneManager_SceneSnapshot_h
+
+#include "SceneFwd.h"
+#include "CoreTypes.h"
+
+#include <QFile>
+#include <QString>
+
+namespace Scene
+{
+    //! Memory-mapped scene snapshot file
+    /*! The file starts with a header of four u32s: magic, version, entity count and a reserved zero. It is followed by the entity table,
+        one entry of three u32s per entity: id, offset of the entity record from the start of the file, and record size. The table is
+        sorted by id. Entity records are in the format of Entity::SerializeToBinary, ie. each component is a separate blob of
+        IAttribute::ToBinary data. All values are little-endian.
+
+        Opening only maps the file and validates the header and the table, so it takes constant time. Entities are created from the
+        mapping on demand with Materialize, either all of them (SceneManager::LoadSceneSnapshot) or just those that are needed.
+
+        \ingroup Scene_group
+    */
+    class SceneSnapshot
+    {
+    public:
+        //! File identifier
+        static const u32 cMagic;
+        //! Current format version
+        static const u32 cVersion;
+
+        SceneSnapshot();
+
+        //! Destructor. Unmaps the file
+        ~SceneSnapshot();
+
+        //! Writes the non-temporary entities of a scene to a snapshot file
+        /*! The file is first written under a temporary name and then renamed, so an existing snapshot is never left half-written.
+            The old snapshot is renamed to a .bak file for the moment between the two renames, and restored if the second one fails.
+            \return true if successful
+         */
+        static bool Write(const SceneManager &scene, const QString &filename);
+
+        //! Maps a snapshot file. Closes the previously opened one
+        /*! \return true if the file is a valid snapshot
+         */
+        bool Open(const QString &filename);
+
+        //! Unmaps the file
+        void Close();
+
+        //! Returns true if a snapshot is open
+        bool IsOpen() const { return data_ != 0; }
+
+        //! Returns the number of entities in the snapshot
+        uint NumEntities() const { return numEntities_; }
+
+        //! Returns the id of an entity in the snapshot. Entities are in ascending id order
+        entity_id_t EntityId(uint index) const;
+
+        //! Returns the index of the entity with the given id, or -1 if the snapshot has no such entity
+        int FindEntity(entity_id_t id) const;
+
+        //! Creates an entity and its components from the snapshot. Emits no signals; that is left to the caller
+        /*! \param index Index of the entity
+            \param scene Scene to create the entity in
+            \param useEntityIDsFromFile If true, the entity will use the id from the snapshot, and a conflicting entity is removed.
+                      If false, a new id is generated.
+            \return The entity, or null if the record was invalid
+         */
+        EntityPtr Materialize(uint index, SceneManager *scene, bool useEntityIDsFromFile) const;
+
+    private:
+        Q_DISABLE_COPY(SceneSnapshot);
+
+        //! Reads a u32 at an offset of the mapping
+        u32 ReadU32(uint offset) const;
+
+        QFile file_; //!< Mapped file.
+        const uchar *data_; //!< Start of the mapping, or null if not open.
+        qint64 size_; //!< Size of the mapping.
+        uint numEntities_; //!< Number of entities.
+    };
+}
+
+#endif
@@ -0,0 +1,160 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneXmlReader.h"
+
+#include <QIODevice>
+
+#include "MemoryLeakCheck.h"
+
+namespace Scene
+{
+    // Number of characters fed to the parser at a time
+    static const qint64 cChunkSize = 64 * 1024;
+
+    SceneXmlReader::SceneXmlReader(QIODevice *device) :
+        stream_(device),
+        inScene_(false),
+        finished_(false)
+    {
+        // Set codec to ISO 8859-1 a.k.a. Latin 1
+        stream_.setCodec("ISO 8859-1");
+    }
+
+    SceneXmlReader::SceneXmlReader(const QString &xml) :
+        inScene_(false),
+        finished_(false)
+    {
+        xml_.addData(xml);
+    }
+
+    QXmlStreamReader::TokenType SceneXmlReader::ReadNext()
+    {
+        for(;;)
+        {
+            QXmlStreamReader::TokenType token = xml_.readNext();
+            if (token != QXmlStreamReader::Invalid)
+                return token;
+
+            // Out of input: feed the next chunk and continue where the parser left off
+            if ((xml_.error() == QXmlStreamReader::PrematureEndOfDocumentError) && (stream_.device()) && (!stream_.atEnd()))
+            {
+                xml_.addData(stream_.read(cChunkSize));
+                continue;
+            }
+
+            if (xml_.error() == QXmlStreamReader::PrematureEndOfDocumentError && inScene_)
+                error_ = "Unexpected end of scene XML";
+            else if (xml_.error() != QXmlStreamReader::PrematureEndOfDocumentError)
+                error_ = xml_.errorString() + " at line " + QString::number(xml_.lineNumber());
+            finished_ = true;
+            return token;
+        }
+    }
+
+    void SceneXmlReader::SkipElement()
+    {
+        int depth = 1;
+        while (depth > 0)
+        {
+            QXmlStreamReader::TokenType token = ReadNext();
+            if (token == QXmlStreamReader::Invalid)
+                return;
+            if (token == QXmlStreamReader::StartElement)
+                ++depth;
+            else if (token == QXmlStreamReader::EndElement)
+                --depth;
+        }
+    }
+
+    void SceneXmlReader::ReadComponent(ComponentDesc &desc)
+    {
+        QXmlStreamAttributes attributes = xml_.attributes();
+        desc.typeName = attributes.value("type").toString();
+        desc.name = attributes.value("name").toString();
+        desc.sync = attributes.value("sync").toString();
+
+        for(;;)
+        {
+            QXmlStreamReader::TokenType token = ReadNext();
+            if ((token == QXmlStreamReader::Invalid) || (token == QXmlStreamReader::EndElement))
+                return;
+            if (token != QXmlStreamReader::StartElement)
+                continue;
+
+            if (xml_.name() == "attribute")
+            {
+                QXmlStreamAttributes attrAttributes = xml_.attributes();
+                AttributeDesc attrDesc;
+                attrDesc.typeName = attrAttributes.value("type").toString();
+                attrDesc.name = attrAttributes.value("name").toString();
+                attrDesc.value = attrAttributes.value("value").toString();
+                desc.attributes.append(attrDesc);
+            }
+            SkipElement();
+        }
+    }
+
+    bool SceneXmlReader::ReadEntity(EntityDesc &desc)
+    {
+        while (!finished_)
+        {
+            QXmlStreamReader::TokenType token = ReadNext();
+            if (token == QXmlStreamReader::Invalid)
+                break;
+
+            if (token == QXmlStreamReader::EndElement)
+            {
+                // End of the scene element. Anything after it is ignored
+                if (inScene_)
+                    finished_ = true;
+                continue;
+            }
+            if (token != QXmlStreamReader::StartElement)
+                continue;
+
+            if (!inScene_)
+            {
+                if (xml_.name() != "scene")
+                {
+                    error_ = "Could not find 'scene' element from XML.";
+                    finished_ = true;
+                    break;
+                }
+                inScene_ = true;
+                continue;
+            }
+
+            if (xml_.name() != "entity")
+            {
+                SkipElement();
+                continue;
+            }
+
+            desc = EntityDesc(xml_.attributes().value("id").toString());
+            for(;;)
+            {
+                token = ReadNext();
+                if ((token == QXmlStreamReader::Invalid) || (token == QXmlStreamReader::EndElement))
+                    break;
+                if (token != QXmlStreamReader::StartElement)
+                    continue;
+                if (xml_.name() == "component")
+                {
+                    ComponentDesc compDesc;
+                    ReadComponent(compDesc);
+                    desc.components.append(compDesc);
+                }
+                else
+                    SkipElement();
+            }
+            return token != QXmlStreamReader::Invalid;
+        }
+
+        if ((!inScene_) && (error_.isEmpty()))
+            error_ = "Could not find 'scene' element from XML.";
+        return false;
+    }
+}
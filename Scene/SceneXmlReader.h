@@ -0,0 +1,63 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_SceneManager_SceneXmlReader_h
+#define incl_SceneManager_SceneXmlReader_h
+
+#include "SceneDesc.h"
+
+#include <QXmlStreamReader>
+#include <QTextStream>
+#include <QString>
+
+class QIODevice;
+
+namespace Scene
+{
+    //! Reads entity descriptions one at a time from Naali scene XML, without building a document of the whole scene
+    /*! The input is decoded as ISO 8859-1, like the DOM based loader does, and fed to the parser in chunks,
+        so memory use does not depend on the size of the scene. Does not touch any scene, so it can be used in a worker thread.
+
+        \ingroup Scene_group
+    */
+    class SceneXmlReader
+    {
+    public:
+        //! Constructor. Reads from a device, which must be open and stay alive as long as the reader
+        explicit SceneXmlReader(QIODevice *device);
+
+        //! Constructor. Reads from scene XML in memory
+        explicit SceneXmlReader(const QString &xml);
+
+        //! Reads the next entity of the scene
+        /*! \param desc Entity description to fill. Components contain the attributes as they are in the XML, ie. only those present
+            \return True if an entity was read, false at the end of the scene or on error
+         */
+        bool ReadEntity(EntityDesc &desc);
+
+        //! Returns true if the XML could not be parsed, or did not contain a scene
+        bool HasError() const { return !error_.isEmpty(); }
+
+        //! Returns description of the error
+        const QString &ErrorString() const { return error_; }
+
+    private:
+        Q_DISABLE_COPY(SceneXmlReader);
+
+        //! Returns the next token, feeding more input to the parser as needed
+        QXmlStreamReader::TokenType ReadNext();
+
+        //! Skips the rest of the current element
+        void SkipElement();
+
+        //! Reads a component element
+        void ReadComponent(ComponentDesc &desc);
+
+        QTextStream stream_; //!< Input stream, when reading from a device.
+        QXmlStreamReader xml_; //!< Parser.
+        bool inScene_; //!< Whether the scene element has been entered.
+        bool finished_; //!< Whether the end of the scene, or an error, has been reached.
+        QString error_; //!< Error description.
+    };
+}
+
+#endif
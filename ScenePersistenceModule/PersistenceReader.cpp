@@ -0,0 +1,193 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PersistenceReader.cpp
+ *  @brief  Restores a scene from the persistence database.
+ */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "PersistenceReader.h"
+#include "LoggingFunctions.h"
+
+#include "Entity.h"
+#include "Framework.h"
+#include "SceneManager.h"
+#include "IComponent.h"
+#include "IAttribute.h"
+#include "ComponentManager.h"
+#include "SceneDesc.h"
+
+#include "sqlite3.h"
+#include "kNet.h"
+
+#include <map>
+
+#include "MemoryLeakCheck.h"
+
+DEFINE_POCO_LOGGING_FUNCTIONS("ScenePersistence")
+
+namespace
+{
+    /// Stored attributes of the components with dynamic structure, whose attributes only exist once they have been deserialized.
+    typedef std::map<IComponent *, ComponentDesc> DynamicComponentMap;
+
+    QString ColumnText(sqlite3_stmt *statement, int column)
+    {
+        const char *text = (const char *)sqlite3_column_text(statement, column);
+        return text ? QString(text) : QString();
+    }
+
+    entity_id_t ColumnEntityId(sqlite3_stmt *statement)
+    {
+        return (entity_id_t)sqlite3_column_int64(statement, 0);
+    }
+}
+
+QList<Scene::Entity *> PersistenceReader::Restore(const QString &filename, Scene::SceneManager *scene, AttributeChange::Type change)
+{
+    PROFILE(PersistenceReader_Restore);
+
+    QList<Scene::Entity *> ret;
+    assert(scene);
+
+    sqlite3 *db = 0;
+    if (sqlite3_open_v2(filename.toStdString().c_str(), &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        LogError("Failed to open persistence database " + filename.toStdString() + ": " + sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return ret;
+    }
+
+    // Attributes are read in the order of the unique index on their key, so the database does not need to sort them.
+    const char selectEntities[] = "SELECT id FROM entities ORDER BY id";
+    const char selectComponents[] = "SELECT entityID, compTypename, compName, networkSyncEnabled FROM components ORDER BY entityID";
+    const char selectAttributes[] = "SELECT entityID, compTypename, compName, attrName, attrType, attrValue FROM attributes "
+        "ORDER BY entityID, compTypename, compName, attrName";
+
+    sqlite3_stmt *entityStatement = 0;
+    sqlite3_stmt *componentStatement = 0;
+    sqlite3_stmt *attributeStatement = 0;
+    if (sqlite3_prepare_v2(db, selectEntities, -1, &entityStatement, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, selectComponents, -1, &componentStatement, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, selectAttributes, -1, &attributeStatement, NULL) != SQLITE_OK)
+    {
+        LogError("Failed to read persistence database " + filename.toStdString() + ": " + sqlite3_errmsg(db));
+        sqlite3_finalize(entityStatement);
+        sqlite3_finalize(componentStatement);
+        sqlite3_finalize(attributeStatement);
+        sqlite3_close(db);
+        return ret;
+    }
+
+    // Read all three tables from the same snapshot of the database
+    sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+
+    ComponentManagerPtr compMgr = scene->GetFramework()->GetComponentManager();
+    int componentRow = sqlite3_step(componentStatement);
+    int attributeRow = sqlite3_step(attributeStatement);
+    while (sqlite3_step(entityStatement) == SQLITE_ROW)
+    {
+        entity_id_t id = ColumnEntityId(entityStatement);
+
+        // Skip rows left over from entities that no longer exist
+        while (componentRow == SQLITE_ROW && ColumnEntityId(componentStatement) < id)
+            componentRow = sqlite3_step(componentStatement);
+        while (attributeRow == SQLITE_ROW && ColumnEntityId(attributeStatement) < id)
+            attributeRow = sqlite3_step(attributeStatement);
+
+        if (scene->HasEntity(id)) // If the entity we are about to add conflicts in ID with an existing entity in the scene, delete the old entity.
+        {
+            LogDebug("PersistenceReader::Restore: Destroying previous entity with id " + ToString(id) + " to avoid conflict with restored entity with the same id.");
+            scene->RemoveEntity(id, AttributeChange::Replicate);
+        }
+
+        Scene::EntityPtr entity = scene->CreateEntity(id);
+        if (!entity)
+        {
+            LogError("PersistenceReader::Restore: Failed to create entity with id " + ToString(id) + "!");
+            continue;
+        }
+
+        for(; componentRow == SQLITE_ROW && ColumnEntityId(componentStatement) == id; componentRow = sqlite3_step(componentStatement))
+            entity->GetOrCreateComponent(ColumnText(componentStatement, 1), ColumnText(componentStatement, 2), AttributeChange::Default,
+                sqlite3_column_int(componentStatement, 3) != 0);
+
+        DynamicComponentMap dynamicComponents;
+        for(; attributeRow == SQLITE_ROW && ColumnEntityId(attributeStatement) == id; attributeRow = sqlite3_step(attributeStatement))
+        {
+            ComponentPtr comp = entity->GetOrCreateComponent(ColumnText(attributeStatement, 1), ColumnText(attributeStatement, 2));
+            if (!comp)
+                continue;
+
+            QString attrName = ColumnText(attributeStatement, 3);
+            kNet::DataDeserializer source((const char *)sqlite3_column_blob(attributeStatement, 5), sqlite3_column_bytes(attributeStatement, 5));
+            try
+            {
+                if (comp->HasDynamicStructure())
+                {
+                    // Decode into a temporary attribute of the stored type, the component creates its own from the string value
+                    AttributeDesc attrDesc;
+                    attrDesc.name = attrName;
+                    attrDesc.typeName = ColumnText(attributeStatement, 4);
+                    IAttribute *temp = compMgr->CreateAttribute(0, attrDesc.typeName.toStdString(), attrName.toStdString());
+                    if (!temp)
+                        continue;
+                    try
+                    {
+                        temp->FromBinary(source, AttributeChange::Disconnected);
+                        attrDesc.value = QString::fromStdString(temp->ToString());
+                    }
+                    catch(...)
+                    {
+                        delete temp;
+                        throw;
+                    }
+                    delete temp;
+                    ComponentDesc &compDesc = dynamicComponents[comp.get()];
+                    if (compDesc.typeName.isEmpty())
+                    {
+                        compDesc.typeName = comp->TypeName();
+                        compDesc.name = comp->Name();
+                        compDesc.sync = QString::fromStdString(ToString<bool>(comp->GetNetworkSyncEnabled()));
+                    }
+                    compDesc.attributes.append(attrDesc);
+                }
+                else
+                {
+                    IAttribute *attribute = comp->GetAttribute(attrName);
+                    if (attribute)
+                        // Trigger no signal yet when scene is in incoherent state
+                        attribute->FromBinary(source, AttributeChange::Disconnected);
+                }
+            }
+            catch(...)
+            {
+                LogError("PersistenceReader::Restore: Failed to decode attribute " + attrName.toStdString() + " of entity " + ToString(id));
+            }
+        }
+        // Trigger no signal yet when scene is in incoherent state
+        for(DynamicComponentMap::const_iterator iter = dynamicComponents.begin(); iter != dynamicComponents.end(); ++iter)
+            iter->first->DeserializeFrom(iter->second, AttributeChange::Disconnected);
+
+        ret.append(entity.get());
+    }
+
+    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+    sqlite3_finalize(entityStatement);
+    sqlite3_finalize(componentStatement);
+    sqlite3_finalize(attributeStatement);
+    sqlite3_close(db);
+
+    // All entities & components have been restored. Trigger change for them now.
+    foreach(Scene::Entity *entity, ret)
+    {
+        scene->EmitEntityCreated(entity, change);
+        foreach(ComponentPtr comp, entity->Components())
+            comp->ComponentChanged(change);
+    }
+
+    LogInfo("Restored " + ToString(ret.size()) + " entities from " + filename.toStdString());
+    return ret;
+}
@@ -0,0 +1,35 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PersistenceReader.h
+ *  @brief  Restores a scene from the persistence database.
+ */
+
+#ifndef incl_ScenePersistenceModule_PersistenceReader_h
+#define incl_ScenePersistenceModule_PersistenceReader_h
+
+#include "SceneFwd.h"
+#include "AttributeChangeType.h"
+
+#include <QList>
+#include <QString>
+
+/// Restores a scene from the database written by PersistenceWriter.
+/** The entities, components and attributes tables are each read with one SELECT ordered by entity id, and the three results are
+    merged entity by entity. Attribute values are decoded from the stored binary form directly into the attributes.
+*/
+class PersistenceReader
+{
+public:
+    /// Creates the entities stored in a persistence database into a scene.
+    /** The entities keep their stored ids, as the database refers to them by id. Existing entities with the same ids are removed.
+        EntityCreated and ComponentChanged are emitted once all entities have been created.
+        @param filename Database file.
+        @param scene Scene to create the entities in.
+        @param change Change type for the signals.
+        @return The created entities, or an empty list if the database could not be read.
+    */
+    static QList<Scene::Entity *> Restore(const QString &filename, Scene::SceneManager *scene, AttributeChange::Type change);
+};
+
+#endif
@@ -0,0 +1,456 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PersistenceWriter.cpp
+ *  @brief  Write-behind queue that stores scene changes to the persistence database from a worker thread.
+ */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "PersistenceWriter.h"
+#include "LoggingFunctions.h"
+
+#include "sqlite3.h"
+
+#include <boost/bind.hpp>
+
+#include "MemoryLeakCheck.h"
+
+DEFINE_POCO_LOGGING_FUNCTIONS("ScenePersistence")
+
+/// Number of queued changes after which they are committed without waiting for the flush interval.
+static const size_t cMaxQueuedChanges = 10000;
+
+bool PersistenceWriter::AttributeKey::operator <(const AttributeKey &rhs) const
+{
+    if (entityId != rhs.entityId)
+        return entityId < rhs.entityId;
+    if (compTypename != rhs.compTypename)
+        return compTypename < rhs.compTypename;
+    if (compName != rhs.compName)
+        return compName < rhs.compName;
+    return attrName < rhs.attrName;
+}
+
+PersistenceWriter::PersistenceWriter(int flushInterval_)
+:db(0),
+insertEntityStatement(0),
+removeEntityStatement(0),
+removeEntityComponentsStatement(0),
+removeEntityAttributesStatement(0),
+insertComponentStatement(0),
+removeComponentStatement(0),
+removeComponentAttributesStatement(0),
+upsertAttributeStatement(0),
+flushInterval(flushInterval_),
+stopping(false)
+{
+}
+
+PersistenceWriter::~PersistenceWriter()
+{
+    Close();
+}
+
+void PersistenceWriter::Open(const QString &filename)
+{
+    Close();
+
+    if (sqlite3_open_v2(filename.toStdString().c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        db = 0;
+        throw Exception(("Failed to open persistence database " + filename).toStdString().c_str());
+    }
+    try
+    {
+        if (sqlite3_extended_result_codes(db, true) != SQLITE_OK)
+            throw Exception("sqlite3_extended_result_codes");
+
+        // With write-ahead logging a commit appends to the log instead of rewriting the database, and readers do not block the writer.
+        // Syncing only at checkpoints is safe in WAL mode: a power loss may lose the last transactions, but never corrupts the database.
+        sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+        sqlite3_exec(db, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
+
+        CreateTables();
+        CreateStatements();
+    }
+    catch(...)
+    {
+        // The writer thread has not been started, so release the database here rather than with Close()
+        FinalizeStatements();
+        sqlite3_close(db);
+        db = 0;
+        throw;
+    }
+
+    stopping = false;
+    Thread(boost::bind(&PersistenceWriter::Run, this)).swap(thread);
+}
+
+void PersistenceWriter::Close()
+{
+    if (!db)
+        return;
+
+    {
+        MutexLock lock(mutex);
+        stopping = true;
+        changed.notify_one();
+    }
+    thread.join();
+
+    FinalizeStatements();
+    sqlite3_close(db);
+    db = 0;
+
+    LogDebug("Persisted " + ToString(stats.changes) + " changes with " + ToString(stats.writes) + " writes in " +
+        ToString(stats.transactions) + " transactions");
+}
+
+PersistenceWriter::Stats PersistenceWriter::GetStats()
+{
+    MutexLock lock(mutex);
+    return stats;
+}
+
+void PersistenceWriter::CreateTables()
+{
+    assert(db);
+
+    const char entities[] =
+        "CREATE TABLE IF NOT EXISTS entities (id INTEGER PRIMARY KEY)";
+
+    if (sqlite3_exec(db, entities, NULL, NULL, NULL) != SQLITE_OK)
+        throw Exception(entities);
+
+    const char components[] =
+        "CREATE TABLE IF NOT EXISTS components ( \
+            entityID INTEGER NOT NULL, \
+            compTypename TEXT NOT NULL, \
+            compName TEXT, \
+            networkSyncEnabled INTEGER NOT NULL, \
+            defaultChangeType INTEGER NOT NULL, \
+            FOREIGN KEY (entityID) REFERENCES entities (id))";
+
+    if (sqlite3_exec(db, components, NULL, NULL, NULL) != SQLITE_OK)
+        throw Exception(components);
+
+    const char attributes[] =
+        "CREATE TABLE IF NOT EXISTS attributes ( \
+            entityID INTEGER NOT NULL, \
+            compTypename TEXT NOT NULL, \
+            compName TEXT, \
+            attrName TEXT NOT NULL, \
+            attrType TEXT NOT NULL, \
+            attrValue BLOB NOT NULL)";
+//            FOREIGN KEY (compTypename) REFERENCES components (compTypename))";
+
+    if (sqlite3_exec(db, attributes, NULL, NULL, NULL) != SQLITE_OK)
+        throw Exception(attributes);
+
+    // Databases written by earlier versions may have duplicate component and attribute rows. Keep the latest of each before adding
+    // the unique indices, which let the writes be single INSERT OR REPLACE statements.
+    const char removeDuplicateComponents[] =
+        "DELETE FROM components WHERE rowid NOT IN \
+            (SELECT MAX(rowid) FROM components GROUP BY entityID, compTypename, compName)";
+
+    if (sqlite3_exec(db, removeDuplicateComponents, NULL, NULL, NULL) != SQLITE_OK)
+        throw Exception(removeDuplicateComponents);
+
+    const char componentIndex[] =
+        "CREATE UNIQUE INDEX IF NOT EXISTS componentKey ON components (entityID, compTypename, compName)";
+
+    if (sqlite3_exec(db, componentIndex, NULL, NULL, NULL) != SQLITE_OK)
+        throw Exception(componentIndex);
+
+    const char removeDuplicateAttributes[] =
+        "DELETE FROM attributes WHERE rowid NOT IN \
+            (SELECT MAX(rowid) FROM attributes GROUP BY entityID, compTypename, compName, attrName)";
+
+    if (sqlite3_exec(db, removeDuplicateAttributes, NULL, NULL, NULL) != SQLITE_OK)
+        throw Exception(removeDuplicateAttributes);
+
+    const char attributeIndex[] =
+        "CREATE UNIQUE INDEX IF NOT EXISTS attributeKey ON attributes (entityID, compTypename, compName, attrName)";
+
+    if (sqlite3_exec(db, attributeIndex, NULL, NULL, NULL) != SQLITE_OK)
+        throw Exception(attributeIndex);
+
+    // Earlier versions bound the ids as 32-bit signed integers, which stored local entity ids (high bit set) as negative numbers.
+    // Store them as their unsigned values so that ORDER BY entityID matches the entity_id_t order the reader's merge join relies on.
+    const char *fixEntityIds[] = {
+        "UPDATE entities SET id = id + 4294967296 WHERE id < 0",
+        "UPDATE components SET entityID = entityID + 4294967296 WHERE entityID < 0",
+        "UPDATE attributes SET entityID = entityID + 4294967296 WHERE entityID < 0" };
+
+    for(size_t i = 0; i < sizeof(fixEntityIds) / sizeof(fixEntityIds[0]); ++i)
+        if (sqlite3_exec(db, fixEntityIds[i], NULL, NULL, NULL) != SQLITE_OK)
+            throw Exception(fixEntityIds[i]);
+}
+
+void PersistenceWriter::CreateStatements()
+{
+    const char insertEntity[] = "INSERT OR IGNORE INTO entities (id) VALUES (?1)";
+    const char removeEntity[] = "DELETE FROM entities WHERE id=?1";
+    const char removeEntityComponents[] = "DELETE FROM components WHERE entityID=?1";
+    const char removeEntityAttributes[] = "DELETE FROM attributes WHERE entityID=?1";
+
+    const char insertComponent[] = "INSERT OR REPLACE INTO components "
+        "(entityID, compTypename, compName, networkSyncEnabled, defaultChangeType) "
+        "VALUES (?1, ?2, ?3, ?4, ?5)";
+
+    const char removeComponent[] = "DELETE FROM components WHERE entityID=?1 AND compTypename=?2 AND compName=?3";
+    const char removeComponentAttributes[] = "DELETE FROM attributes WHERE entityID=?1 AND compTypename=?2 AND compName=?3";
+
+    const char upsertAttribute[] = "INSERT OR REPLACE INTO attributes "
+        "(entityID, compTypename, compName, attrName, attrType, attrValue) VALUES (?1, ?2, ?3, ?4, ?5, ?6)";
+
+    if (sqlite3_prepare_v2(db, insertEntity, -1, &insertEntityStatement, NULL) != SQLITE_OK)
+        throw Exception(insertEntity);
+    if (sqlite3_prepare_v2(db, removeEntity, -1, &removeEntityStatement, NULL) != SQLITE_OK)
+        throw Exception(removeEntity);
+    if (sqlite3_prepare_v2(db, removeEntityComponents, -1, &removeEntityComponentsStatement, NULL) != SQLITE_OK)
+        throw Exception(removeEntityComponents);
+    if (sqlite3_prepare_v2(db, removeEntityAttributes, -1, &removeEntityAttributesStatement, NULL) != SQLITE_OK)
+        throw Exception(removeEntityAttributes);
+    if (sqlite3_prepare_v2(db, insertComponent, -1, &insertComponentStatement, NULL) != SQLITE_OK)
+        throw Exception(insertComponent);
+    if (sqlite3_prepare_v2(db, removeComponent, -1, &removeComponentStatement, NULL) != SQLITE_OK)
+        throw Exception(removeComponent);
+    if (sqlite3_prepare_v2(db, removeComponentAttributes, -1, &removeComponentAttributesStatement, NULL) != SQLITE_OK)
+        throw Exception(removeComponentAttributes);
+    if (sqlite3_prepare_v2(db, upsertAttribute, -1, &upsertAttributeStatement, NULL) != SQLITE_OK)
+        throw Exception(upsertAttribute);
+}
+
+void PersistenceWriter::FinalizeStatements()
+{
+    sqlite3_stmt **statements[] = { &insertEntityStatement, &removeEntityStatement, &removeEntityComponentsStatement,
+        &removeEntityAttributesStatement, &insertComponentStatement, &removeComponentStatement, &removeComponentAttributesStatement,
+        &upsertAttributeStatement };
+
+    for(size_t i = 0; i < sizeof(statements) / sizeof(statements[0]); ++i)
+    {
+        sqlite3_finalize(*statements[i]);
+        *statements[i] = 0;
+    }
+}
+
+void PersistenceWriter::InsertEntity(entity_id_t entityId)
+{
+    StructureChange change;
+    change.type = StructureChange::InsertEntity;
+    change.entityId = entityId;
+    change.networkSyncEnabled = false;
+
+    MutexLock lock(mutex);
+    QueueStructureChange(change);
+}
+
+void PersistenceWriter::RemoveEntity(entity_id_t entityId)
+{
+    StructureChange change;
+    change.type = StructureChange::RemoveEntity;
+    change.entityId = entityId;
+    change.networkSyncEnabled = false;
+
+    MutexLock lock(mutex);
+    DropAttributeWrites(entityId, 0, 0);
+    QueueStructureChange(change);
+}
+
+void PersistenceWriter::InsertComponent(entity_id_t entityId, const QString &compTypename, const QString &compName, bool networkSyncEnabled)
+{
+    StructureChange change;
+    change.type = StructureChange::InsertComponent;
+    change.entityId = entityId;
+    change.compTypename = compTypename.toStdString();
+    change.compName = compName.toStdString();
+    change.networkSyncEnabled = networkSyncEnabled;
+
+    MutexLock lock(mutex);
+    QueueStructureChange(change);
+}
+
+void PersistenceWriter::RemoveComponent(entity_id_t entityId, const QString &compTypename, const QString &compName)
+{
+    StructureChange change;
+    change.type = StructureChange::RemoveComponent;
+    change.entityId = entityId;
+    change.compTypename = compTypename.toStdString();
+    change.compName = compName.toStdString();
+    change.networkSyncEnabled = false;
+
+    MutexLock lock(mutex);
+    DropAttributeWrites(entityId, &change.compTypename, &change.compName);
+    QueueStructureChange(change);
+}
+
+void PersistenceWriter::WriteAttribute(entity_id_t entityId, const QString &compTypename, const QString &compName, const std::string &attrName,
+    const std::string &attrType, const char *data, size_t size)
+{
+    AttributeKey key;
+    key.entityId = entityId;
+    key.compTypename = compTypename.toStdString();
+    key.compName = compName.toStdString();
+    key.attrName = attrName;
+
+    MutexLock lock(mutex);
+    AttributeValue &value = attributeWrites[key];
+    value.attrType = attrType;
+    value.data.assign(data, data + size);
+    ++stats.changes;
+    Changed();
+}
+
+void PersistenceWriter::QueueStructureChange(const StructureChange &change)
+{
+    structureChanges.push_back(change);
+    ++stats.changes;
+    Changed();
+}
+
+void PersistenceWriter::DropAttributeWrites(entity_id_t entityId, const std::string *compTypename, const std::string *compName)
+{
+    AttributeKey first;
+    first.entityId = entityId;
+    if (compTypename)
+    {
+        first.compTypename = *compTypename;
+        first.compName = *compName;
+    }
+
+    AttributeMap::iterator iter = attributeWrites.lower_bound(first);
+    while (iter != attributeWrites.end() && iter->first.entityId == entityId &&
+        (!compTypename || (iter->first.compTypename == *compTypename && iter->first.compName == *compName)))
+        attributeWrites.erase(iter++);
+}
+
+void PersistenceWriter::Changed()
+{
+    size_t queued = structureChanges.size() + attributeWrites.size();
+    // The first queued change starts the flush interval. A full queue is flushed right away
+    if (queued == 1)
+    {
+        oldestChange = boost::get_system_time();
+        changed.notify_one();
+    }
+    else if (queued == cMaxQueuedChanges)
+        changed.notify_one();
+}
+
+void PersistenceWriter::Run()
+{
+    std::vector<StructureChange> structure;
+    AttributeMap attributes;
+
+    ScopedLock lock(mutex);
+    for(;;)
+    {
+        size_t queued = structureChanges.size() + attributeWrites.size();
+        if (!queued)
+        {
+            if (stopping)
+                break;
+            changed.wait(lock);
+            continue;
+        }
+
+        if (!stopping && queued < cMaxQueuedChanges && boost::get_system_time() < oldestChange + flushInterval)
+        {
+            changed.timed_wait(lock, oldestChange + flushInterval);
+            continue;
+        }
+
+        structure.swap(structureChanges);
+        attributes.swap(attributeWrites);
+        lock.unlock();
+
+        Flush(structure, attributes);
+        size_t writes = structure.size() + attributes.size();
+        structure.clear();
+        attributes.clear();
+
+        lock.lock();
+        stats.writes += writes;
+        ++stats.transactions;
+    }
+}
+
+bool PersistenceWriter::Step(sqlite3_stmt *statement)
+{
+    bool success = sqlite3_step(statement) == SQLITE_DONE;
+    if (!success)
+        LogError(std::string("Persistence statement failed: ") + sqlite3_errmsg(db) + " in " + sqlite3_sql(statement));
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+    return success;
+}
+
+void PersistenceWriter::Flush(const std::vector<StructureChange> &structure, const AttributeMap &attributes)
+{
+    if (sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        LogError(std::string("Failed to begin persistence transaction: ") + sqlite3_errmsg(db));
+        return;
+    }
+
+    // A failed statement is logged and skipped, so that it does not lose the rest of the changes
+    for(size_t i = 0; i < structure.size(); ++i)
+    {
+        const StructureChange &change = structure[i];
+        switch(change.type)
+        {
+        case StructureChange::InsertEntity:
+            sqlite3_bind_int64(insertEntityStatement, 1, (sqlite3_int64)change.entityId);
+            Step(insertEntityStatement);
+            break;
+        case StructureChange::RemoveEntity:
+            sqlite3_bind_int64(removeEntityStatement, 1, (sqlite3_int64)change.entityId);
+            Step(removeEntityStatement);
+            sqlite3_bind_int64(removeEntityComponentsStatement, 1, (sqlite3_int64)change.entityId);
+            Step(removeEntityComponentsStatement);
+            sqlite3_bind_int64(removeEntityAttributesStatement, 1, (sqlite3_int64)change.entityId);
+            Step(removeEntityAttributesStatement);
+            break;
+        case StructureChange::InsertComponent:
+            sqlite3_bind_int64(insertComponentStatement, 1, (sqlite3_int64)change.entityId);
+            sqlite3_bind_text(insertComponentStatement, 2, change.compTypename.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insertComponentStatement, 3, change.compName.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(insertComponentStatement, 4, change.networkSyncEnabled ? 1 : 0);
+            sqlite3_bind_int(insertComponentStatement, 5, 0); // defaultChangeType.
+            Step(insertComponentStatement);
+            break;
+        case StructureChange::RemoveComponent:
+            sqlite3_bind_int64(removeComponentStatement, 1, (sqlite3_int64)change.entityId);
+            sqlite3_bind_text(removeComponentStatement, 2, change.compTypename.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(removeComponentStatement, 3, change.compName.c_str(), -1, SQLITE_STATIC);
+            Step(removeComponentStatement);
+            sqlite3_bind_int64(removeComponentAttributesStatement, 1, (sqlite3_int64)change.entityId);
+            sqlite3_bind_text(removeComponentAttributesStatement, 2, change.compTypename.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(removeComponentAttributesStatement, 3, change.compName.c_str(), -1, SQLITE_STATIC);
+            Step(removeComponentAttributesStatement);
+            break;
+        }
+    }
+
+    for(AttributeMap::const_iterator iter = attributes.begin(); iter != attributes.end(); ++iter)
+    {
+        sqlite3_bind_int64(upsertAttributeStatement, 1, (sqlite3_int64)iter->first.entityId);
+        sqlite3_bind_text(upsertAttributeStatement, 2, iter->first.compTypename.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(upsertAttributeStatement, 3, iter->first.compName.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(upsertAttributeStatement, 4, iter->first.attrName.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(upsertAttributeStatement, 5, iter->second.attrType.c_str(), -1, SQLITE_STATIC);
+        const std::vector<char> &data = iter->second.data;
+        sqlite3_bind_blob(upsertAttributeStatement, 6, data.empty() ? "" : &data[0], data.size(), SQLITE_STATIC);
+        Step(upsertAttributeStatement);
+    }
+
+    if (sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        LogError(std::string("Failed to commit persistence transaction: ") + sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    }
+}
@@ -0,0 +1,151 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PersistenceWriter.h
+ *  @brief  Write-behind queue that stores scene changes to the persistence database from a worker thread.
+ */
+
+#ifndef incl_ScenePersistenceModule_PersistenceWriter_h
+#define incl_ScenePersistenceModule_PersistenceWriter_h
+
+#include "CoreTypes.h"
+#include "CoreThread.h"
+
+#include <QString>
+
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/// Write-behind queue of scene changes to the persistence database.
+/** The main thread only queues the changes. Repeated writes to the same attribute are coalesced, so that only the latest value
+    is stored. A worker thread owns the database connection and commits the queued changes in one transaction, at the latest
+    when the oldest queued change is flushInterval old, or earlier if too many changes are queued. The database is in WAL mode.
+*/
+class PersistenceWriter
+{
+public:
+    /// Statistics of the writer.
+    struct Stats
+    {
+        Stats() : changes(0), writes(0), transactions(0) {}
+        u64 changes; ///< Changes queued.
+        u64 writes; ///< Statements executed. Smaller than changes by the number of coalesced attribute writes.
+        u64 transactions; ///< Transactions committed.
+    };
+
+    /// Constructor.
+    /** @param flushInterval Maximum time in milliseconds a queued change waits before it is committed.
+    */
+    explicit PersistenceWriter(int flushInterval);
+
+    /// Destructor. Commits the queued changes and closes the database.
+    ~PersistenceWriter();
+
+    /// Opens a database file, creating the tables if necessary, and starts the worker thread. Throws Exception on failure.
+    void Open(const QString &filename);
+
+    /// Commits the queued changes, stops the worker thread and closes the database.
+    void Close();
+
+    /// Returns true if a database is open.
+    bool IsOpen() const { return db != 0; }
+
+    /// Returns the statistics so far.
+    Stats GetStats();
+
+    void InsertEntity(entity_id_t entityId);
+    void RemoveEntity(entity_id_t entityId);
+    void InsertComponent(entity_id_t entityId, const QString &compTypename, const QString &compName, bool networkSyncEnabled);
+    void RemoveComponent(entity_id_t entityId, const QString &compTypename, const QString &compName);
+
+    /// Queues the binary value of an attribute, replacing a previously queued value of the same attribute.
+    void WriteAttribute(entity_id_t entityId, const QString &compTypename, const QString &compName, const std::string &attrName,
+        const std::string &attrType, const char *data, size_t size);
+
+private:
+    Q_DISABLE_COPY(PersistenceWriter);
+
+    /// Queued change of the entity or component tables, applied in order.
+    struct StructureChange
+    {
+        enum Type { InsertEntity, RemoveEntity, InsertComponent, RemoveComponent };
+        Type type;
+        entity_id_t entityId;
+        std::string compTypename;
+        std::string compName;
+        bool networkSyncEnabled;
+    };
+
+    /// Identifies an attribute row.
+    struct AttributeKey
+    {
+        entity_id_t entityId;
+        std::string compTypename;
+        std::string compName;
+        std::string attrName;
+        bool operator <(const AttributeKey &rhs) const;
+    };
+
+    /// Queued attribute value.
+    struct AttributeValue
+    {
+        std::string attrType;
+        std::vector<char> data;
+    };
+
+    typedef std::map<AttributeKey, AttributeValue> AttributeMap;
+
+    /// Queues a structure change. Called with the mutex locked.
+    void QueueStructureChange(const StructureChange &change);
+
+    /// Drops the queued attribute writes of an entity, or of one component if compTypename is given. Called with the mutex locked.
+    void DropAttributeWrites(entity_id_t entityId, const std::string *compTypename, const std::string *compName);
+
+    /// Marks the queue changed, and wakes the worker thread if needed. Called with the mutex locked.
+    void Changed();
+
+    /// Worker thread main function.
+    void Run();
+
+    /// Commits changes in one transaction. Called in the worker thread.
+    void Flush(const std::vector<StructureChange> &structure, const AttributeMap &attributes);
+
+    /// Executes a statement. Logs and returns false on failure. Called in the worker thread.
+    bool Step(sqlite3_stmt *statement);
+
+    void CreateTables();
+    void CreateStatements();
+    void FinalizeStatements();
+
+    sqlite3 *db;
+
+    sqlite3_stmt *insertEntityStatement;
+    sqlite3_stmt *removeEntityStatement;
+    sqlite3_stmt *removeEntityComponentsStatement;
+    sqlite3_stmt *removeEntityAttributesStatement;
+    sqlite3_stmt *insertComponentStatement;
+    sqlite3_stmt *removeComponentStatement;
+    sqlite3_stmt *removeComponentAttributesStatement;
+    sqlite3_stmt *upsertAttributeStatement;
+
+    boost::posix_time::milliseconds flushInterval;
+
+    Mutex mutex; ///< Guards the members below.
+    Condition changed; ///< Signaled when the worker thread has something to do.
+    std::vector<StructureChange> structureChanges;
+    AttributeMap attributeWrites;
+    boost::system_time oldestChange; ///< Time of the oldest queued change.
+    bool stopping;
+    Stats stats;
+
+    Thread thread;
+};
+
+#endif
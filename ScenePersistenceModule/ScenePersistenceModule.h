@@ -13,13 +13,11 @@
 #include "ModuleLoggingFunctions.h"
 #include "RexTypes.h"
 #include "AttributeChangeType.h"
+#include "PersistenceWriter.h"
 
 #include <QObject>
 #include <QPointer>
 
-struct sqlite3;
-struct sqlite3_stmt;
-
 class SCENEPERSISTENCE_MODULE_API ScenePersistenceModule : public QObject, public IModule
 {
     Q_OBJECT
@@ -44,12 +42,17 @@ public slots:
 
     /// Closes the current storage database file, opens a new one, and immediately stores all the entities
     /// in the scene to that database. After returning, this module actively listens to changes to the
-    /// scene and immediately persists those changes to the given filename.
+    /// scene and persists those changes to the given filename. Changes are written by a worker thread,
+    /// at most cMaxStaleness milliseconds after they happen.
     void StartPersistingStorage(QString filename);
 
     /// Closes the current storage database file and stops listening to any scene changes.
     void ClosePersistingStorage();
 
+    /// Creates the entities stored in a storage database file into the default scene. Call before StartPersistingStorage.
+    /// @return Number of restored entities.
+    int RestoreFromStorage(QString filename);
+
     void EntityCreated(Scene::Entity* entity, AttributeChange::Type change);
     void EntityRemoved(Scene::Entity* entity, AttributeChange::Type change);
     void ComponentAdded(Scene::Entity* entity, IComponent* comp, AttributeChange::Type change);
@@ -59,18 +62,14 @@ public slots:
 private:
     Q_DISABLE_COPY(ScenePersistenceModule);
 
-    sqlite3 *db;
+    /// Maximum time in milliseconds between a scene change and its commit to the database.
+    static const int cMaxStaleness;
 
-    sqlite3_stmt *insertEntityStatement;
-    sqlite3_stmt *removeEntityStatement;
-    sqlite3_stmt *insertComponentStatement;
-    sqlite3_stmt *removeComponentStatement;
-    sqlite3_stmt *findAttributeStatement;
-    sqlite3_stmt *updateAttributeStatement;
-    sqlite3_stmt *insertAttributeStatement;
+    /// Queues the changes and writes them to the database.
+    PersistenceWriter writer;
 
-    void CreateTables();
-    void CreateStatements();
+    /// Buffer for serializing attribute values.
+    std::vector<char> attributeBuffer;
 };
 
 #endif
@@ -412,7 +412,7 @@ void Client::HandleLoginReply(MessageConnection* source, const MsgLoginReply& ms
 
         // Iterators for checking the source of the message and handling message correcly using right properties.
         QMutableMapIterator<QString, ClientLoginState> loginstateIterator(loginstate_list_);
-        QMutableMapIterator<QString, u8> client_idIterator(client_id_list_);
+        QMutableMapIterator<QString, u32> client_idIterator(client_id_list_);
         QMutableMapIterator<QString, bool> reconnectIterator(reconnect_list_);
         QMapIterator<unsigned short, Ptr(kNet::MessageConnection)> sourceIterator = owner_->GetKristalliModule()->GetConnectionArray();
 
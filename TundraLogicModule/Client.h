@@ -191,7 +191,7 @@ private:
     /// Whether the connect attempt is a reconnect because of dropped connection
     bool reconnect_;
     /// User ID, once known
-    u8 client_id_;
+    u32 client_id_;
 
     // Container for all the connections loginstates
     QMap<QString,ClientLoginState> loginstate_list_;
@@ -200,7 +200,7 @@ private:
     // Container for all the connections reconnect bool value
     QMap<QString, bool> reconnect_list_;
     // Container for all the connections clientID values
-    QMap<QString, u8> client_id_list_;
+    QMap<QString, u32> client_id_list_;
     // Container for all the connections scenenames
     QMap<int, QString> scenenames_;
 
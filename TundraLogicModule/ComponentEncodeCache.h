@@ -0,0 +1,136 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_TundraLogicModule_ComponentEncodeCache_h
+#define incl_TundraLogicModule_ComponentEncodeCache_h
+
+#include "CoreTypes.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace TundraLogic
+{
+
+//! Serialized component and attribute data, shared by all destinations during one sync update
+/*! The scene does not change while SyncManager processes the sync states of one update, so a component that is sent
+    to several users with the same set of dirty attributes only needs to be serialized once. The buffers are pooled:
+    Clear() forgets the encodings but keeps the buffers, so that steady state operation does not allocate.
+ */
+class ComponentEncodeCache
+{
+public:
+    //! What an encoding contains
+    enum EncodingType
+    {
+        //! IComponent::SerializeToBinary of the whole component. Object is the component, mask is unused
+        FullComponent,
+        //! Bit-flagged delta of static attributes. Object is the component, mask has one bit per attribute index
+        AttributeDelta,
+        //! IAttribute::ToBinary of one attribute. Object is the attribute, mask is unused
+        SingleAttribute
+    };
+    
+    //! Size of the scratch buffer, and thereby the maximum size of one encoding
+    static const size_t cScratchSize = 64 * 1024;
+    
+    ComponentEncodeCache() :
+        used_(0),
+        hits_(0),
+        encodes_(0)
+    {
+        scratch_.resize(cScratchSize);
+    }
+    
+    //! Return an encoding stored during this update, or null if there is none
+    const std::vector<u8>* Find(EncodingType type, const void* object, u64 mask)
+    {
+        boost::unordered_map<Key, size_t, KeyHash>::const_iterator i = index_.find(Key(type, object, mask));
+        if (i == index_.end())
+            return 0;
+        ++hits_;
+        return &buffers_[i->second];
+    }
+    
+    //! Copy the first size bytes of the scratch buffer into a pooled buffer and index it for Find
+    const std::vector<u8>& Store(EncodingType type, const void* object, u64 mask, size_t size)
+    {
+        size_t slot = Allocate(size);
+        index_[Key(type, object, mask)] = slot;
+        return buffers_[slot];
+    }
+    
+    //! Copy the first size bytes of the scratch buffer into a pooled buffer without indexing it
+    const std::vector<u8>& StoreUnindexed(size_t size)
+    {
+        return buffers_[Allocate(size)];
+    }
+    
+    //! Return the scratch buffer to serialize into
+    char* Scratch() { return &scratch_[0]; }
+    
+    //! Forget all encodings. The buffers are kept for reuse
+    void Clear()
+    {
+        index_.clear();
+        used_ = 0;
+    }
+    
+    //! Return the number of Find calls that hit an encoding
+    u64 Hits() const { return hits_; }
+    //! Return the number of encodings stored
+    u64 Encodes() const { return encodes_; }
+    //! Reset the hit and encode counters
+    void ResetCounters() { hits_ = 0; encodes_ = 0; }
+
+private:
+    struct Key
+    {
+        Key(EncodingType type, const void* object, u64 mask) : type_(type), object_(object), mask_(mask) {}
+        bool operator == (const Key& rhs) const { return (type_ == rhs.type_) && (object_ == rhs.object_) && (mask_ == rhs.mask_); }
+        
+        EncodingType type_;
+        const void* object_;
+        u64 mask_;
+    };
+    
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            size_t seed = 0;
+            boost::hash_combine(seed, key.object_);
+            boost::hash_combine(seed, key.mask_);
+            boost::hash_combine(seed, (int)key.type_);
+            return seed;
+        }
+    };
+    
+    size_t Allocate(size_t size)
+    {
+        if (used_ == buffers_.size())
+            buffers_.push_back(std::vector<u8>());
+        std::vector<u8>& buffer = buffers_[used_];
+        buffer.assign(scratch_.begin(), scratch_.begin() + size);
+        ++encodes_;
+        return used_++;
+    }
+    
+    //! Pooled buffers. A deque so that references stay valid while the pool grows
+    std::deque<std::vector<u8> > buffers_;
+    //! Number of buffers in use during this update
+    size_t used_;
+    //! Encodings of this update
+    boost::unordered_map<Key, size_t, KeyHash> index_;
+    //! Serialization scratch buffer
+    std::vector<char> scratch_;
+    //! Number of cache hits
+    u64 hits_;
+    //! Number of encodings
+    u64 encodes_;
+};
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "InterestManager.h"
+#include "SyncState.h"
+#include "SceneManager.h"
+#include "Entity.h"
+#include "EC_Placeable.h"
+#include "UserConnection.h"
+
+#include "MemoryLeakCheck.h"
+
+namespace TundraLogic
+{
+
+// When the user has no avatar, look it up again only this often (in updates), as the name lookup scans the whole scene
+static const uint cObserverLookupInterval = 30;
+
+DistanceInterestManager::DistanceInterestManager(float relevanceRadius, uint maxStaleness) :
+    relevanceRadius_(relevanceRadius),
+    maxStaleness_(maxStaleness),
+    hasObserver_(false)
+{
+}
+
+void DistanceInterestManager::BeginUpdate(Scene::SceneManager* scene, UserConnection* user, SceneSyncState* state)
+{
+    hasObserver_ = false;
+    if (!scene || !user || !state)
+        return;
+
+    Scene::EntityPtr observer;
+    if (state->observer_id_)
+        observer = scene->GetEntity(state->observer_id_);
+    if (!observer)
+    {
+        state->observer_id_ = 0;
+        if (state->observer_lookup_delay_ > 0)
+        {
+            --state->observer_lookup_delay_;
+            return;
+        }
+        observer = scene->GetEntityByName("Avatar" + QString::number(user->GetConnectionID()));
+        if (!observer)
+        {
+            state->observer_lookup_delay_ = cObserverLookupInterval;
+            return;
+        }
+        state->observer_id_ = observer->GetId();
+    }
+
+    EC_Placeable* placeable = observer->GetComponent<EC_Placeable>().get();
+    if (placeable)
+    {
+        observerPos_ = placeable->transform.Get().position;
+        hasObserver_ = true;
+    }
+}
+
+float DistanceInterestManager::ComputePriority(Scene::Entity* entity, uint staleness)
+{
+    float distance = 0.0f;
+    if (hasObserver_)
+    {
+        EC_Placeable* placeable = entity->GetComponent<EC_Placeable>().get();
+        if (placeable)
+            distance = placeable->transform.Get().position.getDistanceFrom(observerPos_);
+    }
+
+    if ((relevanceRadius_ > 0.0f) && (distance > relevanceRadius_) && (staleness < maxStaleness_))
+        return -1.0f;
+
+    // Priority grows linearly with the time spent waiting, and falls off with distance
+    return (1.0f + staleness) / (1.0f + distance);
+}
+
+}
@@ -0,0 +1,81 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_TundraLogicModule_InterestManager_h
+#define incl_TundraLogicModule_InterestManager_h
+
+#include "Foundation.h"
+#include "ForwardDefines.h"
+#include "Vector3D.h"
+
+class UserConnection;
+
+namespace TundraLogic
+{
+
+struct SceneSyncState;
+
+//! Interface for deciding the order in which dirty entities are replicated to a user
+/*! SyncManager asks the interest manager for a priority of each dirty entity once per update and per user,
+    and sends the entities in descending priority order until the user's per-update byte budget is used up.
+    Entities that did not fit stay dirty and are carried over to the next update with an increased staleness.
+ */
+class IInterestManager
+{
+public:
+    virtual ~IInterestManager() {}
+
+    //! Called once per update for each user before any priorities are queried
+    /*! \param scene Scene being replicated
+        \param user User the sync state belongs to. Null when replicating from client to server
+        \param state Sync state of the user
+     */
+    virtual void BeginUpdate(Scene::SceneManager* scene, UserConnection* user, SceneSyncState* state) = 0;
+
+    //! Return replication priority of a dirty entity. Larger is more urgent
+    /*! \param entity Dirty entity
+        \param staleness How many updates the entity has already been deferred
+        \return Priority. If negative, the entity is not sent during this update at all (it stays dirty)
+     */
+    virtual float ComputePriority(Scene::Entity* entity, uint staleness) = 0;
+};
+
+//! Default interest manager. Prioritizes by distance from the user's avatar and by staleness
+/*! The observer is the entity named "Avatar<connectionID>", as created by the avatar application scripts.
+    Entities without EC_Placeable, and all entities when the user has no avatar, are treated as being at the observer.
+    Entities further away than the relevance radius are held back until they have been deferred maxStaleness times.
+ */
+class DistanceInterestManager : public IInterestManager
+{
+public:
+    //! Constructor
+    /*! \param relevanceRadius Distance beyond which entities are considered irrelevant. Zero disables the cutoff
+        \param maxStaleness Number of updates after which an irrelevant entity is sent anyway
+     */
+    DistanceInterestManager(float relevanceRadius, uint maxStaleness);
+
+    virtual void BeginUpdate(Scene::SceneManager* scene, UserConnection* user, SceneSyncState* state);
+    virtual float ComputePriority(Scene::Entity* entity, uint staleness);
+
+    //! Set relevance radius. Zero disables the cutoff
+    void SetRelevanceRadius(float radius) { relevanceRadius_ = radius; }
+    //! Return relevance radius
+    float GetRelevanceRadius() const { return relevanceRadius_; }
+    //! Set number of updates after which an irrelevant entity is sent anyway
+    void SetMaxStaleness(uint staleness) { maxStaleness_ = staleness; }
+    //! Return max staleness
+    uint GetMaxStaleness() const { return maxStaleness_; }
+
+private:
+    //! Distance beyond which entities are irrelevant
+    float relevanceRadius_;
+    //! Updates after which irrelevant entities are sent anyway
+    uint maxStaleness_;
+    //! Whether the current user has a known observer position
+    bool hasObserver_;
+    //! Observer position of the current user
+    Vector3df observerPos_;
+};
+
+}
+
+#endif
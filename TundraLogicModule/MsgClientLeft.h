@@ -31,21 +31,21 @@ struct MsgClientLeft
 	bool inOrder;
 	u32 priority;
 
-	u8 userID;
+	u32 userID;
 
 	inline size_t Size() const
 	{
-		return 1;
+		return 4;
 	}
 
 	inline void SerializeTo(kNet::DataSerializer &dst) const
 	{
-		dst.Add<u8>(userID);
+		dst.Add<u32>(userID);
 	}
 
 	inline void DeserializeFrom(kNet::DataDeserializer &src)
 	{
-		userID = src.Read<u8>();
+		userID = src.Read<u32>();
 	}
 
 };
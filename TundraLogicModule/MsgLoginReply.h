@@ -32,23 +32,23 @@ struct MsgLoginReply
 	u32 priority;
 
 	u8 success;
-	u8 userID;
+	u32 userID;
 
 	inline size_t Size() const
 	{
-		return 1 + 1;
+		return 1 + 4;
 	}
 
 	inline void SerializeTo(kNet::DataSerializer &dst) const
 	{
 		dst.Add<u8>(success);
-		dst.Add<u8>(userID);
+		dst.Add<u32>(userID);
 	}
 
 	inline void DeserializeFrom(kNet::DataDeserializer &src)
 	{
 		success = src.Read<u8>();
-		userID = src.Read<u8>();
+		userID = src.Read<u32>();
 	}
 
 };
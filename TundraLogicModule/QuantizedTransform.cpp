@@ -0,0 +1,176 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "QuantizedTransform.h"
+#include "IAttribute.h"
+#include "CoreException.h"
+
+#include <kNet.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "MemoryLeakCheck.h"
+
+namespace TundraLogic
+{
+
+const float QuantizedTransform::cPositionStep = 0.001f;
+const float QuantizedTransform::cScaleStep = 0.001f;
+
+// Rotation angles are quantized to 16 bits, and deltas between them wrap around the circle
+static const int cRotationBits = 16;
+static const int cRotationGroup = 1;
+
+static s32 QuantizeLinear(float value, float step)
+{
+    double quantized = floor((double)value / step + 0.5);
+    if (quantized > 2147483647.0)
+        quantized = 2147483647.0;
+    if (quantized < -2147483647.0)
+        quantized = -2147483647.0;
+    return (s32)quantized;
+}
+
+static s32 WrapAngle(s32 value)
+{
+    return (s32)(s16)(u16)(value & 0xffff);
+}
+
+static s32 QuantizeAngle(float degrees)
+{
+    double wrapped = fmod((double)degrees, 360.0);
+    return WrapAngle((s32)floor(wrapped * (1 << cRotationBits) / 360.0 + 0.5));
+}
+
+static float DequantizeAngle(s32 value)
+{
+    return (float)(value * 360.0 / (1 << cRotationBits));
+}
+
+// Return the number of bits needed to store a value as two's complement
+static int SignedBitsNeeded(s32 value)
+{
+    u32 magnitude = value < 0 ? ~(u32)value : (u32)value;
+    int bits = 1;
+    while (magnitude)
+    {
+        ++bits;
+        magnitude >>= 1;
+    }
+    return bits;
+}
+
+QuantizedTransform::QuantizedTransform()
+{
+    *this = QuantizedTransform(Transform());
+}
+
+QuantizedTransform::QuantizedTransform(const Transform& transform)
+{
+    values_[0] = QuantizeLinear(transform.position.x, cPositionStep);
+    values_[1] = QuantizeLinear(transform.position.y, cPositionStep);
+    values_[2] = QuantizeLinear(transform.position.z, cPositionStep);
+    values_[3] = QuantizeAngle(transform.rotation.x);
+    values_[4] = QuantizeAngle(transform.rotation.y);
+    values_[5] = QuantizeAngle(transform.rotation.z);
+    values_[6] = QuantizeLinear(transform.scale.x, cScaleStep);
+    values_[7] = QuantizeLinear(transform.scale.y, cScaleStep);
+    values_[8] = QuantizeLinear(transform.scale.z, cScaleStep);
+}
+
+Transform QuantizedTransform::Dequantize() const
+{
+    Transform transform;
+    transform.SetPos(values_[0] * cPositionStep, values_[1] * cPositionStep, values_[2] * cPositionStep);
+    transform.SetRot(DequantizeAngle(values_[3]), DequantizeAngle(values_[4]), DequantizeAngle(values_[5]));
+    transform.SetScale(values_[6] * cScaleStep, values_[7] * cScaleStep, values_[8] * cScaleStep);
+    return transform;
+}
+
+bool QuantizedTransform::operator == (const QuantizedTransform& rhs) const
+{
+    for (uint i = 0; i < 9; ++i)
+        if (values_[i] != rhs.values_[i])
+            return false;
+    return true;
+}
+
+Attribute<Transform>* GetQuantizedTransformAttribute(IAttribute* attribute)
+{
+    AttributeMetadata* metadata = attribute->GetMetadata();
+    if ((!metadata) || (metadata->networkEncoding != AttributeMetadata::QuantizedEncoding))
+        return 0;
+    return dynamic_cast<Attribute<Transform>*>(attribute);
+}
+
+void WriteQuantizedTransform(kNet::DataSerializer& dest, const QuantizedTransform& value, const QuantizedTransform* reference)
+{
+    QuantizedTransform identity;
+    dest.Add<bit>(reference ? 1 : 0);
+    if (!reference)
+        reference = &identity;
+    
+    // Position, rotation & scale: one bit for whether changed, then the bit width and the per-axis deltas
+    for (uint group = 0; group < 3; ++group)
+    {
+        s32 deltas[3];
+        int bits = 1;
+        bool changed = false;
+        for (uint i = 0; i < 3; ++i)
+        {
+            s32 current = value.values_[group * 3 + i];
+            s32 previous = reference->values_[group * 3 + i];
+            if (group == cRotationGroup)
+                deltas[i] = WrapAngle(current - previous);
+            else
+                deltas[i] = (s32)((u32)current - (u32)previous);
+            if (deltas[i])
+                changed = true;
+            bits = std::max(bits, SignedBitsNeeded(deltas[i]));
+        }
+        
+        dest.Add<bit>(changed ? 1 : 0);
+        if (!changed)
+            continue;
+        dest.AppendBits(bits - 1, 5);
+        for (uint i = 0; i < 3; ++i)
+            dest.AppendBits(bits < 32 ? (u32)deltas[i] & ((1u << bits) - 1) : (u32)deltas[i], bits);
+    }
+}
+
+QuantizedTransform ReadQuantizedTransform(kNet::DataDeserializer& source, const QuantizedTransform* reference)
+{
+    QuantizedTransform identity;
+    if (source.Read<bit>())
+    {
+        if (!reference)
+            throw Exception("Quantized transform delta against an unknown reference");
+    }
+    else
+        reference = &identity;
+    
+    QuantizedTransform value = *reference;
+    for (uint group = 0; group < 3; ++group)
+    {
+        if (!source.Read<bit>())
+            continue;
+        int bits = source.ReadBits(5) + 1;
+        for (uint i = 0; i < 3; ++i)
+        {
+            u32 raw = source.ReadBits(bits);
+            // Sign-extend
+            if ((bits < 32) && (raw & (1u << (bits - 1))))
+                raw |= ~((1u << bits) - 1);
+            s32& current = value.values_[group * 3 + i];
+            if (group == cRotationGroup)
+                current = WrapAngle(current + (s32)raw);
+            else
+                current = (s32)((u32)current + raw);
+        }
+    }
+    return value;
+}
+
+}
@@ -0,0 +1,68 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_TundraLogicModule_QuantizedTransform_h
+#define incl_TundraLogicModule_QuantizedTransform_h
+
+#include "CoreTypes.h"
+#include "Transform.h"
+
+class IAttribute;
+template<typename T> class Attribute;
+
+namespace kNet
+{
+    class DataSerializer;
+    class DataDeserializer;
+}
+
+namespace TundraLogic
+{
+
+//! Transform quantized to integers for compact replication
+/*! Position and scale are quantized to cPositionStep / cScaleStep units, and each Euler rotation angle to 16 bits over the full circle.
+    Dequantized rotation angles are in the range [-180, 180).
+ */
+struct QuantizedTransform
+{
+    //! Position quantization step (meters)
+    static const float cPositionStep;
+    //! Scale quantization step
+    static const float cScaleStep;
+    
+    QuantizedTransform();
+    
+    //! Quantize a transform
+    explicit QuantizedTransform(const Transform& transform);
+    
+    //! Return the transform the quantized values stand for
+    Transform Dequantize() const;
+    
+    bool operator == (const QuantizedTransform& rhs) const;
+    bool operator != (const QuantizedTransform& rhs) const { return !(*this == rhs); }
+    
+    //! Position x, y, z, rotation x, y, z, scale x, y, z
+    s32 values_[9];
+};
+
+//! Return the attribute as a transform attribute if it has opted in to quantized replication, otherwise null
+Attribute<Transform>* GetQuantizedTransformAttribute(IAttribute* attribute);
+
+//! Write a quantized transform as a delta against a reference value
+/*! The receiver must pass the same reference to ReadQuantizedTransform. Unchanged position/rotation/scale take one bit,
+    and changed ones are written with just enough bits for the largest change of the three axes.
+    \param dest Destination
+    \param value Value to write
+    \param reference Value the receiver last got, or null if it has none. In that case the delta is against the identity transform
+ */
+void WriteQuantizedTransform(kNet::DataSerializer& dest, const QuantizedTransform& value, const QuantizedTransform* reference);
+
+//! Read a quantized transform written by WriteQuantizedTransform
+/*! \param source Source
+    \param reference Value last received from the same sender, or null if none
+    \throw Exception if the data was written against a reference, but none was given
+ */
+QuantizedTransform ReadQuantizedTransform(kNet::DataDeserializer& source, const QuantizedTransform* reference);
+
+}
+
+#endif
@@ -180,12 +180,9 @@ QVariantList Server::GetConnectionIDs() const
 
 UserConnection* Server::GetUserConnection(int connectionID) const
 {
-    UserConnectionList users = GetAuthenticatedUsers();
-    for (UserConnectionList::const_iterator iter = users.begin(); iter != users.end(); ++iter)
-    {
-        if ((*iter)->userID == connectionID)
-            return (*iter);
-    }
+    UserConnection* user = owner_->GetKristalliModule()->GetUserConnection((u32)connectionID);
+    if ((user) && (user->properties["authenticated"] == "true"))
+        return user;
     
     return 0;
 }
@@ -23,10 +23,14 @@
 #include "EC_DynamicComponent.h"
 
 #include "SceneAPI.h"
+#include "ConfigurationManager.h"
+#include "HighPerfClock.h"
 
 #include <kNet.h>
 
 #include <cstring>
+#include <algorithm>
+#include <functional>
 
 #include "MemoryLeakCheck.h"
 
@@ -44,13 +48,38 @@ kNet::MessageConnection* currentSender = 0;
 namespace TundraLogic
 {
 
+// Check whether an attribute has changed after the given sequence number, by someone else than the destination itself
+static bool IsDirtyFor(const AttributeChangeStamp& stamp, change_seq_t synced, kNet::MessageConnection* destination)
+{
+    if (stamp.seq_ <= synced)
+        return false;
+#ifndef ECHO_CHANGES_TO_SENDER
+    if (stamp.origin_ == destination)
+        return false;
+#endif
+    return true;
+}
+
 SyncManager::SyncManager(TundraLogicModule* owner, unsigned short con) :
     owner_(owner),
     framework_(owner->GetFramework()),
     update_period_(1.0f / 30.0f),
     update_acc_(0.0),
+    bytes_per_update_(0),
     attachedConnection(con)
 {
+    Foundation::ConfigurationManager& config = framework_->GetDefaultConfig();
+    // The settings are read as signed, so that a negative value does not wrap around to a huge budget or staleness
+    int bytesPerUpdate = config.DeclareSetting<int>("TundraLogic", "sync_bytes_per_update", 16384);
+    if (bytesPerUpdate < 0)
+    {
+        TundraLogicModule::LogWarning("Negative sync_bytes_per_update " + ToString(bytesPerUpdate) + ", using the default 16384");
+        bytesPerUpdate = 16384;
+    }
+    bytes_per_update_ = bytesPerUpdate;
+    float relevanceRadius = config.DeclareSetting<float>("TundraLogic", "sync_relevance_radius", 0.0f);
+    int maxStaleness = std::max(0, config.DeclareSetting<int>("TundraLogic", "sync_max_staleness", 30));
+    interest_manager_ = boost::shared_ptr<IInterestManager>(new DistanceInterestManager(relevanceRadius, maxStaleness));
 }
 
 SyncManager::~SyncManager()
@@ -78,6 +107,7 @@ void SyncManager::RegisterToScene(Scene::ScenePtr scene)
     {
         disconnect(this);
         server_syncstate_.Clear();
+        journal_.Clear();
     }
     
     scene_.reset();
@@ -194,6 +224,8 @@ void SyncManager::NewUserConnected(UserConnection* user)
         user->syncState = boost::shared_ptr<ISyncState>(new SceneSyncState());
     
     SceneSyncState* state = checked_static_cast<SceneSyncState*>(user->syncState.get());
+    // Earlier journal entries are not needed, as the full state will be sent
+    state->cursor_ = journal_.CurrentUpdate();
     
     for(Scene::SceneManager::iterator iter = scene->begin(); iter != scene->end(); ++iter)
     {
@@ -230,36 +262,13 @@ void SyncManager::OnAttributeChanged(IComponent* comp, IAttribute* attr, Attribu
     Scene::Entity* entity = comp->GetParentEntity();
     if ((!entity) || (entity->IsLocal()))
         return;
-    bool dynamic = comp->HasDynamicStructure();
     
-    if (isServer)
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for (UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-        {
-#ifndef ECHO_CHANGES_TO_SENDER
-            if ((*i)->connection == currentSender)
-                continue;
-#endif
-            SceneSyncState* state = checked_static_cast<SceneSyncState*>((*i)->syncState.get());
-            if (state)
-            {
-                if (!dynamic)
-                    state->OnAttributeChanged(entity->GetId(), comp->TypeNameHash(), comp->Name(), attr);
-                else
-                    // Note: this may be an add, change or remove. We inspect closer when it's time to send the update message.
-                    state->OnDynamicAttributeChanged(entity->GetId(), comp->TypeNameHash(), comp->Name(), QString::fromStdString(attr->GetNameString()));
-            }
-        }
-    }
+    // Record the change once for all users. The sender is recorded so that the change is not echoed back to it
+    if (!comp->HasDynamicStructure())
+        journal_.OnAttributeChanged(entity->GetId(), comp, attr, currentSender);
     else
-    {
-        SceneSyncState* state = &server_syncstate_;
-        if (!dynamic)
-            state->OnAttributeChanged(entity->GetId(), comp->TypeNameHash(), comp->Name(), attr);
-        else
-            state->OnDynamicAttributeChanged(entity->GetId(), comp->TypeNameHash(), comp->Name(), QString::fromStdString(attr->GetNameString()));
-    }
+        // Note: this may be an add, change or remove. We inspect closer when it's time to send the update message.
+        journal_.OnDynamicAttributeChanged(entity->GetId(), comp, QString::fromStdString(attr->GetNameString()), currentSender);
     
     // This attribute changing might in turn cause other attributes to change on the server, and these must be echoed to all, so reset sender now
     currentSender = 0;
@@ -274,21 +283,7 @@ void SyncManager::OnComponentAdded(Scene::Entity* entity, IComponent* comp, Attr
     if (entity->IsLocal())
         return;
     
-    if (owner_->IsServer())
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for (UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-        {
-            SceneSyncState* state = checked_static_cast<SceneSyncState*>((*i)->syncState.get());
-            if (state)
-                state->OnComponentAdded(entity->GetId(), comp->TypeNameHash(), comp->Name());
-        }
-    }
-    else
-    {
-        SceneSyncState* state = &server_syncstate_;
-        state->OnComponentAdded(entity->GetId(), comp->TypeNameHash(), comp->Name());
-    }
+    journal_.OnComponentAdded(entity->GetId(), comp);
 }
 
 void SyncManager::OnComponentRemoved(Scene::Entity* entity, IComponent* comp, AttributeChange::Type change)
@@ -300,21 +295,7 @@ void SyncManager::OnComponentRemoved(Scene::Entity* entity, IComponent* comp, At
     if (entity->IsLocal())
         return;
     
-    if (owner_->IsServer())
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for (UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-        {
-            SceneSyncState* state = checked_static_cast<SceneSyncState*>((*i)->syncState.get());
-            if (state)
-                state->OnComponentRemoved(entity->GetId(), comp->TypeNameHash(), comp->Name());
-        }
-    }
-    else
-    {
-        SceneSyncState* state = &server_syncstate_;
-        state->OnComponentRemoved(entity->GetId(), comp->TypeNameHash(), comp->Name());
-    }
+    journal_.OnComponentRemoved(entity->GetId(), comp);
 }
 
 void SyncManager::OnEntityCreated(Scene::Entity* entity, AttributeChange::Type change)
@@ -322,21 +303,7 @@ void SyncManager::OnEntityCreated(Scene::Entity* entity, AttributeChange::Type c
     if ((change != AttributeChange::Replicate) || (entity->IsLocal()))
         return;
     
-    if (owner_->IsServer())
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for (UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-        {
-            SceneSyncState* state = checked_static_cast<SceneSyncState*>((*i)->syncState.get());
-            if (state)
-                state->OnEntityChanged(entity->GetId());
-        }
-    }
-    else
-    {
-        SceneSyncState* state = &server_syncstate_;
-        state->OnEntityChanged(entity->GetId());
-    }
+    journal_.OnEntityChanged(entity->GetId());
 }
 
 void SyncManager::OnEntityRemoved(Scene::Entity* entity, AttributeChange::Type change)
@@ -345,21 +312,7 @@ void SyncManager::OnEntityRemoved(Scene::Entity* entity, AttributeChange::Type c
         return;
     if (entity->IsLocal())
         return;
-    if (owner_->IsServer())
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for (UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-        {
-            SceneSyncState* state = checked_static_cast<SceneSyncState*>((*i)->syncState.get());
-            if (state)
-                state->OnEntityRemoved(entity->GetId());
-        }
-    }
-    else
-    {
-        SceneSyncState* state = &server_syncstate_;
-        state->OnEntityRemoved(entity->GetId());
-    }
+    journal_.OnEntityRemoved(entity->GetId());
 }
 
 void SyncManager::OnActionTriggered(Scene::Entity *entity, const QString &action, const QStringList &params, EntityAction::ExecutionType type)
@@ -447,6 +400,15 @@ void SyncManager::Update(f64 frametime)
     if (!scene)
         return;
     
+    tick_t startTime = GetCurrentClockTime();
+    
+    // Serializations are only valid as long as the scene does not change, ie. during this update
+    encode_cache_.Clear();
+    
+    // Journal entries older than this have been processed by all sync states and can be forgotten
+    uint oldestCursor = journal_.CurrentUpdate() + 1;
+    std::vector<SceneSyncState*> states;
+    
     if (owner_->IsServer())
     {
         // If we are server, process all users
@@ -455,7 +417,11 @@ void SyncManager::Update(f64 frametime)
         {
             SceneSyncState* state = checked_static_cast<SceneSyncState*>((*i)->syncState.get());
             if (state)
-                ProcessSyncState((*i)->connection, state);
+            {
+                ProcessSyncState((*i)->connection, state, *i);
+                oldestCursor = std::min(oldestCursor, state->cursor_);
+                states.push_back(state);
+            }
         }
     }
     else
@@ -463,33 +429,158 @@ void SyncManager::Update(f64 frametime)
         // If we are client, process just the server sync state
         kNet::MessageConnection* connection = owner_->GetKristalliModule()->GetMessageConnection(attachedConnection);
         if (connection)
-            ProcessSyncState(connection, &server_syncstate_);
+            ProcessSyncState(connection, &server_syncstate_, 0);
+        oldestCursor = std::min(oldestCursor, server_syncstate_.cursor_);
+        states.push_back(&server_syncstate_);
     }
+    
+    journal_.EndUpdate(oldestCursor);
+    
+    // Forget the change stamps of entities that every sync state has either sent or dropped. Those still pending somewhere are kept for later
+    std::vector<entity_id_t>& unlisted = journal_.unlisted_entities_;
+    uint kept = 0;
+    for (uint i = 0; i < unlisted.size(); ++i)
+    {
+        bool pending = false;
+        for (uint j = 0; j < states.size() && !pending; ++j)
+            pending = states[j]->IsPending(unlisted[i]);
+        if (pending)
+            unlisted[kept++] = unlisted[i];
+        else
+            journal_.ForgetEntity(unlisted[i], oldestCursor);
+    }
+    unlisted.resize(kept);
+    
+    stats_.encodes_ += encode_cache_.Encodes();
+    stats_.encode_hits_ += encode_cache_.Hits();
+    encode_cache_.ResetCounters();
+    ++stats_.updates_;
+    stats_.time_ += (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
 }
 
-void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state)
+void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state, UserConnection* user)
 {
     PROFILE(SyncManager_ProcessSyncState);
     
     Scene::ScenePtr scene = scene_.lock();
     
     int num_messages_sent = 0;
+    uint bytes_sent = 0;
     
-    //! \todo Always sends everything that is dirty/removed. No priorization or limiting of sent data size yet.
+    // Process removed entities
+    for (uint i = 0; i < journal_.removed_entities_.size(); ++i)
+    {
+        if (journal_.removed_entities_[i].first < state->cursor_)
+            continue;
+        entity_id_t id = journal_.removed_entities_[i].second;
+        // If the user never got the entity, it does not need to know about the removal either
+        if (state->GetEntity(id))
+        {
+            MsgRemoveEntity msg;
+            msg.entityID = id;
+            destination->Send(msg);
+            ++num_messages_sent;
+        }
+        state->RemoveEntity(id);
+    }
     
-    // Process dirty entities (added/updated/removed components)
-    std::set<entity_id_t> dirty = state->dirty_entities_;
-    for (std::set<entity_id_t>::iterator i = dirty.begin(); i != dirty.end(); ++i)
+    // Process removed components. The journal lists them in order of removal, so collect consecutive removals of an entity into one message
     {
-        Scene::EntityPtr entity = scene->GetEntity(*i);
+        MsgRemoveComponents removeMsg;
+        EntitySyncState* entitystate = 0;
+        for (uint i = 0; i < journal_.removed_components_.size(); ++i)
+        {
+            const SceneChangeJournal::RemovedComponentRecord& record = journal_.removed_components_[i];
+            if (record.update_ < state->cursor_)
+                continue;
+            if ((removeMsg.components.size()) && (removeMsg.entityID != record.entity_))
+            {
+                destination->Send(removeMsg);
+                ++num_messages_sent;
+                removeMsg.components.clear();
+            }
+            removeMsg.entityID = record.entity_;
+            entitystate = state->GetEntity(record.entity_);
+            ComponentSyncState* componentstate = entitystate ? entitystate->GetComponent(record.type_hash_, record.name_) : 0;
+            if (!componentstate)
+                continue;
+            
+            MsgRemoveComponents::S_components remComponent;
+            remComponent.componentTypeHash = componentstate->type_hash_;
+            remComponent.componentName = StringToBuffer(componentstate->name_.toStdString());
+            bytes_sent += remComponent.componentName.size();
+            removeMsg.components.push_back(remComponent);
+            entitystate->RemoveComponent(record.type_hash_, record.name_);
+        }
+        if (removeMsg.components.size())
+        {
+            destination->Send(removeMsg);
+            ++num_messages_sent;
+        }
+    }
+    
+    // Entities changed since the previous update of this state are pending for sending, in addition to those carried over
+    for (uint i = 0; i < journal_.changed_entities_.size(); ++i)
+    {
+        if (journal_.changed_entities_[i].first >= state->cursor_)
+            state->OnEntityChanged(journal_.changed_entities_[i].second);
+    }
+    state->cursor_ = journal_.CurrentUpdate() + 1;
+    
+    // Prioritize the pending entities. Interest management is only applied to users, not when a client sends to the server
+    IInterestManager* interest = user ? interest_manager_.get() : 0;
+    if (interest)
+        interest->BeginUpdate(scene.get(), user, state);
+    
+    std::vector<std::pair<float, entity_id_t> > dirty;
+    dirty.reserve(state->pending_.size());
+    for (boost::unordered_map<entity_id_t, uint>::iterator i = state->pending_.begin(); i != state->pending_.end();)
+    {
+        Scene::EntityPtr entity = scene->GetEntity(i->first);
+        // Entity has ceased to exist, nothing to send
         if (!entity)
+        {
+            i = state->pending_.erase(i);
             continue;
+        }
+        float priority = 1.0f;
+        if (interest)
+        {
+            priority = interest->ComputePriority(entity.get(), i->second);
+            if (priority < 0.0f)
+            {
+                ++i->second;
+                ++stats_.deferred_;
+                ++i;
+                continue;
+            }
+        }
+        dirty.push_back(std::make_pair(priority, i->first));
+        ++i;
+    }
+    std::stable_sort(dirty.begin(), dirty.end(), std::greater<std::pair<float, entity_id_t> >());
+    
+    // Process dirty entities (added/updated components)
+    for (std::vector<std::pair<float, entity_id_t> >::iterator i = dirty.begin(); i != dirty.end(); ++i)
+    {
+        // If budget is used up, carry the rest over to the next update. Always send at least one entity so that large entities get through
+        if ((bytes_per_update_) && (bytes_sent >= bytes_per_update_))
+        {
+            for (; i != dirty.end(); ++i)
+            {
+                state->Defer(i->second);
+                ++stats_.deferred_;
+            }
+            break;
+        }
+        
+        Scene::EntityPtr entity = scene->GetEntity(i->second);
         const Scene::Entity::ComponentVector &components = entity->Components();
-        EntitySyncState* entitystate = state->GetEntity(*i);
+        EntitySyncState* entitystate = state->GetEntity(i->second);
         // No record in entitystate -> newly created entity, send full state
         if (!entitystate)
         {
-            entitystate = state->GetOrCreateEntity(*i);
+            entitystate = state->GetOrCreateEntity(i->second);
             MsgCreateEntity msg;
             msg.entityID = entity->GetId();
             for(uint j = 0; j < components.size(); ++j)
@@ -499,84 +590,72 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                 if ((component->IsSerializable()) && (component->GetNetworkSyncEnabled()))
                 {
                     // Create componentstate so we can start tracking individual attributes
-                    ComponentSyncState* componentstate = entitystate->GetOrCreateComponent(component->TypeNameHash(), component->Name());
-                    UNREFERENCED_PARAM(componentstate);
+                    entitystate->GetOrCreateComponent(component->TypeNameHash(), component->Name(), journal_.CurrentSeq());
                     MsgCreateEntity::S_components newComponent;
                     newComponent.componentTypeHash = component->TypeNameHash();
                     newComponent.componentName = StringToBuffer(component->Name().toStdString());
-                    newComponent.componentData.resize(64 * 1024);
-                    DataSerializer dest((char*)&newComponent.componentData[0], newComponent.componentData.size());
-                    component->SerializeToBinary(dest);
-                    newComponent.componentData.resize(dest.BytesFilled());
+                    newComponent.componentData = SerializeComponent(component.get());
+                    bytes_sent += newComponent.componentName.size() + newComponent.componentData.size();
                     msg.components.push_back(newComponent);
                 }
-                
-                entitystate->AckDirty(component->TypeNameHash(), component->Name());
             }
             destination->Send(msg);
             ++num_messages_sent;
         }
         else
         {
-            // Existing entitystate, check created & modified components
+            // Existing entitystate, check created & modified components from the journal
             //! \todo Renaming an existing component, that already has been replicated to client, leads to duplication.
             //! So it's not currently supported sensibly.
+            EntityChangeStamps* entitystamps = journal_.GetEntity(i->second);
+            if (entitystamps)
             {
-                std::set<std::pair<uint, QString> > dirtycomps = entitystate->dirty_components_;
                 MsgCreateComponents createMsg;
                 createMsg.entityID = entity->GetId();
                 MsgUpdateComponents updateMsg;
                 updateMsg.entityID = entity->GetId();
                 
-                for (std::set<std::pair<uint, QString> >::iterator j = dirtycomps.begin(); j != dirtycomps.end(); ++j)
+                for (uint j = 0; j < entitystamps->components_.size(); ++j)
                 {
-                    ComponentPtr component = entity->GetComponent(j->first, j->second);
+                    const ComponentChangeStamps& compstamps = entitystamps->components_[j];
+                    ComponentSyncState* componentstate = entitystate->GetComponent(compstamps.type_hash_, compstamps.name_);
+                    // Nothing changed since the user got the component
+                    if ((componentstate) && (compstamps.seq_ <= componentstate->synced_seq_))
+                        continue;
+                    
+                    ComponentPtr component = entity->GetComponent(compstamps.type_hash_, compstamps.name_);
                     if ((component) && (component->IsSerializable()) && (component->GetNetworkSyncEnabled()))
                     {
-                        ComponentSyncState* componentstate = entitystate->GetComponent(component->TypeNameHash(), component->Name());
                         // New component
                         if (!componentstate)
                         {
                             // Create componentstate so we can start tracking individual attributes
-                            componentstate = entitystate->GetOrCreateComponent(component->TypeNameHash(), component->Name());
+                            entitystate->GetOrCreateComponent(component->TypeNameHash(), component->Name(), journal_.CurrentSeq());
                             
                             MsgCreateComponents::S_components newComponent;
                             newComponent.componentTypeHash = component->TypeNameHash();
                             newComponent.componentName = StringToBuffer(component->Name().toStdString());
-                            newComponent.componentData.resize(64 * 1024);
-                            DataSerializer dest((char*)&newComponent.componentData[0], newComponent.componentData.size());
-                            component->SerializeToBinary(dest);
-                            newComponent.componentData.resize(dest.BytesFilled());
+                            newComponent.componentData = SerializeComponent(component.get());
+                            bytes_sent += newComponent.componentName.size() + newComponent.componentData.size();
                             createMsg.components.push_back(newComponent);
                         }
                         else
                         {
+                            change_seq_t synced = componentstate->synced_seq_;
+                            componentstate->synced_seq_ = journal_.CurrentSeq();
+                            
                             // Existing data, serialize changed attributes only
                             // Static structure component
                             if (!component->HasDynamicStructure())
                             {
-                                MsgUpdateComponents::S_components updComponent;
-                                updComponent.componentTypeHash = component->TypeNameHash();
-                                updComponent.componentName = StringToBuffer(component->Name().toStdString());
-                                updComponent.componentData.resize(64 * 1024);
-                                DataSerializer dest((char*)&updComponent.componentData[0], updComponent.componentData.size());
-                                bool has_changes = false;
-                                // Otherwise, we assume the attribute structure is static in the component, and we check which attributes are in the dirty list
-                                const AttributeVector& attributes = component->GetAttributes();
-                                for (uint k = 0; k < attributes.size(); k++)
-                                {
-                                    if (componentstate->dirty_static_attributes_.find(attributes[k]) != componentstate->dirty_static_attributes_.end())
-                                    {
-                                        dest.Add<bit>(1);
-                                        attributes[k]->ToBinary(dest);
-                                        has_changes = true;
-                                    }
-                                    else
-                                        dest.Add<bit>(0);
-                                }
-                                if (has_changes)
+                                const std::vector<u8>* delta = SerializeComponentDelta(component.get(), compstamps, componentstate, synced, destination);
+                                if (delta)
                                 {
-                                    updComponent.componentData.resize(dest.BytesFilled());
+                                    MsgUpdateComponents::S_components updComponent;
+                                    updComponent.componentTypeHash = component->TypeNameHash();
+                                    updComponent.componentName = StringToBuffer(component->Name().toStdString());
+                                    updComponent.componentData = *delta;
+                                    bytes_sent += updComponent.componentName.size() + updComponent.componentData.size();
                                     updateMsg.components.push_back(updComponent);
                                 }
                             }
@@ -587,29 +666,32 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                                 updComponent.componentTypeHash = component->TypeNameHash();
                                 updComponent.componentName = StringToBuffer(component->Name().toStdString());
                                 bool has_changes = false;
-                                const std::set<QString>& dirtyAttrs = componentstate->dirty_dynamic_attributes_;
-                                std::set<QString>::const_iterator k = dirtyAttrs.begin();
-                                while (k != dirtyAttrs.end())
+                                std::map<QString, AttributeChangeStamp>::const_iterator k = compstamps.dynamic_attributes_.begin();
+                                while (k != compstamps.dynamic_attributes_.end())
                                 {
+                                    if (!IsDirtyFor(k->second, synced, destination))
+                                    {
+                                        ++k;
+                                        continue;
+                                    }
                                     has_changes = true;
                                     MsgUpdateComponents::S_dynamiccomponents::S_attributes updAttribute;
                                     // Check if the attribute is changed or removed
-                                    IAttribute* attribute = component->GetAttribute(*k);
+                                    IAttribute* attribute = component->GetAttribute(k->first);
                                     if (attribute)
                                     {
-                                        updAttribute.attributeName = StringToBuffer((*k).toStdString());
+                                        updAttribute.attributeName = StringToBuffer(k->first.toStdString());
                                         updAttribute.attributeType = StringToBuffer(attribute->TypeName());
-                                        updAttribute.attributeData.resize(64 * 1024);
-                                        DataSerializer dest((char*)&updAttribute.attributeData[0], updAttribute.attributeData.size());
-                                        attribute->ToBinary(dest);
-                                        updAttribute.attributeData.resize(dest.BytesFilled());
+                                        updAttribute.attributeData = SerializeAttribute(attribute);
+                                        bytes_sent += updAttribute.attributeType.size() + updAttribute.attributeData.size();
                                     }
                                     else
                                     {
                                         // Removed attribute: empty typename & data
-                                        updAttribute.attributeName = StringToBuffer((*k).toStdString());
+                                        updAttribute.attributeName = StringToBuffer(k->first.toStdString());
                                     }
                                     
+                                    bytes_sent += updAttribute.attributeName.size();
                                     updComponent.attributes.push_back(updAttribute);
                                     ++k;
                                 }
@@ -618,7 +700,6 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                             }
                         }
                     }
-                    entitystate->AckDirty(j->first, j->second);
                 }
                 
                 // Send message(s) only if there were components
@@ -633,51 +714,96 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                     ++num_messages_sent;
                 }
             }
-            
-            // Check removed components
-            {
-                std::set<std::pair<uint, QString> > removedcomps = entitystate->removed_components_;
-                MsgRemoveComponents removeMsg;
-                removeMsg.entityID = entity->GetId();
-                
-                for (std::set<std::pair<uint, QString> >::iterator j = removedcomps.begin(); j != removedcomps.end(); ++j)
-                {
-                    MsgRemoveComponents::S_components remComponent;
-                    remComponent.componentTypeHash = j->first;
-                    remComponent.componentName = StringToBuffer(j->second.toStdString());
-                    removeMsg.components.push_back(remComponent);
-                    
-                    entitystate->RemoveComponent(j->first, j->second);
-                    entitystate->AckRemove(j->first, j->second);
-                }
-                
-                if (removeMsg.components.size())
-                {
-                    destination->Send(removeMsg);
-                    ++num_messages_sent;
-                }
-            }
         }
         
-        state->AckDirty(*i);
-        
+        state->AckDirty(i->second);
     }
+    
+    ++stats_.connections_;
+    stats_.bytes_ += bytes_sent;
+    stats_.messages_ += num_messages_sent;
+    
+    //if (num_messages_sent)
+    //    TundraLogicModule::LogInfo("Sent " + ToString<int>(num_messages_sent) + " scenesync messages");
+}
 
-    // Process removed entities
-    std::set<entity_id_t> removed = state->removed_entities_;
-    for (std::set<entity_id_t>::iterator i = removed.begin(); i != removed.end(); ++i)
+const std::vector<u8>& SyncManager::SerializeComponent(IComponent* component)
+{
+    const std::vector<u8>* cached = encode_cache_.Find(ComponentEncodeCache::FullComponent, component, 0);
+    if (cached)
+        return *cached;
+    
+    DataSerializer dest(encode_cache_.Scratch(), ComponentEncodeCache::cScratchSize);
+    component->SerializeToBinary(dest);
+    return encode_cache_.Store(ComponentEncodeCache::FullComponent, component, 0, dest.BytesFilled());
+}
+
+const std::vector<u8>* SyncManager::SerializeComponentDelta(IComponent* component, const ComponentChangeStamps& stamps, ComponentSyncState* componentstate,
+    change_seq_t synced, kNet::MessageConnection* destination)
+{
+    const AttributeVector& attributes = component->GetAttributes();
+    
+    // The set of dirty attributes identifies the serialization. It only fits in the cache key if there are at most 64 attributes,
+    // and quantized attributes are deltas against per-destination values
+    bool cacheable = attributes.size() <= 64;
+    u64 mask = 0;
+    bool has_changes = false;
+    for (uint k = 0; k < attributes.size(); ++k)
     {
-        MsgRemoveEntity msg;
-        msg.entityID = *i;
-        destination->Send(msg);
-        state->RemoveEntity(*i);
-        state->AckRemove(*i);
-        ++num_messages_sent;
-        
+        if ((k < stamps.attributes_.size()) && (IsDirtyFor(stamps.attributes_[k], synced, destination)))
+        {
+            has_changes = true;
+            if (GetQuantizedTransformAttribute(attributes[k]))
+                cacheable = false;
+            if (cacheable)
+                mask |= ((u64)1) << k;
+        }
     }
+    if (!has_changes)
+        return 0;
     
-    //if (num_messages_sent)
-    //    TundraLogicModule::LogInfo("Sent " + ToString<int>(num_messages_sent) + " scenesync messages");
+    if (cacheable)
+    {
+        const std::vector<u8>* cached = encode_cache_.Find(ComponentEncodeCache::AttributeDelta, component, mask);
+        if (cached)
+            return cached;
+    }
+    
+    DataSerializer dest(encode_cache_.Scratch(), ComponentEncodeCache::cScratchSize);
+    for (uint k = 0; k < attributes.size(); ++k)
+    {
+        if ((k < stamps.attributes_.size()) && (IsDirtyFor(stamps.attributes_[k], synced, destination)))
+        {
+            dest.Add<bit>(1);
+            Attribute<Transform>* transform = GetQuantizedTransformAttribute(attributes[k]);
+            if (transform)
+            {
+                QuantizedTransform value(transform->Get());
+                std::map<uint, QuantizedTransform>::iterator reference = componentstate->sent_transforms_.find(k);
+                WriteQuantizedTransform(dest, value, reference != componentstate->sent_transforms_.end() ? &reference->second : 0);
+                componentstate->sent_transforms_[k] = value;
+            }
+            else
+                attributes[k]->ToBinary(dest);
+        }
+        else
+            dest.Add<bit>(0);
+    }
+    if (cacheable)
+        return &encode_cache_.Store(ComponentEncodeCache::AttributeDelta, component, mask, dest.BytesFilled());
+    else
+        return &encode_cache_.StoreUnindexed(dest.BytesFilled());
+}
+
+const std::vector<u8>& SyncManager::SerializeAttribute(IAttribute* attribute)
+{
+    const std::vector<u8>* cached = encode_cache_.Find(ComponentEncodeCache::SingleAttribute, attribute, 0);
+    if (cached)
+        return *cached;
+    
+    DataSerializer dest(encode_cache_.Scratch(), ComponentEncodeCache::cScratchSize);
+    attribute->ToBinary(dest);
+    return encode_cache_.Store(ComponentEncodeCache::SingleAttribute, attribute, 0, dest.BytesFilled());
 }
 
 bool SyncManager::ValidateAction(kNet::MessageConnection* source, unsigned messageID, entity_id_t entityID)
@@ -784,8 +910,7 @@ void SyncManager::HandleCreateEntity(kNet::MessageConnection* source, const MsgC
                 
                 // Reflect changes back to syncstate
                 EntitySyncState* entitystate = state->GetOrCreateEntity(entityID);
-                ComponentSyncState* componentstate = entitystate->GetOrCreateComponent(type_hash, name);
-                UNREFERENCED_PARAM(componentstate);
+                entitystate->GetOrCreateComponent(type_hash, name, journal_.CurrentSeq());
             }
         }
         else
@@ -907,8 +1032,7 @@ void SyncManager::HandleCreateComponents(kNet::MessageConnection* source, const
                 
                 // Reflect changes back to syncstate
                 EntitySyncState* entitystate = state->GetOrCreateEntity(entityID);
-                ComponentSyncState* componentstate = entitystate->GetOrCreateComponent(type_hash, name);
-                UNREFERENCED_PARAM(componentstate);
+                entitystate->GetOrCreateComponent(type_hash, name, journal_.CurrentSeq());
             }
         }
         else
@@ -990,6 +1114,7 @@ void SyncManager::HandleUpdateComponents(kNet::MessageConnection* source, const
                 {
                     std::vector<bool> actually_changed_attributes;
                     const AttributeVector& attributes = component->GetAttributes();
+                    ComponentSyncState* componentstate = 0;
                     try
                     {
                         // Deserialize changed attributes (1 bit) with no signals first
@@ -1002,15 +1127,34 @@ void SyncManager::HandleUpdateComponents(kNet::MessageConnection* source, const
                                 if ((!isServer) && (attributes[i]->HasMetadata()) && (attributes[i]->GetMetadata()->interpolation == AttributeMetadata::Interpolate))
                                     interpolate = true;
                                 
+                                // Quantized transforms are deltas against the previous value received from the same sender
+                                Transform quantizedValue;
+                                bool quantized = GetQuantizedTransformAttribute(attributes[i]) != 0;
+                                if (quantized)
+                                {
+                                    if (!componentstate)
+                                        componentstate = state->GetOrCreateEntity(entityID)->GetOrCreateComponent(type_hash, name, journal_.CurrentSeq());
+                                    std::map<uint, QuantizedTransform>::iterator reference = componentstate->received_transforms_.find(i);
+                                    QuantizedTransform value = ReadQuantizedTransform(source, reference != componentstate->received_transforms_.end() ? &reference->second : 0);
+                                    componentstate->received_transforms_[i] = value;
+                                    quantizedValue = value.Dequantize();
+                                }
+                                
                                 if (!interpolate)
                                 {
-                                    attributes[i]->FromBinary(source, AttributeChange::Disconnected);
+                                    if (quantized)
+                                        checked_static_cast<Attribute<Transform>*>(attributes[i])->Set(quantizedValue, AttributeChange::Disconnected);
+                                    else
+                                        attributes[i]->FromBinary(source, AttributeChange::Disconnected);
                                     actually_changed_attributes.push_back(true);
                                 }
                                 else
                                 {
                                     IAttribute* endValue = attributes[i]->Clone();
-                                    endValue->FromBinary(source, AttributeChange::Disconnected);
+                                    if (quantized)
+                                        checked_static_cast<Attribute<Transform>*>(endValue)->Set(quantizedValue, AttributeChange::Disconnected);
+                                    else
+                                        endValue->FromBinary(source, AttributeChange::Disconnected);
                                     //! \todo server's tickrate might not be same as ours. Should perhaps sync it upon join
                                     // Allow a slightly longer interval than the actual tickrate, for possible packet jitter
                                     scene->StartAttributeInterpolation(attributes[i], endValue, update_period_ * 1.35f);
@@ -1175,12 +1319,12 @@ void SyncManager::HandleRemoveComponents(kNet::MessageConnection* source, const
         {
             entity->RemoveComponent(comp, change);
             comp.reset();
+            
+            // Reflect changes back to syncstate
+            EntitySyncState* entitystate = state->GetEntity(entityID);
+            if (entitystate)
+                entitystate->RemoveComponent(type_hash, name);
         }
-        
-        // Reflect changes back to syncstate
-        EntitySyncState* entitystate = state->GetEntity(entityID);
-        if (entitystate)
-            entitystate->RemoveComponent(type_hash, name);
     }
 }
 
@@ -1199,7 +1343,8 @@ void SyncManager::HandleEntityIDCollision(kNet::MessageConnection* source, const
     TundraLogicModule::LogDebug("An entity ID collision occurred. Entity " + ToString<int>(msg.oldEntityID) + " became " + ToString<int>(msg.newEntityID));
     scene->ChangeEntityId(msg.oldEntityID, msg.newEntityID);
     
-    // Do the change also in server scene replication state
+    // Do the change also in the change journal and server scene replication state
+    journal_.ChangeEntityId(msg.oldEntityID, msg.newEntityID);
     SceneSyncState* state = GetSceneSyncState(source);
     if (state)
     {
@@ -1268,12 +1413,9 @@ SceneSyncState* SyncManager::GetSceneSyncState(kNet::MessageConnection* connecti
     if (!owner_->IsServer())
         return &server_syncstate_;
     
-    UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-    for (UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-    {
-        if ((*i)->connection == connection)
-            return checked_static_cast<SceneSyncState*>((*i)->syncState.get());
-    }
+    UserConnection* user = owner_->GetKristalliModule()->GetUserConnection(connection);
+    if (user)
+        return checked_static_cast<SceneSyncState*>(user->syncState.get());
     return 0;
 }
 
@@ -7,6 +7,8 @@
 #include "IComponent.h"
 #include "ForwardDefines.h"
 #include "SyncState.h"
+#include "InterestManager.h"
+#include "ComponentEncodeCache.h"
 
 #include <QObject>
 #include <map>
@@ -39,6 +41,39 @@ struct RemovedComponent
     QString name_;
 };
 
+//! Accumulated scene replication statistics, reset by the syncstats console command
+struct SyncStats
+{
+    SyncStats() :
+        updates_(0),
+        connections_(0),
+        bytes_(0),
+        messages_(0),
+        deferred_(0),
+        encodes_(0),
+        encode_hits_(0),
+        time_(0.0)
+    {
+    }
+    
+    //! Number of updates (ticks) processed
+    uint updates_;
+    //! Sum of processed sync states over all updates
+    uint connections_;
+    //! Payload bytes sent
+    u64 bytes_;
+    //! Messages sent
+    u64 messages_;
+    //! Dirty entities carried over to a later update
+    u64 deferred_;
+    //! Components or attributes serialized
+    u64 encodes_;
+    //! Serializations reused from another connection during the same update
+    u64 encode_hits_;
+    //! Time spent in processing the sync states (seconds)
+    double time_;
+};
+
 class SyncManager : public QObject
 {
     Q_OBJECT
@@ -62,12 +97,30 @@ public:
     //! Handle Kristalli event
     void HandleKristalliEvent(event_id_t event_id, IEventData* data);
     
+    //! Replace the interest management used for prioritizing users' dirty entities. Null disables prioritization
+    void SetInterestManager(boost::shared_ptr<IInterestManager> manager) { interest_manager_ = manager; }
+    
+    //! Return the interest management in use
+    boost::shared_ptr<IInterestManager> GetInterestManager() const { return interest_manager_; }
+    
 public slots:
     //! Set update period (seconds)
     void SetUpdatePeriod(float period);
     
     //! Get update period
     float GetUpdatePeriod() { return update_period_; }
+    
+    //! Set the per-connection payload byte budget for one update. Zero means unlimited
+    void SetBytesPerUpdate(uint bytes) { bytes_per_update_ = bytes; }
+    
+    //! Get the per-connection payload byte budget for one update
+    uint GetBytesPerUpdate() const { return bytes_per_update_; }
+    
+    //! Return accumulated replication statistics
+    const SyncStats& GetStats() const { return stats_; }
+    
+    //! Reset accumulated replication statistics
+    void ResetStats() { stats_ = SyncStats(); }
 
     // Connected to server signal newUserConnected.
     void ProcessNewUserConnection(int, UserConnection*);
@@ -120,11 +173,28 @@ private:
     void HandleEntityAction(kNet::MessageConnection* source, MsgEntityAction& msg);
 
     //! Process one sync state for changes in the scene
-    /*! \todo For now, sends all changed entities/components. In the future, this shall be subject to interest management
+    /*! Picks up the changes recorded in the journal since the previous update of the sync state. Dirty entities are sent
+        in the order of priority given by the interest manager, until the byte budget for this update is used up.
+        The rest stay pending and are sent on later updates. Removed entities and components are always sent.
         \param destination MessageConnection where to send the messages
         \param state Syncstate to process
+        \param user User the syncstate belongs to, or null when processing the server syncstate on a client
      */
-    void ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state);
+    void ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state, UserConnection* user);
+    
+    //! Return full serialization of a component, serializing it only on the first request during an update
+    const std::vector<u8>& SerializeComponent(IComponent* component);
+    
+    //! Return serialization of the static attributes of a component that are dirty for a destination, as bitflags followed by the changed values
+    /*! Destinations with the same set of dirty attributes share the serialization during an update, unless a dirty attribute
+        uses quantized encoding: those are written as deltas against what the destination last got, stored in the componentstate.
+        \return Serialized data, or null if no attribute is dirty
+     */
+    const std::vector<u8>* SerializeComponentDelta(IComponent* component, const ComponentChangeStamps& stamps, ComponentSyncState* componentstate,
+        change_seq_t synced, kNet::MessageConnection* destination);
+    
+    //! Return serialization of a single attribute, serializing it only on the first request during an update
+    const std::vector<u8>& SerializeAttribute(IAttribute* attribute);
     
     //! Validate the scene manipulation action. If returns false, it is ignored
     /*! \param source Where the action came from
@@ -167,6 +237,21 @@ private:
     //! Time accumulator for update
     float update_acc_;
     
+    //! Per-connection payload byte budget for one update, zero for unlimited
+    uint bytes_per_update_;
+    
+    //! Interest management for prioritizing the dirty entities of users
+    boost::shared_ptr<IInterestManager> interest_manager_;
+    
+    //! Replication statistics
+    SyncStats stats_;
+    
+    //! Replicated changes of the scene, shared by all sync states
+    SceneChangeJournal journal_;
+    
+    //! Component serializations of the current update, shared by all sync states
+    ComponentEncodeCache encode_cache_;
+    
     //! Server sync state (client operation only)
     SceneSyncState server_syncstate_;
 
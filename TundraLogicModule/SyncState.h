@@ -7,148 +7,394 @@
 #include "IAttribute.h"
 #include "UserConnection.h"
 #include "Entity.h"
+#include "QuantizedTransform.h"
 
 #include <QString>
 
+#include <boost/unordered_map.hpp>
+
 #include <map>
+#include <vector>
+
+namespace kNet
+{
+    class MessageConnection;
+}
 
 namespace TundraLogic
 {
 
-//! State of component replication for a specific user
-struct ComponentSyncState
+//! Running sequence number of a change recorded in the scene change journal. Zero means "never changed"
+typedef u64 change_seq_t;
+
+//! Latest change of one attribute
+struct AttributeChangeStamp
+{
+    AttributeChangeStamp() :
+        seq_(0),
+        origin_(0)
+    {
+    }
+    
+    //! Sequence number of the latest change
+    change_seq_t seq_;
+    //! Connection the latest change arrived from, or null if it was made locally. Never dereferenced
+    kNet::MessageConnection* origin_;
+};
+
+//! Latest changes of one component, shared by all sync states
+struct ComponentChangeStamps
 {
+    ComponentChangeStamps() :
+        component_(0),
+        type_hash_(0),
+        seq_(0)
+    {
+    }
+    
+    //! The component. Never dereferenced, only used for matching changes to the stamps
+    IComponent* component_;
+    //! Type name hash of the component. Together with the name identifies the component to the sync states
     uint type_hash_;
+    //! Name of the component
     QString name_;
-    // Note! These pointers are never dereferenced, and might be invalid. They are just for quick response to AttributeChanged signals.
-    std::set<IAttribute*> dirty_static_attributes_;
-    std::set<QString> dirty_dynamic_attributes_;
+    //! Sequence number of the latest change to any attribute, or of the creation of the component
+    change_seq_t seq_;
+    //! Static structured attributes, by attribute index
+    std::vector<AttributeChangeStamp> attributes_;
+    //! Dynamic structured attributes (added, changed or removed), by name
+    std::map<QString, AttributeChangeStamp> dynamic_attributes_;
 };
 
-//! State of entity replication for a specific user
-struct EntitySyncState
+//! Components of an entity that have recorded changes
+struct EntityChangeStamps
 {
-    //! Components that this client is already aware of
-    std::vector<ComponentSyncState> components_;
-    //! Created/modified components
-    std::set<std::pair<uint, QString> > dirty_components_;
-    //! Pending removed components (typenamehash, name)
-    std::set<std::pair<uint, QString> > removed_components_;
-    
-    ComponentSyncState* GetOrCreateComponent(uint type_hash, const QString& name)
+    EntityChangeStamps() :
+        listed_update_((uint)-1)
     {
-        // If we want to recreate the component and have a pending remove, remove the remove
-        removed_components_.erase(std::make_pair<uint, QString>(type_hash, name));
-        ComponentSyncState* old = GetComponent(type_hash, name);
-        if (old)
-            return old;
-        ComponentSyncState newstate;
-        newstate.type_hash_ = type_hash;
-        newstate.name_ = name;
-        components_.push_back(newstate);
-        return &components_[components_.size()-1];
     }
     
-    ComponentSyncState* GetComponent(uint type_hash, const QString& name)
+    std::vector<ComponentChangeStamps> components_;
+    //! Journal update during which the entity was last appended to the changed entities list
+    uint listed_update_;
+    
+    ComponentChangeStamps* GetOrCreateComponent(IComponent* comp)
     {
-        for (int i = 0; i < (int)components_.size(); ++i)
+        uint type_hash = comp->TypeNameHash();
+        for (uint i = 0; i < components_.size(); ++i)
         {
-            if ((components_[i].type_hash_ == type_hash) && (components_[i].name_ == name))
+            if (components_[i].component_ == comp)
+            {
+                // Stamps left over from a component removed without being recorded may have the address of a new component
+                if ((components_[i].type_hash_ != type_hash) || (components_[i].name_ != comp->Name()))
+                    components_[i] = NewComponent(comp, type_hash);
                 return &components_[i];
+            }
         }
-        return 0;
+        components_.push_back(NewComponent(comp, type_hash));
+        return &components_.back();
     }
     
-    void RemoveComponent(uint type_hash, const QString& name)
+    void RemoveComponent(IComponent* comp)
     {
-        dirty_components_.erase(std::make_pair<uint, QString>(type_hash, name));
-        removed_components_.erase(std::make_pair<uint, QString>(type_hash, name));
-        for (int i = 0; i < (int)components_.size(); ++i)
+        for (uint i = 0; i < components_.size(); ++i)
         {
-            if ((components_[i].type_hash_ == type_hash) && (components_[i].name_ == name))
+            if (components_[i].component_ == comp)
+            {
                 components_.erase(components_.begin() + i);
+                return;
+            }
+        }
+    }
+    
+private:
+    static ComponentChangeStamps NewComponent(IComponent* comp, uint type_hash)
+    {
+        ComponentChangeStamps stamps;
+        stamps.component_ = comp;
+        stamps.type_hash_ = type_hash;
+        stamps.name_ = comp->Name();
+        return stamps;
+    }
+};
+
+//! Journal of replicated scene changes, shared by all sync states
+/*! Every change is recorded once, by stamping the changed attribute with a running sequence number, and the cost does not
+    depend on the number of users. Each sync state remembers up to which sequence number it has sent each component,
+    and which journal update it has processed the changed/removed lists up to.
+ */
+class SceneChangeJournal
+{
+public:
+    //! Removed component record
+    struct RemovedComponentRecord
+    {
+        uint update_;
+        entity_id_t entity_;
+        //! Type name hash of the removed component
+        uint type_hash_;
+        //! Name of the removed component
+        QString name_;
+    };
+    
+    SceneChangeJournal() :
+        seq_(0),
+        update_(0)
+    {
+    }
+    
+    //! Return the sequence number of the latest recorded change
+    change_seq_t CurrentSeq() const { return seq_; }
+    
+    //! Return the number of the current journal update
+    uint CurrentUpdate() const { return update_; }
+    
+    //! Return recorded changes of an entity, or null if there are none
+    EntityChangeStamps* GetEntity(entity_id_t id)
+    {
+        boost::unordered_map<entity_id_t, EntityChangeStamps>::iterator i = entities_.find(id);
+        return i != entities_.end() ? &i->second : 0;
+    }
+    
+    void OnEntityChanged(entity_id_t id)
+    {
+        GetOrCreateEntity(id);
+    }
+    
+    void OnEntityRemoved(entity_id_t id)
+    {
+        entities_.erase(id);
+        removed_entities_.push_back(std::make_pair(update_, id));
+    }
+    
+    void OnComponentAdded(entity_id_t id, IComponent* comp)
+    {
+        ComponentChangeStamps* compStamps = GetOrCreateEntity(id)->GetOrCreateComponent(comp);
+        compStamps->seq_ = ++seq_;
+    }
+    
+    void OnComponentRemoved(entity_id_t id, IComponent* comp)
+    {
+        EntityChangeStamps* stamps = GetEntity(id);
+        if (stamps)
+            stamps->RemoveComponent(comp);
+        RemovedComponentRecord record = { update_, id, comp->TypeNameHash(), comp->Name() };
+        removed_components_.push_back(record);
+    }
+    
+    void OnAttributeChanged(entity_id_t id, IComponent* comp, IAttribute* attribute, kNet::MessageConnection* origin)
+    {
+        ComponentChangeStamps* compStamps = GetOrCreateEntity(id)->GetOrCreateComponent(comp);
+        compStamps->seq_ = ++seq_;
+        const AttributeVector& attributes = comp->GetAttributes();
+        if (compStamps->attributes_.size() < attributes.size())
+            compStamps->attributes_.resize(attributes.size());
+        for (uint i = 0; i < attributes.size(); ++i)
+        {
+            if (attributes[i] == attribute)
+            {
+                compStamps->attributes_[i].seq_ = seq_;
+                compStamps->attributes_[i].origin_ = origin;
+                break;
+            }
+        }
+    }
+    
+    void OnDynamicAttributeChanged(entity_id_t id, IComponent* comp, const QString& attrName, kNet::MessageConnection* origin)
+    {
+        ComponentChangeStamps* compStamps = GetOrCreateEntity(id)->GetOrCreateComponent(comp);
+        compStamps->seq_ = ++seq_;
+        AttributeChangeStamp& stamp = compStamps->dynamic_attributes_[attrName];
+        stamp.seq_ = seq_;
+        stamp.origin_ = origin;
+    }
+    
+    //! Move the recorded changes of an entity to a new ID
+    void ChangeEntityId(entity_id_t old_id, entity_id_t new_id)
+    {
+        boost::unordered_map<entity_id_t, EntityChangeStamps>::iterator i = entities_.find(old_id);
+        if (i == entities_.end())
+            return;
+        EntityChangeStamps stamps = i->second;
+        entities_.erase(i);
+        entities_[new_id] = stamps;
+        unlisted_entities_.push_back(new_id);
+    }
+    
+    //! Forget the recorded changes of an entity, unless it has been listed as changed again after all sync states processed it
+    /*! The caller must make sure that no sync state still has the entity pending, as the stamps are needed to send it.
+        \param oldestCursor Oldest update that some sync state has not yet processed
+     */
+    void ForgetEntity(entity_id_t id, uint oldestCursor)
+    {
+        boost::unordered_map<entity_id_t, EntityChangeStamps>::iterator i = entities_.find(id);
+        if ((i != entities_.end()) && (i->second.listed_update_ < oldestCursor))
+            entities_.erase(i);
+    }
+    
+    //! Finish the current update. Forget changed/removed list entries that all sync states have processed
+    /*! Entities dropped from the changed list are moved to unlisted_entities_, whose stamps the caller may forget with ForgetEntity().
+        \param oldestCursor Oldest update that some sync state has not yet processed
+     */
+    void EndUpdate(uint oldestCursor)
+    {
+        uint kept = 0;
+        for (uint i = 0; i < changed_entities_.size(); ++i)
+        {
+            if (changed_entities_[i].first >= oldestCursor)
+                changed_entities_[kept++] = changed_entities_[i];
+            else
+                unlisted_entities_.push_back(changed_entities_[i].second);
+        }
+        changed_entities_.resize(kept);
+        TrimList(removed_entities_, oldestCursor);
+        kept = 0;
+        for (uint i = 0; i < removed_components_.size(); ++i)
+        {
+            if (removed_components_[i].update_ >= oldestCursor)
+                removed_components_[kept++] = removed_components_[i];
         }
+        removed_components_.resize(kept);
+        ++update_;
     }
     
-    void OnComponentAdded(uint type_hash, const QString& name)
+    void Clear()
     {
-        dirty_components_.insert(std::make_pair<uint, QString>(type_hash, name));
-        removed_components_.erase(std::make_pair<uint, QString>(type_hash, name));
+        entities_.clear();
+        changed_entities_.clear();
+        removed_entities_.clear();
+        removed_components_.clear();
+        unlisted_entities_.clear();
     }
     
-    void OnAttributeChanged(uint type_hash, const QString& name, IAttribute* attribute)
+    //! Entities with changes, tagged with the update they were listed on. Each entity is listed at most once per update
+    std::vector<std::pair<uint, entity_id_t> > changed_entities_;
+    //! Removed entities, tagged with the update they were removed on
+    std::vector<std::pair<uint, entity_id_t> > removed_entities_;
+    //! Removed components
+    std::vector<RemovedComponentRecord> removed_components_;
+    //! Entities that all sync states have taken off the changed list. Their stamps can be forgotten once no sync state has them pending
+    std::vector<entity_id_t> unlisted_entities_;
+
+private:
+    EntityChangeStamps* GetOrCreateEntity(entity_id_t id)
     {
-        dirty_components_.insert(std::make_pair<uint, QString>(type_hash, name));
-        removed_components_.erase(std::make_pair<uint, QString>(type_hash, name));
-        // If client already has the component state, dirty the specific attribute
-        if (attribute)
+        EntityChangeStamps* stamps = &entities_[id];
+        if (stamps->listed_update_ != update_)
         {
-            ComponentSyncState* compState = GetComponent(type_hash, name);
-            if (compState)
-                compState->dirty_static_attributes_.insert(attribute);
+            stamps->listed_update_ = update_;
+            changed_entities_.push_back(std::make_pair(update_, id));
         }
+        return stamps;
     }
     
-    void OnDynamicAttributeChanged(uint type_hash, const QString& name, const QString& attrName)
+    static void TrimList(std::vector<std::pair<uint, entity_id_t> >& list, uint oldestCursor)
     {
-        dirty_components_.insert(std::make_pair<uint, QString>(type_hash, name));
-        removed_components_.erase(std::make_pair<uint, QString>(type_hash, name));
-        // If client already has the component state, dirty the specific attribute
-        ComponentSyncState* compState = GetComponent(type_hash, name);
-        if (compState)
-            compState->dirty_dynamic_attributes_.insert(attrName);
+        uint kept = 0;
+        for (uint i = 0; i < list.size(); ++i)
+        {
+            if (list[i].first >= oldestCursor)
+                list[kept++] = list[i];
+        }
+        list.resize(kept);
     }
     
-    void OnComponentRemoved(uint type_hash, const QString& name)
+    //! Recorded changes of entities
+    boost::unordered_map<entity_id_t, EntityChangeStamps> entities_;
+    //! Sequence number of the latest change
+    change_seq_t seq_;
+    //! Current update
+    uint update_;
+};
+
+//! State of component replication for a specific user
+struct ComponentSyncState
+{
+    //! Type name hash and name identify the component, as in the network messages. A pointer could be reused by a later component
+    uint type_hash_;
+    QString name_;
+    //! Changes up to this sequence number have been sent to the user
+    change_seq_t synced_seq_;
+    //! Quantized transform attributes last sent to the user, by attribute index. Deltas are written against these
+    std::map<uint, QuantizedTransform> sent_transforms_;
+    //! Quantized transform attributes last received from the user, by attribute index. Deltas are read against these
+    std::map<uint, QuantizedTransform> received_transforms_;
+};
+
+//! State of entity replication for a specific user
+struct EntitySyncState
+{
+    //! Components that this client is already aware of
+    std::vector<ComponentSyncState> components_;
+    
+    ComponentSyncState* GetOrCreateComponent(uint type_hash, const QString& name, change_seq_t synced_seq)
     {
-        removed_components_.insert(std::make_pair<uint, QString>(type_hash, name));
-        dirty_components_.erase(std::make_pair<uint, QString>(type_hash, name));
+        ComponentSyncState* old = GetComponent(type_hash, name);
+        if (old)
+            return old;
+        ComponentSyncState newstate;
+        newstate.type_hash_ = type_hash;
+        newstate.name_ = name;
+        newstate.synced_seq_ = synced_seq;
+        components_.push_back(newstate);
+        return &components_[components_.size()-1];
     }
     
-    void AckDirty(uint type_hash, const QString& name)
+    ComponentSyncState* GetComponent(uint type_hash, const QString& name)
     {
-        dirty_components_.erase(std::make_pair<uint, QString>(type_hash, name));
-        ComponentSyncState* compState = GetComponent(type_hash, name);
-        if (compState)
+        for (int i = 0; i < (int)components_.size(); ++i)
         {
-            compState->dirty_static_attributes_.clear();
-            compState->dirty_dynamic_attributes_.clear();
+            if ((components_[i].type_hash_ == type_hash) && (components_[i].name_ == name))
+                return &components_[i];
         }
+        return 0;
     }
     
-    void AckRemove(uint type_hash, const QString& name)
+    void RemoveComponent(uint type_hash, const QString& name)
     {
-        removed_components_.erase(std::make_pair<uint, QString>(type_hash, name));
+        for (int i = 0; i < (int)components_.size(); ++i)
+        {
+            if ((components_[i].type_hash_ == type_hash) && (components_[i].name_ == name))
+            {
+                components_.erase(components_.begin() + i);
+                return;
+            }
+        }
     }
 };
 
 //! State of scene replication for a specific user
+/*! Changes are not recorded here, but in the SceneChangeJournal shared by all users. Only entities that must be sent
+    regardless of the journal (new user, or deferred by interest management) are kept in pending_.
+ */
 struct SceneSyncState : public ISyncState
 {
+    SceneSyncState() :
+        cursor_(0),
+        observer_id_(0),
+        observer_lookup_delay_(0)
+    {
+    }
+    
     //! Entities that this client is already aware of
-    std::map<entity_id_t, EntitySyncState> entities_;
-    //! Created/modified entities
-    std::set<entity_id_t> dirty_entities_;
-    //! Pending removed entities
-    std::set<entity_id_t> removed_entities_;
+    boost::unordered_map<entity_id_t, EntitySyncState> entities_;
+    //! Entities waiting to be sent, and for how many updates interest management has deferred them
+    boost::unordered_map<entity_id_t, uint> pending_;
+    //! First journal update whose changed/removed lists have not been processed yet
+    uint cursor_;
+    //! Observer (avatar) entity of the user, as resolved by interest management. 0 if not known
+    entity_id_t observer_id_;
+    //! Updates to wait before looking up an unknown observer entity again
+    uint observer_lookup_delay_;
     
     EntitySyncState* GetOrCreateEntity(entity_id_t id)
     {
-        // If we want to recreate the entity and have a pending remove, remove the remove
-        removed_entities_.erase(id);
-        std::map<entity_id_t, EntitySyncState>::iterator i = entities_.find(id);
-        if (i == entities_.end())
-        {
-            EntitySyncState* newstate = &entities_[id];
-            return newstate;
-        }
-        else
-            return &i->second;
+        return &entities_[id];
     }
     
     EntitySyncState* GetEntity(entity_id_t id)
     {
-        std::map<entity_id_t, EntitySyncState>::iterator i = entities_.find(id);
+        boost::unordered_map<entity_id_t, EntitySyncState>::iterator i = entities_.find(id);
         if (i != entities_.end())
             return &i->second;
         return 0;
@@ -156,80 +402,43 @@ struct SceneSyncState : public ISyncState
     
     void RemoveEntity(entity_id_t id)
     {
-        dirty_entities_.erase(id);
-        removed_entities_.erase(id);
+        pending_.erase(id);
         entities_.erase(id);
     }
     
     void OnEntityChanged(entity_id_t id)
     {
-        dirty_entities_.insert(id);
-    }
-    
-    void OnEntityRemoved(entity_id_t id)
-    {
-        removed_entities_.insert(id);
+        pending_.insert(std::make_pair(id, 0U));
     }
     
-    void OnAttributeChanged(entity_id_t id, uint type_hash, const QString& name, IAttribute* attribute)
+    bool IsPending(entity_id_t id) const
     {
-        OnEntityChanged(id);
-        // If the entity does not exist in the user's syncstate yet, don't have to care
-        // (full entitystate will be serialized once it's time)
-        EntitySyncState* entitystate = GetEntity(id);
-        if (!entitystate)
-            return;
-        entitystate->OnAttributeChanged(type_hash, name, attribute);
+        return pending_.find(id) != pending_.end();
     }
     
-    void OnDynamicAttributeChanged(entity_id_t id, uint type_hash, const QString& name, const QString& attrName)
-    {
-        OnEntityChanged(id);
-        // If the entity does not exist in the user's syncstate yet, don't have to care
-        // (full entitystate will be serialized once it's time)
-        EntitySyncState* entitystate = GetEntity(id);
-        if (!entitystate)
-            return;
-        entitystate->OnDynamicAttributeChanged(type_hash, name, attrName);
-    }
-    
-    void OnComponentAdded(entity_id_t id, uint type_hash, const QString& name)
-    {
-        OnEntityChanged(id);
-        // If the entity does not exist in the user's syncstate yet, don't have to care
-        // (full entitystate will be serialized once it's time)
-        EntitySyncState* entitystate = GetEntity(id);
-        if (!entitystate)
-            return;
-        entitystate->OnComponentAdded(type_hash, name);
-    }
-    
-    void OnComponentRemoved(entity_id_t id, uint type_hash, const QString& name)
+    void AckDirty(entity_id_t id)
     {
-        OnEntityChanged(id);
-        // If the entity does not exist in the user's syncstate yet, don't have to care
-        // (full entitystate will be serialized once it's time)
-        EntitySyncState* entitystate = GetEntity(id);
-        if (!entitystate)
-            return;
-        entitystate->OnComponentRemoved(type_hash, name);
+        pending_.erase(id);
     }
     
-    void AckDirty(entity_id_t id)
+    void Defer(entity_id_t id)
     {
-        dirty_entities_.erase(id);
+        ++pending_[id];
     }
     
-    void AckRemove(entity_id_t id)
+    uint GetStaleness(entity_id_t id) const
     {
-        removed_entities_.erase(id);
+        boost::unordered_map<entity_id_t, uint>::const_iterator i = pending_.find(id);
+        return i != pending_.end() ? i->second : 0;
     }
     
     void Clear()
     {
         entities_.clear();
-        dirty_entities_.clear();
-        removed_entities_.clear();
+        pending_.clear();
+        cursor_ = 0;
+        observer_id_ = 0;
+        observer_lookup_delay_ = 0;
     }
 };
 
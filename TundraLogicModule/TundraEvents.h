@@ -35,7 +35,7 @@ namespace Events
     class TundraConnectedEventData : public IEventData
     {
     public:
-        u8 user_id_;
+        u32 user_id_;
     };
 }
 
@@ -75,6 +75,9 @@ void TundraLogicModule::PostInitialize()
 {
     kristalliEventCategory_ = framework_->GetEventManager()->QueryEventCategory("Kristalli");
     frameworkEventCategory_ = framework_->GetEventManager()->QueryEventCategory("Framework");
+    // Only the Tundra and Kristalli events are handled, so declare them instead of being sent every event
+    framework_->GetEventManager()->RegisterEventSubscription(this, tundraEventCategory_);
+    framework_->GetEventManager()->RegisterEventSubscription(this, kristalliEventCategory_);
     
     framework_->Console()->RegisterCommand(CreateConsoleCommand("startserver", 
         "Starts a server. Usage: startserver(port)",
@@ -90,10 +93,10 @@ void TundraLogicModule::PostInitialize()
         ConsoleBind(this, &TundraLogicModule::ConsoleDisconnect)));
 
     framework_->Console()->RegisterCommand(CreateConsoleCommand("savescene",
-        "Saves scene into XML or binary. Usage: savescene(filename,binary)",
+        "Saves scene into XML, binary or snapshot. Usage: savescene(filename,binary|snapshot)",
         ConsoleBind(this, &TundraLogicModule::ConsoleSaveScene)));
     framework_->Console()->RegisterCommand(CreateConsoleCommand("loadscene",
-        "Loads scene from XML or binary. Usage: loadscene(filename,binary)",
+        "Loads scene from XML, binary or snapshot. Usage: loadscene(filename,binary|snapshot)",
         ConsoleBind(this, &TundraLogicModule::ConsoleLoadScene)));
     
     framework_->Console()->RegisterCommand(CreateConsoleCommand("importscene",
@@ -113,6 +116,10 @@ void TundraLogicModule::PostInitialize()
     framework_->Console()->RegisterCommand(CreateConsoleCommand("changecon",
         "Change primary view to another connection already established. Meant to be used without webkit UI.",
         ConsoleBind(this, &TundraLogicModule::ConsoleChangeConnection)));
+    
+    framework_->Console()->RegisterCommand(CreateConsoleCommand("syncstats",
+        "Prints scene replication statistics (bytes and time per update) collected since the previous call, and resets them.",
+        ConsoleBind(this, &TundraLogicModule::ConsoleSyncStats)));
         
     // Take a pointer to KristalliProtocolModule so that we don't have to take/check it every time
     kristalliModule_ = framework_->GetModuleManager()->GetModule<KristalliProtocol::KristalliProtocolModule>().lock();
@@ -283,7 +290,10 @@ void TundraLogicModule::LoadStartupScene()
     else
     {
         bool useBinary = startupScene.find(".tbin") != std::string::npos;
-        if (!useBinary)
+        bool useSnapshot = startupScene.find(".tsnap") != std::string::npos;
+        if (useSnapshot)
+            scene->LoadSceneSnapshot(startupScene, true/*clearScene*/, false/*replaceOnConflict*/, AttributeChange::Default);
+        else if (!useBinary)
             scene->LoadSceneXML(startupScene, true/*clearScene*/, false/*replaceOnConflict*/, AttributeChange::Default);
         else
             scene->LoadSceneBinary(startupScene, true/*clearScene*/, false/*replaceOnConflict*/, AttributeChange::Default);
@@ -300,7 +310,10 @@ void TundraLogicModule::StartupSceneLoaded(AssetPtr asset)
     if (!sceneDiskSource.isEmpty())
     {
         bool useBinary = sceneDiskSource.endsWith(".tbin");
-        if (!useBinary)
+        bool useSnapshot = sceneDiskSource.endsWith(".tsnap");
+        if (useSnapshot)
+            scene->LoadSceneSnapshot(sceneDiskSource.toStdString(), true/*clearScene*/, false/*replaceOnConflict*/, AttributeChange::Default);
+        else if (!useBinary)
             scene->LoadSceneXML(sceneDiskSource.toStdString(), true/*clearScene*/, false/*replaceOnConflict*/, AttributeChange::Default);
         else
             scene->LoadSceneBinary(sceneDiskSource.toStdString(), true/*clearScene*/, false/*replaceOnConflict*/, AttributeChange::Default);
@@ -419,11 +432,16 @@ ConsoleCommandResult TundraLogicModule::ConsoleSaveScene(const StringVector &par
         return ConsoleResultFailure("No filename given.");
     
     bool useBinary = false;
+    bool useSnapshot = false;
     if ((params.size() > 1) && (params[1] == "binary"))
         useBinary = true;
+    if ((params.size() > 1) && (params[1] == "snapshot"))
+        useSnapshot = true;
     
     bool success;
-    if (!useBinary)
+    if (useSnapshot)
+        success = scene->SaveSceneSnapshot(params[0]);
+    else if (!useBinary)
         success = scene->SaveSceneXML(params[0]);
     else
         success = scene->SaveSceneBinary(params[0]);
@@ -444,11 +462,16 @@ ConsoleCommandResult TundraLogicModule::ConsoleLoadScene(const StringVector &par
         return ConsoleResultFailure("No filename given.");
     
     bool useBinary = false;
+    bool useSnapshot = false;
     if ((params.size() > 1) && (params[1] == "binary"))
         useBinary = true;
+    if ((params.size() > 1) && (params[1] == "snapshot"))
+        useSnapshot = true;
     
     QList<Scene::Entity *> entities;
-    if (!useBinary)
+    if (useSnapshot)
+        entities = scene->LoadSceneSnapshot(params[0], true/*clearScene*/, false/*replaceOnConflcit*/, AttributeChange::Default);
+    else if (!useBinary)
         entities = scene->LoadSceneXML(params[0], true/*clearScene*/, false/*replaceOnConflcit*/, AttributeChange::Default);
     else
         entities = scene->LoadSceneBinary(params[0], true/*clearScene*/, false/*replaceOnConflcit*/, AttributeChange::Default);
@@ -531,6 +554,30 @@ ConsoleCommandResult TundraLogicModule::ConsoleImportMesh(const StringVector &pa
     return ConsoleResultSuccess();
 }
 
+ConsoleCommandResult TundraLogicModule::ConsoleSyncStats(const StringVector &params)
+{
+    SyncManager* sm = syncManagers_.value(activeSyncManager);
+    if (!sm)
+        return ConsoleResultFailure("No active scene replication.");
+    
+    const SyncStats& stats = sm->GetStats();
+    if (!stats.updates_)
+        return ConsoleResultFailure("No updates since the previous call.");
+    
+    uint connections = std::max(stats.connections_, 1U);
+    LogInfo("Scene replication over " + ToString<uint>(stats.updates_) + " updates, " + ToString<uint>(stats.connections_) + " connection updates:");
+    LogInfo("  bytes/update: " + ToString<double>((double)stats.bytes_ / stats.updates_) +
+        ", bytes/connection/update: " + ToString<double>((double)stats.bytes_ / connections));
+    LogInfo("  messages/update: " + ToString<double>((double)stats.messages_ / stats.updates_) +
+        ", deferred entities/update: " + ToString<double>((double)stats.deferred_ / stats.updates_));
+    LogInfo("  serializations/update: " + ToString<double>((double)stats.encodes_ / stats.updates_) +
+        ", reused/update: " + ToString<double>((double)stats.encode_hits_ / stats.updates_));
+    LogInfo("  update time: " + ToString<double>(stats.time_ * 1000.0 / stats.updates_) + " ms");
+    sm->ResetStats();
+    
+    return ConsoleResultSuccess();
+}
+
 bool TundraLogicModule::IsServer() const
 {
     return kristalliModule_->IsServer();
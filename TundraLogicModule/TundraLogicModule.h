@@ -94,6 +94,9 @@ public:
     /// Change primary view to another already established connection
     ConsoleCommandResult ConsoleChangeConnection(const StringVector& params);
     
+    /// Prints and resets scene replication statistics
+    ConsoleCommandResult ConsoleSyncStats(const StringVector& params);
+    
     /// Check whether we are a server
     bool IsServer() const;
     